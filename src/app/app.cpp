@@ -40,6 +40,7 @@
 #include "app/resource_finder.h"
 #include "app/send_crash.h"
 #include "app/site.h"
+#include "app/startup_trace.h"
 #include "app/tools/active_tool.h"
 #include "app/tools/tool_box.h"
 #include "app/ui/backup_indicator.h"
@@ -78,6 +79,7 @@
   #include "os/x11/system.h"
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 
@@ -251,6 +253,10 @@ int App::initialize(const AppOptions& options)
 {
   os::System* system = os::instance();
 
+  std::unique_ptr<StartupTrace> trace;
+  if (options.traceStartup())
+    trace = std::make_unique<StartupTrace>();
+
   m_isGui = options.startUI() && !options.previewCLI();
 
   // Notify the scripting engine that we're going to enter to GUI
@@ -263,7 +269,10 @@ int App::initialize(const AppOptions& options)
 #endif
 
   m_isShell = options.startShell();
-  m_coreModules = std::make_unique<CoreModules>();
+  {
+    StartupTrace::Phase phase(trace.get(), "preferences");
+    m_coreModules = std::make_unique<CoreModules>();
+  }
 
   auto& pref = preferences();
 
@@ -311,7 +320,10 @@ int App::initialize(const AppOptions& options)
       break;
   }
 
-  initialize_color_spaces(pref);
+  {
+    StartupTrace::Phase phase(trace.get(), "color spaces");
+    initialize_color_spaces(pref);
+  }
 
 #ifdef ENABLE_DRM
   LOG("APP: Initializing DRM...\n");
@@ -324,24 +336,43 @@ int App::initialize(const AppOptions& options)
 #endif
 
   // Load modules
-  m_modules = std::make_unique<Modules>(createLogInDesktop, pref);
-  m_legacy = std::make_unique<LegacyModules>(isGui() ? REQUIRE_INTERFACE : 0);
-  m_brushes = std::make_unique<AppBrushes>();
+  {
+    StartupTrace::Phase phase(trace.get(), "modules");
+    m_modules = std::make_unique<Modules>(createLogInDesktop, pref);
+  }
 
-  // Data recovery is enabled only in GUI mode
-  if (isGui() && pref.general.dataRecovery())
+  // Data recovery is enabled only in GUI mode. The search of sessions
+  // is done in a background thread, so we start it as soon as
+  // possible to overlap it with the rest of the initialization.
+  if (isGui() && pref.general.dataRecovery()) {
+    StartupTrace::Phase phase(trace.get(), "data recovery");
     m_modules->createDataRecovery(context());
+    m_modules->searchDataRecoverySessions();
+  }
+
+  {
+    StartupTrace::Phase phase(trace.get(), isGui() ? "gui and theme" : "legacy modules");
+    m_legacy = std::make_unique<LegacyModules>(isGui() ? REQUIRE_INTERFACE : 0);
+  }
+  {
+    StartupTrace::Phase phase(trace.get(), "brushes");
+    m_brushes = std::make_unique<AppBrushes>();
+  }
 
   if (isPortable())
     LOG("APP: Running in portable mode\n");
 
   // Load or create the default palette, or migrate the default
   // palette from an old format palette to the new one, etc.
-  load_default_palette();
+  {
+    StartupTrace::Phase phase(trace.get(), "default palette");
+    load_default_palette();
+  }
 
   // Initialize GUI interface
   if (isGui()) {
     LOG("APP: GUI mode\n");
+    StartupTrace::Phase phase(trace.get(), "main window");
 
     // Set the ClipboardDelegate impl to copy/paste text in the native
     // clipboard from the ui::Entry control.
@@ -361,10 +392,6 @@ int App::initialize(const AppOptions& options)
     if (m_mod)
       m_mod->modMainWindow(m_mainWindow.get());
 
-    // Data recovery is enabled only in GUI mode
-    if (pref.general.dataRecovery())
-      m_modules->searchDataRecoverySessions();
-
     // Default status of the main window.
     app_rebuild_documents_tabs();
     m_mainWindow->statusBar()->showDefaultText();
@@ -391,9 +418,20 @@ int App::initialize(const AppOptions& options)
   }
 
 #ifdef ENABLE_SCRIPTING
-  // Call the init() function from all plugins
+  // Call the init() function from all plugins. With the GUI, the
+  // scripts are initialized after the main window is shown (one
+  // extension per iteration of the message loop), unless a script is
+  // going to be executed from the CLI (it could use commands from
+  // plugins).
   LOG("APP: Initializing scripts...\n");
-  extensions().executeInitActions();
+  {
+    StartupTrace::Phase phase(trace.get(), "scripts");
+    const bool hasCliScripts =
+      std::any_of(options.values().begin(), options.values().end(), [&options](const auto& value) {
+        return (value.option() == &options.script());
+      });
+    extensions().executeInitActions(isGui() && !hasCliScripts);
+  }
 #endif
 
   // Process options
@@ -406,12 +444,19 @@ int App::initialize(const AppOptions& options)
     else
       delegate.reset(new DefaultCliDelegate);
 
+    StartupTrace::Phase phase(trace.get(), "cli options");
     CliProcessor cli(delegate.get(), options);
     code = cli.process(context());
   }
 
   LOG("APP: Finish launching...\n");
-  system->finishLaunching();
+  {
+    StartupTrace::Phase phase(trace.get(), "finish launching");
+    system->finishLaunching();
+  }
+
+  if (trace)
+    trace->print(std::cerr);
   return code;
 }
 
@@ -63,7 +63,7 @@ AppOptions::AppOptions(int argc, const char* argv[])
              .description("File to store the sprite sheet metadata"))
   , m_format(m_po.add("format")
                .requiresValue("<format>")
-               .description("Format to export the data file\n(json-hash, json-array)"))
+               .description("Format to export the data file\n(json-hash, json-array, cbor)"))
   , m_sheet(m_po.add("sheet")
               .requiresValue("<filename.png>")
               .description("Image file to save the texture"))
@@ -161,10 +161,27 @@ AppOptions::AppOptions(int argc, const char* argv[])
       m_po.add("list-slices")
         .description("List slices of the next given sprite\nor include slices in JSON data"))
   , m_oneFrame(m_po.add("oneframe").description("Load just the first frame"))
+  , m_skipHiddenLayers(
+      m_po.add("skip-hidden-layers")
+        .description("Don't load the pixels of hidden layers\nof the next given PSD file"))
   , m_exportTileset(
       m_po.add("export-tileset").description("Export only tilesets from visible tilemap layers"))
+  , m_fileSync(
+      m_po.add("file-sync")
+        .requiresValue("<policy>")
+        .description(
+          "When the next saved files are flushed to disk:\n  each (default, after each file)\n  end (once after all files)\n  none"))
+  , m_atomicSave(m_po.add("atomic-save")
+                   .description("Write the next saved files in temporary\n"
+                                "files and rename them when they are complete"))
+  , m_pngCompression(m_po.add("png-compression")
+                       .requiresValue("<preset>")
+                       .description("Compression of the next saved PNG files\nor sheet:\n"
+                                    "  default\n  fast\n  smallest"))
   , m_verbose(m_po.add("verbose").mnemonic('v').description("Explain what is being done"))
   , m_debug(m_po.add("debug").description("Extreme verbose mode and\ncopy log to desktop"))
+  , m_traceStartup(m_po.add("trace-startup")
+                     .description("Print the time spent in each phase\nof the program initialization"))
 #ifdef ENABLE_STEAM
   , m_noInApp(m_po.add("noinapp").description(
       "Disable \"in game\" visibility on Steam\nDoesn't count playtime"))
@@ -206,6 +223,11 @@ bool AppOptions::hasExporterParams() const
   return m_po.enabled(m_data) || m_po.enabled(m_sheet);
 }
 
+bool AppOptions::traceStartup() const
+{
+  return m_po.enabled(m_traceStartup);
+}
+
 #ifdef ENABLE_STEAM
 bool AppOptions::noInApp() const
 {
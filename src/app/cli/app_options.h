@@ -40,6 +40,7 @@ public:
   bool showHelp() const { return m_showHelp; }
   bool showVersion() const { return m_showVersion; }
   VerboseLevel verboseLevel() const { return m_verboseLevel; }
+  bool traceStartup() const;
 
   const ValueList& values() const { return m_po.values(); }
 
@@ -92,7 +93,11 @@ public:
   const Option& listTags() const { return m_listTags; }
   const Option& listSlices() const { return m_listSlices; }
   const Option& oneFrame() const { return m_oneFrame; }
+  const Option& skipHiddenLayers() const { return m_skipHiddenLayers; }
   const Option& exportTileset() const { return m_exportTileset; }
+  const Option& fileSync() const { return m_fileSync; }
+  const Option& atomicSave() const { return m_atomicSave; }
+  const Option& pngCompression() const { return m_pngCompression; }
 
   bool hasExporterParams() const;
 #ifdef ENABLE_STEAM
@@ -167,10 +172,15 @@ private:
   Option& m_listTags;
   Option& m_listSlices;
   Option& m_oneFrame;
+  Option& m_skipHiddenLayers;
   Option& m_exportTileset;
+  Option& m_fileSync;
+  Option& m_atomicSave;
+  Option& m_pngCompression;
 
   Option& m_verbose;
   Option& m_debug;
+  Option& m_traceStartup;
 #ifdef ENABLE_STEAM
   Option& m_noInApp;
 #endif
@@ -20,6 +20,8 @@
 #include "app/doc_exporter.h"
 #include "app/doc_undo.h"
 #include "app/file/file.h"
+#include "app/file/file_sync.h"
+#include "app/file/png_options.h"
 #include "app/filename_formatter.h"
 #include "app/restore_visible_layers.h"
 #include "app/ui_context.h"
@@ -177,6 +179,7 @@ int CliProcessor::process(Context* ctx)
     Params scriptParams;
 #endif
     Console console;
+    FileSyncBatch fileSync;
     CliOpenFile cof;
     SpriteSheetType sheetType = SpriteSheetType::None;
     Doc* lastDoc = nullptr;
@@ -202,6 +205,8 @@ int CliProcessor::process(Context* ctx)
               format = SpriteSheetDataFormat::JsonHash;
             else if (value.value() == "json-array")
               format = SpriteSheetDataFormat::JsonArray;
+            else if (value.value() == "cbor")
+              format = SpriteSheetDataFormat::Cbor;
 
             m_exporter->setDataFormat(format);
           }
@@ -585,10 +590,45 @@ int CliProcessor::process(Context* ctx)
         else if (opt == &m_options.oneFrame()) {
           cof.oneFrame = true;
         }
+        // --skip-hidden-layers
+        else if (opt == &m_options.skipHiddenLayers()) {
+          cof.skipHiddenLayers = true;
+        }
         // --export-tileset
         else if (opt == &m_options.exportTileset()) {
           cof.exportTileset = true;
         }
+        // --file-sync <policy>
+        else if (opt == &m_options.fileSync()) {
+          FileSyncOptions opts = fileSync.options();
+          if (value.value() == "each")
+            opts.policy = FileSyncPolicy::EachFile;
+          else if (value.value() == "end")
+            opts.policy = FileSyncPolicy::EndOfBatch;
+          else if (value.value() == "none")
+            opts.policy = FileSyncPolicy::None;
+          else
+            throw std::runtime_error("--file-sync needs a valid policy\n"
+                                     "Usage: --file-sync <policy>\n"
+                                     "Where <policy> can be each, end, or none");
+          fileSync.setOptions(opts);
+        }
+        // --png-compression <preset>
+        else if (opt == &m_options.pngCompression()) {
+          PngOptions::Compression compression;
+          if (!PngOptions::parseCompression(value.value(), compression))
+            throw std::runtime_error("--png-compression needs a valid preset\n"
+                                     "Usage: --png-compression <preset>\n"
+                                     "Where <preset> can be default, fast, or smallest");
+
+          cof.pngCompression = value.value();
+        }
+        // --atomic-save
+        else if (opt == &m_options.atomicSave()) {
+          FileSyncOptions opts = fileSync.options();
+          opts.atomicSave = true;
+          fileSync.setOptions(opts);
+        }
       }
       // File names aren't associated to any option
       else {
@@ -611,9 +651,26 @@ int CliProcessor::process(Context* ctx)
         sheetType = SpriteSheetType::Rows;
       m_exporter->setSpriteSheetType(sheetType);
 
+      // The --png-compression preset is applied to the sheet even if
+      // it was specified before --sheet
+      PngOptions::Compression compression;
+      if (PngOptions::parseCompression(cof.pngCompression, compression)) {
+        auto opts = std::make_shared<PngOptions>();
+        opts->setCompression(compression);
+        m_exporter->setTextureFormatOptions(opts);
+      }
+
       m_delegate->exportFiles(ctx, *m_exporter.get());
       m_exporter.reset(nullptr);
     }
+
+    // Sync files saved with "--file-sync end"
+    try {
+      fileSync.flush();
+    }
+    catch (const std::exception& ex) {
+      console.printf("%s\n", ex.what());
+    }
   }
 
   // Running mode
@@ -635,7 +692,7 @@ bool CliProcessor::openFile(Context* ctx, CliOpenFile& cof)
 
   Doc* oldDoc = ctx->activeDocument();
 
-  m_batch.open(ctx, cof.filename, cof.oneFrame);
+  m_batch.open(ctx, cof.filename, cof.oneFrame, cof.skipHiddenLayers);
 
   // Mark used file names as "already processed" so we don't try to
   // open then again
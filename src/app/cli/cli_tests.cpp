@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2019  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,8 +10,10 @@
 #include "app/cli/app_options.h"
 #include "app/cli/cli_processor.h"
 #include "app/doc_exporter.h"
+#include "app/file/png_options.h"
 
 #include <initializer_list>
+#include <memory>
 
 using namespace app;
 
@@ -34,13 +36,17 @@ public:
   void beforeOpenFile(const CliOpenFile& cof) override {}
   void afterOpenFile(const CliOpenFile& cof) override {}
   void saveFile(Context* ctx, const CliOpenFile& cof) override {}
-  void exportFiles(Context* ctx, DocExporter& exporter) override {}
+  void exportFiles(Context* ctx, DocExporter& exporter) override
+  {
+    m_textureFormatOptions = exporter.textureFormatOptions();
+  }
 #ifdef ENABLE_SCRIPTING
   int execScript(const std::string& filename, const Params& params) override { return 0; }
 #endif
 
   bool helpWasShown() const { return m_helpWasShown; }
   bool versionWasShown() const { return m_versionWasShown; }
+  const FormatOptionsPtr& textureFormatOptions() const { return m_textureFormatOptions; }
 
 private:
   bool m_helpWasShown;
@@ -48,6 +54,7 @@ private:
   bool m_uiMode;
   bool m_shellMode;
   bool m_batchMode;
+  FormatOptionsPtr m_textureFormatOptions;
 };
 
 std::unique_ptr<AppOptions> args(std::initializer_list<const char*> l)
@@ -92,3 +99,15 @@ TEST(Cli, Version)
   p.process(nullptr);
   EXPECT_TRUE(d.versionWasShown());
 }
+
+TEST(Cli, PngCompressionBeforeSheet)
+{
+  CliTestDelegate d;
+  auto a = args({ "--png-compression", "fast", "--sheet", "sheet.png" });
+  CliProcessor p(&d, *a);
+  p.process(nullptr);
+
+  auto opts = std::dynamic_pointer_cast<PngOptions>(d.textureFormatOptions());
+  ASSERT_TRUE(opts != nullptr);
+  EXPECT_EQ(PngOptions::Compression::Fast, opts->compression());
+}
@@ -30,6 +30,7 @@
 
 #ifdef ENABLE_SCRIPTING
   #include "app/app.h"
+  #include "app/extensions.h"
   #include "app/script/engine.h"
   #include "app/script/script_input_chain.h"
   #include "app/ui/input_chain.h"
@@ -104,6 +105,9 @@ void DefaultCliDelegate::saveFile(Context* ctx, const CliOpenFile& cof)
   if (cof.ignoreEmpty)
     params.set("ignoreEmpty", "true");
 
+  if (!cof.pngCompression.empty())
+    params.set("pngCompression", cof.pngCompression.c_str());
+
   ctx->executeCommand(saveAsCommand, params);
 }
 
@@ -141,6 +145,9 @@ int DefaultCliDelegate::execScript(const std::string& filename, const Params& pa
   if (!App::instance()->isGui()) {
     App::instance()->inputChain().prioritize(&scriptInputChain, nullptr);
   }
+  // Scripts can use commands from plugins
+  App::instance()->extensions().initPendingScripts();
+
   auto engine = App::instance()->scriptEngine();
   if (!engine->evalUserFile(filename, params))
     throw base::Exception("Error executing script %s", filename.c_str());
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2021  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -16,102 +16,253 @@
 #include "app/doc.h"
 #include "doc/cels_range.h"
 #include "doc/palette.h"
+#include "doc/parallel_for.h"
 #include "doc/sprite.h"
+#include "doc/tile.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
 #include "os/color_space.h"
 #include "os/system.h"
 
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <vector>
+
 namespace app { namespace cmd {
 
-static doc::ImageRef convert_image_color_space(const doc::Image* srcImage,
-                                               const gfx::ColorSpaceRef& newCS,
-                                               os::ColorSpaceConversion* conversion)
-{
-  ImageSpec spec = srcImage->spec();
-  spec.setColorSpace(newCS);
-  ImageRef dstImage(Image::create(spec));
+namespace {
+
+// Last conversions created for each (src, dst) pair of color spaces,
+// so converting several sprites/images between the same profiles
+// (e.g. loading files or generating thumbnails) doesn't re-create the
+// os::ColorSpace/os::ColorSpaceConversion objects each time.
+class ConversionsCache {
+public:
+  static constexpr std::size_t kMaxSize = 4;
+
+  os::Ref<os::ColorSpaceConversion> get(const gfx::ColorSpaceRef& srcCS,
+                                        const gfx::ColorSpaceRef& dstCS)
+  {
+    std::lock_guard lock(m_mutex);
+
+    for (auto it = m_items.begin(); it != m_items.end(); ++it) {
+      if ((it->src == srcCS || it->src->nearlyEqual(*srcCS)) &&
+          (it->dst == dstCS || it->dst->nearlyEqual(*dstCS))) {
+        // Move to the front (most recently used)
+        std::rotate(m_items.begin(), it, it + 1);
+        return m_items.front().conversion;
+      }
+    }
 
-  if (!conversion) {
-    dstImage->copy(srcImage, gfx::Clip(0, 0, srcImage->bounds()));
-    return dstImage;
+    os::System* system = os::instance();
+    auto srcOCS = system->makeColorSpace(srcCS);
+    auto dstOCS = system->makeColorSpace(dstCS);
+    ASSERT(srcOCS);
+    ASSERT(dstOCS);
+
+    Item item{ srcCS, dstCS, system->convertBetweenColorSpace(srcOCS, dstOCS) };
+    m_items.insert(m_items.begin(), item);
+    if (m_items.size() > kMaxSize)
+      m_items.pop_back();
+    return item.conversion;
   }
 
-  if (spec.colorMode() == doc::ColorMode::RGB) {
-    for (int y = 0; y < spec.height(); ++y) {
+private:
+  struct Item {
+    gfx::ColorSpaceRef src;
+    gfx::ColorSpaceRef dst;
+    os::Ref<os::ColorSpaceConversion> conversion;
+  };
+  std::mutex m_mutex;
+  std::vector<Item> m_items;
+};
+
+ConversionsCache g_conversions;
+
+// Number of rows converted by each task (so big images are converted
+// by several threads too).
+constexpr int kRowsPerTask = 128;
+
+// A band of rows of an image to convert.
+struct ConvertTask {
+  const doc::Image* src;
+  doc::Image* dst;
+  int y1, y2;
+};
+
+void convert_rows(const ConvertTask& task, os::ColorSpaceConversion* conversion)
+{
+  const doc::Image* srcImage = task.src;
+  doc::Image* dstImage = task.dst;
+  const int w = srcImage->width();
+
+  if (srcImage->colorMode() == doc::ColorMode::RGB) {
+    for (int y = task.y1; y < task.y2; ++y) {
       conversion->convertRgba((uint32_t*)dstImage->getPixelAddress(0, y),
                               (const uint32_t*)srcImage->getPixelAddress(0, y),
-                              spec.width());
+                              w);
     }
   }
-  else if (spec.colorMode() == doc::ColorMode::GRAYSCALE) {
+  else if (srcImage->colorMode() == doc::ColorMode::GRAYSCALE) {
     // TODO create a set of functions to create pixel format
     // conversions (this should be available when we add new kind of
     // pixel formats).
-    std::vector<uint8_t> buf(spec.width() * spec.height());
+    std::vector<uint8_t> buf(std::size_t(w) * (task.y2 - task.y1));
 
     auto it = buf.begin();
-    for (int y = 0; y < spec.height(); ++y) {
+    for (int y = task.y1; y < task.y2; ++y) {
       auto srcPtr = (const uint16_t*)srcImage->getPixelAddress(0, y);
-      for (int x = 0; x < spec.width(); ++x, ++srcPtr, ++it)
+      for (int x = 0; x < w; ++x, ++srcPtr, ++it)
         *it = doc::graya_getv(*srcPtr);
     }
 
-    conversion->convertGray(&buf[0], &buf[0], spec.width() * spec.height());
+    conversion->convertGray(&buf[0], &buf[0], int(buf.size()));
 
     it = buf.begin();
-    for (int y = 0; y < spec.height(); ++y) {
+    for (int y = task.y1; y < task.y2; ++y) {
       auto srcPtr = (const uint16_t*)srcImage->getPixelAddress(0, y);
       auto dstPtr = (uint16_t*)dstImage->getPixelAddress(0, y);
-      for (int x = 0; x < spec.width(); ++x, ++dstPtr, ++srcPtr, ++it)
+      for (int x = 0; x < w; ++x, ++dstPtr, ++srcPtr, ++it)
         *dstPtr = doc::graya(*it, doc::graya_geta(*srcPtr));
     }
   }
+}
 
-  return dstImage;
+// Converts all the given images to the new color space. Bands of rows
+// of all images are converted in parallel.
+std::vector<ImageRef> convert_images_color_space(const std::vector<const doc::Image*>& srcImages,
+                                                 const gfx::ColorSpaceRef& newCS,
+                                                 os::ColorSpaceConversion* conversion)
+{
+  std::vector<ImageRef> dstImages;
+  std::vector<ConvertTask> tasks;
+  dstImages.reserve(srcImages.size());
+
+  for (const doc::Image* srcImage : srcImages) {
+    ImageSpec spec = srcImage->spec();
+    spec.setColorSpace(newCS);
+    ImageRef dstImage(Image::create(spec));
+
+    if (conversion && (spec.colorMode() == doc::ColorMode::RGB ||
+                       spec.colorMode() == doc::ColorMode::GRAYSCALE)) {
+      for (int y = 0; y < spec.height(); y += kRowsPerTask) {
+        const int y2 = std::min(y + kRowsPerTask, spec.height());
+        tasks.push_back(ConvertTask{ srcImage, dstImage.get(), y, y2 });
+      }
+    }
+    else {
+      dstImage->copy(srcImage, gfx::Clip(0, 0, srcImage->bounds()));
+    }
+
+    dstImages.push_back(dstImage);
+  }
+
+  doc::parallel_for_bands(0, int(tasks.size()), 2, [&tasks, conversion](int a, int b) {
+    for (int i = a; i < b; ++i)
+      convert_rows(tasks[i], conversion);
+  });
+
+  return dstImages;
 }
 
-void convert_color_profile(doc::Sprite* sprite, const gfx::ColorSpaceRef& newCS)
+// Converts all palette entries with one convertRgba() call.
+void convert_palette_color_space(const doc::Palette* srcPal,
+                                 doc::Palette* dstPal,
+                                 os::ColorSpaceConversion* conversion)
 {
-  ASSERT(sprite->colorSpace());
-  ASSERT(newCS);
+  ASSERT(srcPal->size() == dstPal->size());
 
-  os::System* system = os::instance();
-  auto srcOCS = system->makeColorSpace(sprite->colorSpace());
-  auto dstOCS = system->makeColorSpace(newCS);
-  ASSERT(srcOCS);
-  ASSERT(dstOCS);
+  const int n = srcPal->size();
+  std::vector<color_t> colors(n);
+  conversion->convertRgba((uint32_t*)colors.data(), (const uint32_t*)srcPal->rawColorsData(), n);
 
-  auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
+  for (int i = 0; i < n; ++i)
+    dstPal->setEntry(i, colors[i]);
+}
 
-  // Convert images
-  if (sprite->pixelFormat() != doc::IMAGE_INDEXED) {
-    for (Cel* cel : sprite->uniqueCels()) {
-      ImageRef old_image = cel->imageRef();
-      if (old_image.get()->pixelFormat() != IMAGE_TILEMAP) {
-        ImageRef new_image = convert_image_color_space(old_image.get(), newCS, conversion.get());
+// Returns the images of the sprite that must be converted: images of
+// regular cels and tiles of all tilesets (without the empty tile).
+std::vector<ImageRef> get_sprite_images(const doc::Sprite* sprite)
+{
+  std::vector<ImageRef> images;
+  std::set<ObjectId> ids;
 
-        sprite->replaceImage(old_image->id(), new_image);
+  for (Cel* cel : sprite->uniqueCels()) {
+    ImageRef image = cel->imageRef();
+    if (image->pixelFormat() != IMAGE_TILEMAP && ids.insert(image->id()).second)
+      images.push_back(image);
+  }
+
+  if (sprite->hasTilesets()) {
+    for (const Tileset* tileset : *sprite->tilesets()) {
+      if (!tileset)
+        continue;
+
+      for (tile_index i = doc::notile + 1; i < tileset->size(); ++i) {
+        ImageRef image = tileset->get(i);
+        if (image && ids.insert(image->id()).second)
+          images.push_back(image);
       }
     }
   }
 
+  return images;
+}
+
+// Converts the images and palettes of the sprite to the new color
+// space, calling replaceImage(oldImage, newImage) for each image and
+// setPalette(newPal) for each modified palette.
+template<typename ReplaceImage, typename SetPalette>
+void convert_sprite_color_space(const doc::Sprite* sprite,
+                                const gfx::ColorSpaceRef& newCS,
+                                ReplaceImage replaceImage,
+                                SetPalette setPalette)
+{
+  auto conversion = g_conversions.get(sprite->colorSpace(), newCS);
+
+  // Convert images
+  if (sprite->pixelFormat() != doc::IMAGE_INDEXED) {
+    const std::vector<ImageRef> oldImages = get_sprite_images(sprite);
+    std::vector<const doc::Image*> srcImages(oldImages.size());
+    for (std::size_t i = 0; i < oldImages.size(); ++i)
+      srcImages[i] = oldImages[i].get();
+
+    const std::vector<ImageRef> newImages =
+      convert_images_color_space(srcImages, newCS, conversion.get());
+
+    for (std::size_t i = 0; i < oldImages.size(); ++i)
+      replaceImage(oldImages[i], newImages[i]);
+  }
+
   if (conversion) {
     // Convert palette
     if (sprite->pixelFormat() != doc::IMAGE_GRAYSCALE) {
       for (auto& pal : sprite->getPalettes()) {
         Palette newPal(pal->frame(), pal->size());
-
-        for (int i = 0; i < pal->size(); ++i) {
-          color_t oldCol = pal->entry(i);
-          color_t newCol = pal->entry(i);
-          conversion->convertRgba((uint32_t*)&newCol, (const uint32_t*)&oldCol, 1);
-          newPal.setEntry(i, newCol);
-        }
+        convert_palette_color_space(pal, &newPal, conversion.get());
 
         if (*pal != newPal)
-          sprite->setPalette(&newPal, false);
+          setPalette(&newPal);
       }
     }
   }
+}
+
+} // anonymous namespace
+
+void convert_color_profile(doc::Sprite* sprite, const gfx::ColorSpaceRef& newCS)
+{
+  ASSERT(sprite->colorSpace());
+  ASSERT(newCS);
+
+  convert_sprite_color_space(
+    sprite,
+    newCS,
+    [sprite](const ImageRef& oldImage, const ImageRef& newImage) {
+      sprite->replaceImage(oldImage->id(), newImage);
+    },
+    [sprite](const Palette* newPal) { sprite->setPalette(newPal, false); });
 
   sprite->setColorSpace(newCS);
 
@@ -127,30 +278,19 @@ void convert_color_profile(doc::Image* image,
   ASSERT(oldCS);
   ASSERT(newCS);
 
-  os::System* system = os::instance();
-  auto srcOCS = system->makeColorSpace(oldCS);
-  auto dstOCS = system->makeColorSpace(newCS);
-  ASSERT(srcOCS);
-  ASSERT(dstOCS);
-
-  auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
+  auto conversion = g_conversions.get(oldCS, newCS);
   if (conversion) {
     switch (image->pixelFormat()) {
       case doc::IMAGE_RGB:
       case doc::IMAGE_GRAYSCALE: {
-        ImageRef newImage = convert_image_color_space(image, newCS, conversion.get());
+        ImageRef newImage = convert_images_color_space({ image }, newCS, conversion.get()).front();
 
         image->copy(newImage.get(), gfx::Clip(image->bounds()));
         break;
       }
 
       case doc::IMAGE_INDEXED: {
-        for (int i = 0; i < palette->size(); ++i) {
-          color_t oldCol, newCol;
-          oldCol = newCol = palette->entry(i);
-          conversion->convertRgba((uint32_t*)&newCol, (const uint32_t*)&oldCol, 1);
-          palette->setEntry(i, newCol);
-        }
+        convert_palette_color_space(palette, palette, conversion.get());
         break;
       }
     }
@@ -160,49 +300,18 @@ void convert_color_profile(doc::Image* image,
 ConvertColorProfile::ConvertColorProfile(doc::Sprite* sprite, const gfx::ColorSpaceRef& newCS)
   : WithSprite(sprite)
 {
-  os::System* system = os::instance();
-
   ASSERT(sprite->colorSpace());
   ASSERT(newCS);
 
-  auto srcOCS = system->makeColorSpace(sprite->colorSpace());
-  auto dstOCS = system->makeColorSpace(newCS);
-
-  ASSERT(srcOCS);
-  ASSERT(dstOCS);
-
-  auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
-
-  // Convert images
-  if (sprite->pixelFormat() != doc::IMAGE_INDEXED) {
-    for (Cel* cel : sprite->uniqueCels()) {
-      ImageRef old_image = cel->imageRef();
-      if (old_image.get()->pixelFormat() != IMAGE_TILEMAP) {
-        ImageRef new_image = convert_image_color_space(old_image.get(), newCS, conversion.get());
-
-        m_seq.add(new cmd::ReplaceImage(sprite, old_image, new_image));
-      }
-    }
-  }
-
-  if (conversion) {
-    // Convert palette
-    if (sprite->pixelFormat() != doc::IMAGE_GRAYSCALE) {
-      for (auto& pal : sprite->getPalettes()) {
-        Palette newPal(pal->frame(), pal->size());
-
-        for (int i = 0; i < pal->size(); ++i) {
-          color_t oldCol = pal->entry(i);
-          color_t newCol = pal->entry(i);
-          conversion->convertRgba((uint32_t*)&newCol, (const uint32_t*)&oldCol, 1);
-          newPal.setEntry(i, newCol);
-        }
-
-        if (*pal != newPal)
-          m_seq.add(new cmd::SetPalette(sprite, pal->frame(), &newPal));
-      }
-    }
-  }
+  convert_sprite_color_space(
+    sprite,
+    newCS,
+    [this, sprite](const ImageRef& oldImage, const ImageRef& newImage) {
+      m_seq.add(new cmd::ReplaceImage(sprite, oldImage, newImage));
+    },
+    [this, sprite](const Palette* newPal) {
+      m_seq.add(new cmd::SetPalette(sprite, newPal->frame(), newPal));
+    });
 
   m_seq.add(new cmd::AssignColorProfile(sprite, newCS));
 }
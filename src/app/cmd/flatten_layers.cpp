@@ -31,14 +31,38 @@
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
 #include "doc/layer.h"
+#include "doc/parallel_for.h"
 #include "doc/primitives.h"
 #include "doc/sprite.h"
 #include "render/render.h"
 
 #include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
 
 namespace app { namespace cmd {
 
+namespace {
+
+// Cel data and z-index of each visible layer in a frame. Two frames
+// with the same key have the same rendered image.
+using FrameKey = std::vector<std::pair<const doc::CelData*, int>>;
+
+struct FrameResult {
+  doc::frame_t frame;
+  int renderedIndex;              // Index of the result with the rendered image for this frame
+  doc::ImageRef image = nullptr;  // Cropped image (nullptr if fully transparent)
+  gfx::Rect bounds;               // Bounds of the cropped image in the rendered area
+  doc::Cel* newCel = nullptr;     // New cel created for this frame in the flatLayer
+
+  FrameResult(doc::frame_t frame, int renderedIndex) : frame(frame), renderedIndex(renderedIndex)
+  {
+  }
+};
+
+} // anonymous namespace
+
 FlattenLayers::FlattenLayers(doc::Sprite* sprite,
                              const doc::SelectedLayers& layers0,
                              const Options options)
@@ -92,9 +116,6 @@ void FlattenLayers::onExecute()
     area.setSize(spec.size());
   }
 
-  // Create a temporary image.
-  ImageRef image(Image::create(spec));
-
   LayerImage* flatLayer; // The layer onto which everything will be flattened.
   color_t bgcolor;       // The background color to use for flatLayer.
   bool newFlatLayer = false;
@@ -119,10 +140,6 @@ void FlattenLayers::onExecute()
     bgcolor = sprite->transparentColor();
   }
 
-  render::Render render;
-  render.setNewBlend(m_options.newBlendMethod);
-  render.setBgOptions(render::BgOptions::MakeNone());
-
   {
     // Show only the layers to be flattened so other layers are hidden
     // temporarily.
@@ -131,10 +148,11 @@ void FlattenLayers::onExecute()
 
     const LayerList visibleLayers = sprite->allVisibleLayers();
 
-    // Map draw area to image coords
-    const gfx::ClipF area_to_image(0, 0, area);
-
-    // Copy all frames to the background.
+    // Frames to be rendered. Frames where all the visible layers have
+    // the same cels (linked cels, same z-index) are rendered once.
+    std::vector<FrameResult> results;
+    std::vector<int> toRender;
+    std::map<FrameKey, int> renderedFrames;
     for (frame_t frame(0); frame < sprite->totalFrames(); ++frame) {
       // If the flatLayer is the only cel in this frame, we can skip
       // this frame to keep existing links in the flatLayer.
@@ -146,29 +164,77 @@ void FlattenLayers::onExecute()
       if (!anotherCelExists)
         continue;
 
-      // Clear the image and render this frame.
-      clear_image(image.get(), bgcolor);
-      render.renderSprite(image.get(), sprite, frame, area_to_image);
+      FrameKey key;
+      key.reserve(visibleLayers.size());
+      for (const Layer* layer : visibleLayers) {
+        const Cel* cel = layer->cel(frame);
+        key.emplace_back(cel ? cel->data() : nullptr, cel ? cel->zIndex() : 0);
+      }
+
+      const int i = int(results.size());
+      auto it = renderedFrames.find(key);
+      if (it != renderedFrames.end()) {
+        results.emplace_back(frame, it->second);
+      }
+      else {
+        renderedFrames[key] = i;
+        results.emplace_back(frame, i);
+        toRender.push_back(i);
+      }
+    }
+
+    // Render frames from several threads, each band with its own
+    // render::Render and temporary image.
+    const gfx::ClipF area_to_image(0, 0, area);
+    doc::parallel_for_bands(0, int(toRender.size()), 4, [&](const int a, const int b) {
+      render::Render render;
+      render.setNewBlend(m_options.newBlendMethod);
+      render.setBgOptions(render::BgOptions::MakeNone());
+
+      ImageRef image(Image::create(spec));
+      for (int j = a; j < b; ++j) {
+        FrameResult& result = results[toRender[j]];
+
+        // Clear the image and render this frame.
+        clear_image(image.get(), bgcolor);
+        render.renderSprite(image.get(), sprite, result.frame, area_to_image);
+
+        // Get exact bounds for rendered frame, the image is nullptr
+        // when it's fully transparent.
+        gfx::Rect bounds = image->bounds();
+        if (doc::algorithm::shrink_bounds(image.get(),
+                                          image->maskColor(),
+                                          nullptr,
+                                          image->bounds(),
+                                          bounds)) {
+          result.image.reset(doc::crop_image(image.get(), bounds, image->maskColor()));
+          result.bounds = bounds;
+        }
+      }
+    });
 
-      // Get exact bounds for rendered frame
-      gfx::Rect bounds = image->bounds();
-      const bool shrink = doc::algorithm::shrink_bounds(image.get(),
-                                                        image->maskColor(),
-                                                        nullptr,
-                                                        image->bounds(),
-                                                        bounds);
+    // Modify the flatLayer cels in frame order.
+    for (FrameResult& result : results) {
+      const frame_t frame = result.frame;
+      const FrameResult& rendered = results[result.renderedIndex];
+      const gfx::Rect& bounds = rendered.bounds;
 
       // Skip when fully transparent
       Cel* cel = flatLayer->cel(frame);
-      if (!shrink) {
+      if (!rendered.image) {
         if (!newFlatLayer && cel)
           executeAndAdd(new cmd::RemoveCel(cel));
 
         continue;
       }
 
-      // Apply shrunk bounds to new image
-      const ImageRef new_image(doc::crop_image(image.get(), bounds, image->maskColor()));
+      // Apply shrunk bounds to new image (a copy for identical frames,
+      // as each cel needs its own image if they are not linked)
+      auto new_image = [&rendered, &result]() -> ImageRef {
+        if (&rendered == &result)
+          return rendered.image;
+        return ImageRef(Image::createCopy(rendered.image.get()));
+      };
 
       // Replace image on existing cel
       if (cel) {
@@ -192,12 +258,19 @@ void FlattenLayers::onExecute()
         }
 
         // Modify destination cel
-        executeAndAdd(new cmd::ReplaceImage(sprite, cel_image, new_image));
+        executeAndAdd(new cmd::ReplaceImage(sprite, cel_image, new_image()));
       }
       // Add new cel on null
       else {
-        cel = new Cel(frame, new_image);
-        cel->setPosition(area.x + bounds.x, area.y + bounds.y);
+        // Link the cel with the one created for an identical frame
+        if (rendered.newCel) {
+          cel = Cel::MakeLink(frame, rendered.newCel);
+        }
+        else {
+          cel = new Cel(frame, new_image());
+          cel->setPosition(area.x + bounds.x, area.y + bounds.y);
+          result.newCel = cel;
+        }
 
         // No need to undo adding this cel when flattening onto
         // a new layer, as the layer itself would be destroyed,
@@ -0,0 +1,54 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/cmd/permute_frames.h"
+
+#include "app/doc.h"
+#include "app/doc_event.h"
+#include "doc/sprite.h"
+
+namespace app { namespace cmd {
+
+PermuteFrames::PermuteFrames(Sprite* sprite, const std::vector<frame_t>& newFrames)
+  : WithSprite(sprite)
+  , m_newFrames(newFrames)
+  , m_oldFrames(newFrames.size())
+{
+  ASSERT(frame_t(newFrames.size()) == sprite->totalFrames());
+
+  for (frame_t i = 0; i < frame_t(m_newFrames.size()); ++i)
+    m_oldFrames[m_newFrames[i]] = i;
+}
+
+void PermuteFrames::onExecute()
+{
+  Sprite* spr = sprite();
+  spr->permuteFrames(m_newFrames);
+  spr->incrementVersion();
+}
+
+void PermuteFrames::onUndo()
+{
+  Sprite* spr = sprite();
+  spr->permuteFrames(m_oldFrames);
+  spr->incrementVersion();
+}
+
+void PermuteFrames::onFireNotifications()
+{
+  // Just one notification for all the moved frames and cels
+  Sprite* sprite = this->sprite();
+  Doc* doc = static_cast<Doc*>(sprite->document());
+  DocEvent ev(doc);
+  ev.sprite(sprite);
+  doc->notify_observers<DocEvent&>(&DocObserver::onGeneralUpdate, ev);
+}
+
+}} // namespace app::cmd
@@ -0,0 +1,45 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_CMD_PERMUTE_FRAMES_H_INCLUDED
+#define APP_CMD_PERMUTE_FRAMES_H_INCLUDED
+#pragma once
+
+#include "app/cmd.h"
+#include "app/cmd/with_sprite.h"
+#include "doc/frame.h"
+
+#include <vector>
+
+namespace app { namespace cmd {
+using namespace doc;
+
+// Reorders all frames of the sprite (durations and cels of all
+// layers) in one step. The frame "i" is moved to "newFrames[i]".
+// Replaces one SetFrameDuration/SetCelFrame command per affected
+// frame/cel when several frames are moved at once.
+class PermuteFrames : public Cmd,
+                      public WithSprite {
+public:
+  PermuteFrames(Sprite* sprite, const std::vector<frame_t>& newFrames);
+
+protected:
+  void onExecute() override;
+  void onUndo() override;
+  void onFireNotifications() override;
+  size_t onMemSize() const override
+  {
+    return sizeof(*this) + sizeof(frame_t) * (m_newFrames.capacity() + m_oldFrames.capacity());
+  }
+
+private:
+  std::vector<frame_t> m_newFrames;
+  std::vector<frame_t> m_oldFrames; // Inverse permutation
+};
+
+}} // namespace app::cmd
+
+#endif
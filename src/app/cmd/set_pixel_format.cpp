@@ -18,52 +18,91 @@
 #include "app/cmd/set_transparent_color.h"
 #include "app/doc.h"
 #include "app/doc_event.h"
+#include "app/util/worker_rgbmap.h"
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/document.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
+#include "doc/parallel_for.h"
 #include "doc/rgbmap.h"
 #include "doc/sprite.h"
 #include "doc/tilesets.h"
 #include "render/quantization.h"
 #include "render/task_delegate.h"
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
 namespace app { namespace cmd {
 
 using namespace doc;
 
 namespace {
 
-class SuperDelegate : public render::TaskDelegate {
+// Aggregates the progress of all the images that are converted (from
+// several threads) to report it to the given delegate.
+class SuperDelegate {
 public:
   SuperDelegate(int nimages, render::TaskDelegate* delegate)
     : m_nimages(nimages)
-    , m_curImage(0)
     , m_delegate(delegate)
   {
   }
 
-  void notifyTaskProgress(double progress) override
+  void addProgress(double delta)
   {
-    if (m_delegate)
-      m_delegate->notifyTaskProgress((progress + m_curImage) / m_nimages);
+    if (m_delegate) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_progress += delta;
+      m_delegate->notifyTaskProgress(m_progress / m_nimages);
+    }
   }
 
-  bool continueTask() override
+  bool continueTask()
   {
-    if (m_delegate)
+    if (m_delegate) {
+      std::lock_guard<std::mutex> lock(m_mutex);
       return m_delegate->continueTask();
+    }
     else
       return true;
   }
 
-  void nextImage() { ++m_curImage; }
-
 private:
+  std::mutex m_mutex;
   int m_nimages;
-  int m_curImage;
-  TaskDelegate* m_delegate;
+  double m_progress = 0.0;
+  render::TaskDelegate* m_delegate;
+};
+
+// Delegate for the conversion of one image in a worker thread.
+class ImageDelegate : public render::TaskDelegate {
+public:
+  ImageDelegate(SuperDelegate* superDel) : m_superDel(superDel) {}
+
+  ~ImageDelegate() { m_superDel->addProgress(1.0 - m_progress); }
+
+  void notifyTaskProgress(double progress) override
+  {
+    m_superDel->addProgress(progress - m_progress);
+    m_progress = progress;
+  }
+
+  bool continueTask() override { return m_superDel->continueTask(); }
+
+private:
+  SuperDelegate* m_superDel;
+  double m_progress = 0.0;
+};
+
+// An image to be converted, "frame" is used to get the palette/RgbMap.
+struct ImageToConvert {
+  ImageRef oldImage;
+  frame_t frame;
+  bool isBackground;
+  ImageRef newImage;
 };
 
 } // anonymous namespace
@@ -82,41 +121,15 @@ SetPixelFormat::SetPixelFormat(Sprite* sprite,
   if (sprite->pixelFormat() == newFormat)
     return;
 
-  // Calculate the number of images to convert just to show a proper
-  // progress bar.
-  tile_index nimages = 0;
-  for (Cel* cel : sprite->uniqueCels())
-    if (!cel->layer()->isTilemap())
-      ++nimages;
-  if (sprite->hasTilesets()) {
-    for (Tileset* tileset : *sprite->tilesets()) {
-      if (tileset)
-        nimages += tileset->size();
-    }
-  }
-
-  SuperDelegate superDel(nimages, delegate);
-
-  // Convert cel images
+  // Collect the cel images and tileset images to convert. Their
+  // ReplaceImage commands are added in this same order.
+  std::vector<ImageToConvert> images;
   for (Cel* cel : sprite->uniqueCels()) {
     if (cel->layer()->isTilemap())
       continue;
 
-    ImageRef oldImage = cel->imageRef();
-    convertImage(sprite,
-                 dithering,
-                 oldImage,
-                 cel->frame(),
-                 cel->layer()->isBackground(),
-                 mapAlgorithm,
-                 toGray,
-                 &superDel,
-                 fitCriteria);
-
-    superDel.nextImage();
+    images.push_back({ cel->imageRef(), cel->frame(), cel->layer()->isBackground(), nullptr });
   }
-
-  // Convert tileset images
   if (sprite->hasTilesets()) {
     for (Tileset* tileset : *sprite->tilesets()) {
       if (!tileset)
@@ -125,22 +138,44 @@ SetPixelFormat::SetPixelFormat(Sprite* sprite,
       for (tile_index i = 0; i < tileset->size(); ++i) {
         ImageRef oldImage = tileset->get(i);
         if (oldImage) {
-          convertImage(sprite,
-                       dithering,
-                       oldImage,
-                       0,     // TODO select a frame or generate other tilesets?
-                       false, // TODO is background? it depends of the layer where this tileset is
-                              // used
-                       mapAlgorithm,
-                       toGray,
-                       &superDel,
-                       fitCriteria);
+          images.push_back({ oldImage,
+                             0,     // TODO select a frame or generate other tilesets?
+                             false, // TODO is background? it depends of the layer where this
+                                    // tileset is used
+                             nullptr });
         }
-        superDel.nextImage();
       }
     }
   }
 
+  // Create the sprite RgbMap with the given algorithm/criteria (as
+  // the converted sprite will use it), the worker threads use their
+  // own RgbMap with the same settings.
+  if (newFormat == IMAGE_INDEXED)
+    sprite->rgbMap(0, sprite->rgbMapForSprite(), mapAlgorithm, fitCriteria);
+
+  // Convert images in parallel
+  SuperDelegate superDel(std::max<int>(1, images.size()), delegate);
+  doc::parallel_for_bands(0, int(images.size()), 1, [&](const int a, const int b) {
+    WorkerRgbMap rgbmap(sprite, mapAlgorithm, fitCriteria);
+    for (int i = a; i < b; ++i) {
+      ImageToConvert& img = images[i];
+      ImageDelegate imgDel(&superDel);
+      img.newImage = convertImage(sprite,
+                                  dithering,
+                                  img.oldImage.get(),
+                                  img.frame,
+                                  img.isBackground,
+                                  (newFormat == IMAGE_INDEXED ? rgbmap.get(img.frame) : nullptr),
+                                  toGray,
+                                  &imgDel);
+    }
+  });
+
+  for (ImageToConvert& img : images)
+    m_pre.add(new cmd::ReplaceImage(sprite, img.oldImage, img.newImage));
+  images.clear();
+
   // By default, when converting to RGB or grayscale, the mask color
   // is always 0.
   int newMaskIndex = 0;
@@ -228,45 +263,37 @@ void SetPixelFormat::setFormat(PixelFormat format)
   doc->notify_observers<DocEvent&>(&DocObserver::onPixelFormatChanged, ev);
 }
 
-void SetPixelFormat::convertImage(doc::Sprite* sprite,
-                                  const render::Dithering& dithering,
-                                  const doc::ImageRef& oldImage,
-                                  const doc::frame_t frame,
-                                  const bool isBackground,
-                                  const doc::RgbMapAlgorithm mapAlgorithm,
-                                  doc::rgba_to_graya_func toGray,
-                                  render::TaskDelegate* delegate,
-                                  const doc::FitCriteria fitCriteria)
+ImageRef SetPixelFormat::convertImage(const doc::Sprite* sprite,
+                                      const render::Dithering& dithering,
+                                      const doc::Image* oldImage,
+                                      const doc::frame_t frame,
+                                      const bool isBackground,
+                                      doc::RgbMap* rgbmap,
+                                      doc::rgba_to_graya_func toGray,
+                                      render::TaskDelegate* delegate) const
 {
   ASSERT(oldImage);
   ASSERT(oldImage->pixelFormat() != IMAGE_TILEMAP);
 
-  // Making the RGBMap for Image->INDEXDED conversion.
-  // TODO: this is needed only when newImage
-  RgbMap* rgbmap;
+  // The RGBMap is used for Image->INDEXED conversion.
   int newMaskIndex = (isBackground ? -1 : 0);
   if (m_newFormat == IMAGE_INDEXED) {
-    rgbmap = sprite->rgbMap(frame, sprite->rgbMapForSprite(), mapAlgorithm, fitCriteria);
+    ASSERT(rgbmap);
     if (m_oldFormat == IMAGE_INDEXED)
       newMaskIndex = sprite->transparentColor();
     else
       newMaskIndex = rgbmap->maskIndex();
   }
-  else {
-    rgbmap = nullptr;
-  }
-  ImageRef newImage(render::convert_pixel_format(oldImage.get(),
-                                                 nullptr,
-                                                 m_newFormat,
-                                                 dithering,
-                                                 rgbmap,
-                                                 sprite->palette(frame),
-                                                 isBackground,
-                                                 newMaskIndex,
-                                                 toGray,
-                                                 delegate));
-
-  m_pre.add(new cmd::ReplaceImage(sprite, oldImage, newImage));
+  return ImageRef(render::convert_pixel_format(oldImage,
+                                               nullptr,
+                                               m_newFormat,
+                                               dithering,
+                                               rgbmap,
+                                               sprite->palette(frame),
+                                               isBackground,
+                                               newMaskIndex,
+                                               toGray,
+                                               delegate));
 }
 
 }} // namespace app::cmd
@@ -19,8 +19,10 @@
 #include "doc/rgbmap_algorithm.h"
 
 namespace doc {
+class Image;
+class RgbMap;
 class Sprite;
-}
+} // namespace doc
 
 namespace render {
 class Dithering;
@@ -48,15 +50,14 @@ protected:
 
 private:
   void setFormat(doc::PixelFormat format);
-  void convertImage(doc::Sprite* sprite,
-                    const render::Dithering& dithering,
-                    const doc::ImageRef& oldImage,
-                    const doc::frame_t frame,
-                    const bool isBackground,
-                    const doc::RgbMapAlgorithm mapAlgorithm,
-                    doc::rgba_to_graya_func toGray,
-                    render::TaskDelegate* delegate,
-                    const doc::FitCriteria fitCriteria = doc::FitCriteria::DEFAULT);
+  doc::ImageRef convertImage(const doc::Sprite* sprite,
+                             const render::Dithering& dithering,
+                             const doc::Image* oldImage,
+                             const doc::frame_t frame,
+                             const bool isBackground,
+                             doc::RgbMap* rgbmap,
+                             doc::rgba_to_graya_func toGray,
+                             render::TaskDelegate* delegate) const;
 
   doc::PixelFormat m_oldFormat;
   doc::PixelFormat m_newFormat;
@@ -17,6 +17,7 @@
 #include "app/doc.h"
 #include "app/doc_exporter.h"
 #include "app/file/file.h"
+#include "app/file/png_options.h"
 #include "app/file_selector.h"
 #include "app/filename_formatter.h"
 #include "app/i18n/strings.h"
@@ -273,6 +274,19 @@ Doc* generate_sprite_sheet_from_params(DocExporter& exporter,
   exporter.setSplitTags(splitTags);
   exporter.setIgnoreEmptyCels(ignoreEmpty);
   exporter.setMergeDuplicates(mergeDuplicates);
+  if (!params.pngCompression().empty()) {
+    PngOptions::Compression compression;
+    if (PngOptions::parseCompression(params.pngCompression(), compression)) {
+      auto opts = std::make_shared<PngOptions>();
+      opts->setCompression(compression);
+      exporter.setTextureFormatOptions(opts);
+    }
+    else {
+      Console console;
+      console.printf("Invalid PNG compression \"%s\" (use default, fast, or smallest)\n",
+                     params.pngCompression().c_str());
+    }
+  }
   if (listLayers)
     exporter.setListLayers(true);
   if (listTags)
@@ -435,7 +449,7 @@ public:
     }
 
     if (m_dataFilename.empty() || m_dataFilename == kSpecifiedFilename)
-      m_dataFilename = base + ".json";
+      m_dataFilename = base + "." + get_sprite_sheet_data_format_extension(params.dataFormat());
 
     exportButton()->Click.connect([this] { onExport(); });
     sheetType()->Change.connect([this] { onSheetTypeChange(); });
@@ -462,6 +476,7 @@ public:
     frames()->Change.connect([this] { generatePreview(); });
     dataFilenameFormat()->Change.connect([this] { onDataFilenameFormatChange(); });
     dataTagnameFormat()->Change.connect([this] { onDataTagnameFormatChange(); });
+    dataFormat()->Change.connect([this] { onDataFormatChange(); });
     openGenerated()->Click.connect([this] { onOpenGeneratedChange(); });
     preview()->Click.connect([this] { generatePreview(); });
     m_genTimer.Tick.connect([this] { onGenTimerTick(); });
@@ -687,10 +702,15 @@ private:
       return std::string();
   }
 
+  SpriteSheetDataFormat selectedDataFormat() const
+  {
+    return SpriteSheetDataFormat(dataFormat()->getSelectedItemIndex());
+  }
+
   SpriteSheetDataFormat dataFormatValue() const
   {
     if (dataEnabled()->isSelected())
-      return SpriteSheetDataFormat(dataFormat()->getSelectedItemIndex());
+      return selectedDataFormat();
     else
       return SpriteSheetDataFormat::Default;
   }
@@ -867,6 +887,21 @@ private:
     onFileNamesChange();
   }
 
+  // Changes the extension of the data filename to the new format
+  // (only if it's a known data file extension).
+  void onDataFormatChange()
+  {
+    const std::string ext = base::get_file_extension(m_dataFilename);
+    if (base::utf8_icmp(ext, "json") != 0 && base::utf8_icmp(ext, "cbor") != 0)
+      return;
+
+    m_dataFilename =
+      base::replace_extension(m_dataFilename,
+                              get_sprite_sheet_data_format_extension(selectedDataFormat()));
+    m_dataFilenameAskOverwrite = true;
+    onFileNamesChange();
+  }
+
   void onImageEnabledChange()
   {
     m_filenameAskOverwrite = true;
@@ -878,8 +913,7 @@ private:
 
   void onDataFilename()
   {
-    // TODO hardcoded "json" extension
-    base::paths exts = { "json" };
+    base::paths exts = { get_sprite_sheet_data_format_extension(selectedDataFormat()) };
     base::paths newFilename;
     if (!app::show_file_selector(Strings::export_sprite_sheet_save_json_title(),
                                  m_dataFilename,
@@ -60,6 +60,7 @@ struct ExportSpriteSheetParams : public NewParams {
   Param<bool> listTags{ this, true, "listTags" };
   Param<bool> listSlices{ this, true, "listSlices" };
   Param<bool> fromTilesets{ this, false, "fromTilesets" };
+  Param<std::string> pngCompression{ this, std::string(), "pngCompression" };
 };
 
 class ExportSpriteSheetCommand : public CommandWithNewParams<ExportSpriteSheetParams> {
@@ -80,6 +80,7 @@ OpenFileCommand::OpenFileCommand()
   , m_ui(true)
   , m_repeatCheckbox(false)
   , m_oneFrame(false)
+  , m_skipHiddenLayers(false)
   , m_seqDecision(gen::SequenceDecision::ASK)
 {
 }
@@ -96,6 +97,7 @@ void OpenFileCommand::onLoadParams(const Params& params)
 
   m_repeatCheckbox = params.get_as<bool>("repeat_checkbox");
   m_oneFrame = params.get_as<bool>("oneframe");
+  m_skipHiddenLayers = params.get_as<bool>("skip_hidden_layers");
 
   std::string sequence = params.get("sequence");
   if (m_oneFrame || sequence == "skip" || sequence == "no") {
@@ -170,6 +172,9 @@ void OpenFileCommand::onExecute(Context* context)
   if (m_oneFrame)
     flags |= FILE_LOAD_ONE_FRAME;
 
+  if (m_skipHiddenLayers)
+    flags |= FILE_LOAD_SKIP_HIDDEN_LAYERS;
+
   std::string filename;
   while (!filenames.empty()) {
     filename = filenames[0];
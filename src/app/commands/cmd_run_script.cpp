@@ -18,6 +18,7 @@
 #include "app/commands/params.h"
 #include "app/console.h"
 #include "app/context.h"
+#include "app/extensions.h"
 #include "app/i18n/strings.h"
 #include "app/pref/preferences.h"
 #include "app/resource_finder.h"
@@ -73,6 +74,10 @@ void RunScriptCommand::onExecute(Context* context)
       return;
   }
 
+  // The script could use commands from plugins that weren't
+  // initialized yet (see Extensions::executeInitActions())
+  App::instance()->extensions().initPendingScripts();
+
   App::instance()->scriptEngine()->evalUserFile(m_filename, m_params);
 
   if (context->isUIAvailable())
@@ -22,6 +22,7 @@
 #include "app/file/file.h"
 #include "app/file/gif_format.h"
 #include "app/file/png_format.h"
+#include "app/file/png_options.h"
 #include "app/file_selector.h"
 #include "app/i18n/strings.h"
 #include "app/job.h"
@@ -37,6 +38,7 @@
 #include "base/convert_to.h"
 #include "base/fs.h"
 #include "base/scoped_value.h"
+#include "base/string.h"
 #include "base/thread.h"
 #include "doc/mask.h"
 #include "doc/sprite.h"
@@ -207,6 +209,27 @@ void SaveFileBaseCommand::saveDocumentInBackground(const Context* context,
     bounds = document->sprite()->bounds();
   }
 
+  // PNG compression preset (from the CLI or scripts), it's used only
+  // for this save operation.
+  std::shared_ptr<PngOptions> pngOpts;
+  if (!params().pngCompression().empty() &&
+      base::string_to_lower(base::get_file_extension(filename)) == "png") {
+    PngOptions::Compression compression;
+    if (!PngOptions::parseCompression(params().pngCompression(), compression)) {
+      Console console;
+      console.printf("Invalid PNG compression \"%s\" (use default, fast, or smallest)\n",
+                     params().pngCompression().c_str());
+      return;
+    }
+
+    // Copy the document options to keep its user chunks
+    if (auto docOpts = std::dynamic_pointer_cast<PngOptions>(document->formatOptions()))
+      pngOpts = std::make_shared<PngOptions>(*docOpts);
+    else
+      pngOpts = std::make_shared<PngOptions>();
+    pngOpts->setCompression(compression);
+  }
+
   FileOpROI roi(document,
                 bounds,
                 params().slice(),
@@ -222,6 +245,9 @@ void SaveFileBaseCommand::saveDocumentInBackground(const Context* context,
   if (!fop)
     return;
 
+  if (pngOpts)
+    fop->setFormatOptionsForSaving(pngOpts);
+
   if (resizeOnTheFly == ResizeOnTheFly::On)
     fop->setOnTheFlyScale(scale);
 
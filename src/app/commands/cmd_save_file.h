@@ -59,6 +59,7 @@ struct SaveFileParams : public NewParams {
   Param<double> scale{ this, 1.0, "scale" };
   Param<gfx::Rect> bounds{ this, gfx::Rect(), "bounds" };
   Param<bool> playSubtags{ this, false, "playSubtags" };
+  Param<std::string> pngCompression{ this, std::string(), "pngCompression" };
 };
 
 class SaveFileBaseCommand : public CommandWithNewParams<SaveFileParams> {
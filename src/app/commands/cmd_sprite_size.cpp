@@ -22,6 +22,7 @@
 #include "app/modules/palettes.h"
 #include "app/sprite_job.h"
 #include "app/util/resize_image.h"
+#include "app/util/worker_rgbmap.h"
 #include "base/convert_to.h"
 #include "doc/algorithm/resize_image.h"
 #include "doc/cel.h"
@@ -30,6 +31,7 @@
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
 #include "doc/mask.h"
+#include "doc/parallel_for.h"
 #include "doc/primitives.h"
 #include "doc/slice.h"
 #include "doc/sprite.h"
@@ -39,6 +41,7 @@
 #include "sprite_size.xml.h"
 
 #include <algorithm>
+#include <vector>
 
 #define PERC_FORMAT "%.4g"
 
@@ -67,6 +70,10 @@ struct SpriteSizeParams : public NewParams {
 };
 
 class SpriteSizeJob : public SpriteJob {
+  // Number of images resized by each thread between progress
+  // updates/cancel checks.
+  static constexpr int kImagesPerThread = 4;
+
   int m_new_width;
   int m_new_height;
   ResizeMethod m_resize_method;
@@ -91,6 +98,51 @@ class SpriteSizeJob : public SpriteJob {
     return gfx::RectT<T>(x1, y1, scale_x(rc.x2()) - x1, scale_y(rc.y2()) - y1);
   }
 
+  // Only indexed images use the RgbMap to be resized.
+  const RgbMap* rgbmapFor(WorkerRgbMap& rgbmap, const frame_t frame) const
+  {
+    return (sprite()->pixelFormat() == IMAGE_INDEXED ? rgbmap.get(frame) : nullptr);
+  }
+
+  // Calls func(i, rgbmap) for each i in [begin, end) from several
+  // threads. The range is processed in chunks, and the progress is
+  // reported from this thread after each chunk, so the results of a
+  // chunk can be committed in order with commitChunk(chunkBegin,
+  // chunkEnd). Returns false if the job was canceled.
+  template<typename Func, typename CommitFunc>
+  bool resizeInParallel(const int begin,
+                        const int end,
+                        int& progress,
+                        const int img_count,
+                        const RgbMap* spriteRgbMap,
+                        Func&& func,
+                        CommitFunc&& commitChunk)
+  {
+    const int chunkSize = kImagesPerThread * doc::parallel_bands_count(end - begin, 1);
+
+    for (int chunkBegin = begin; chunkBegin < end; chunkBegin += chunkSize) {
+      const int chunkEnd = std::min(chunkBegin + chunkSize, end);
+
+      doc::parallel_for_bands(chunkBegin, chunkEnd, 1, [&](const int a, const int b) {
+        WorkerRgbMap rgbmap(sprite(),
+                            spriteRgbMap->rgbmapAlgorithm(),
+                            spriteRgbMap->fitCriteria());
+        for (int i = a; i < b; ++i)
+          func(i, rgbmap);
+      });
+
+      commitChunk(chunkBegin, chunkEnd);
+
+      progress += chunkEnd - chunkBegin;
+      jobProgress((float)progress / img_count);
+
+      // Cancel all the operation?
+      if (isCanceled())
+        return false;
+    }
+    return true;
+  }
+
 public:
   SpriteSizeJob(Context* ctx,
                 Doc* doc,
@@ -119,15 +171,19 @@ protected:
           img_count += tileset->size();
       }
     }
-    for (Cel* cel : sprite()->uniqueCels()) { // TODO add size() member function to CelsRange
-      (void)cel;
-      ++img_count;
-    }
+    std::vector<Cel*> cels;
+    for (Cel* cel : sprite()->uniqueCels()) // TODO add size() member function to CelsRange
+      cels.push_back(cel);
+    img_count += int(cels.size());
 
     int progress = 0;
     const gfx::SizeF scale(double(m_new_width) / double(sprite()->width()),
                            double(m_new_height) / double(sprite()->height()));
 
+    // Create the sprite RgbMap in this thread, the workers use its
+    // algorithm and fit criteria.
+    const RgbMap* spriteRgbMap = sprite()->rgbMap(0);
+
     // Resize tilesets
     if (tilesets) {
       for (tileset_index tsi = 0; tsi < tilesets->size(); ++tsi) {
@@ -145,61 +201,94 @@ protected:
         doc::Grid newGrid(newGridSize);
 
         auto newTileset = new doc::Tileset(sprite(), newGrid, tileset->size());
-        doc::tile_index idx = 0;
         newTileset->setName(tileset->name());
         newTileset->setUserData(tileset->userData());
-        for (auto& tile : *tileset) {
-          if (idx != 0) {
-            doc::ImageRef newTileImg(resize_image(tile.image.get(),
-                                                  scale,
-                                                  m_resize_method,
-                                                  sprite()->palette(0),
-                                                  sprite()->rgbMap(0))); // TODO first frame?
 
-            newTileset->set(idx, newTileImg);
-            newTileset->setTileData(idx, tileset->getTileData(idx));
-          }
-
-          jobProgress((float)progress / img_count);
-          ++progress;
-          ++idx;
+        // The empty tile (index 0) is not resized
+        ++progress;
+
+        std::vector<doc::ImageRef> newTileImgs(tileset->size());
+        const bool completed = resizeInParallel(
+          1,
+          int(tileset->size()),
+          progress,
+          img_count,
+          spriteRgbMap,
+          [this, tileset, scale, &newTileImgs](const int idx, WorkerRgbMap& rgbmap) {
+            newTileImgs[idx].reset(resize_image(tileset->get(idx).get(),
+                                                scale,
+                                                m_resize_method,
+                                                sprite()->palette(0),
+                                                rgbmapFor(rgbmap, 0))); // TODO first frame?
+          },
+          [tileset, newTileset, &newTileImgs](const int a, const int b) {
+            for (doc::tile_index idx = a; idx < b; ++idx) {
+              newTileset->set(idx, newTileImgs[idx]);
+              newTileset->setTileData(idx, tileset->getTileData(idx));
+              newTileImgs[idx].reset();
+            }
+          });
+
+        if (!completed) {
+          delete newTileset;
+          return; // Tx destructor will undo all operations
         }
-        tx(new cmd::ReplaceTileset(sprite(), tsi, newTileset));
 
-        // Cancel all the operation?
-        if (isCanceled())
-          return; // Tx destructor will undo all operations
+        tx(new cmd::ReplaceTileset(sprite(), tsi, newTileset));
       }
     }
 
-    // For each cel...
-    for (Cel* cel : sprite()->uniqueCels()) {
-      // We need to adjust only the origin/position of tilemap cels
-      // (because tiles are resized automatically when we resize the
-      // tileset).
-      if (cel->layer()->isTilemap()) {
-        Tileset* tileset = static_cast<LayerTilemap*>(cel->layer())->tileset();
-        gfx::Size canvasSize = tileset->grid().tilemapSizeToCanvas(
-          gfx::Size(cel->image()->width(), cel->image()->height()));
-        gfx::Rect newBounds(cel->x() * scale.w, cel->y() * scale.h, canvasSize.w, canvasSize.h);
-        tx(new cmd::SetCelBoundsF(cel, newBounds));
-      }
-      else {
-        resize_cel_image(tx,
-                         cel,
-                         scale,
-                         m_resize_method,
-                         cel->layer()->isReference() ? -cel->boundsF().origin() :
-                                                       gfx::PointF(-cel->bounds().origin()));
-      }
-
-      jobProgress((float)progress / img_count);
-      ++progress;
+    // For each cel... (the images of each chunk of cels are resized
+    // in parallel, and then committed to the transaction in order)
+    std::vector<doc::ImageRef> newImages(cels.size());
+    const bool completed = resizeInParallel(
+      0,
+      int(cels.size()),
+      progress,
+      img_count,
+      spriteRgbMap,
+      [this, scale, &cels, &newImages](const int i, WorkerRgbMap& rgbmap) {
+        Cel* cel = cels[i];
+        if (!cel->layer()->isTilemap()) {
+          newImages[i] = create_resized_cel_image(cel,
+                                                  scale,
+                                                  m_resize_method,
+                                                  rgbmapFor(rgbmap, cel->frame()));
+        }
+      },
+      [this, &tx, scale, &cels, &newImages](const int a, const int b) {
+        for (int i = a; i < b; ++i) {
+          Cel* cel = cels[i];
+
+          // We need to adjust only the origin/position of tilemap cels
+          // (because tiles are resized automatically when we resize the
+          // tileset).
+          if (cel->layer()->isTilemap()) {
+            Tileset* tileset = static_cast<LayerTilemap*>(cel->layer())->tileset();
+            gfx::Size canvasSize = tileset->grid().tilemapSizeToCanvas(
+              gfx::Size(cel->image()->width(), cel->image()->height()));
+            gfx::Rect newBounds(cel->x() * scale.w,
+                                cel->y() * scale.h,
+                                canvasSize.w,
+                                canvasSize.h);
+            tx(new cmd::SetCelBoundsF(cel, newBounds));
+          }
+          else {
+            resize_cel_image(tx,
+                             cel,
+                             scale,
+                             m_resize_method,
+                             cel->layer()->isReference() ?
+                               -cel->boundsF().origin() :
+                               gfx::PointF(-cel->bounds().origin()),
+                             newImages[i]);
+          }
+          newImages[i].reset();
+        }
+      });
 
-      // Cancel all the operation?
-      if (isCanceled())
-        return; // Tx destructor will undo all operations
-    }
+    if (!completed)
+      return; // Tx destructor will undo all operations
 
     // Resize mask
     if (document()->isMaskVisible()) {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -9,7 +9,8 @@
 // #define TEST_BACKUPS_WITH_A_SHORT_PERIOD
 
 // Uncomment if you want to check that backups are correctly saved
-// after being saved.
+// after being saved (without enabling the
+// "general.check_data_recovery_integrity" option).
 // #define TEST_BACKUP_INTEGRITY
 
 #ifdef HAVE_CONFIG_H
@@ -28,6 +29,7 @@
 #include "app/doc_diff.h"
 #include "app/pref/preferences.h"
 #include "base/chrono.h"
+#include "base/log.h"
 #include "base/remove_from_container.h"
 #include "base/thread.h"
 #include "ui/app_state.h"
@@ -193,31 +195,10 @@ bool BackupObserver::saveDocData(Doc* doc)
       RECO_TRACE("RECO: Document '%d' backup was canceled by UI\n", doc->id());
     }
     else {
-#ifdef TEST_BACKUP_INTEGRITY
-      DocReader reader(doc, 500);
-      std::unique_ptr<Doc> copy(m_session->restoreBackupDocById(doc->id(), nullptr));
-      DocDiff diff = compare_docs(doc, copy.get());
-      if (diff.anything) {
-        RECO_TRACE("RECO: Differences: %s %s %s %s %s %s %s %s %s %s %s\n",
-                   diff.canvas ? "canvas" : "",
-                   diff.totalFrames ? "totalFrames" : "",
-                   diff.frameDuration ? "frameDuration" : "",
-                   diff.tags ? "tags" : "",
-                   diff.palettes ? "palettes" : "",
-                   diff.tilesets ? "tilesets" : "",
-                   diff.layers ? "layers" : "",
-                   diff.cels ? "cels" : "",
-                   diff.images ? "images" : "",
-                   diff.colorProfiles ? "colorProfiles" : "",
-                   diff.gridBounds ? "gridBounds" : "");
-
-        Doc* copyDoc = copy.release();
-        ui::execute_from_ui_thread([this, copyDoc] { m_ctx->documents().add(copyDoc); });
-      }
-      else {
-        RECO_TRACE("RECO: No differences\n");
-      }
+#ifndef TEST_BACKUP_INTEGRITY
+      if (m_config->checkIntegrity)
 #endif
+        checkBackupIntegrity(doc);
       return true;
     }
   }
@@ -227,4 +208,52 @@ bool BackupObserver::saveDocData(Doc* doc)
   return false;
 }
 
+// Executed from the backgroundThread() (non-UI thread)
+void BackupObserver::checkBackupIntegrity(Doc* doc)
+{
+  DocReader reader(doc, 500);
+  std::unique_ptr<Doc> copy(m_session->restoreBackupDocById(doc->id(), nullptr));
+  if (!copy) {
+    LOG(ERROR, "RECO: Backup of document '%d' cannot be restored\n", doc->id());
+    return;
+  }
+
+  // Images are compared pixel by pixel (without hashing them) because
+  // the restored copy has new image IDs each time, so their hashes
+  // cannot be cached.
+  DocDiffOptions options;
+  options.parallel = true;
+
+  const DocDiff diff = compare_docs(doc, copy.get(), options);
+  if (diff.anything) {
+    LOG(ERROR,
+        "RECO: Backup of document '%d' has %d difference(s): %s %s %s %s %s %s %s %s %s %s %s\n",
+        doc->id(),
+        int(diff.items.size()),
+        diff.canvas ? "canvas" : "",
+        diff.totalFrames ? "totalFrames" : "",
+        diff.frameDuration ? "frameDuration" : "",
+        diff.tags ? "tags" : "",
+        diff.palettes ? "palettes" : "",
+        diff.tilesets ? "tilesets" : "",
+        diff.layers ? "layers" : "",
+        diff.cels ? "cels" : "",
+        diff.images ? "images" : "",
+        diff.colorProfiles ? "colorProfiles" : "",
+        diff.gridBounds ? "gridBounds" : "");
+
+    for (const DocDiffItem& item : diff.items) {
+      RECO_TRACE("RECO:  - Type=%d ID=%d index=%d\n", int(item.type), int(item.id), item.index);
+    }
+
+#ifdef TEST_BACKUP_INTEGRITY
+    Doc* copyDoc = copy.release();
+    ui::execute_from_ui_thread([this, copyDoc] { m_ctx->documents().add(copyDoc); });
+#endif
+  }
+  else {
+    RECO_TRACE("RECO: No differences\n");
+  }
+}
+
 }} // namespace app::crash
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -41,6 +41,7 @@ public:
 private:
   void backgroundThread();
   bool saveDocData(Doc* doc);
+  void checkBackupIntegrity(Doc* doc);
 
   RecoveryConfig* m_config;
   Session* m_session;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -43,6 +43,7 @@ DataRecovery::DataRecovery(Context* ctx)
     m_config.keepEditedSpriteDataFor = pref.general.keepEditedSpriteDataFor();
   else
     m_config.keepEditedSpriteDataFor = 0;
+  m_config.checkIntegrity = pref.general.checkDataRecoveryIntegrity();
 
   ResourceFinder rf;
   rf.includeUserDir(base::join_path("sessions", ".").c_str());
@@ -159,6 +160,10 @@ void DataRecovery::searchForSessions()
       }
       else {
         RECO_TRACE("to be loaded\n");
+
+        // Read the description of each backup (from the session
+        // index) in this background thread.
+        session->loadBackupsInfo();
         sessions.push_back(session);
       }
     }
@@ -31,6 +31,7 @@
 #include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/palette_io.h"
+#include "doc/parallel_for.h"
 #include "doc/serial_format.h"
 #include "doc/slice.h"
 #include "doc/slice_io.h"
@@ -45,9 +46,12 @@
 #include "doc/user_data_io.h"
 #include "doc/util.h"
 #include "fixmath/fixmath.h"
+#include "fmt/format.h"
 
+#include <algorithm>
 #include <fstream>
 #include <map>
+#include <vector>
 
 namespace app { namespace crash {
 
@@ -76,6 +80,14 @@ public:
     , m_loadInfo(nullptr)
     , m_taskToken(t)
   {
+    struct File {
+      std::string fn;
+      ObjectId id;
+      ObjectVersion ver;
+      bool valid;
+    };
+    std::vector<File> files;
+
     for (const auto& fn : base::list_files(dir, base::ItemType::Files)) {
       auto i = fn.find('-');
       if (i == std::string::npos)
@@ -90,17 +102,33 @@ public:
       if (!id || !ver)
         continue; // Error converting strings to ID/ver
 
-      // Checking for the magic number of each file takes a long time,
-      // we can guess that all files are valid when there is no
-      // m_taskToken, i.e. when we have to just show the description
-      // of the doc in the list of backups.
-      if (m_taskToken && !check_magic_number(base::join_path(m_dir, fn))) {
+      files.push_back(File{ fn, id, ver, true });
+    }
+
+    // Checking for the magic number of each file takes a long time
+    // (so we do it from several threads), we can guess that all files
+    // are valid when there is no m_taskToken, i.e. when we have to
+    // just show the description of the doc in the list of backups.
+    if (m_taskToken) {
+      doc::parallel_for_bands(0, int(files.size()), 64, [this, &files](const int a, const int b) {
+        for (int i = a; i < b; ++i)
+          files[i].valid = check_magic_number(base::join_path(m_dir, files[i].fn));
+      });
+    }
+
+    for (const File& file : files) {
+      const std::string& fn = file.fn;
+      const ObjectId id = file.id;
+      if (!file.valid) {
         RECO_TRACE("RECO: Ignoring invalid file %s (no magic number)\n", fn.c_str());
         continue;
       }
 
       ObjVersions& versions = m_objVersions[id];
-      versions.add(ver);
+      versions.add(file.ver);
+
+      if (fn.compare(0, 3, "img") == 0)
+        m_imageIds.push_back(id);
 
       if (fn.compare(0, 3, "doc") == 0) {
         if (!m_docId)
@@ -158,6 +186,59 @@ private:
     return m_celdatas[celdataId] = celData;
   }
 
+  // Reads all images from several threads before reading tilesets
+  // and cels (which get their images through getImageRef()). Images
+  // that cannot be read here are read again (reporting the errors)
+  // when they are needed.
+  void prefetchImages()
+  {
+    // Each image can have several versions (files)
+    std::vector<ObjectId> ids = m_imageIds;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::vector<ImageRef> images(ids.size());
+    doc::parallel_for_bands(0, int(ids.size()), 8, [this, &ids, &images](const int a, const int b) {
+      for (int i = a; i < b && !canceled(); ++i)
+        images[i] = tryLoadImage(ids[i]);
+    });
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+      if (images[i])
+        m_images[ids[i]] = images[i];
+    }
+  }
+
+  // Thread-safe version of loadObject() for images (it doesn't
+  // modify the Reader state nor report errors).
+  ImageRef tryLoadImage(const ObjectId id) const
+  {
+    auto it = m_objVersions.find(id);
+    if (it == m_objVersions.end())
+      return nullptr;
+
+    const ObjVersions& versions = it->second;
+    for (size_t i = 0; i < versions.size(); ++i) {
+      ObjectVersion ver = versions[i];
+      if (!ver)
+        continue;
+
+      const std::string fn = fmt::format("img-{}.{}", id, ver);
+      std::ifstream s(FSTREAM_PATH(base::join_path(m_dir, fn)), std::ifstream::binary);
+      try {
+        if (read32(s) == MAGIC_NUMBER) {
+          ImageRef image(read_image(s, false));
+          if (image)
+            return image;
+        }
+      }
+      catch (const std::exception&) {
+        // Try the next version
+      }
+    }
+    return nullptr;
+  }
+
   template<typename T>
   T loadObject(const char* prefix, ObjectId id, T (Reader::*readMember)(std::ifstream&))
   {
@@ -259,6 +340,10 @@ private:
     m_sprite = spr.get();
     spr->setTransparentColor(transparentColor);
 
+    prefetchImages();
+    if (canceled())
+      return nullptr;
+
     if (nframes >= 1) {
       spr->setTotalFrames(nframes);
       for (frame_t fr = 0; fr < nframes; ++fr) {
@@ -583,6 +668,7 @@ private:
   DocumentInfo* m_loadInfo;
   std::vector<std::pair<ObjectId, ObjectId>> m_celsToLoad;
   std::map<ObjectId, ImageRef> m_images;
+  std::vector<ObjectId> m_imageIds;
   std::map<ObjectId, CelDataRef> m_celdatas;
   // Each ObjectId is a tileset ID that didn't contain the empty tile
   // as the first tile (this was an old format used in internal betas)
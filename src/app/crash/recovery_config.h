@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -15,6 +15,10 @@ namespace app { namespace crash {
 struct RecoveryConfig {
   double dataRecoveryPeriod;
   int keepEditedSpriteDataFor;
+
+  // Restores each backup after saving it to compare it with the
+  // original document.
+  bool checkIntegrity = false;
 };
 
 }} // namespace app::crash
@@ -34,6 +34,9 @@
 #include "ui/app_state.h"
 #include "ver/info.h"
 
+#include <map>
+#include <sstream>
+
 namespace app { namespace crash {
 
 static const char* kPidFilename = "pid";   // Process ID running the session (or non-existent if the
@@ -43,6 +46,21 @@ static const char* kVerFilename = "ver";   // File that indicates the Aseprite v
 static const char* kOpenFilename = "open"; // File that indicates if the document is/was open in the
                                            // session (or non-existent if the document was closed
                                            // correctly)
+static const char* kIndexFilename = "index"; // Cached information of each backup of the session
+
+// Returns a string that changes when files are added to (or removed
+// from) the backup directory, i.e. when the backup is modified.
+static std::string backup_stamp(const std::string& dir)
+{
+  const base::Time t = base::get_modification_time(dir);
+  return fmt::format("{:04}{:02}{:02}{:02}{:02}{:02}",
+                     t.year,
+                     t.month,
+                     t.day,
+                     t.hour,
+                     t.minute,
+                     t.second);
+}
 
 Session::Backup::Backup(const std::string& dir) : m_dir(dir)
 {
@@ -50,23 +68,34 @@ Session::Backup::Backup(const std::string& dir) : m_dir(dir)
 
 std::string Session::Backup::description(const bool withFullPath) const
 {
-  // Lazy initialize description and filename.
-  if (m_desc.empty()) {
-    DocumentInfo info;
-    read_document_info(m_dir, info);
-    m_fn = info.filename;
-    m_desc = fmt::format("{} Sprite {}x{}, {} {}",
-                         info.mode == ColorMode::RGB       ? "RGB" :
-                         info.mode == ColorMode::GRAYSCALE ? "Grayscale" :
-                         info.mode == ColorMode::INDEXED   ? "Indexed" :
-                         info.mode == ColorMode::BITMAP    ? "Bitmap" :
-                                                             "Unknown",
-                         info.width,
-                         info.height,
-                         info.frames,
-                         info.frames == 1 ? "frame" : "frames");
+  const DocumentInfo& info = this->info();
+  return fmt::format("{} Sprite {}x{}, {} {}: {}",
+                     info.mode == ColorMode::RGB       ? "RGB" :
+                     info.mode == ColorMode::GRAYSCALE ? "Grayscale" :
+                     info.mode == ColorMode::INDEXED   ? "Indexed" :
+                     info.mode == ColorMode::BITMAP    ? "Bitmap" :
+                                                         "Unknown",
+                     info.width,
+                     info.height,
+                     info.frames,
+                     info.frames == 1 ? "frame" : "frames",
+                     withFullPath ? info.filename : base::get_file_name(info.filename));
+}
+
+const DocumentInfo& Session::Backup::info() const
+{
+  // Lazy initialize the document information.
+  if (!m_hasInfo) {
+    read_document_info(m_dir, m_info);
+    m_hasInfo = true;
   }
-  return fmt::format("{}: {}", m_desc, withFullPath ? m_fn : base::get_file_name(m_fn));
+  return m_info;
+}
+
+void Session::Backup::setInfo(const DocumentInfo& info)
+{
+  m_info = info;
+  m_hasInfo = true;
 }
 
 Session::Session(RecoveryConfig* config, const std::string& path)
@@ -128,6 +157,66 @@ const Session::Backups& Session::backups()
   return m_backups;
 }
 
+void Session::loadBackupsInfo()
+{
+  struct Entry {
+    std::string stamp;
+    DocumentInfo info;
+  };
+  std::map<std::string, Entry> oldIndex, index;
+
+  // Each line of the index file is "<dir> <stamp> <mode> <width>
+  // <height> <frames> <filename>"
+  const std::string indexFn = indexFilename();
+  if (base::is_file(indexFn)) {
+    std::ifstream f(FSTREAM_PATH(indexFn));
+    std::string line;
+    while (std::getline(f, line)) {
+      std::istringstream ss(line);
+      std::string name;
+      Entry entry;
+      int mode;
+      ss >> name >> entry.stamp >> mode >> entry.info.width >> entry.info.height >>
+        entry.info.frames;
+      if (!ss)
+        continue;
+      entry.info.mode = ColorMode(mode);
+      ss.get(); // Skip the space before the filename
+      std::getline(ss, entry.info.filename);
+      oldIndex[name] = entry;
+    }
+  }
+
+  bool modified = false;
+  for (const BackupPtr& backup : backups()) {
+    if (ui::is_app_state_closing())
+      return;
+
+    const std::string name = base::get_file_name(backup->dir());
+    const std::string stamp = backup_stamp(backup->dir());
+    auto it = oldIndex.find(name);
+    if (it != oldIndex.end() && it->second.stamp == stamp) {
+      backup->setInfo(it->second.info);
+      index[name] = it->second;
+    }
+    else {
+      index[name] = Entry{ stamp, backup->info() };
+      modified = true;
+    }
+  }
+
+  if (!modified && index.size() == oldIndex.size())
+    return;
+
+  RECO_TRACE("RECO: Saving index of session '%s'\n", m_path.c_str());
+  std::ofstream f(FSTREAM_PATH(indexFn));
+  for (const auto& [name, entry] : index) {
+    f << name << ' ' << entry.stamp << ' ' << int(entry.info.mode) << ' ' << entry.info.width
+      << ' ' << entry.info.height << ' ' << entry.info.frames << ' ' << entry.info.filename
+      << '\n';
+  }
+}
+
 bool Session::isRunning()
 {
   loadPid();
@@ -226,6 +315,9 @@ void Session::removeFromDisk()
     if (base::is_file(verFilename()))
       base::delete_file(verFilename());
 
+    if (base::is_file(indexFilename()))
+      base::delete_file(indexFilename());
+
     base::remove_directory(m_path);
   }
   catch (const std::exception& ex) {
@@ -378,6 +470,11 @@ std::string Session::verFilename() const
   return base::join_path(m_path, kVerFilename);
 }
 
+std::string Session::indexFilename() const
+{
+  return base::join_path(m_path, kIndexFilename);
+}
+
 void Session::markDocumentAsCorrectlyClosed(app::Doc* doc)
 {
   std::string dir = base::join_path(m_path, base::convert_to<std::string>(doc->id()));
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "app/crash/raw_images_as.h"
+#include "app/crash/read_document.h"
 #include "base/disable_copying.h"
 #include "base/process.h"
 #include "base/task.h"
@@ -34,10 +35,16 @@ public:
     const std::string& dir() const { return m_dir; }
     std::string description(const bool withFullPath) const;
 
+    // Information of the document (lazily read from the backup data
+    // if it wasn't set before from the session index).
+    const DocumentInfo& info() const;
+    bool hasInfo() const { return m_hasInfo; }
+    void setInfo(const DocumentInfo& info);
+
   private:
     std::string m_dir;
-    mutable std::string m_desc;
-    mutable std::string m_fn;
+    mutable DocumentInfo m_info;
+    mutable bool m_hasInfo = false;
   };
   using BackupPtr = std::shared_ptr<Backup>;
   using Backups = std::vector<BackupPtr>;
@@ -49,6 +56,13 @@ public:
   std::string version();
   const Backups& backups();
 
+  // Loads the information of all backups from the session index file
+  // (or from the backup data if the backup is not in the index or
+  // was modified) and updates the index. It's called from the
+  // background thread that searches sessions, so the list of backups
+  // can be displayed without reading each backup.
+  void loadBackupsInfo();
+
   bool isRunning();
   bool isCrashedSession();
   bool isOldSession();
@@ -72,6 +86,7 @@ private:
   void loadPid();
   std::string pidFilename() const;
   std::string verFilename() const;
+  std::string indexFilename() const;
   void markDocumentAsCorrectlyClosed(Doc* doc);
   void deleteDirectory(const std::string& dir);
   void fixFilename(Doc* doc);
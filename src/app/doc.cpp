@@ -427,22 +427,20 @@ void Doc::destroyMaskBoundaries()
 
 void Doc::generateMaskBoundaries(const Mask* mask)
 {
-  m_maskBoundaries.reset();
-
   // No mask specified? Use the current one in the document
   if (!mask) {
-    if (!isMaskVisible()) // The mask is hidden
-      return;             // Done, without boundaries
+    if (!isMaskVisible()) { // The mask is hidden
+      m_maskBoundaries.reset();
+      return; // Done, without boundaries
+    }
     else
       mask = this->mask(); // Use the document mask
   }
 
   ASSERT(mask);
 
-  if (!mask->isEmpty()) {
-    m_maskBoundaries.regen(mask->bitmap());
-    m_maskBoundaries.offset(mask->bounds().x, mask->bounds().y);
-  }
+  // Only the rows that changed from the previous mask are re-generated
+  m_maskBoundaries.regen(mask);
 
   notifySelectionBoundariesChanged();
 }
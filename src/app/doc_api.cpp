@@ -21,6 +21,7 @@
 #include "app/cmd/flip_image.h"
 #include "app/cmd/move_cel.h"
 #include "app/cmd/move_layer.h"
+#include "app/cmd/permute_frames.h"
 #include "app/cmd/remove_cel.h"
 #include "app/cmd/remove_frame.h"
 #include "app/cmd/remove_layer.h"
@@ -60,6 +61,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <numeric>
 #include <set>
 #include <vector>
 
@@ -396,22 +398,6 @@ void DocApi::moveFrame(Sprite* sprite,
   if (frame >= 0 && frame <= sprite->lastFrame() && beforeFrame >= 0 &&
       beforeFrame <= sprite->lastFrame() + 1 &&
       ((frame != beforeFrame) || (!sprite->tags().empty() && tagsHandling != kDontAdjustTags))) {
-    // Change the frame-lengths.
-    int frlen_aux = sprite->frameDuration(frame);
-
-    // Moving the frame to the future.
-    if (frame < beforeFrame) {
-      for (frame_t c = frame; c < beforeFrame - 1; ++c)
-        setFrameDuration(sprite, c, sprite->frameDuration(c + 1));
-      setFrameDuration(sprite, beforeFrame - 1, frlen_aux);
-    }
-    // Moving the frame to the past.
-    else if (beforeFrame < frame) {
-      for (frame_t c = frame; c > beforeFrame; --c)
-        setFrameDuration(sprite, c, sprite->frameDuration(c - 1));
-      setFrameDuration(sprite, beforeFrame, frlen_aux);
-    }
-
     if (tagsHandling != kDontAdjustTags) {
       adjustTags(sprite, frame, -1, dropFramePlace, tagsHandling);
       if (targetFrame >= frame)
@@ -419,63 +405,59 @@ void DocApi::moveFrame(Sprite* sprite,
       adjustTags(sprite, targetFrame, +1, dropFramePlace, tagsHandling);
     }
 
-    // Change cel positions.
-    if (frame != beforeFrame)
-      moveFrameLayer(sprite->root(), frame, beforeFrame);
+    // Change frame durations and cel positions.
+    if (frame != beforeFrame) {
+      const bool batch = (m_movingFramesSprite == sprite);
+      std::vector<frame_t> framesOrder;
+      if (!batch) {
+        framesOrder.resize(sprite->totalFrames());
+        std::iota(framesOrder.begin(), framesOrder.end(), frame_t(0));
+      }
+      std::vector<frame_t>& order = (batch ? m_framesOrder : framesOrder);
+
+      // Moving the frame to the future the frames in the middle are
+      // moved to the past, and vice versa.
+      const frame_t movedFrame = order[frame];
+      order.erase(order.begin() + frame);
+      order.insert(order.begin() + (frame < beforeFrame ? beforeFrame - 1 : beforeFrame),
+                   movedFrame);
+
+      if (!batch)
+        permuteFrames(sprite, order);
+    }
   }
 }
 
-void DocApi::moveFrameLayer(Layer* layer, frame_t frame, frame_t beforeFrame)
+void DocApi::beginMoveFrames(Sprite* sprite)
 {
-  ASSERT(layer);
-
-  switch (layer->type()) {
-    case ObjectType::LayerImage:
-    case ObjectType::LayerTilemap: {
-      LayerImage* imglayer = static_cast<LayerImage*>(layer);
-
-      CelList cels;
-      imglayer->getCels(cels);
-
-      CelIterator it = cels.begin();
-      CelIterator end = cels.end();
-
-      for (; it != end; ++it) {
-        Cel* cel = *it;
-        frame_t celFrame = cel->frame();
-        frame_t newFrame = celFrame;
-
-        // moving the frame to the future
-        if (frame < beforeFrame) {
-          if (celFrame == frame) {
-            newFrame = beforeFrame - 1;
-          }
-          else if (celFrame > frame && celFrame < beforeFrame) {
-            --newFrame;
-          }
-        }
-        // moving the frame to the past
-        else if (beforeFrame < frame) {
-          if (celFrame == frame) {
-            newFrame = beforeFrame;
-          }
-          else if (celFrame >= beforeFrame && celFrame < frame) {
-            ++newFrame;
-          }
-        }
+  ASSERT(!m_movingFramesSprite);
+  m_movingFramesSprite = sprite;
+  m_framesOrder.resize(sprite->totalFrames());
+  std::iota(m_framesOrder.begin(), m_framesOrder.end(), frame_t(0));
+}
 
-        if (celFrame != newFrame)
-          setCelFramePosition(cel, newFrame);
-      }
-      break;
-    }
+void DocApi::endMoveFrames()
+{
+  ASSERT(m_movingFramesSprite);
+  Sprite* sprite = m_movingFramesSprite;
+  m_movingFramesSprite = nullptr;
+  permuteFrames(sprite, m_framesOrder);
+  m_framesOrder.clear();
+}
 
-    case ObjectType::LayerGroup: {
-      for (Layer* child : static_cast<LayerGroup*>(layer)->layers())
-        moveFrameLayer(child, frame, beforeFrame);
-      break;
-    }
+// Applies the new order of frames, "framesOrder[i]" is the original
+// frame that will be placed in the frame "i".
+void DocApi::permuteFrames(Sprite* sprite, const std::vector<frame_t>& framesOrder)
+{
+  std::vector<frame_t> newFrames(framesOrder.size());
+  bool changed = false;
+  for (frame_t i = 0; i < frame_t(framesOrder.size()); ++i) {
+    newFrames[framesOrder[i]] = i;
+    if (framesOrder[i] != i)
+      changed = true;
   }
+  if (changed)
+    m_transaction.execute(new cmd::PermuteFrames(sprite, newFrames));
 }
 
 void DocApi::addCel(LayerImage* layer, Cel* cel)
@@ -18,6 +18,7 @@
 #include "gfx/rect.h"
 
 #include <map>
+#include <vector>
 
 namespace doc {
 class Cel;
@@ -86,6 +87,13 @@ public:
                  const DropFramePlace dropFramePlace,
                  const TagsHandling tagsHandling);
 
+  // All moveFrame() calls between beginMoveFrames() and
+  // endMoveFrames() are accumulated and applied with just one
+  // cmd::PermuteFrames at the end (instead of moving frame durations
+  // and cels of each moved frame).
+  void beginMoveFrames(Sprite* sprite);
+  void endMoveFrames();
+
   // Cels API
   void addCel(LayerImage* layer, Cel* cel);
   Cel* addCel(LayerImage* layer, frame_t frameNumber, const ImageRef& image);
@@ -130,7 +138,7 @@ private:
   void cropImageLayer(LayerImage* layer, const gfx::Rect& bounds, const bool trimOutside);
   bool cropCel(LayerImage* layer, Cel* cel, const gfx::Rect& bounds, const bool trimOutside);
   void setCelFramePosition(Cel* cel, frame_t frame);
-  void moveFrameLayer(Layer* layer, frame_t frame, frame_t beforeFrame);
+  void permuteFrames(Sprite* sprite, const std::vector<frame_t>& framesOrder);
   void adjustTags(Sprite* sprite,
                   const frame_t frame,
                   const frame_t delta,
@@ -164,6 +172,11 @@ private:
   // cels from the src layers when we copy a block of cels.
   // map: ObjectId of CelData -> Cel*
   std::map<doc::ObjectId, doc::Cel*> m_linkedCels;
+
+  // Original frame in each position of the sprite while moveFrame()
+  // calls are accumulated (see beginMoveFrames()).
+  Sprite* m_movingFramesSprite = nullptr;
+  std::vector<frame_t> m_framesOrder;
 };
 
 } // namespace app
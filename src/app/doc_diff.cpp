@@ -17,6 +17,7 @@
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
 #include "doc/palette.h"
+#include "doc/parallel_for.h"
 #include "doc/primitives.h"
 #include "doc/sprite.h"
 #include "doc/tag.h"
@@ -46,9 +47,93 @@ namespace app {
   #define TRACEDIFF(a, b)
 #endif
 
-DocDiff compare_docs(const Doc* a, const Doc* b)
+namespace {
+
+// Total number of pixels to compare in all images to use several
+// threads.
+constexpr int64_t kMinPixelsForParallelDiff = 512 * 512;
+
+// Pair of images to be compared at the end of compare_docs().
+struct ImagePair {
+  const Image* a;
+  const Image* b;
+  DocDiffItem item;
+};
+
+uint32_t image_hash(const Image* image)
+{
+  return calculate_image_hash(image, image->bounds());
+}
+
+bool is_same_image_pair(const ImagePair& pair, const DocDiffOptions& options)
+{
+  if (options.hashCacheA && options.hashCacheB &&
+      options.hashCacheA->hash(pair.a) != options.hashCacheB->hash(pair.b)) {
+    return false;
+  }
+  // Compare pixel by pixel (when hashes match, to discard collisions)
+  return is_same_image(pair.a, pair.b);
+}
+
+} // anonymous namespace
+
+void DocDiff::add(const DocDiffItem::Type type, const doc::ObjectId id, const int index)
+{
+  anything = true;
+  switch (type) {
+    case DocDiffItem::Type::Canvas:        canvas = true; break;
+    case DocDiffItem::Type::TotalFrames:   totalFrames = true; break;
+    case DocDiffItem::Type::FrameDuration: frameDuration = true; break;
+    case DocDiffItem::Type::Tag:           tags = true; break;
+    case DocDiffItem::Type::Palette:       palettes = true; break;
+    case DocDiffItem::Type::Tileset:       tilesets = true; break;
+    case DocDiffItem::Type::Layer:         layers = true; break;
+    case DocDiffItem::Type::Cel:           cels = true; break;
+    case DocDiffItem::Type::Image:         images = true; break;
+    case DocDiffItem::Type::ColorProfile:  colorProfiles = true; break;
+    case DocDiffItem::Type::GridBounds:    gridBounds = true; break;
+  }
+  items.push_back(DocDiffItem{ type, id, index });
+}
+
+uint32_t ImageHashCache::hash(const Image* image)
+{
+  const ObjectId id = image->id();
+  const ObjectVersion version = image->version();
+  {
+    std::lock_guard lock(m_mutex);
+    auto it = m_used.find(id);
+    if (it != m_used.end() && it->second.version == version)
+      return it->second.hash;
+
+    it = m_old.find(id);
+    if (it != m_old.end() && it->second.version == version) {
+      const Entry entry = it->second;
+      m_used[id] = entry;
+      return entry.hash;
+    }
+  }
+
+  // Hash the image without locking the mutex
+  const uint32_t hash = image_hash(image);
+
+  std::lock_guard lock(m_mutex);
+  m_used[id] = Entry{ version, hash };
+  return hash;
+}
+
+void ImageHashCache::nextGeneration()
+{
+  std::lock_guard lock(m_mutex);
+  m_old = std::move(m_used);
+  m_used.clear();
+}
+
+DocDiff compare_docs(const Doc* a, const Doc* b, const DocDiffOptions& options)
 {
+  using Type = DocDiffItem::Type;
   DocDiff diff;
+  std::vector<ImagePair> imagePairs;
 
   // Don't compare filenames
   // if (a->filename() != b->filename())...
@@ -58,7 +143,7 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
       a->sprite()->height() != b->sprite()->height() ||
       a->sprite()->pixelFormat() != b->sprite()->pixelFormat() ||
       a->sprite()->userData() != b->sprite()->userData()) {
-    diff.anything = diff.canvas = true;
+    diff.add(Type::Canvas, a->sprite()->id());
 
     TRACEDIFF(a->sprite()->size(), b->sprite()->size());
     TRACEDIFF(a->sprite()->pixelFormat(), b->sprite()->pixelFormat());
@@ -67,38 +152,37 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
 
   // Frames layers
   if (a->sprite()->totalFrames() != b->sprite()->totalFrames()) {
-    diff.anything = diff.totalFrames = true;
+    diff.add(Type::TotalFrames, a->sprite()->id());
 
     TRACEDIFF(a->sprite()->totalFrames(), b->sprite()->totalFrames());
   }
   else {
     for (frame_t f = 0; f < a->sprite()->totalFrames(); ++f) {
       if (a->sprite()->frameDuration(f) != b->sprite()->frameDuration(f)) {
-        diff.anything = diff.frameDuration = true;
+        diff.add(Type::FrameDuration, a->sprite()->id(), f);
 
         TRACEDIFF(a->sprite()->frameDuration(f), b->sprite()->frameDuration(f));
-        break;
       }
     }
   }
 
   // Tags
   if (a->sprite()->tags().size() != b->sprite()->tags().size()) {
-    diff.anything = diff.tags = true;
+    diff.add(Type::Tag);
 
     TRACEDIFF(a->sprite()->tags().size(), b->sprite()->tags().size());
   }
   else {
     auto aIt = a->sprite()->tags().begin(), aEnd = a->sprite()->tags().end();
     auto bIt = b->sprite()->tags().begin(), bEnd = b->sprite()->tags().end();
-    for (; aIt != aEnd && bIt != bEnd; ++aIt, ++bIt) {
+    for (int i = 0; aIt != aEnd && bIt != bEnd; ++aIt, ++bIt, ++i) {
       const Tag* aTag = *aIt;
       const Tag* bTag = *bIt;
       if (aTag->fromFrame() != bTag->fromFrame() || aTag->toFrame() != bTag->toFrame() ||
           aTag->name() != bTag->name() || aTag->color() != bTag->color() ||
           aTag->aniDir() != bTag->aniDir() || aTag->repeat() != bTag->repeat() ||
           aTag->userData() != bTag->userData()) {
-        diff.anything = diff.tags = true;
+        diff.add(Type::Tag, aTag->id(), i);
 
         TRACEDIFF(aTag->fromFrame(), bTag->fromFrame());
         TRACEDIFF(aTag->toFrame(), bTag->toFrame());
@@ -113,19 +197,20 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
 
   // Palettes
   if (a->sprite()->getPalettes().size() != b->sprite()->getPalettes().size()) {
+    diff.add(Type::Palette);
+  }
+  else {
     const PalettesList& aPals = a->sprite()->getPalettes();
     const PalettesList& bPals = b->sprite()->getPalettes();
     auto aIt = aPals.begin(), aEnd = aPals.end();
     auto bIt = bPals.begin(), bEnd = bPals.end();
 
-    for (; aIt != aEnd && bIt != bEnd; ++aIt, ++bIt) {
+    for (int i = 0; aIt != aEnd && bIt != bEnd; ++aIt, ++bIt, ++i) {
       const Palette* aPal = *aIt;
       const Palette* bPal = *bIt;
 
-      if (aPal->countDiff(bPal, nullptr, nullptr)) {
-        diff.anything = diff.palettes = true;
-        break;
-      }
+      if (aPal->frame() != bPal->frame() || aPal->countDiff(bPal, nullptr, nullptr))
+        diff.add(Type::Palette, aPal->id(), i);
     }
   }
 
@@ -135,7 +220,7 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
   const tile_index bTilesetSize = (b->sprite()->hasTilesets() ? b->sprite()->tilesets()->size() :
                                                                 0);
   if (aTilesetSize != bTilesetSize) {
-    diff.anything = diff.tilesets = true;
+    diff.add(Type::Tileset);
   }
   else {
     for (int i = 0; i < aTilesetSize; ++i) {
@@ -147,34 +232,32 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
         continue;
       }
       else if (aTileset == nullptr || bTileset == nullptr) {
-        diff.anything = diff.tilesets = true;
-        break;
+        diff.add(Type::Tileset, (aTileset ? aTileset->id() : NullId));
       }
       else if (aTileset->grid().tileSize() != bTileset->grid().tileSize() ||
                aTileset->size() != bTileset->size() ||
                aTileset->userData() != bTileset->userData()) {
-        diff.anything = diff.tilesets = true;
+        diff.add(Type::Tileset, aTileset->id());
 
         TRACEDIFF(aTileset->grid().tileSize(), bTileset->grid().tileSize());
         TRACEDIFF(aTileset->size(), bTileset->size());
         TRACEDIFF(aTileset->userData(), bTileset->userData());
-        break;
       }
       else {
         for (tile_index ti = 0; ti < aTileset->size(); ++ti) {
-          if (!is_same_image(aTileset->get(ti).get(), bTileset->get(ti).get())) {
-            diff.anything = diff.tilesets = true;
-            goto done;
-          }
+          imagePairs.push_back(ImagePair{
+            aTileset->get(ti).get(),
+            bTileset->get(ti).get(),
+            DocDiffItem{ Type::Tileset, aTileset->id(), int(ti) },
+          });
         }
       }
     }
-  done:;
   }
 
   // Compare layers
   if (a->sprite()->allLayersCount() != b->sprite()->allLayersCount()) {
-    diff.anything = diff.layers = true;
+    diff.add(Type::Layer);
   }
   else {
     LayerList aLayers = a->sprite()->allLayers();
@@ -195,7 +278,7 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
           (aLay->isTilemap() && bLay->isTilemap() &&
            (((const LayerTilemap*)aLay)->tilesetIndex() !=
             ((const LayerTilemap*)bLay)->tilesetIndex()))) {
-        diff.anything = diff.layers = true;
+        diff.add(Type::Layer, aLay->id());
         break;
       }
 
@@ -205,13 +288,13 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
           const Cel* bCel = bLay->cel(f);
 
           if ((!aCel && bCel) || (aCel && !bCel)) {
-            diff.anything = diff.cels = true;
+            diff.add(Type::Cel, (aCel ? aCel->id() : NullId), f);
           }
           else if (aCel && bCel) {
             if (aCel->frame() != bCel->frame() || aCel->bounds() != bCel->bounds() ||
                 aCel->opacity() != bCel->opacity() ||
                 aCel->data()->userData() != bCel->data()->userData()) {
-              diff.anything = diff.cels = true;
+              diff.add(Type::Cel, aCel->id(), f);
 
               TRACEDIFF(aCel->frame(), bCel->frame());
               TRACEDIFF(aCel->bounds(), bCel->bounds());
@@ -219,13 +302,18 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
               TRACEDIFF(aCel->data()->userData(), bCel->data()->userData());
             }
             if (aCel->image() && bCel->image()) {
-              if (aCel->image()->bounds() != bCel->image()->bounds() ||
-                  !is_same_image(aCel->image(), bCel->image()))
-                diff.anything = diff.images = true;
+              if (aCel->image()->bounds() != bCel->image()->bounds())
+                diff.add(Type::Image, aCel->id(), f);
+              else
+                imagePairs.push_back(ImagePair{
+                  aCel->image(),
+                  bCel->image(),
+                  DocDiffItem{ Type::Image, aCel->id(), f },
+                });
             }
             // In case one is nullptr and the other not
             else if (aCel->image() != bCel->image())
-              diff.anything = diff.images = true;
+              diff.add(Type::Image, aCel->id(), f);
           }
         }
       }
@@ -234,12 +322,42 @@ DocDiff compare_docs(const Doc* a, const Doc* b)
 
   // Compare color spaces
   if (!a->sprite()->colorSpace()->nearlyEqual(*b->sprite()->colorSpace())) {
-    diff.anything = diff.colorProfiles = true;
+    diff.add(Type::ColorProfile, a->sprite()->id());
   }
 
   // Compare grid bounds
   if (a->sprite()->gridBounds() != b->sprite()->gridBounds()) {
-    diff.anything = diff.gridBounds = true;
+    diff.add(Type::GridBounds, a->sprite()->id());
+  }
+
+  // Compare the pixels of all images (the most expensive part) in
+  // several threads if it's worth it.
+  const int n = int(imagePairs.size());
+  std::vector<uint8_t> same(n, 1);
+  auto compareImages = [&imagePairs, &same, &options](const int begin, const int end) {
+    for (int i = begin; i < end; ++i)
+      same[i] = is_same_image_pair(imagePairs[i], options);
+  };
+
+  int64_t totalPixels = 0;
+  for (const ImagePair& pair : imagePairs)
+    totalPixels += int64_t(pair.a->width()) * pair.a->height();
+
+  if (options.parallel && totalPixels >= kMinPixelsForParallelDiff)
+    doc::parallel_for_bands(0, n, 1, compareImages);
+  else
+    compareImages(0, n);
+
+  for (int i = 0; i < n; ++i) {
+    if (!same[i]) {
+      const DocDiffItem& item = imagePairs[i].item;
+      diff.add(item.type, item.id, item.index);
+    }
+  }
+
+  if (options.hashCacheA && options.hashCacheB) {
+    options.hashCacheA->nextGeneration();
+    options.hashCacheB->nextGeneration();
   }
 
   return diff;
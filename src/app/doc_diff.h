@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -9,9 +9,49 @@
 #define APP_DOC_DIFF_H_INCLUDED
 #pragma once
 
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace doc {
+class Image;
+}
+
 namespace app {
 class Doc;
 
+// One specific difference found by compare_docs().
+struct DocDiffItem {
+  enum class Type {
+    Canvas,
+    TotalFrames,
+    FrameDuration,
+    Tag,
+    Palette,
+    Tileset,
+    Layer,
+    Cel,
+    Image,
+    ColorProfile,
+    GridBounds,
+  };
+
+  Type type;
+
+  // ID of the object in the first document (sprite, tag, tileset,
+  // layer, or cel), or NullId if there is no specific object.
+  doc::ObjectId id = doc::NullId;
+
+  // Frame (for frame durations, cels, and cel images), index of the
+  // tag/palette, or index of the tile in the tileset, -1 if it
+  // doesn't apply.
+  int index = -1;
+};
+
 struct DocDiff {
   bool anything : 1;
   bool canvas : 1;
@@ -26,6 +66,10 @@ struct DocDiff {
   bool colorProfiles : 1;
   bool gridBounds : 1;
 
+  // All differences found (differences in images are added at the
+  // end, after comparing all of them).
+  std::vector<DocDiffItem> items;
+
   DocDiff()
     : anything(false)
     , canvas(false)
@@ -41,11 +85,53 @@ struct DocDiff {
     , gridBounds(false)
   {
   }
+
+  void add(DocDiffItem::Type type, doc::ObjectId id = doc::NullId, int index = -1);
+};
+
+// Hashes of images indexed by image ID and version, so images that
+// weren't modified between two compare_docs() calls don't need to
+// be hashed again. Hashes of images that were not used in the last
+// compare_docs() call are discarded.
+class ImageHashCache {
+public:
+  uint32_t hash(const doc::Image* image);
+  void nextGeneration();
+
+private:
+  struct Entry {
+    doc::ObjectVersion version;
+    uint32_t hash;
+  };
+  using Map = std::unordered_map<doc::ObjectId, Entry>;
+
+  std::mutex m_mutex;
+  Map m_used;
+  Map m_old;
+};
+
+struct DocDiffOptions {
+  // Caches of hashes for the images of the first and the second
+  // document. When both caches are given, the hashes of the images
+  // are compared first, and their pixels only if the hashes match
+  // (to discard collisions). With this mode two images with
+  // different color values in transparent pixels are reported as
+  // different (the whole pixel data must be the same).
+  //
+  // Hashing an image is as expensive as comparing its pixels, so
+  // images are not hashed if one of the documents cannot be cached
+  // (e.g. a document restored from a backup has new image IDs each
+  // time).
+  ImageHashCache* hashCacheA = nullptr;
+  ImageHashCache* hashCacheB = nullptr;
+
+  // Compares images in several threads.
+  bool parallel = false;
 };
 
 // Useful for testing purposes to detect if two documents (after
 // some kind of operation) are equivalent.
-DocDiff compare_docs(const Doc* a, const Doc* b);
+DocDiff compare_docs(const Doc* a, const Doc* b, const DocDiffOptions& options = DocDiffOptions());
 
 } // namespace app
 
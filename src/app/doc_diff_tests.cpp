@@ -0,0 +1,128 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_diff.h"
+#include "app/test_context.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <memory>
+
+using namespace app;
+using namespace doc;
+
+typedef std::unique_ptr<Doc> DocPtr;
+
+class DocDiffTest : public ::testing::Test {
+public:
+  DocDiffTest() : a(ctx.documents().add(16, 16)), b(ctx.documents().add(16, 16))
+  {
+    clear_image(imageA(), rgba(0, 0, 0, 0));
+    clear_image(imageB(), rgba(0, 0, 0, 0));
+  }
+
+  ~DocDiffTest()
+  {
+    a->close();
+    b->close();
+  }
+
+  Cel* celA() { return a->sprite()->root()->firstLayer()->cel(0); }
+  Image* imageA() { return celA()->image(); }
+  Image* imageB() { return b->sprite()->root()->firstLayer()->cel(0)->image(); }
+
+  TestContextT<Context> ctx;
+  DocPtr a;
+  DocPtr b;
+};
+
+TEST_F(DocDiffTest, NoDifferences)
+{
+  const DocDiff diff = compare_docs(a.get(), b.get());
+  EXPECT_FALSE(diff.anything);
+  EXPECT_TRUE(diff.items.empty());
+}
+
+TEST_F(DocDiffTest, Items)
+{
+  b->sprite()->setFrameDuration(0, a->sprite()->frameDuration(0) + 10);
+  put_pixel(imageB(), 2, 3, rgba(255, 0, 0, 255));
+
+  const DocDiff diff = compare_docs(a.get(), b.get());
+  EXPECT_TRUE(diff.anything);
+  EXPECT_TRUE(diff.frameDuration);
+  EXPECT_TRUE(diff.images);
+  EXPECT_FALSE(diff.canvas);
+  EXPECT_FALSE(diff.cels);
+
+  // Differences in images are added at the end
+  ASSERT_EQ(2, int(diff.items.size()));
+  EXPECT_EQ(DocDiffItem::Type::FrameDuration, diff.items[0].type);
+  EXPECT_EQ(a->sprite()->id(), diff.items[0].id);
+  EXPECT_EQ(0, diff.items[0].index);
+  EXPECT_EQ(DocDiffItem::Type::Image, diff.items[1].type);
+  EXPECT_EQ(celA()->id(), diff.items[1].id);
+  EXPECT_EQ(0, diff.items[1].index);
+}
+
+TEST_F(DocDiffTest, HashedMode)
+{
+  ImageHashCache cacheA, cacheB;
+  DocDiffOptions options;
+  options.hashCacheA = &cacheA;
+  options.hashCacheB = &cacheB;
+  options.parallel = true;
+
+  EXPECT_FALSE(compare_docs(a.get(), b.get(), options).anything);
+
+  put_pixel(imageB(), 5, 5, rgba(0, 255, 0, 255));
+  imageB()->incrementVersion();
+  DocDiff diff = compare_docs(a.get(), b.get(), options);
+  EXPECT_TRUE(diff.images);
+  ASSERT_EQ(1, int(diff.items.size()));
+  EXPECT_EQ(celA()->id(), diff.items[0].id);
+
+  // In hashed mode transparent pixels must be exactly the same
+  put_pixel(imageB(), 5, 5, rgba(0, 255, 0, 0));
+  imageB()->incrementVersion();
+  EXPECT_TRUE(compare_docs(a.get(), b.get(), options).images);
+  EXPECT_FALSE(compare_docs(a.get(), b.get()).images);
+}
+
+TEST_F(DocDiffTest, ImageHashCacheInvalidation)
+{
+  ImageHashCache cache;
+  Image* image = imageA();
+  const uint32_t hash0 = cache.hash(image);
+  EXPECT_EQ(hash0, calculate_image_hash(image, image->bounds()));
+
+  // The hash is cached while the image version doesn't change
+  put_pixel(image, 0, 0, rgba(255, 255, 255, 255));
+  const uint32_t hash1 = calculate_image_hash(image, image->bounds());
+  ASSERT_NE(hash0, hash1);
+  EXPECT_EQ(hash0, cache.hash(image));
+
+  image->incrementVersion();
+  EXPECT_EQ(hash1, cache.hash(image));
+
+  // Hashes used in the previous generation are kept
+  put_pixel(image, 1, 0, rgba(255, 255, 255, 255));
+  const uint32_t hash2 = calculate_image_hash(image, image->bounds());
+  cache.nextGeneration();
+  EXPECT_EQ(hash1, cache.hash(image));
+
+  // Hashes not used in the last generation are discarded
+  cache.nextGeneration();
+  cache.nextGeneration();
+  EXPECT_EQ(hash2, cache.hash(image));
+}
@@ -18,13 +18,13 @@
 #include "app/doc.h"
 #include "app/file/file.h"
 #include "app/filename_formatter.h"
+#include "app/json_writer.h"
 #include "app/restore_visible_layers.h"
 #include "app/snap_to_grid.h"
 #include "app/util/autocrop.h"
 #include "base/convert_to.h"
 #include "base/fs.h"
 #include "base/fstream_path.h"
-#include "base/replace_string.h"
 #include "base/string.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
@@ -49,7 +49,6 @@
 #include <algorithm>
 #include <cstdio>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -61,26 +60,32 @@ using namespace doc;
 
 namespace {
 
-std::string escape_for_json(const std::string& path)
+void write_rect(DataWriter& w, const gfx::Rect& rc)
 {
-  std::string res = path;
-  base::replace_string(res, "\\", "\\\\");
-  base::replace_string(res, "\"", "\\\"");
-  return res;
+  w.beginObject(DataWriter::Layout::Inline);
+  w.field("x", rc.x);
+  w.field("y", rc.y);
+  w.field("w", rc.w);
+  w.field("h", rc.h);
+  w.endObject();
 }
 
-std::ostream& operator<<(std::ostream& os, const doc::UserData& data)
+void write_user_data(DataWriter& w, const doc::UserData& data)
 {
   doc::color_t color = data.color();
   if (doc::rgba_geta(color)) {
-    os << ", \"color\": \"#" << std::hex << std::setfill('0') << std::setw(2)
-       << (int)doc::rgba_getr(color) << std::setw(2) << (int)doc::rgba_getg(color) << std::setw(2)
-       << (int)doc::rgba_getb(color) << std::setw(2) << (int)doc::rgba_geta(color) << std::dec
-       << "\"";
+    char buf[16];
+    std::snprintf(buf,
+                  sizeof(buf),
+                  "#%02x%02x%02x%02x",
+                  doc::rgba_getr(color),
+                  doc::rgba_getg(color),
+                  doc::rgba_getb(color),
+                  doc::rgba_geta(color));
+    w.field("color", buf);
   }
   if (!data.text().empty())
-    os << ", \"data\": \"" << escape_for_json(data.text()) << "\"";
-  return os;
+    w.field("data", data.text());
 }
 
 } // anonymous namespace
@@ -613,6 +618,7 @@ void DocExporter::reset()
   m_listLayerHierarchy = false;
   m_listSlices = false;
   m_documents.clear();
+  m_textureFormatOptions.reset();
 }
 
 void DocExporter::setDocImageBuffer(const doc::ImageBufferPtr& docBuf)
@@ -644,7 +650,9 @@ Doc* DocExporter::exportSheet(Context* ctx, base::task_token& token)
       }
     }
 
-    fos.open(FSTREAM_PATH(m_dataFilename), std::ios::out);
+    fos.open(FSTREAM_PATH(m_dataFilename),
+             std::ios::out | (m_dataFormat == SpriteSheetDataFormat::Cbor ? std::ios::binary :
+                                                                           std::ios::openmode()));
     osbuf = fos.rdbuf();
   }
   std::ostream os(osbuf);
@@ -690,14 +698,24 @@ Doc* DocExporter::exportSheet(Context* ctx, base::task_token& token)
   token.set_progress(0.9f);
 
   // Save the metadata.
-  if (osbuf)
-    createDataFile(samples, os, texture);
+  if (osbuf) {
+    if (m_dataFormat == SpriteSheetDataFormat::Cbor) {
+      CborWriter writer(os);
+      createDataFile(samples, writer, texture);
+    }
+    else {
+      JsonWriter writer(os);
+      createDataFile(samples, writer, texture);
+    }
+  }
   token.set_progress(0.95f);
 
   // Save the image files.
   if (!m_textureFilename.empty()) {
     DX_TRACE("DX: exportSheet", m_textureFilename);
     textureDocument->setFilename(m_textureFilename.c_str());
+    if (m_textureFormatOptions)
+      textureDocument->setFormatOptions(m_textureFormatOptions);
     int ret = save_document(ctx, textureDocument.get());
     if (ret == 0)
       textureDocument->markAsSaved();
@@ -1300,12 +1318,9 @@ void DocExporter::trimTexture(const Samples& samples, doc::Sprite* texture) cons
                    m_textureHeight > 0 ? m_textureHeight : size.h);
 }
 
-void DocExporter::createDataFile(const Samples& samples, std::ostream& os, doc::Sprite* texture)
+void DocExporter::createDataFile(const Samples& samples, DataWriter& w, doc::Sprite* texture)
 {
-  std::string frames_begin;
-  std::string frames_end;
   bool filename_as_key = false;
-  bool filename_as_attr = false;
   int nonExtrudedPosition = 0;
   int nonExtrudedSize = 0;
 
@@ -1317,84 +1332,81 @@ void DocExporter::createDataFile(const Samples& samples, std::ostream& os, doc::
     nonExtrudedSize -= 2;
   }
 
-  // TODO we should use some string templates system here
   switch (m_dataFormat) {
-    case SpriteSheetDataFormat::JsonHash:
-      frames_begin = "{";
-      frames_end = "}";
-      filename_as_key = true;
-      filename_as_attr = false;
-      break;
+    case SpriteSheetDataFormat::JsonHash:  filename_as_key = true; break;
     case SpriteSheetDataFormat::JsonArray:
-      frames_begin = "[";
-      frames_end = "]";
-      filename_as_key = false;
-      filename_as_attr = true;
-      break;
+    case SpriteSheetDataFormat::Cbor:      filename_as_key = false; break;
   }
 
-  os << "{ \"frames\": " << frames_begin << "\n";
-  for (Samples::const_iterator it = samples.begin(), end = samples.end(); it != end;) {
-    const Sample& sample = *it;
+  w.beginObject();
+  w.key("frames");
+  if (filename_as_key)
+    w.beginObject();
+  else
+    w.beginArray();
+
+  for (const Sample& sample : samples) {
     gfx::Size srcSize = sample.originalSize();
     gfx::Rect spriteSourceBounds = sample.trimmedBounds();
     gfx::Rect frameBounds = sample.inTextureBounds();
 
-    if (filename_as_key)
-      os << "   \"" << escape_for_json(sample.filename()) << "\": {\n";
-    else if (filename_as_attr)
-      os << "   {\n"
-         << "    \"filename\": \"" << escape_for_json(sample.filename()) << "\",\n";
-
-    os << "    \"frame\": { "
-       << "\"x\": " << frameBounds.x + nonExtrudedPosition << ", "
-       << "\"y\": " << frameBounds.y + nonExtrudedPosition << ", "
-       << "\"w\": " << frameBounds.w + nonExtrudedSize << ", "
-       << "\"h\": " << frameBounds.h + nonExtrudedSize << " },\n"
-       << "    \"rotated\": false,\n"
-       << "    \"trimmed\": " << (sample.trimmed() ? "true" : "false") << ",\n"
-       << "    \"spriteSourceSize\": { "
-       << "\"x\": " << spriteSourceBounds.x << ", "
-       << "\"y\": " << spriteSourceBounds.y << ", "
-       << "\"w\": " << spriteSourceBounds.w << ", "
-       << "\"h\": " << spriteSourceBounds.h << " },\n"
-       << "    \"sourceSize\": { "
-       << "\"w\": " << srcSize.w << ", "
-       << "\"h\": " << srcSize.h << " },\n"
-       << "    \"duration\": " << sample.sprite()->frameDuration(sample.frame()) << "\n"
-       << "   }";
-
-    if (++it != samples.end())
-      os << ",\n";
-    else
-      os << "\n";
+    if (filename_as_key) {
+      w.key(sample.filename());
+      w.beginObject();
+    }
+    else {
+      w.beginObject();
+      w.field("filename", sample.filename());
+    }
+
+    w.key("frame");
+    write_rect(w,
+               gfx::Rect(frameBounds.x + nonExtrudedPosition,
+                         frameBounds.y + nonExtrudedPosition,
+                         frameBounds.w + nonExtrudedSize,
+                         frameBounds.h + nonExtrudedSize));
+    w.field("rotated", false);
+    w.field("trimmed", sample.trimmed());
+    w.key("spriteSourceSize");
+    write_rect(w, spriteSourceBounds);
+    w.key("sourceSize");
+    w.beginObject(DataWriter::Layout::Inline);
+    w.field("w", srcSize.w);
+    w.field("h", srcSize.h);
+    w.endObject();
+    w.field("duration", sample.sprite()->frameDuration(sample.frame()));
+    w.endObject();
   }
-  os << " " << frames_end;
+
+  if (filename_as_key)
+    w.endObject();
+  else
+    w.endArray();
 
   // "meta" property
-  os << ",\n"
-     << " \"meta\": {\n"
-     << "  \"app\": \"" << get_app_url() << "\",\n"
-     << "  \"version\": \"" << get_app_version() << "\",\n";
+  w.key("meta");
+  w.beginObject();
+  w.field("app", get_app_url());
+  w.field("version", get_app_version());
 
   if (!m_textureFilename.empty())
-    os << "  \"image\": \"" << escape_for_json(base::get_file_name(m_textureFilename)).c_str()
-       << "\",\n";
+    w.field("image", base::get_file_name(m_textureFilename));
 
-  os << "  \"format\": \"" << (texture->pixelFormat() == IMAGE_RGB ? "RGBA8888" : "I8") << "\",\n"
-     << "  \"size\": { "
-     << "\"w\": " << texture->width() << ", "
-     << "\"h\": " << texture->height() << " },\n"
-     << "  \"scale\": \"1\"";
+  w.field("format", (texture->pixelFormat() == IMAGE_RGB ? "RGBA8888" : "I8"));
+  w.key("size");
+  w.beginObject(DataWriter::Layout::Inline);
+  w.field("w", texture->width());
+  w.field("h", texture->height());
+  w.endObject();
+  w.field("scale", "1");
 
   // meta.frameTags
   if (m_listTags) {
-    os << ",\n"
-       << "  \"frameTags\": ["; // TODO rename this someday in the future
+    w.key("frameTags"); // TODO rename this someday in the future
+    w.beginArray();
 
     std::set<doc::ObjectId> includedSprites;
 
-    bool firstTag = true;
     for (auto& item : m_documents) {
       if (item.isOneImageOnly())
         continue;
@@ -1411,11 +1423,6 @@ void DocExporter::createDataFile(const Samples& samples, std::ostream& os, doc::
       includedSprites.insert(sprite->id());
 
       for (Tag* tag : sprite->tags()) {
-        if (firstTag)
-          firstTag = false;
-        else
-          os << ",";
-
         std::string format = m_tagnameFormat;
         if (format.empty()) {
           format = "{tag}";
@@ -1423,20 +1430,23 @@ void DocExporter::createDataFile(const Samples& samples, std::ostream& os, doc::
 
         FilenameInfo fnInfo;
         fnInfo.filename(doc->filename()).innerTagName(tag->name());
-        std::string tagname = filename_formatter(format, fnInfo);
-        os << "\n   { \"name\": \"" << escape_for_json(tagname) << "\","
-           << " \"from\": " << (tag->fromFrame()) << ","
-           << " \"to\": " << (tag->toFrame())
-           << ","
-              " \"direction\": \""
-           << escape_for_json(convert_anidir_to_string(tag->aniDir())) << "\"";
+
+        w.beginObject(DataWriter::Layout::Inline);
+        w.field("name", filename_formatter(format, fnInfo));
+        w.field("from", tag->fromFrame());
+        w.field("to", tag->toFrame());
+        w.field("direction", convert_anidir_to_string(tag->aniDir()));
         if (tag->repeat() > 0) {
-          os << ", \"repeat\": \"" << tag->repeat() << "\"";
+          // The repeat field is exported as a string (as in previous versions)
+          char buf[32];
+          std::snprintf(buf, sizeof(buf), "%d", tag->repeat());
+          w.field("repeat", buf);
         }
-        os << tag->userData() << " }";
+        write_user_data(w, tag->userData());
+        w.endObject();
       }
     }
-    os << "\n  ]";
+    w.endArray();
   }
 
   // meta.layers
@@ -1478,24 +1488,20 @@ void DocExporter::createDataFile(const Samples& samples, std::ostream& os, doc::
       }
     }
 
-    bool firstLayer = true;
-    os << ",\n"
-       << "  \"layers\": [";
+    w.key("layers");
+    w.beginArray();
     for (Layer* layer : metaLayers) {
-      if (firstLayer)
-        firstLayer = false;
-      else
-        os << ",";
-      os << "\n   { \"name\": \"" << escape_for_json(layer->name()) << "\"";
+      w.beginObject(DataWriter::Layout::Inline);
+      w.field("name", layer->name());
 
       if (layer->parent() != layer->sprite()->root())
-        os << ", \"group\": \"" << escape_for_json(layer->parent()->name()) << "\"";
+        w.field("group", layer->parent()->name());
 
       if (LayerImage* layerImg = dynamic_cast<LayerImage*>(layer)) {
-        os << ", \"opacity\": " << layerImg->opacity() << ", \"blendMode\": \""
-           << blend_mode_to_string(layerImg->blendMode()) << "\"";
+        w.field("opacity", layerImg->opacity());
+        w.field("blendMode", blend_mode_to_string(layerImg->blendMode()));
       }
-      os << layer->userData();
+      write_user_data(w, layer->userData());
 
       // Cels
       CelList cels;
@@ -1509,45 +1515,39 @@ void DocExporter::createDataFile(const Samples& samples, std::ostream& os, doc::
       }
 
       if (someCelWithData) {
-        bool firstCel = true;
-
-        os << ", \"cels\": [";
+        w.key("cels");
+        w.beginArray();
         for (const Cel* cel : cels) {
           if (cel->zIndex() != 0 || !cel->data()->userData().isEmpty()) {
-            if (firstCel)
-              firstCel = false;
-            else
-              os << ", ";
-
-            os << "{ \"frame\": " << cel->frame();
+            w.beginObject();
+            w.field("frame", cel->frame());
             if (cel->opacity() != 255) {
-              os << ", \"opacity\": " << cel->opacity();
+              w.field("opacity", cel->opacity());
             }
             if (cel->zIndex() != 0) {
-              os << ", \"zIndex\": " << cel->zIndex();
+              w.field("zIndex", cel->zIndex());
             }
             if (!cel->data()->userData().isEmpty()) {
-              os << cel->data()->userData();
+              write_user_data(w, cel->data()->userData());
             }
-            os << " }";
+            w.endObject();
           }
         }
-        os << "]";
+        w.endArray();
       }
 
-      os << " }";
+      w.endObject();
     }
-    os << "\n  ]";
+    w.endArray();
   }
 
   // meta.slices
   if (m_listSlices) {
-    os << ",\n"
-       << "  \"slices\": [";
+    w.key("slices");
+    w.beginArray();
 
     std::set<doc::ObjectId> includedSprites;
 
-    bool firstSlice = true;
     for (auto& item : m_documents) {
       if (item.isOneImageOnly())
         continue;
@@ -1566,58 +1566,47 @@ void DocExporter::createDataFile(const Samples& samples, std::ostream& os, doc::
       // TODO add possibility to export some slices
 
       for (Slice* slice : sprite->slices()) {
-        if (firstSlice)
-          firstSlice = false;
-        else
-          os << ",";
-        os << "\n   { \"name\": \"" << escape_for_json(slice->name()) << "\"" << slice->userData();
+        w.beginObject(DataWriter::Layout::Inline);
+        w.field("name", slice->name());
+        write_user_data(w, slice->userData());
 
         // Keys
         if (!slice->empty()) {
-          bool firstKey = true;
-
-          os << ", \"keys\": [";
+          w.key("keys");
+          w.beginArray();
           for (const auto& key : *slice) {
-            if (firstKey)
-              firstKey = false;
-            else
-              os << ", ";
-
             const SliceKey* sliceKey = key.value();
 
-            os << "{ \"frame\": " << key.frame() << ", "
-               << "\"bounds\": {"
-               << "\"x\": " << sliceKey->bounds().x << ", "
-               << "\"y\": " << sliceKey->bounds().y << ", "
-               << "\"w\": " << sliceKey->bounds().w << ", "
-               << "\"h\": " << sliceKey->bounds().h << " }";
+            w.beginObject();
+            w.field("frame", key.frame());
+            w.key("bounds");
+            write_rect(w, sliceKey->bounds());
 
             if (!sliceKey->center().isEmpty()) {
-              os << ", \"center\": {"
-                 << "\"x\": " << sliceKey->center().x << ", "
-                 << "\"y\": " << sliceKey->center().y << ", "
-                 << "\"w\": " << sliceKey->center().w << ", "
-                 << "\"h\": " << sliceKey->center().h << " }";
+              w.key("center");
+              write_rect(w, sliceKey->center());
             }
 
             if (sliceKey->hasPivot()) {
-              os << ", \"pivot\": {"
-                 << "\"x\": " << sliceKey->pivot().x << ", "
-                 << "\"y\": " << sliceKey->pivot().y << " }";
+              w.key("pivot");
+              w.beginObject();
+              w.field("x", sliceKey->pivot().x);
+              w.field("y", sliceKey->pivot().y);
+              w.endObject();
             }
 
-            os << " }";
+            w.endObject();
           }
-          os << "]";
+          w.endArray();
         }
-        os << " }";
+        w.endObject();
       }
     }
-    os << "\n  ]";
+    w.endArray();
   }
 
-  os << "\n }\n"
-     << "}\n";
+  w.endObject(); // meta
+  w.endObject();
 }
 
 } // namespace app
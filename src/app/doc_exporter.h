@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -9,6 +9,7 @@
 #define APP_DOC_EXPORTER_H_INCLUDED
 #pragma once
 
+#include "app/file/format_options.h"
 #include "app/sprite_sheet_data_format.h"
 #include "app/sprite_sheet_type.h"
 #include "base/disable_copying.h"
@@ -38,6 +39,7 @@ class Tag;
 namespace app {
 
 class Context;
+class DataWriter;
 class Doc;
 
 class DocExporter {
@@ -53,10 +55,13 @@ public:
   SpriteSheetType spriteSheetType() { return m_sheetType; }
   const std::string& filenameFormat() const { return m_filenameFormat; }
   const std::string& tagnameFormat() const { return m_tagnameFormat; }
+  const FormatOptionsPtr& textureFormatOptions() const { return m_textureFormatOptions; }
 
   void setDataFormat(SpriteSheetDataFormat format) { m_dataFormat = format; }
   void setDataFilename(const std::string& filename) { m_dataFilename = filename; }
   void setTextureFilename(const std::string& filename) { m_textureFilename = filename; }
+  // Format options used to save the texture (e.g. PngOptions)
+  void setTextureFormatOptions(const FormatOptionsPtr& opts) { m_textureFormatOptions = opts; }
   void setTextureWidth(int width) { m_textureWidth = width; }
   void setTextureHeight(int height) { m_textureHeight = height; }
   void setTextureColumns(int columns) { m_textureColumns = columns; }
@@ -116,7 +121,7 @@ private:
                      doc::Image* textureImage,
                      base::task_token& token) const;
   void trimTexture(const Samples& samples, doc::Sprite* texture) const;
-  void createDataFile(const Samples& samples, std::ostream& os, doc::Sprite* texture);
+  void createDataFile(const Samples& samples, DataWriter& w, doc::Sprite* texture);
 
   class Item {
   public:
@@ -151,6 +156,7 @@ private:
   SpriteSheetDataFormat m_dataFormat;
   std::string m_dataFilename;
   std::string m_textureFilename;
+  FormatOptionsPtr m_textureFormatOptions;
   std::string m_filenameFormat;
   std::string m_tagnameFormat;
   int m_textureWidth;
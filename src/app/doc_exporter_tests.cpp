@@ -0,0 +1,109 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_exporter.h"
+#include "base/fs.h"
+#include "base/task.h"
+#include "doc/cel.h"
+#include "doc/layer.h"
+#include "doc/slice.h"
+#include "doc/sprite.h"
+#include "doc/tag.h"
+#include "ver/info.h"
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+using namespace app;
+using namespace doc;
+
+// The JSON layout of the sprite sheet data must be the same as in
+// previous versions.
+TEST(DocExporter, JsonDataFile)
+{
+  Context ctx;
+  std::unique_ptr<Doc> doc(ctx.documents().add(4, 4));
+  doc->setFilename("test.aseprite");
+
+  Sprite* sprite = doc->sprite();
+  Layer* layer = sprite->root()->firstLayer();
+  layer->setName("Layer");
+  layer->cel(0)->data()->userData().setColor(rgba(255, 0, 0, 255));
+
+  Tag* tag = new Tag(0, 0);
+  tag->setName("Idle");
+  sprite->tags().add(tag);
+
+  Slice* slice = new Slice;
+  slice->userData().setColor(rgba(0, 0, 255, 255));
+  slice->insert(0, SliceKey(gfx::Rect(0, 1, 2, 3), gfx::Rect(), gfx::Point(1, 2)));
+  sprite->slices().add(slice);
+
+  const std::string fn = "test_sheet.json";
+  DocExporter exporter;
+  exporter.setDataFormat(SpriteSheetDataFormat::JsonArray);
+  exporter.setDataFilename(fn);
+  exporter.setFilenameFormat("{title}");
+  exporter.setListTags(true);
+  exporter.setListLayers(true);
+  exporter.setListSlices(true);
+  exporter.addDocumentSamples(doc.get(), nullptr, false, false, false, nullptr, nullptr);
+
+  base::task_token token;
+  std::unique_ptr<Doc> texture(exporter.exportSheet(&ctx, token));
+  ASSERT_TRUE(texture != nullptr);
+
+  std::ifstream f(fn);
+  const std::string output((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  f.close();
+
+  EXPECT_EQ(std::string("{ \"frames\": [\n"
+                        "   {\n"
+                        "    \"filename\": \"test\",\n"
+                        "    \"frame\": { \"x\": 0, \"y\": 0, \"w\": 4, \"h\": 4 },\n"
+                        "    \"rotated\": false,\n"
+                        "    \"trimmed\": false,\n"
+                        "    \"spriteSourceSize\": { \"x\": 0, \"y\": 0, \"w\": 4, \"h\": 4 },\n"
+                        "    \"sourceSize\": { \"w\": 4, \"h\": 4 },\n"
+                        "    \"duration\": 100\n"
+                        "   }\n"
+                        " ],\n"
+                        " \"meta\": {\n"
+                        "  \"app\": \"") +
+              get_app_url() +
+              "\",\n"
+              "  \"version\": \"" +
+              get_app_version() +
+              "\",\n"
+              "  \"format\": \"RGBA8888\",\n"
+              "  \"size\": { \"w\": 4, \"h\": 4 },\n"
+              "  \"scale\": \"1\",\n"
+              "  \"frameTags\": [\n"
+              "   { \"name\": \"Idle\", \"from\": 0, \"to\": 0, \"direction\": \"forward\", "
+              "\"color\": \"#000000ff\" }\n"
+              "  ],\n"
+              "  \"layers\": [\n"
+              "   { \"name\": \"Layer\", \"opacity\": 255, \"blendMode\": \"normal\", "
+              "\"cels\": [{ \"frame\": 0, \"color\": \"#ff0000ff\" }] }\n"
+              "  ],\n"
+              "  \"slices\": [\n"
+              "   { \"name\": \"Slice\", \"color\": \"#0000ffff\", \"keys\": [{ \"frame\": 0, "
+              "\"bounds\": {\"x\": 0, \"y\": 1, \"w\": 2, \"h\": 3 }, "
+              "\"pivot\": {\"x\": 1, \"y\": 2 } }] }\n"
+              "  ]\n"
+              " }\n"
+              "}\n",
+            output);
+
+  doc->close();
+  base::delete_file(fn);
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -104,6 +104,10 @@ static DocRange move_or_copy_frames(DocApi& api,
   frame_t firstCopiedBlock = 0;
   frame_t dstBeforeFrame = (place == kDocRangeBefore ? dstFrame : dstFrame + 1);
 
+  // All frames are moved with just one command
+  if (op == Move)
+    api.beginMoveFrames(sprite);
+
   for (; srcFrame != srcFrameEnd; ++srcFrame) {
     frame_t fromFrame = (*srcFrame) + srcDelta;
 
@@ -178,6 +182,9 @@ static DocRange move_or_copy_frames(DocApi& api,
 #endif
   }
 
+  if (op == Move)
+    api.endMoveFrames();
+
   DocRange result;
   if (!srcRange.selectedLayers().empty())
     result.selectLayers(srcRange.selectedLayers());
@@ -318,7 +325,9 @@ static DocRange drop_range_op(Doc* doc,
 
     // TODO Try to add the range with just one call to DocApi
     // methods, to avoid generating a lot of cmd::SetCelFrame (see
-    // DocApi::setCelFramePosition() function).
+    // DocApi::setCelFramePosition() function). Frames are already
+    // moved with just one cmd::PermuteFrames (see
+    // DocApi::beginMoveFrames()).
 
     switch (from.type()) {
       case DocRange::kCels: {
@@ -491,9 +500,11 @@ void reverse_frames(Doc* doc, const DocRange& range)
   }
 
   if (moveFrames) {
+    api.beginMoveFrames(sprite);
     for (frame_t frameRev = frameEnd + 1; frameRev > frameBegin; --frameRev) {
       api.moveFrame(sprite, frameBegin, frameRev, kDropBeforeFrame, kDontAdjustTags);
     }
+    api.endMoveFrames();
   }
   else if (swapCels) {
     for (Layer* layer : layers) {
@@ -20,12 +20,15 @@
 #include "app/load_matrix.h"
 #include "app/pref/preferences.h"
 #include "app/resource_finder.h"
+#include "base/chrono.h"
 #include "base/exception.h"
 #include "base/file_content.h"
 #include "base/file_handle.h"
 #include "base/fs.h"
 #include "base/fstream_path.h"
+#include "doc/parallel_for.h"
 #include "render/dithering_matrix.h"
+#include "ui/system.h"
 #include "ui/widget.h"
 
 #if ENABLE_SENTRY
@@ -42,6 +45,8 @@
 #include "archive_entry.h"
 #include "json11.hpp"
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <queue>
 #include <sstream>
@@ -59,6 +64,7 @@ namespace {
 const char* kPackageJson = "package.json";
 const char* kInfoJson = "__info.json";
 const char* kPrefLua = "__pref.lua";
+const char* kIndexJson = ".index.json";
 
 class ReadArchive {
 public:
@@ -206,6 +212,97 @@ void write_json_file(const std::string& path, const json11::Json& json)
   out.write(text.c_str(), text.size());
 }
 
+// Cache of the parsed package.json files of all extensions, saved in
+// the user extensions folder, to avoid reading and parsing each
+// package.json file on each startup. An entry is valid while the
+// modification time and size of the package.json file don't change.
+class PackageIndex {
+public:
+  explicit PackageIndex(const std::string& fn) : m_fn(fn)
+  {
+    if (m_fn.empty() || !base::is_file(m_fn))
+      return;
+    try {
+      json11::Json json;
+      read_json_file(m_fn, json);
+      if (json["version"].int_value() == kVersion)
+        m_oldPackages = json["packages"].object_items();
+    }
+    catch (const std::exception& ex) {
+      LOG(ERROR, "EXT: Error loading extensions index: %s\n", ex.what());
+    }
+  }
+
+  // Returns true if the given package.json file is in the index with
+  // the same stamp (i.e. the file wasn't modified).
+  bool find(const std::string& packageFn, const std::string& stamp, json11::Json& json)
+  {
+    auto it = m_oldPackages.find(packageFn);
+    if (it != m_oldPackages.end() && it->second["stamp"].string_value() == stamp) {
+      m_packages[packageFn] = it->second;
+      json = it->second["json"];
+      ++m_hits;
+      return true;
+    }
+    return false;
+  }
+
+  // Adds a new or modified package.json file to the index.
+  void add(const std::string& packageFn, const std::string& stamp, const json11::Json& json)
+  {
+    m_packages[packageFn] = json11::Json::object{
+      { "stamp", stamp },
+      { "json",  json  }
+    };
+    m_modified = true;
+  }
+
+  int hits() const { return m_hits; }
+
+  static std::string fileStamp(const std::string& fn)
+  {
+    const base::Time t = base::get_modification_time(fn);
+    char buf[64];
+    std::snprintf(buf,
+                  sizeof(buf),
+                  "%04d%02d%02d%02d%02d%02d-%zu",
+                  t.year,
+                  t.month,
+                  t.day,
+                  t.hour,
+                  t.minute,
+                  t.second,
+                  base::file_size(fn));
+    return buf;
+  }
+
+  // Saves the index if it changed (new/modified/removed packages).
+  void save()
+  {
+    if (m_fn.empty() || (!m_modified && m_packages.size() == m_oldPackages.size()))
+      return;
+    try {
+      write_json_file(m_fn,
+                      json11::Json::object{
+                        { "version",  kVersion   },
+                        { "packages", m_packages }
+      });
+    }
+    catch (const std::exception& ex) {
+      LOG(ERROR, "EXT: Error saving extensions index: %s\n", ex.what());
+    }
+  }
+
+private:
+  static constexpr int kVersion = 1;
+
+  std::string m_fn;
+  json11::Json::object m_oldPackages;
+  json11::Json::object m_packages;
+  bool m_modified = false;
+  int m_hits = 0;
+};
+
 } // anonymous namespace
 
 //////////////////////////////////////////////////////////////////////
@@ -788,6 +885,21 @@ Extensions::Extensions()
     LOG("EXT: User extensions path '%s'\n", m_userExtensionsPath.c_str());
   }
 
+  base::Chrono chrono;
+  PackageIndex index(m_userExtensionsPath.empty() ?
+                       std::string() :
+                       base::join_path(m_userExtensionsPath, kIndexJson));
+
+  struct Package {
+    std::string dir;
+    std::string fn;
+    std::string stamp;
+    bool isBuiltin;
+    json11::Json json;
+    std::string error;
+  };
+  std::vector<Package> packages;
+
   ResourceFinder rf;
   rf.includeUserDir("extensions");
   rf.includeDataDir("extensions");
@@ -813,14 +925,54 @@ Extensions::Extensions()
         continue;
       }
 
+      packages.push_back(
+        Package{ dir, fullFn, PackageIndex::fileStamp(fullFn), isBuiltinExtension, {}, {} });
+    }
+  }
+
+  // Parse the package.json files that are not in the index (or were
+  // modified) from several threads.
+  std::vector<Package*> toParse;
+  for (auto& package : packages) {
+    if (!index.find(package.fn, package.stamp, package.json))
+      toParse.push_back(&package);
+  }
+  doc::parallel_for_bands(0, int(toParse.size()), 4, [&toParse](const int a, const int b) {
+    for (int i = a; i < b; ++i) {
+      Package* package = toParse[i];
       try {
-        loadExtension(dir, fullFn, isBuiltinExtension);
+        read_json_file(package->fn, package->json);
       }
       catch (const std::exception& ex) {
-        LOG("EXT: Error loading JSON file: %s\n", ex.what());
+        package->error = ex.what();
       }
     }
+  });
+  for (const Package* package : toParse) {
+    if (package->error.empty())
+      index.add(package->fn, package->stamp, package->json);
   }
+
+  // Load extensions in the same order they were found
+  for (const auto& package : packages) {
+    if (!package.error.empty()) {
+      LOG("EXT: Error loading JSON file: %s\n", package.error.c_str());
+      continue;
+    }
+    try {
+      loadExtension(package.dir, package.json, package.isBuiltin);
+    }
+    catch (const std::exception& ex) {
+      LOG("EXT: Error loading JSON file: %s\n", ex.what());
+    }
+  }
+
+  index.save();
+
+  LOG("EXT: %d extensions loaded in %.3f s (%d package.json from the index)\n",
+      int(m_extensions.size()),
+      chrono.elapsed(),
+      index.hits());
 }
 
 Extensions::~Extensions()
@@ -829,16 +981,78 @@ Extensions::~Extensions()
     delete ext;
 }
 
-void Extensions::executeInitActions()
+void Extensions::executeInitActions(const bool deferScripts)
 {
+#ifdef ENABLE_SCRIPTING
+  if (deferScripts) {
+    m_pendingInit.clear();
+    for (auto& ext : m_extensions) {
+      if (ext->isEnabled() && ext->hasScripts())
+        m_pendingInit.push_back(ext);
+    }
+    if (!m_pendingInit.empty())
+      ui::execute_from_ui_thread([this] { initNextPendingScript(); });
+    return;
+  }
+#endif
+
+  base::Chrono chrono;
   for (auto& ext : m_extensions)
     ext->executeInitActions();
+  LOG("EXT: Scripts initialized in %.3f s\n", chrono.elapsed());
+
+  ScriptsChange(nullptr);
+}
+
+void Extensions::initPendingScripts()
+{
+  if (m_pendingInit.empty())
+    return;
+
+  base::Chrono chrono;
+  List pending;
+  std::swap(pending, m_pendingInit);
+  for (auto& ext : pending)
+    ext->executeInitActions();
+  LOG("EXT: Pending scripts initialized in %.3f s\n", chrono.elapsed());
 
   ScriptsChange(nullptr);
 }
 
+void Extensions::initNextPendingScript()
+{
+  // The pending scripts could be already initialized by
+  // initPendingScripts() or the extension removed.
+  if (m_pendingInit.empty())
+    return;
+
+  Extension* ext = m_pendingInit.front();
+  m_pendingInit.erase(m_pendingInit.begin());
+
+  base::Chrono chrono;
+  ext->executeInitActions();
+  LOG("EXT: Scripts of '%s' initialized in %.3f s\n", ext->name().c_str(), chrono.elapsed());
+
+  // Initialize the next extension in the next iteration of the
+  // message loop, and update menus/shortcuts when all are ready.
+  if (!m_pendingInit.empty())
+    ui::execute_from_ui_thread([this] { initNextPendingScript(); });
+  else
+    ScriptsChange(nullptr);
+}
+
+void Extensions::removePendingScript(Extension* extension)
+{
+  auto it = std::find(m_pendingInit.begin(), m_pendingInit.end(), extension);
+  if (it != m_pendingInit.end())
+    m_pendingInit.erase(it);
+}
+
 void Extensions::executeExitActions()
 {
+  // Extensions that weren't initialized don't need to exit
+  m_pendingInit.clear();
+
   for (auto& ext : m_extensions)
     ext->executeExitActions();
 
@@ -925,12 +1139,14 @@ std::vector<Extension::DitheringMatrixInfo*> Extensions::ditheringMatrices()
 
 void Extensions::enableExtension(Extension* extension, const bool state)
 {
+  removePendingScript(extension);
   extension->enable(state);
   generateExtensionSignals(extension);
 }
 
 void Extensions::uninstallExtension(Extension* extension, const DeletePluginPref delPref)
 {
+  removePendingScript(extension);
   extension->uninstall(delPref);
   generateExtensionSignals(extension);
 
@@ -1066,8 +1282,9 @@ Extension* Extensions::installCompressedExtension(const std::string& zipFn,
   }
 
   // Load the extension
-  Extension* extension =
-    loadExtension(info.dstPath, base::join_path(info.dstPath, kPackageJson), false);
+  json11::Json json;
+  read_json_file(base::join_path(info.dstPath, kPackageJson), json);
+  Extension* extension = loadExtension(info.dstPath, json, false);
   if (!extension)
     throw base::Exception("Error adding the new extension");
 
@@ -1079,11 +1296,9 @@ Extension* Extensions::installCompressedExtension(const std::string& zipFn,
 }
 
 Extension* Extensions::loadExtension(const std::string& path,
-                                     const std::string& fullPackageFilename,
+                                     const json11::Json& json,
                                      const bool isBuiltinExtension)
 {
-  json11::Json json;
-  read_json_file(fullPackageFilename, json);
   auto name = json["name"].string_value();
   auto version = json["version"].string_value();
   auto displayName = json["displayName"].string_value();
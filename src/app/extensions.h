@@ -17,6 +17,10 @@
 #include <string>
 #include <vector>
 
+namespace json11 {
+class Json;
+}
+
 namespace ui {
 class Widget;
 }
@@ -194,9 +198,17 @@ public:
   Extensions();
   ~Extensions();
 
-  void executeInitActions();
+  // Calls the init() function of all scripts. With "deferScripts",
+  // the scripts are initialized later from the UI thread, one
+  // extension in each iteration of the message loop (so the main
+  // window can be shown before).
+  void executeInitActions(const bool deferScripts = false);
   void executeExitActions();
 
+  // Initializes right now the scripts that were deferred (e.g. before
+  // running a script that could use plugin commands).
+  void initPendingScripts();
+
   iterator begin() { return m_extensions.begin(); }
   iterator end() { return m_extensions.end(); }
 
@@ -228,11 +240,17 @@ public:
 
 private:
   Extension* loadExtension(const std::string& path,
-                           const std::string& fullPackageFilename,
+                           const json11::Json& json,
                            const bool isBuiltinExtension);
   void generateExtensionSignals(Extension* extension);
+  void initNextPendingScript();
+  void removePendingScript(Extension* extension);
 
   List m_extensions;
+
+  // Enabled extensions with scripts that weren't initialized yet
+  // (see executeInitActions()).
+  List m_pendingInit;
   std::string m_userExtensionsPath;
 };
 
@@ -349,7 +349,7 @@ bool AseFormat::onPostLoad(FileOp* fop)
 bool AseFormat::onSave(FileOp* fop)
 {
   const Sprite* sprite = fop->document()->sprite();
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* f = handle.get();
 
   // Write the header
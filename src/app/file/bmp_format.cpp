@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -19,16 +19,29 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "app/file/row_converters.h"
 #include "base/cfile.h"
 #include "base/file_handle.h"
 #include "doc/doc.h"
+#include "doc/parallel_for.h"
 #include "fmt/format.h"
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 namespace app {
 
 // Max supported .bmp size (to filter out invalid image sizes)
 const uint32_t kMaxBmpSize = 1024 * 1024 * 128; // 128 MB
 
+// Pixel data is read/written in chunks of this size (to report the
+// progress between chunks).
+const std::size_t kChunkSize = 1024 * 1024; // 1 MB
+
+// Minimum number of rows converted in each thread.
+const int kMinBandRows = 32;
+
 using namespace base;
 
 class BmpFormat : public FileFormat {
@@ -486,171 +499,65 @@ static void read_bmicolors(FileOp* fop, int bytes, FILE* f, bool win_flag)
     fgetc(f);
 }
 
-/* read_1bit_line:
- *  Support function for reading the 1 bit bitmap file format.
+/* read_rows:
+ *  Reads "height" rows of "stride" bytes of pixel data. If the file
+ *  is truncated, the missing rows are filled with zeros. Returns false
+ *  if the user stops the operation.
  */
-static void read_1bit_line(int length, FILE* f, Image* image, int line)
+static bool read_rows(FILE* f,
+                      const std::size_t stride,
+                      const int height,
+                      FileOp* fop,
+                      std::vector<uint8_t>& data)
 {
-  unsigned char b[32];
-  unsigned long n;
-  int i, j, k;
-  int pix;
-
-  for (i = 0; i < length; i++) {
-    j = i % 32;
-    if (j == 0) {
-      n = fgetl(f);
-      n = ((n & 0x000000ff) << 24) | ((n & 0x0000ff00) << 8) | ((n & 0x00ff0000) >> 8) |
-          ((n & 0xff000000) >> 24);
-      for (k = 0; k < 32; k++) {
-        b[31 - k] = (char)(n & 1);
-        n = n >> 1;
-      }
-    }
-    pix = b[j];
-    put_pixel(image, i, line, pix);
-  }
-}
+  data.assign(stride * height, 0);
 
-/* read_2bit_line (not standard):
- *  Support function for reading the 2 bit bitmap file format.
- */
-static void read_2bit_line(int length, FILE* f, Image* image, int line)
-{
-  unsigned char b[16];
-  unsigned long n;
-  int i, j, k;
-  int temp;
-  int pix;
-
-  for (i = 0; i < length; i++) {
-    j = i % 16;
-    if (j == 0) {
-      n = fgetl(f);
-      for (k = 0; k < 4; k++) {
-        temp = n & 255;
-        b[k * 4 + 3] = temp & 3;
-        temp = temp >> 2;
-        b[k * 4 + 2] = temp & 3;
-        temp = temp >> 2;
-        b[k * 4 + 1] = temp & 3;
-        temp = temp >> 2;
-        b[k * 4] = temp & 3;
-        n = n >> 8;
-      }
-    }
-    pix = b[j];
-    put_pixel(image, i, line, pix);
-  }
-}
+  const int rowsPerChunk = std::max<int>(1, int(kChunkSize / std::max<std::size_t>(1, stride)));
+  for (int y = 0; y < height; y += rowsPerChunk) {
+    const int n = std::min(rowsPerChunk, height - y);
+    if (fread(&data[y * stride], 1, stride * n, f) < stride * n)
+      break;
 
-/* read_4bit_line:
- *  Support function for reading the 4 bit bitmap file format.
- */
-static void read_4bit_line(int length, FILE* f, Image* image, int line)
-{
-  unsigned char b[8];
-  unsigned long n;
-  int i, j, k;
-  int temp;
-  int pix;
-
-  for (i = 0; i < length; i++) {
-    j = i % 8;
-    if (j == 0) {
-      n = fgetl(f);
-      for (k = 0; k < 4; k++) {
-        temp = n & 255;
-        b[k * 2 + 1] = temp & 15;
-        temp = temp >> 4;
-        b[k * 2] = temp & 15;
-        n = n >> 8;
-      }
-    }
-    pix = b[j];
-    put_pixel(image, i, line, pix);
+    fop->setProgress((float)(y + n) / (float)(height));
+    if (fop->isStop())
+      return false;
   }
+  return true;
 }
 
-/* read_8bit_line:
- *  Support function for reading the 8 bit bitmap file format.
+/* convert_rows:
+ *  Calls func(src, dst) for each row of the read pixel data and the
+ *  image row where it goes (BMP rows are bottom-up if biHeight > 0).
+ *  Rows are converted in several threads.
  */
-static void read_8bit_line(int length, FILE* f, Image* image, int line)
+template<typename Func>
+static void convert_rows(const std::vector<uint8_t>& data,
+                         const std::size_t stride,
+                         Image* image,
+                         const BITMAPINFOHEADER* infoheader,
+                         Func&& func)
 {
-  unsigned char b[4];
-  unsigned long n;
-  int i, j, k;
-  int pix;
-
-  for (i = 0; i < length; i++) {
-    j = i % 4;
-    if (j == 0) {
-      n = fgetl(f);
-      for (k = 0; k < 4; k++) {
-        b[k] = (char)(n & 255);
-        n = n >> 8;
-      }
-    }
-    pix = b[j];
-    put_pixel(image, i, line, pix);
-  }
-}
-
-static void read_16bit_line(int length, FILE* f, Image* image, int line, bool& withAlpha)
-{
-  int i, r, g, b, a, word;
-
-  for (i = 0; i < length; i++) {
-    word = fgetw(f);
-
-    r = (word >> 10) & 0x1f;
-    g = (word >> 5) & 0x1f;
-    b = (word) & 0x1f;
-    a = (word & 0x8000 ? 255 : 0);
-    if (a)
-      withAlpha = true;
-    put_pixel(image,
-              i,
-              line,
-              rgba(scale_5bits_to_8bits(r), scale_5bits_to_8bits(g), scale_5bits_to_8bits(b), a));
-  }
-
-  i = (2 * i) % 4;
-  if (i > 0)
-    while (i++ < 4)
-      fgetc(f);
-}
-
-static void read_24bit_line(int length, FILE* f, Image* image, int line)
-{
-  int i, r, g, b;
+  const int height = image->height();
+  const bool topDown = ((int)infoheader->biHeight < 0);
 
-  for (i = 0; i < length; i++) {
-    b = fgetc(f);
-    g = fgetc(f);
-    r = fgetc(f);
-    put_pixel(image, i, line, rgba(r, g, b, 255));
-  }
-
-  i = (3 * i) % 4;
-  if (i > 0)
-    while (i++ < 4)
-      fgetc(f);
+  doc::parallel_for_bands(0, height, kMinBandRows, [&](const int a, const int b) {
+    for (int i = a; i < b; ++i) {
+      const int line = (topDown ? i : height - 1 - i);
+      func(&data[i * stride], image->getPixelAddress(0, line));
+    }
+  });
 }
 
-static void read_32bit_line(int length, FILE* f, Image* image, int line, bool& withAlpha)
+/* make_opaque:
+ *  Sets the alpha of all pixels to 255 (for 16/32 bits BMPs without
+ *  alpha values).
+ */
+static void make_opaque(Image* image)
 {
-  int i, r, g, b, a;
-
-  for (i = 0; i < length; i++) {
-    b = fgetc(f);
-    g = fgetc(f);
-    r = fgetc(f);
-    a = fgetc(f);
-    if (a)
-      withAlpha = true;
-    put_pixel(image, i, line, rgba(r, g, b, a));
-  }
+  doc::parallel_for_bands(0, image->height(), kMinBandRows, [image](const int a, const int b) {
+    for (int y = a; y < b; ++y)
+      make_opaque_rgba_row((uint32_t*)image->getPixelAddress(0, y), image->width());
+  });
 }
 
 /* read_image:
@@ -662,35 +569,60 @@ static void read_image(FILE* f,
                        FileOp* fop,
                        bool& withAlpha)
 {
-  int i, line, height, dir;
-
-  height = (int)infoheader->biHeight;
-  line = height < 0 ? 0 : height - 1;
-  dir = height < 0 ? 1 : -1;
-  height = ABS(height);
-
-  for (i = 0; i < height; i++, line += dir) {
-    switch (infoheader->biBitCount) {
-      case 1:  read_1bit_line(infoheader->biWidth, f, image, line); break;
-      case 2:  read_2bit_line(infoheader->biWidth, f, image, line); break;
-      case 4:  read_4bit_line(infoheader->biWidth, f, image, line); break;
-      case 8:  read_8bit_line(infoheader->biWidth, f, image, line); break;
-      case 16: read_16bit_line(infoheader->biWidth, f, image, line, withAlpha); break;
-      case 24: read_24bit_line(infoheader->biWidth, f, image, line); break;
-      case 32: read_32bit_line(infoheader->biWidth, f, image, line, withAlpha); break;
-    }
+  const int bpp = infoheader->biBitCount;
+  const int width = infoheader->biWidth;
+  const std::size_t stride = row_stride_32(width, bpp);
+
+  std::vector<uint8_t> data;
+  if (!read_rows(f, stride, image->height(), fop, data))
+    return;
+
+  std::atomic<bool> alpha(false);
+  convert_rows(data,
+               stride,
+               image,
+               infoheader,
+               [bpp, width, &alpha](const uint8_t* src, uint8_t* dst) {
+                 switch (bpp) {
+                   case 1:
+                   case 2:
+                   case 4:
+                   case 8:  unpack_indexed_row(src, bpp, width, dst); break;
+                   case 16:
+                     if (argb1555_to_rgba_row(src, width, (uint32_t*)dst))
+                       alpha = true;
+                     break;
+                   case 24: bgr_to_rgba_row(src, width, (uint32_t*)dst); break;
+                   case 32:
+                     if (bgra_to_rgba_row(src, width, (uint32_t*)dst))
+                       alpha = true;
+                     break;
+                 }
+               });
+  if (alpha)
+    withAlpha = true;
+
+  if ((bpp == 32 || bpp == 16) && !withAlpha)
+    make_opaque(image);
+}
 
-    fop->setProgress((float)(i + 1) / (float)(height));
-    if (fop->isStop())
-      break;
-  }
+/* put_rle_pixels:
+ *  Fills "count" pixels of the "line" from "pos" with the given
+ *  index, clipping them to the image bounds.
+ */
+static void put_rle_pixels(Image* image,
+                           const int pos,
+                           const int line,
+                           const int count,
+                           const int index)
+{
+  if (line < 0 || line >= image->height())
+    return;
 
-  if ((infoheader->biBitCount == 32 || infoheader->biBitCount == 16) && !withAlpha) {
-    LockImageBits<RgbTraits> imageBits(image, image->bounds());
-    auto imgIt = imageBits.begin(), imgEnd = imageBits.end();
-    for (; imgIt != imgEnd; ++imgIt)
-      *imgIt |= 0xff000000;
-  }
+  const int x0 = std::max(pos, 0);
+  const int x1 = std::min(pos + count, image->width());
+  if (x0 < x1)
+    std::fill_n((IndexedTraits::address_t)image->getPixelAddress(x0, line), x1 - x0, index);
 }
 
 /* read_rle8_compressed_image:
@@ -701,7 +633,8 @@ static void read_image(FILE* f,
  */
 static void read_rle8_compressed_image(FILE* f, Image* image, const BITMAPINFOHEADER* infoheader)
 {
-  unsigned char count, val, val0;
+  unsigned char buf[256];
+  unsigned char count, val;
   int j, pos, line, height, dir;
   int eolflag, eopicflag;
 
@@ -721,10 +654,8 @@ static void read_rle8_compressed_image(FILE* f, Image* image, const BITMAPINFOHE
       val = fgetc(f);
 
       if (count > 0) { /* repeat pixel count times */
-        for (j = 0; j < count; j++) {
-          put_pixel(image, pos, line, val);
-          pos++;
-        }
+        put_rle_pixels(image, pos, line, count, val);
+        pos += count;
       }
       else {
         switch (val) {
@@ -740,14 +671,15 @@ static void read_rle8_compressed_image(FILE* f, Image* image, const BITMAPINFOHE
             break;
 
           default: /* read in absolute mode */
-            for (j = 0; j < val; j++) {
-              val0 = fgetc(f);
-              put_pixel(image, pos, line, val0);
-              pos++;
-            }
+            for (j = 0; j < val; j++)
+              buf[j] = fgetc(f);
+
+            for (j = 0; j < val; j++)
+              put_rle_pixels(image, pos + j, line, 1, buf[j]);
+            pos += val;
 
             if (j % 2 == 1)
-              val0 = fgetc(f); /* align on word boundary */
+              fgetc(f); /* align on word boundary */
             break;
         }
       }
@@ -794,10 +726,13 @@ static void read_rle4_compressed_image(FILE* f, Image* image, const BITMAPINFOHE
       if (count > 0) { /* repeat pixels count times */
         b[1] = val & 15;
         b[0] = (val >> 4) & 15;
-        for (j = 0; j < count; j++) {
-          put_pixel(image, pos, line, b[j % 2]);
-          pos++;
+        if (b[0] == b[1])
+          put_rle_pixels(image, pos, line, count, b[0]);
+        else {
+          for (j = 0; j < count; j++)
+            put_rle_pixels(image, pos + j, line, 1, b[j % 2]);
         }
+        pos += count;
       }
       else {
         switch (val) {
@@ -823,7 +758,7 @@ static void read_rle4_compressed_image(FILE* f, Image* image, const BITMAPINFOHE
                   val0 = val0 >> 4;
                 }
               }
-              put_pixel(image, pos, line, b[j % 4]);
+              put_rle_pixels(image, pos, line, 1, b[j % 4]);
               pos++;
             }
             break;
@@ -872,18 +807,11 @@ static int read_bitfields_image(FILE* f,
                                 uint32_t gmask,
                                 uint32_t bmask,
                                 uint32_t amask,
+                                FileOp* fop,
                                 bool& withAlpha)
 {
-  uint32_t buffer, rshift, gshift, bshift, ashift;
+  uint32_t rshift, gshift, bshift, ashift;
   int rbits = 0, gbits = 0, bbits = 0, abits = 0;
-  int i, j, k, line, height, dir, r, g, b, a;
-  int bits_per_pixel;
-  int bytes_per_pixel;
-
-  height = (int)infoheader->biHeight;
-  line = height < 0 ? 0 : height - 1;
-  dir = height < 0 ? 1 : -1;
-  height = ABS(height);
 
   /* calculate shifts */
   rshift = calc_shift(rmask, rbits);
@@ -892,44 +820,74 @@ static int read_bitfields_image(FILE* f,
   ashift = calc_shift(amask, abits);
 
   /* calculate bits-per-pixel and bytes-per-pixel */
-  bits_per_pixel = infoheader->biBitCount;
-  bytes_per_pixel = ((bits_per_pixel / 8) + ((bits_per_pixel % 8) > 0 ? 1 : 0));
-
-  for (i = 0; i < height; i++, line += dir) {
-    for (j = 0; j < (int)infoheader->biWidth; j++) {
-      /* read the DWORD, WORD or BYTE in little-endian order */
-      buffer = 0;
-      for (k = 0; k < bytes_per_pixel; k++)
-        buffer |= fgetc(f) << (k << 3);
-
-      r = (buffer & rmask) >> rshift;
-      g = (buffer & gmask) >> gshift;
-      b = (buffer & bmask) >> bshift;
-      a = (buffer & amask) >> ashift;
-
-      r = (rbits == 8 ? r : scale_xbits_to_8bits(rbits, r));
-      g = (gbits == 8 ? g : scale_xbits_to_8bits(gbits, g));
-      b = (bbits == 8 ? b : scale_xbits_to_8bits(bbits, b));
-      a = (abits == 8 ? a : scale_xbits_to_8bits(abits, a));
-
-      if (a)
-        withAlpha = true;
-      put_pixel_fast<RgbTraits>(image, j, line, rgba(r, g, b, a));
-    }
-
-    j = (bytes_per_pixel * j) % 4;
-    if (j > 0)
-      while (j++ < 4)
-        fgetc(f);
+  const int bits_per_pixel = infoheader->biBitCount;
+  const int bytes_per_pixel = ((bits_per_pixel / 8) + ((bits_per_pixel % 8) > 0 ? 1 : 0));
+  const int width = infoheader->biWidth;
+  const std::size_t stride = row_stride_32(width, bytes_per_pixel * 8);
+
+  std::vector<uint8_t> data;
+  if (!read_rows(f, stride, image->height(), fop, data))
+    return 0;
+
+  std::atomic<bool> alpha(false);
+
+  // Common masks
+  if (bytes_per_pixel == 2 && rmask == 0xf800 && gmask == 0x07e0 && bmask == 0x001f && !amask) {
+    convert_rows(data, stride, image, infoheader, [width](const uint8_t* src, uint8_t* dst) {
+      rgb565_to_rgba_row(src, width, (uint32_t*)dst);
+    });
   }
-
-  if (!withAlpha) {
-    LockImageBits<RgbTraits> imageBits(image, image->bounds());
-    auto imgIt = imageBits.begin(), imgEnd = imageBits.end();
-    for (; imgIt != imgEnd; ++imgIt)
-      *imgIt |= 0xff000000;
+  else if (bytes_per_pixel == 4 && rmask == 0x00ff0000 && gmask == 0x0000ff00 &&
+           bmask == 0x000000ff && amask == 0xff000000) {
+    convert_rows(data,
+                 stride,
+                 image,
+                 infoheader,
+                 [width, &alpha](const uint8_t* src, uint8_t* dst) {
+                   if (bgra_to_rgba_row(src, width, (uint32_t*)dst))
+                     alpha = true;
+                 });
+  }
+  else {
+    convert_rows(
+      data,
+      stride,
+      image,
+      infoheader,
+      [=, &alpha](const uint8_t* src, uint8_t* dst) {
+        uint32_t* dstAddress = (uint32_t*)dst;
+        bool rowAlpha = false;
+        for (int j = 0; j < width; j++) {
+          /* read the DWORD, WORD or BYTE in little-endian order */
+          uint32_t buffer = 0;
+          for (int k = 0; k < bytes_per_pixel; k++)
+            buffer |= uint32_t(*(src++)) << (k << 3);
+
+          int r = (buffer & rmask) >> rshift;
+          int g = (buffer & gmask) >> gshift;
+          int b = (buffer & bmask) >> bshift;
+          int a = (buffer & amask) >> ashift;
+
+          r = (rbits == 8 ? r : scale_xbits_to_8bits(rbits, r));
+          g = (gbits == 8 ? g : scale_xbits_to_8bits(gbits, g));
+          b = (bbits == 8 ? b : scale_xbits_to_8bits(bbits, b));
+          a = (abits == 8 ? a : scale_xbits_to_8bits(abits, a));
+
+          if (a)
+            rowAlpha = true;
+          *(dstAddress++) = rgba(r, g, b, a);
+        }
+        if (rowAlpha)
+          alpha = true;
+      });
   }
 
+  if (alpha)
+    withAlpha = true;
+
+  if (!withAlpha)
+    make_opaque(image);
+
   return 0;
 }
 
@@ -1071,8 +1029,15 @@ bool BmpFormat::onLoad(FileOp* fop)
 
     case BI_BITFIELDS:
     case BI_ALPHABITFIELDS:
-      if (read_bitfields_image(f, image.get(), &infoheader, rmask, gmask, bmask, amask, withAlpha) <
-          0) {
+      if (read_bitfields_image(f,
+                               image.get(),
+                               &infoheader,
+                               rmask,
+                               gmask,
+                               bmask,
+                               amask,
+                               fop,
+                               withAlpha) < 0) {
         fop->setError("Unsupported bitfields in the BMP file.\n");
         return false;
       }
@@ -1147,7 +1112,7 @@ bool BmpFormat::onSave(FileOp* fop)
   }
 
   int filler = int((32 - ((w * bpp - 1) & 31) - 1) / 8);
-  int c, i, j, r, g, b;
+  int i, r, g, b;
 
   if (bpp <= 8) {
     biSizeImage = (w + filler) * bpp / 8 * h;
@@ -1163,7 +1128,7 @@ bool BmpFormat::onSave(FileOp* fop)
       bfSize = WININFOHEADERSIZE + OS2FILEHEADERSIZE + biSizeImage; // header + image data
   }
 
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* f = handle.get();
 
   /* file_header */
@@ -1224,57 +1189,39 @@ bool BmpFormat::onSave(FileOp* fop)
     }
   }
 
-  // Only used in indexed mode
-  int colorsPerByte = std::max(1, 8 / bpp);
-  int colorMask;
-  switch (bpp) {
-    case 8:  colorMask = 0xFF; break;
-    case 4:  colorMask = 0x0F; break;
-    case 1:  colorMask = 0x01; break;
-    default: colorMask = 0; break;
-  }
-
-  // Save image pixels (from bottom to top)
-  for (i = h - 1; i >= 0; i--) {
-    switch (spec.colorMode()) {
-      case ColorMode::RGB: {
-        auto scanline = (const uint32_t*)img->getScanline(i);
-        for (j = 0; j < w; ++j) {
-          c = scanline[j];
-          fputc(rgba_getb(c), f);
-          fputc(rgba_getg(c), f);
-          fputc(rgba_getr(c), f);
-          if (withAlpha)
-            fputc(rgba_geta(c), f);
-        }
-        break;
-      }
-      case ColorMode::GRAYSCALE: {
-        auto scanline = (const uint16_t*)img->getScanline(i);
-        for (j = 0; j < w; ++j) {
-          c = scanline[j];
-          fputc(graya_getv(c), f);
-        }
-        break;
-      }
-      case ColorMode::INDEXED: {
-        auto scanline = (const uint8_t*)img->getScanline(i);
-        for (j = 0; j < w;) {
-          uint8_t value = 0;
-          for (int k = colorsPerByte - 1; k >= 0 && j < w; --k, ++j) {
-            c = scanline[j];
-            value |= (c & colorMask) << (bpp * k);
-          }
-          fputc(value, f);
+  // Save image pixels (from bottom to top). Each chunk of rows is
+  // converted in several threads and written at once.
+  const std::size_t stride = row_stride_32(w, bpp);
+  const int rowsPerChunk = std::clamp<int>(int(kChunkSize / stride), 1, h);
+  std::vector<uint8_t> chunk(stride * rowsPerChunk, 0); // Padding bytes are always 0
+  const ColorMode colorMode = spec.colorMode();
+
+  for (i = 0; i < h; i += rowsPerChunk) {
+    const int n = std::min(rowsPerChunk, h - i);
+
+    doc::parallel_for_bands(0, n, kMinBandRows, [&, i](const int k0, const int k1) {
+      for (int k = k0; k < k1; ++k) {
+        const void* scanline = img->getScanline(h - 1 - (i + k));
+        uint8_t* dst = &chunk[k * stride];
+        switch (colorMode) {
+          case ColorMode::RGB:
+            if (withAlpha)
+              rgba_to_bgra_row((const uint32_t*)scanline, w, dst);
+            else
+              rgba_to_bgr_row((const uint32_t*)scanline, w, dst);
+            break;
+          case ColorMode::GRAYSCALE:
+            graya_to_gray_row((const uint16_t*)scanline, w, dst);
+            break;
+          case ColorMode::INDEXED:
+            pack_indexed_row((const uint8_t*)scanline, bpp, w, dst);
+            break;
         }
-        break;
       }
-    }
-
-    for (j = 0; j < filler; j++)
-      fputc(0, f);
+    });
 
-    fop->setProgress((float)(h - i) / (float)h);
+    fwrite(chunk.data(), 1, stride * n, f);
+    fop->setProgress((float)(i + n) / (float)h);
   }
 
   if (ferror(f)) {
@@ -0,0 +1,138 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_FILE_BUFFERED_FILE_H_INCLUDED
+#define APP_FILE_BUFFERED_FILE_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace app {
+
+// Reads a FILE byte by byte through a big buffer, so decoders can
+// stream the file without calling fgetc() for each byte (which locks
+// the FILE in each call) and without loading the whole file.
+class BufferedFileReader {
+public:
+  static constexpr std::size_t kBufferSize = 64 * 1024;
+
+  explicit BufferedFileReader(FILE* file)
+    : m_file(file)
+    , m_buffer(kBufferSize)
+    , m_bufferPos(std::ftell(file))
+  {
+  }
+
+  // Returns 0 when we reach the end of the file (see eof()).
+  uint8_t read8()
+  {
+    if (m_pos == m_size && !fill())
+      return 0;
+    return m_buffer[m_pos++];
+  }
+
+  // Reads a 32-bit big-endian value.
+  uint32_t read32be()
+  {
+    uint32_t v = read8() << 24;
+    v |= read8() << 16;
+    v |= read8() << 8;
+    v |= read8();
+    return v;
+  }
+
+  bool eof() const { return m_eof; }
+
+  std::size_t tell() const { return m_bufferPos + m_pos; }
+
+  void seek(std::size_t pos)
+  {
+    std::fseek(m_file, long(pos), SEEK_SET);
+    m_bufferPos = pos;
+    m_pos = m_size = 0;
+    m_eof = false;
+  }
+
+private:
+  bool fill()
+  {
+    m_bufferPos += m_size;
+    m_size = std::fread(m_buffer.data(), 1, m_buffer.size(), m_file);
+    m_pos = 0;
+    if (m_size == 0)
+      m_eof = true;
+    return (m_size > 0);
+  }
+
+  FILE* m_file;
+  std::vector<uint8_t> m_buffer;
+  std::size_t m_bufferPos; // File position of m_buffer[0]
+  std::size_t m_pos = 0;
+  std::size_t m_size = 0;
+  bool m_eof = false;
+
+  DISABLE_COPYING(BufferedFileReader);
+};
+
+// Writes a FILE byte by byte through a big buffer. The buffer is
+// flushed in the destructor, but flush() must be called before
+// checking ferror() on the FILE.
+class BufferedFileWriter {
+public:
+  static constexpr std::size_t kBufferSize = 64 * 1024;
+
+  explicit BufferedFileWriter(FILE* file) : m_file(file), m_buffer(kBufferSize) {}
+
+  ~BufferedFileWriter() { flush(); }
+
+  void write8(uint8_t value)
+  {
+    if (m_pos == m_buffer.size())
+      flush();
+    m_buffer[m_pos++] = value;
+  }
+
+  // Writes a 32-bit big-endian value.
+  void write32be(uint32_t value)
+  {
+    write8((value >> 24) & 0xff);
+    write8((value >> 16) & 0xff);
+    write8((value >> 8) & 0xff);
+    write8(value & 0xff);
+  }
+
+  std::size_t tell() const { return std::size_t(std::ftell(m_file)) + m_pos; }
+
+  void seek(std::size_t pos)
+  {
+    flush();
+    std::fseek(m_file, long(pos), SEEK_SET);
+  }
+
+  void flush()
+  {
+    if (m_pos > 0) {
+      std::fwrite(m_buffer.data(), 1, m_pos, m_file);
+      m_pos = 0;
+    }
+  }
+
+private:
+  FILE* m_file;
+  std::vector<uint8_t> m_buffer;
+  std::size_t m_pos = 0;
+
+  DISABLE_COPYING(BufferedFileWriter);
+};
+
+} // namespace app
+
+#endif
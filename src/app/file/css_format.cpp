@@ -76,7 +76,7 @@ bool CssFormat::onSave(FileOp* fop)
   const ImageRef image = fop->sequenceImageToSave();
   int x, y, c, r, g, b, a, alpha;
   const auto css_options = std::static_pointer_cast<CssOptions>(fop->formatOptions());
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* f = handle.get();
   auto print_color = [f](int r, int g, int b, int a) {
     if (a == 255) {
@@ -230,7 +230,7 @@ bool CssFormat::onSave(FileOp* fop)
   }
   if (css_options->generateHtml) {
     std::string html_filepath = fop->filename() + ".html";
-    FileHandle handle(open_file_with_exception_sync_on_close(html_filepath, "wb"));
+    FileHandle handle(fop->openOutputFile(html_filepath));
     FILE* h = handle.get();
     fprintf(h,
             "<html><head><link rel=\"stylesheet\" media=\"all\" "
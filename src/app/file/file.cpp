@@ -20,6 +20,7 @@
 #include "app/file/file_data.h"
 #include "app/file/file_format.h"
 #include "app/file/file_formats_manager.h"
+#include "app/file/file_sync.h"
 #include "app/file/format_options.h"
 #include "app/file/split_filename.h"
 #include "app/filename_formatter.h"
@@ -489,6 +490,9 @@ FileOp* FileOp::createLoadDocumentOperation(Context* context,
   if (flags & FILE_LOAD_ONE_FRAME)
     fop->m_oneframe = true;
 
+  if (flags & FILE_LOAD_SKIP_HIDDEN_LAYERS)
+    fop->m_skipHiddenLayers = true;
+
   if (flags & FILE_LOAD_CREATE_PALETTE)
     fop->m_createPaletteFromRgba = true;
 
@@ -980,12 +984,14 @@ void FileOp::operate(IFileOpProgress* progress)
           makeDirectories();
 
           // Call the "save" procedure... did it fail?
-          if (!m_format->save(this)) {
+          if (!saveWithFormat()) {
             setError("Error saving frame %d in the file \"%s\"\n",
                      outputFrame + 1,
                      m_filename.c_str());
-            break;
           }
+          commitOutputFiles();
+          if (hasError())
+            break;
         }
 
         m_seq.progress_offset += m_seq.progress_fraction;
@@ -1006,9 +1012,10 @@ void FileOp::operate(IFileOpProgress* progress)
       }
 
       // Call the "save" procedure.
-      if (!m_format->save(this)) {
+      if (!saveWithFormat()) {
         setError("Error saving the sprite in the file \"%s\"\n", m_filename.c_str());
       }
+      commitOutputFiles();
     }
 
     // Save special data from .aseprite-data file
@@ -1438,6 +1445,7 @@ FileOp::FileOp(FileOpType type, Context* context, const FileOpConfig* config)
   , m_done(false)
   , m_stop(false)
   , m_oneframe(false)
+  , m_skipHiddenLayers(false)
   , m_createPaletteFromRgba(false)
   , m_ignoreEmpty(false)
   , m_embeddedColorProfile(false)
@@ -1468,6 +1476,75 @@ void FileOp::prepareForSequence()
   m_formatOptions.reset();
 }
 
+base::FileHandle FileOp::openOutputFile(const std::string& filename)
+{
+  const std::string outFn = outputFilename(filename);
+  if (syncEachOutputFile())
+    return base::open_file_with_exception_sync_on_close(outFn, "wb");
+
+  return base::open_file_with_exception(outFn, "wb");
+}
+
+std::string FileOp::outputFilename(const std::string& filename)
+{
+  if (std::find(m_outputFiles.begin(), m_outputFiles.end(), filename) == m_outputFiles.end())
+    m_outputFiles.push_back(filename);
+
+  if (m_config.fileSync.atomicSave)
+    return get_atomic_save_temp_filename(filename);
+
+  return filename;
+}
+
+// Calls FileFormat::save() converting exceptions to errors, so the
+// output files are always committed (or discarded) by
+// commitOutputFiles().
+bool FileOp::saveWithFormat()
+{
+  try {
+    return m_format->save(this);
+  }
+  catch (const std::exception& ex) {
+    setError("%s", ex.what());
+    return false;
+  }
+}
+
+void FileOp::commitOutputFiles()
+{
+  const FileSyncOptions& opts = m_config.fileSync;
+  std::vector<std::string> files;
+  std::swap(files, m_outputFiles);
+
+  for (const auto& fn : files) {
+    try {
+      if (opts.atomicSave) {
+        const std::string tmp = get_atomic_save_temp_filename(fn);
+
+        // Discard the partial output, the old file is kept as-is.
+        if (hasError()) {
+          if (base::is_file(tmp))
+            base::delete_file(tmp);
+          continue;
+        }
+
+        // Sync the data before the rename, so a crash cannot leave
+        // an incomplete file with the final name.
+        if (opts.policy == FileSyncPolicy::EachFile)
+          sync_file(tmp);
+
+        replace_file(tmp, fn);
+      }
+
+      if (!hasError() && opts.policy == FileSyncPolicy::EndOfBatch)
+        sync_file_at_end_of_batch(fn);
+    }
+    catch (const std::exception& ex) {
+      setError("Error saving file \"%s\"\n%s", fn.c_str(), ex.what());
+    }
+  }
+}
+
 void FileOp::makeDirectories()
 {
   std::string dir = base::get_file_path(m_filename);
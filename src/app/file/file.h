@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -14,6 +14,7 @@
 #include "app/file/file_op_config.h"
 #include "app/file/format_options.h"
 #include "app/pref/preferences.h"
+#include "base/file_handle.h"
 #include "base/paths.h"
 #include "doc/frame.h"
 #include "doc/frames_sequence.h"
@@ -25,6 +26,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 // Flags for FileOp::createLoadDocumentOperation()
 #define FILE_LOAD_SEQUENCE_NONE         0x00000001
@@ -34,6 +36,7 @@
 #define FILE_LOAD_ONE_FRAME             0x00000010
 #define FILE_LOAD_DATA_FILE             0x00000020
 #define FILE_LOAD_CREATE_PALETTE        0x00000040
+#define FILE_LOAD_SKIP_HIDDEN_LAYERS    0x00000080
 
 namespace doc {
 class Tag;
@@ -164,6 +167,7 @@ public:
 
   bool isSequence() const { return !m_seq.filename_list.empty(); }
   bool isOneFrame() const { return m_oneframe; }
+  bool isSkipHiddenLayers() const { return m_skipHiddenLayers; }
   bool preserveColorProfile() const { return m_config.preserveColorProfile; }
   const FileFormat* fileFormat() const { return m_format; }
 
@@ -229,6 +233,10 @@ public:
 
   void setLoadedFormatOptions(const FormatOptionsPtr& opts);
 
+  // Format options to be used only in this save operation (the
+  // document format options aren't modified).
+  void setFormatOptionsForSaving(const FormatOptionsPtr& opts) { m_formatOptions = opts; }
+
   // Helpers for file decoder/encoder (FileFormat) with
   // FILE_SUPPORT_SEQUENCES flag.
   void sequenceSetNColors(int ncolors);
@@ -273,6 +281,28 @@ public:
   bool newBlend() const { return m_config.newBlend; }
   const FileOpConfig& config() const { return m_config; }
 
+  // True if formats that write their output files by themselves
+  // (i.e. without openOutputFile()) must sync each file before
+  // closing it. With atomic saves the temporary file is synced
+  // later, before it's renamed.
+  bool syncEachOutputFile() const
+  {
+    return (m_config.fileSync.policy == FileSyncPolicy::EachFile && !m_config.fileSync.atomicSave);
+  }
+
+  // Opens an output file to save the document (filename() by
+  // default) applying the FileSyncOptions of the config(). File
+  // formats must use these functions to create their output files.
+  base::FileHandle openOutputFile(const std::string& filename);
+  base::FileHandle openOutputFile() { return openOutputFile(m_filename); }
+
+  // Returns the path where the given output file must be written (a
+  // temporary file when FileSyncOptions::atomicSave is enabled), for
+  // formats that need to open the file by themselves. The file is
+  // moved to its final location (and synced) after
+  // FileFormat::save() succeeds.
+  std::string outputFilename(const std::string& filename);
+
 private:
   FileOp(); // Undefined
   FileOp(FileOpType type, Context* context, const FileOpConfig* config);
@@ -299,6 +329,8 @@ private:
   bool m_oneframe;                    // Load just one frame (in formats
                                       // that support animation like
                                       // GIF/FLI/ASE).
+  bool m_skipHiddenLayers;            // Don't load pixels of hidden
+                                      // layers (in formats like PSD).
   bool m_createPaletteFromRgba;
   bool m_ignoreEmpty;
 
@@ -337,6 +369,12 @@ private:
   void prepareForSequence();
   void makeAbstractImage();
   void makeDirectories();
+  bool saveWithFormat();
+  void commitOutputFiles();
+
+  // Output files created with outputFilename() in the current
+  // FileFormat::save() call.
+  std::vector<std::string> m_outputFiles;
 };
 
 // Available extensions for each load/save operation.
@@ -0,0 +1,456 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_exporter.h"
+#include "app/file/file.h"
+#include "base/fs.h"
+#include "base/task.h"
+#include "doc/doc.h"
+#include "doc/layer_tilemap.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace app;
+using namespace doc;
+
+namespace {
+
+const char* kExtensions[] = { "ase", "bmp", "gif", "jpg", "pcx",
+                              "png", "qoi", "tga", "webp", "psd" };
+enum { ASE, BMP, GIF, JPG, PCX, PNG, QOI, TGA, WEBP, PSD, kFormats };
+
+// Synthetic sprites used in the benchmarks. Each benchmark receives
+// the format and the fields of this struct as arguments.
+struct SpriteArgs {
+  int format;
+  ColorMode colorMode;
+  int size;     // Width and height
+  int layers;   // Image layers
+  int frames;   // Frames (only for animation formats)
+  bool tilemap; // Add a tilemap layer (with 16x16 tiles)
+
+  explicit SpriteArgs(const benchmark::State& state)
+    : format(state.range(0))
+    , colorMode((ColorMode)state.range(1))
+    , size(state.range(2))
+    , layers(state.range(3))
+    , frames(state.range(4))
+    , tilemap(state.range(5) != 0)
+  {
+  }
+};
+
+std::string benchmark_filename(const std::string& ext)
+{
+  return "_file_formats_benchmark." + ext;
+}
+
+// Pixel-art like image (runs of random colors), which is the most
+// common kind of image in our files.
+void fill_image(Image* image, const int seed)
+{
+  std::srand(seed);
+  color_t c = 0;
+  for (int y = 0; y < image->height(); ++y) {
+    for (int x = 0; x < image->width(); ++x) {
+      if ((std::rand() % 16) == 0) {
+        switch (image->pixelFormat()) {
+          case IMAGE_RGB:
+            c = rgba(std::rand() % 256, std::rand() % 256, std::rand() % 256, 255);
+            break;
+          case IMAGE_GRAYSCALE: c = graya(std::rand() % 256, 255); break;
+          default:              c = std::rand() % 256; break;
+        }
+      }
+      put_pixel(image, x, y, c);
+    }
+  }
+}
+
+Doc* create_document(Context* ctx, const SpriteArgs& args)
+{
+  Doc* doc = ctx->documents().add(args.size, args.size, args.colorMode, 256);
+  Sprite* sprite = doc->sprite();
+  sprite->setTotalFrames(args.frames);
+
+  // The first layer is created by Docs::add() with one cel in the
+  // first frame
+  LayerImage* layer = static_cast<LayerImage*>(sprite->root()->firstLayer());
+  for (int i = 0; i < args.layers; ++i) {
+    if (i > 0) {
+      layer = new LayerImage(sprite);
+      sprite->root()->addLayer(layer);
+    }
+    for (frame_t frame = 0; frame < args.frames; ++frame) {
+      Cel* cel = layer->cel(frame);
+      if (!cel) {
+        ImageRef image(Image::create(sprite->spec()));
+        cel = new Cel(frame, image);
+        layer->addCel(cel);
+      }
+      fill_image(cel->image(), (i + 1) * (frame + 1));
+    }
+  }
+
+  if (args.tilemap) {
+    const Grid grid(gfx::Size(16, 16));
+    const int ntiles = 256;
+    auto tileset = new Tileset(sprite, grid, ntiles);
+    for (tile_index ti = 1; ti < ntiles; ++ti) {
+      fill_image(tileset->get(ti).get(), ti);
+      tileset->notifyTileContentChange(ti);
+    }
+    const tileset_index tsi = sprite->tilesets()->add(tileset);
+
+    auto tilemapLayer = new LayerTilemap(sprite, tsi);
+    sprite->root()->addLayer(tilemapLayer);
+
+    const int cols = args.size / 16;
+    const int rows = args.size / 16;
+    for (frame_t frame = 0; frame < args.frames; ++frame) {
+      ImageRef tilemap(Image::create(IMAGE_TILEMAP, cols, rows));
+      std::srand(frame);
+      for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x)
+          put_pixel(tilemap.get(), x, y, tile(std::rand() % ntiles, 0));
+      tilemapLayer->addCel(new Cel(frame, tilemap));
+    }
+  }
+  return doc;
+}
+
+// Bytes of all the cel images in memory, used to calculate the
+// throughput.
+int64_t sprite_bytes(const Sprite* sprite)
+{
+  int64_t bytes = 0;
+  for (const Cel* cel : sprite->cels())
+    bytes += int64_t(cel->image()->rowBytes()) * cel->image()->height();
+  return bytes;
+}
+
+// Writes an uncompressed RGB PSD file with one layer per each sprite
+// layer (we don't have a PSD encoder).
+bool write_psd_file(const std::string& fn, const Sprite* sprite)
+{
+  if (sprite->colorMode() != ColorMode::RGB)
+    return false;
+
+  std::vector<uint8_t> out;
+  auto put8 = [&out](const int v) { out.push_back(uint8_t(v)); };
+  auto put16 = [&](const int v) {
+    put8(v >> 8);
+    put8(v);
+  };
+  auto put32 = [&](const uint32_t v) {
+    put16(int(v >> 16));
+    put16(int(v & 0xffff));
+  };
+  // Planar channels of raw data (layers have one compression field
+  // per channel, the merged image just one for all channels)
+  auto putChannels = [&](const Image* image, const int nchannels, const bool layer) {
+    if (!layer)
+      put16(0);
+    const int shifts[] = { rgba_r_shift, rgba_g_shift, rgba_b_shift, rgba_a_shift };
+    for (int c = 0; c < nchannels; ++c) {
+      if (layer)
+        put16(0);
+      for (int y = 0; y < image->height(); ++y) {
+        const uint32_t* row = (const uint32_t*)image->getPixelAddress(0, y);
+        for (int x = 0; x < image->width(); ++x)
+          put8((row[x] >> shifts[c]) & 0xff);
+      }
+    }
+  };
+
+  const int w = sprite->width();
+  const int h = sprite->height();
+  const LayerList layers = sprite->allLayers();
+  const uint32_t channelSize = 2 + uint32_t(w) * h;
+
+  // File header
+  out.insert(out.end(), { '8', 'B', 'P', 'S' });
+  put16(1); // Version
+  for (int i = 0; i < 6; ++i)
+    put8(0);
+  put16(3); // RGB channels of the merged image
+  put32(h);
+  put32(w);
+  put16(8); // Depth
+  put16(3); // RGB color mode
+
+  put32(0); // Color mode data
+  put32(0); // Image resources
+
+  // Layer and mask information
+  const std::size_t layerAndMaskPos = out.size();
+  put32(0);
+  const std::size_t layerInfoPos = out.size();
+  put32(0);
+  put16(int(layers.size()));
+  for (const Layer* layer : layers) {
+    put32(0); // Top
+    put32(0); // Left
+    put32(h); // Bottom
+    put32(w); // Right
+    put16(4);
+    for (int id : { 0, 1, 2, -1 }) {
+      put16(id);
+      put32(channelSize);
+    }
+    out.insert(out.end(), { '8', 'B', 'I', 'M', 'n', 'o', 'r', 'm' });
+    put8(255); // Opacity
+    put8(0);   // Clipping
+    put8(0);   // Flags
+    put8(0);   // Filler
+
+    // Extra data: empty mask, empty blending ranges, and the name as
+    // a Pascal string padded to 4 bytes.
+    std::string name = layer->name().substr(0, 255);
+    const int nameSize = int((1 + name.size() + 3) & ~3);
+    put32(8 + nameSize);
+    put32(0);
+    put32(0);
+    put8(int(name.size()));
+    out.insert(out.end(), name.begin(), name.end());
+    for (int i = 1 + int(name.size()); i < nameSize; ++i)
+      put8(0);
+  }
+  for (const Layer* layer : layers) {
+    const Cel* cel = layer->cel(0);
+    if (cel)
+      putChannels(cel->image(), 4, true);
+  }
+  if ((out.size() - layerInfoPos) & 1)
+    put8(0);
+
+  auto patch32 = [&out](const std::size_t pos, const uint32_t v) {
+    out[pos] = v >> 24;
+    out[pos + 1] = v >> 16;
+    out[pos + 2] = v >> 8;
+    out[pos + 3] = v;
+  };
+  patch32(layerInfoPos, uint32_t(out.size() - layerInfoPos - 4));
+  put32(0); // Global layer mask info
+  patch32(layerAndMaskPos, uint32_t(out.size() - layerAndMaskPos - 4));
+
+  // Merged image data (we just use the first layer)
+  putChannels(layers.front()->cel(0)->image(), 3, false);
+
+  std::ofstream f(fn, std::ios::binary);
+  f.write((const char*)out.data(), out.size());
+  return f.good();
+}
+
+// Peak memory used by the process between reset_peak_memory() and
+// peak_memory() (only on Linux, where the peak resident set size
+// can be reset).
+#if __linux__
+int64_t read_proc_status(const char* field)
+{
+  std::ifstream f("/proc/self/status");
+  std::string line;
+  const std::size_t n = std::strlen(field);
+  while (std::getline(f, line)) {
+    if (line.compare(0, n, field) == 0)
+      return std::atoll(line.c_str() + n) * 1024;
+  }
+  return 0;
+}
+
+struct PeakMemory {
+  int64_t base;
+  PeakMemory()
+  {
+    std::ofstream("/proc/self/clear_refs") << "5";
+    base = read_proc_status("VmRSS:");
+  }
+  void report(benchmark::State& state) const
+  {
+    state.counters["PeakMemory"] = benchmark::Counter(double(read_proc_status("VmHWM:") - base),
+                                                      benchmark::Counter::kDefaults,
+                                                      benchmark::Counter::OneK::kIs1024);
+  }
+};
+#else
+struct PeakMemory {
+  void report(benchmark::State&) const {}
+};
+#endif
+
+void add_args(benchmark::internal::Benchmark* b, const bool load)
+{
+  const int rgb = int(ColorMode::RGB);
+  const int indexed = int(ColorMode::INDEXED);
+  const int gray = int(ColorMode::GRAYSCALE);
+
+  // Big single images
+  for (int fmt = 0; fmt < kFormats; ++fmt) {
+    if (fmt != PSD || load)
+      b->Args({ fmt, rgb, 2048, 1, 1, 0 });
+  }
+  for (int fmt : { ASE, BMP, GIF, PCX, PNG, TGA })
+    b->Args({ fmt, indexed, 2048, 1, 1, 0 });
+  for (int fmt : { ASE, BMP, JPG, PNG })
+    b->Args({ fmt, gray, 2048, 1, 1, 0 });
+
+  // Layers (flattened in formats without layers)
+  for (int fmt : { ASE, PNG, QOI })
+    b->Args({ fmt, rgb, 1024, 16, 1, 0 });
+  if (load)
+    b->Args({ PSD, rgb, 1024, 16, 1, 0 });
+
+  // Animations
+  for (int fmt : { ASE, GIF, WEBP })
+    b->Args({ fmt, rgb, 256, 4, 64, 0 });
+  for (int fmt : { ASE, GIF })
+    b->Args({ fmt, indexed, 256, 4, 64, 0 });
+
+  // Tilemaps
+  for (int fmt : { ASE, PNG })
+    b->Args({ fmt, rgb, 1024, 1, 1, 1 });
+  b->Args({ ASE, rgb, 256, 1, 64, 1 });
+}
+
+void save_args(benchmark::internal::Benchmark* b)
+{
+  add_args(b, false);
+}
+
+void load_args(benchmark::internal::Benchmark* b)
+{
+  add_args(b, true);
+}
+
+} // anonymous namespace
+
+void BM_SaveFormat(benchmark::State& state)
+{
+  const SpriteArgs args(state);
+  const std::string ext = kExtensions[args.format];
+  const std::string fn = benchmark_filename(ext);
+
+  Context ctx;
+  std::unique_ptr<Doc> doc(create_document(&ctx, args));
+  doc->setFilename(fn);
+
+  PeakMemory peak;
+  for (auto _ : state) {
+    if (save_document(&ctx, doc.get()) != 0) {
+      state.SkipWithError("Error saving the file");
+      break;
+    }
+  }
+  peak.report(state);
+
+  state.SetBytesProcessed(state.iterations() * sprite_bytes(doc->sprite()));
+  state.SetLabel(ext);
+
+  doc->close();
+  base::delete_file(fn);
+}
+
+void BM_LoadFormat(benchmark::State& state)
+{
+  const SpriteArgs args(state);
+  const std::string ext = kExtensions[args.format];
+  const std::string fn = benchmark_filename(ext);
+
+  Context ctx;
+  int64_t bytes = 0;
+  {
+    std::unique_ptr<Doc> doc(create_document(&ctx, args));
+    doc->setFilename(fn);
+    const bool saved = (args.format == PSD ? write_psd_file(fn, doc->sprite()) :
+                                             save_document(&ctx, doc.get()) == 0);
+    bytes = sprite_bytes(doc->sprite());
+    doc->close();
+    if (!saved) {
+      state.SkipWithError("Error saving the file");
+      return;
+    }
+  }
+
+  PeakMemory peak;
+  for (auto _ : state) {
+    std::unique_ptr<Doc> doc(load_document(&ctx, fn));
+    if (!doc) {
+      state.SkipWithError("Error loading the file");
+      break;
+    }
+    doc->close();
+  }
+  peak.report(state);
+
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.SetLabel(ext);
+
+  base::delete_file(fn);
+}
+
+void BM_ExportSpriteSheet(benchmark::State& state)
+{
+  const SpriteArgs args(state);
+  const std::string ext = kExtensions[args.format];
+  const std::string textureFn = benchmark_filename(ext);
+  const std::string dataFn = benchmark_filename("json");
+
+  Context ctx;
+  std::unique_ptr<Doc> doc(create_document(&ctx, args));
+
+  PeakMemory peak;
+  for (auto _ : state) {
+    DocExporter exporter;
+    exporter.setTextureFilename(textureFn);
+    exporter.setDataFilename(dataFn);
+    exporter.setSpriteSheetType(SpriteSheetType::Packed);
+    exporter.addDocumentSamples(doc.get(), nullptr, false, false, false, nullptr, nullptr);
+
+    base::task_token token;
+    std::unique_ptr<Doc> sheet(exporter.exportSheet(&ctx, token));
+    if (!sheet) {
+      state.SkipWithError("Error exporting the sprite sheet");
+      break;
+    }
+  }
+  peak.report(state);
+
+  state.SetBytesProcessed(state.iterations() * sprite_bytes(doc->sprite()));
+  state.SetLabel(ext);
+
+  doc->close();
+  base::delete_file(textureFn);
+  base::delete_file(dataFn);
+}
+
+BENCHMARK(BM_SaveFormat)->Apply(save_args)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_LoadFormat)->Apply(load_args)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK(BM_ExportSpriteSheet)
+  ->Args({ PNG, int(ColorMode::RGB), 256, 4, 64, 0 })
+  ->Args({ PNG, int(ColorMode::INDEXED), 256, 4, 64, 0 })
+  ->Args({ PNG, int(ColorMode::RGB), 64, 1, 1024, 0 })
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -27,6 +27,10 @@ void FileOpConfig::fillFromPreferences()
   rgbMapAlgorithm = pref.quantization.rgbmapAlgorithm();
   fitCriteria = pref.quantization.fitCriteria();
   cacheCompressedTilesets = pref.tileset.cacheCompressedTilesets();
+
+  // This is not a preference, it's specified for a batch of files
+  // (e.g. from the CLI).
+  fileSync = get_file_sync_options();
 }
 
 } // namespace app
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "app/color.h"
+#include "app/file/file_sync.h"
 #include "app/pref/preferences.h"
 #include "doc/rgbmap_algorithm.h"
 #include "gfx/color_space.h"
@@ -47,6 +48,10 @@ struct FileOpConfig {
   // compressed data that was loaded as-is).
   bool cacheCompressedTilesets = true;
 
+  // How saved files are flushed to disk, and if they are written
+  // to a temporary file first (see FileSyncBatch).
+  FileSyncOptions fileSync;
+
   void fillFromPreferences();
 };
 
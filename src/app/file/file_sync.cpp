@@ -0,0 +1,168 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/file/file_sync.h"
+
+#include "base/debug.h"
+#include "base/fs.h"
+#include "base/log.h"
+#include "base/string.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace app {
+
+namespace {
+
+// State of the active batch. FileOps are executed in background
+// threads, so everything is protected with a mutex.
+std::mutex g_mutex;
+FileSyncBatch* g_batch = nullptr;
+FileSyncOptions g_options;
+std::vector<std::string> g_pending;
+
+} // anonymous namespace
+
+FileSyncBatch::FileSyncBatch(const FileSyncOptions& options)
+{
+  std::lock_guard lock(g_mutex);
+  ASSERT(!g_batch);
+  g_batch = this;
+  g_options = options;
+}
+
+FileSyncBatch::~FileSyncBatch()
+{
+  try {
+    flush();
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "FILE: Error syncing files: %s\n", ex.what());
+  }
+
+  std::lock_guard lock(g_mutex);
+  ASSERT(g_batch == this);
+  g_batch = nullptr;
+  g_options = FileSyncOptions();
+}
+
+FileSyncOptions FileSyncBatch::options() const
+{
+  std::lock_guard lock(g_mutex);
+  return g_options;
+}
+
+void FileSyncBatch::setOptions(const FileSyncOptions& options)
+{
+  std::lock_guard lock(g_mutex);
+  g_options = options;
+}
+
+void FileSyncBatch::flush()
+{
+  std::vector<std::string> files;
+  {
+    std::lock_guard lock(g_mutex);
+    std::swap(files, g_pending);
+  }
+
+  // Several frames can be saved in the same file (e.g. overwriting
+  // the same output), sync each file just once.
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+
+  for (const auto& fn : files) {
+    // The file could be deleted after it was saved (e.g. a
+    // temporary output).
+    if (base::is_file(fn))
+      sync_file(fn);
+  }
+}
+
+FileSyncOptions get_file_sync_options()
+{
+  std::lock_guard lock(g_mutex);
+  return g_options;
+}
+
+void sync_file_at_end_of_batch(const std::string& filename)
+{
+  {
+    std::lock_guard lock(g_mutex);
+    if (g_batch) {
+      g_pending.push_back(filename);
+      return;
+    }
+  }
+  sync_file(filename);
+}
+
+void sync_file(const std::string& filename)
+{
+#ifdef _WIN32
+  HANDLE handle = CreateFileW(base::from_utf8(filename).c_str(),
+                              GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+  if (handle == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Cannot open file to sync: " + filename);
+
+  const BOOL ok = FlushFileBuffers(handle);
+  CloseHandle(handle);
+  if (!ok)
+    throw std::runtime_error("Cannot sync file: " + filename);
+#else
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open file to sync: " + filename);
+
+  const int res = ::fsync(fd);
+  ::close(fd);
+  if (res != 0)
+    throw std::runtime_error("Cannot sync file: " + filename);
+#endif
+}
+
+void replace_file(const std::string& src, const std::string& dst)
+{
+#ifdef _WIN32
+  if (!MoveFileExW(base::from_utf8(src).c_str(),
+                   base::from_utf8(dst).c_str(),
+                   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    throw std::runtime_error("Cannot rename file " + src + " to " + dst);
+#else
+  // rename() replaces "dst" atomically on POSIX systems
+  if (std::rename(src.c_str(), dst.c_str()) != 0)
+    throw std::runtime_error("Cannot rename file " + src + " to " + dst);
+#endif
+}
+
+std::string get_atomic_save_temp_filename(const std::string& filename)
+{
+  // Hidden file in the same directory of the final file, so the
+  // rename() doesn't cross filesystems.
+  return base::join_path(base::get_file_path(filename),
+                         "." + base::get_file_name(filename) + ".tmp");
+}
+
+} // namespace app
@@ -0,0 +1,76 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_FILE_FILE_SYNC_H_INCLUDED
+#define APP_FILE_FILE_SYNC_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+
+#include <string>
+#include <vector>
+
+namespace app {
+
+// When the saved files are flushed to disk.
+enum class FileSyncPolicy {
+  EachFile,   // Sync each file when it's closed (default)
+  EndOfBatch, // Sync all saved files when the batch ends
+  None,       // Don't sync (e.g. temporary outputs)
+};
+
+struct FileSyncOptions {
+  FileSyncPolicy policy = FileSyncPolicy::EachFile;
+
+  // True if each file must be written in a temporary file and then
+  // renamed to its final name (so other processes never see a
+  // partially written file).
+  bool atomicSave = false;
+};
+
+// A scope where several files are saved (e.g. the whole CLI
+// execution). While a batch is alive, its options are used as the
+// default options of all new save FileOps, and files saved with
+// FileSyncPolicy::EndOfBatch are synced together in flush() or in
+// the destructor.
+//
+// Only one batch can be active at the same time.
+class FileSyncBatch {
+public:
+  FileSyncBatch(const FileSyncOptions& options = FileSyncOptions());
+  ~FileSyncBatch();
+
+  FileSyncOptions options() const;
+  void setOptions(const FileSyncOptions& options);
+
+  // Syncs all the pending files.
+  void flush();
+
+private:
+  DISABLE_COPYING(FileSyncBatch);
+};
+
+// Returns the options of the active batch (or the default options if
+// there is no batch).
+FileSyncOptions get_file_sync_options();
+
+// Adds a file to be synced when the active batch ends. If there is
+// no active batch, the file is synced immediately.
+void sync_file_at_end_of_batch(const std::string& filename);
+
+// Flushes the given file to disk.
+void sync_file(const std::string& filename);
+
+// Renames "src" to "dst" replacing "dst" atomically if it exists.
+void replace_file(const std::string& src, const std::string& dst);
+
+// Returns the name of the temporary file used to save "filename"
+// when FileSyncOptions::atomicSave is enabled.
+std::string get_atomic_save_temp_filename(const std::string& filename);
+
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -12,7 +12,9 @@
 #include "app/doc.h"
 #include "app/file/file.h"
 #include "app/file/file_formats_manager.h"
+#include "app/file/file_sync.h"
 #include "base/base64.h"
+#include "base/fs.h"
 #include "doc/doc.h"
 #include "doc/user_data.h"
 #include "fmt/format.h"
@@ -23,6 +25,11 @@
 #include <functional>
 #include <vector>
 
+#if LAF_LINUX
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
 using namespace app;
 
 TEST(File, SeveralSizes)
@@ -363,3 +370,41 @@ TEST(File, CustomProperties)
     }
   }
 }
+
+#if LAF_LINUX
+// The temporary file of an atomic save is discarded when the file
+// format throws an exception (here the temporary file is a link to
+// /dev/full, so the .ase encoder fails writing the compressed pixels).
+TEST(File, AtomicSaveDiscardsTempFileOnException)
+{
+  app::Context ctx;
+  const std::string fn = "test_atomic.ase";
+  const std::string tmp = get_atomic_save_temp_filename(fn);
+  ASSERT_EQ(0, symlink("/dev/full", tmp.c_str()));
+
+  FileSyncOptions opts;
+  opts.atomicSave = true;
+  FileSyncBatch batch(opts);
+  {
+    std::unique_ptr<Doc> doc(ctx.documents().add(256, 256));
+    doc->setFilename(fn);
+
+    // Random pixels (so they cannot be compressed in the FILE buffer)
+    Image* image = doc->sprite()->root()->firstLayer()->cel(frame_t(0))->image();
+    std::srand(256);
+    for (int y = 0; y < image->height(); y++) {
+      for (int x = 0; x < image->width(); x++)
+        put_pixel_fast<RgbTraits>(image, x, y, rgba(std::rand() % 256, 0, 0, 255));
+    }
+
+    EXPECT_NE(0, save_document(&ctx, doc.get()));
+    doc->close();
+  }
+
+  struct stat st;
+  EXPECT_NE(0, lstat(tmp.c_str(), &st));
+  EXPECT_FALSE(base::is_file(fn));
+  if (lstat(tmp.c_str(), &st) == 0)
+    base::delete_file(tmp);
+}
+#endif
@@ -196,7 +196,7 @@ bool FliFormat::onSave(FileOp* fop)
   const FileAbstractImage* sprite = fop->abstractImageToSave();
 
   // Open the file to write in binary mode
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* f = handle.get();
   flic::StdioFileInterface finterface(f);
   flic::Encoder encoder(&finterface);
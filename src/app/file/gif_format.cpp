@@ -1609,7 +1609,7 @@ bool GifFormat::onSave(FileOp* fop)
   #if GIFLIB_MAJOR >= 5
   int errCode = 0;
   #endif
-  int fd = base::open_file_descriptor_with_exception(fop->filename(), "wb");
+  int fd = base::open_file_descriptor_with_exception(fop->outputFilename(fop->filename()), "wb");
   GifFilePtr gif_file(EGifOpenFileHandle(fd
   #if GIFLIB_MAJOR >= 5
                                          ,
@@ -1623,7 +1623,7 @@ bool GifFormat::onSave(FileOp* fop)
 
   GifEncoder encoder(fop, gif_file);
   bool result = encoder.encode();
-  if (result)
+  if (result && fop->syncEachOutputFile())
     base::sync_file_descriptor(fd);
   return result;
 }
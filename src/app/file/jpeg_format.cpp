@@ -16,6 +16,7 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "app/file/row_converters.h"
 #include "app/find_widget.h"
 #include "app/load_widget.h"
 #include "app/pref/preferences.h"
@@ -277,6 +278,12 @@ bool JpegFormat::onLoad(FileOp* fop)
         src_address = ((uint8_t**)buffer)[y];
         dst_address = (uint32_t*)image->getPixelAddress(start_dst_x(y), start_dst_y(y));
 
+        // Contiguous destination pixels (no rotation/flip)
+        if (next_addr_increment == 1) {
+          rgb_to_rgba_row(src_address, dinfo.output_width, dst_address);
+          continue;
+        }
+
         for (x = 0; x < dinfo.output_width; x++) {
           r = *(src_address++);
           g = *(src_address++);
@@ -296,6 +303,11 @@ bool JpegFormat::onLoad(FileOp* fop)
         src_address = ((uint8_t**)buffer)[y];
         dst_address = (uint16_t*)image->getPixelAddress(start_dst_x(y), start_dst_y(y));
 
+        if (next_addr_increment == 1) {
+          gray_to_graya_row(src_address, dinfo.output_width, dst_address);
+          continue;
+        }
+
         for (x = 0; x < dinfo.output_width; x++) {
           *dst_address = graya(*(src_address++), 255);
           dst_address += next_addr_increment;
@@ -418,7 +430,7 @@ bool JpegFormat::onSave(FileOp* fop)
   LOG("JPEG: Saving with options: quality=%d\n", qualityValue);
 
   // Open the file for write in it.
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* file = handle.get();
 
   // Allocate and initialize JPEG compression object.
@@ -479,31 +491,18 @@ bool JpegFormat::onSave(FileOp* fop)
   while (cinfo.next_scanline < cinfo.image_height) {
     // RGB
     if (spec.colorMode() == ColorMode::RGB) {
-      uint32_t* src_address;
-      uint8_t* dst_address;
-      int x, y;
-      for (y = 0; y < (int)buffer_height; y++) {
-        src_address = (uint32_t*)img->getScanline(cinfo.next_scanline + y);
-        dst_address = ((uint8_t**)buffer)[y];
-
-        for (x = 0; x < spec.width(); ++x) {
-          c = *(src_address++);
-          *(dst_address++) = rgba_getr(c);
-          *(dst_address++) = rgba_getg(c);
-          *(dst_address++) = rgba_getb(c);
-        }
+      for (int y = 0; y < (int)buffer_height; y++) {
+        rgba_to_rgb_row((const uint32_t*)img->getScanline(cinfo.next_scanline + y),
+                        spec.width(),
+                        ((uint8_t**)buffer)[y]);
       }
     }
     // Grayscale.
     else {
-      uint16_t* src_address;
-      uint8_t* dst_address;
-      int x, y;
-      for (y = 0; y < (int)buffer_height; y++) {
-        src_address = (uint16_t*)img->getScanline(cinfo.next_scanline + y);
-        dst_address = ((uint8_t**)buffer)[y];
-        for (x = 0; x < spec.width(); ++x)
-          *(dst_address++) = graya_getv(*(src_address++));
+      for (int y = 0; y < (int)buffer_height; y++) {
+        graya_to_gray_row((const uint16_t*)img->getScanline(cinfo.next_scanline + y),
+                          spec.width(),
+                          ((uint8_t**)buffer)[y]);
       }
     }
     jpeg_write_scanlines(&cinfo, buffer, buffer_height);
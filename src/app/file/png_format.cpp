@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,6 +15,7 @@
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
 #include "app/file/png_format.h"
+#include "app/file/png_idat_encoder.h"
 #include "app/file/png_options.h"
 #include "base/file_handle.h"
 #include "doc/doc.h"
@@ -491,7 +492,7 @@ bool PngFormat::onSave(FileOp* fop)
   png_bytep row_pointer;
   int color_type = 0;
 
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* fp = handle.get();
 
   png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
@@ -547,8 +548,13 @@ bool PngFormat::onSave(FileOp* fop)
                PNG_COMPRESSION_TYPE_BASE,
                PNG_FILTER_TYPE_BASE);
 
+  // Options given for this specific save operation (e.g. a
+  // compression preset) or the ones from the document.
+  auto opts = std::dynamic_pointer_cast<PngOptions>(fop->formatOptions());
+  if (!opts)
+    opts = fop->formatOptionsOfDocument<PngOptions>();
+
   // User chunks
-  auto opts = fop->formatOptionsOfDocument<PngOptions>();
   if (opts && !opts->isEmpty()) {
     int num_unknowns = opts->size();
     ASSERT(num_unknowns > 0);
@@ -622,15 +628,33 @@ bool PngFormat::onSave(FileOp* fop)
     png_free(png, trans);
   }
 
+  // Compression settings for libpng (PngIdatEncoder uses the same
+  // settings)
+  const PngOptions::Compression compression = opts->compression();
+  const bool indexed = (color_type == PNG_COLOR_TYPE_PALETTE);
+  switch (compression) {
+    case PngOptions::Compression::Default: break;
+    case PngOptions::Compression::Fast:
+      png_set_compression_level(png, 1);
+      png_set_filter(png, PNG_FILTER_TYPE_BASE, (indexed ? PNG_FILTER_NONE : PNG_FILTER_UP));
+      break;
+    case PngOptions::Compression::Smallest:
+      png_set_compression_level(png, 9);
+      png_set_compression_mem_level(png, 9);
+      png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_ALL_FILTERS);
+      break;
+  }
+
   png_write_info(png, info);
   png_set_packing(png);
 
-  row_pointer = (png_bytep)png_malloc(png, png_get_rowbytes(png, info));
-
-  for (png_uint_32 y = 0; y < height; ++y) {
-    uint8_t* dst_address = row_pointer;
+  const std::size_t rowbytes = png_get_rowbytes(png, info);
+  const int png_color_type = png_get_color_type(png, info);
 
-    if (png_get_color_type(png, info) == PNG_COLOR_TYPE_RGB_ALPHA) {
+  // Converts the row "y" of the image to the PNG format (it can be
+  // called from different threads).
+  auto fill_row = [&](const png_uint_32 y, uint8_t* dst_address) {
+    if (png_color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
       unsigned int x, c, a;
       bool opaque = true;
 
@@ -681,7 +705,7 @@ bool PngFormat::onSave(FileOp* fop)
         }
       }
     }
-    else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_RGB) {
+    else if (png_color_type == PNG_COLOR_TYPE_RGB) {
       auto src_address = (const uint32_t*)img->getScanline(y);
       unsigned int x, c;
 
@@ -692,7 +716,7 @@ bool PngFormat::onSave(FileOp* fop)
         *(dst_address++) = rgba_getb(c);
       }
     }
-    else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY_ALPHA) {
+    else if (png_color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
       auto src_address = (const uint16_t*)img->getScanline(y);
       unsigned int x, c, a;
       bool opaque = true;
@@ -712,7 +736,7 @@ bool PngFormat::onSave(FileOp* fop)
         *(dst_address++) = a;
       }
     }
-    else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY) {
+    else if (png_color_type == PNG_COLOR_TYPE_GRAY) {
       auto src_address = (const uint16_t*)img->getScanline(y);
       unsigned int x, c;
 
@@ -721,21 +745,65 @@ bool PngFormat::onSave(FileOp* fop)
         *(dst_address++) = graya_getv(c);
       }
     }
-    else if (png_get_color_type(png, info) == PNG_COLOR_TYPE_PALETTE) {
+    else if (png_color_type == PNG_COLOR_TYPE_PALETTE) {
       auto src_address = (const uint8_t*)img->getScanline(y);
       unsigned int x;
 
       for (x = 0; x < width; ++x)
         *(dst_address++) = *(src_address++);
     }
+  };
+
+  if (PngIdatEncoder::isWorthParallelizing(height, rowbytes)) {
+    PngIdatEncoder encoder(height, rowbytes, png_get_channels(png, info), indexed, compression);
+
+    // The IDAT chunks are collected and written from this function
+    // (and not from the encoder callbacks) because a libpng error
+    // longjmp()s to the setjmp() above, and it cannot cross the
+    // C++ frames of the encoder.
+    std::vector<std::vector<uint8_t>> idat;
+    bool ok = false;
+    try {
+      ok = encoder.encode(
+        fill_row,
+        [&idat](const uint8_t* data, std::size_t size) { idat.emplace_back(data, data + size); },
+        [fop](double progress) { fop->setProgress(progress); });
+    }
+    catch (const std::exception& ex) {
+      fop->setError("Error encoding PNG data: %s\n", ex.what());
+    }
+    if (!ok)
+      return false;
 
-    png_write_rows(png, &row_pointer, 1);
+    for (const auto& data : idat)
+      png_write_chunk(png, (png_const_bytep) "IDAT", data.data(), data.size());
 
-    fop->setProgress((double)(y + 1) / (double)(height));
+    // We cannot use png_write_end() because libpng doesn't know
+    // about the IDAT chunks we've written, so we write the user
+    // chunks located after the image data and IEND manually.
+    for (const auto& chunk : opts->chunks()) {
+      if (chunk.location & PNG_AFTER_IDAT) {
+        png_write_chunk(png,
+                        (png_const_bytep)chunk.name.c_str(),
+                        chunk.data.data(),
+                        chunk.data.size());
+      }
+    }
+    png_write_chunk(png, (png_const_bytep) "IEND", nullptr, 0);
   }
+  else {
+    row_pointer = (png_bytep)png_malloc(png, rowbytes);
+
+    for (png_uint_32 y = 0; y < height; ++y) {
+      fill_row(y, row_pointer);
+      png_write_rows(png, &row_pointer, 1);
 
-  png_free(png, row_pointer);
-  png_write_end(png, info);
+      fop->setProgress((double)(y + 1) / (double)(height));
+    }
+
+    png_free(png, row_pointer);
+    png_write_end(png, info);
+  }
 
   if (spec.colorMode() == ColorMode::INDEXED) {
     png_free(png, palette);
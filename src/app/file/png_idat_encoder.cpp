@@ -0,0 +1,291 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/file/png_idat_encoder.h"
+
+#include "doc/parallel_for.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "zlib.h"
+
+namespace app {
+
+namespace {
+
+// Uncompressed size of each block of rows. Each block is deflated
+// independently so smaller blocks give more parallelism but lose a
+// bit of compression ratio in each sync flush.
+constexpr std::size_t kBlockSize = 256 * 1024;
+
+// Maximum size of a deflate dictionary.
+constexpr std::size_t kWindowSize = 32 * 1024;
+
+// Images smaller than this are encoded directly with libpng.
+constexpr std::size_t kMinParallelSize = 2 * kBlockSize;
+
+// PNG filter types
+enum { kFilterNone, kFilterSub, kFilterUp, kFilterAverage, kFilterPaeth, kFilters };
+
+inline uint8_t paeth_predictor(const int a, const int b, const int c)
+{
+  const int p = a + b - c;
+  const int pa = std::abs(p - a);
+  const int pb = std::abs(p - b);
+  const int pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  if (pb <= pc)
+    return b;
+  return c;
+}
+
+// Applies the given filter type to the "cur" row ("prev" is the
+// previous row, all zeros for the first row). Returns the sum of
+// absolute values of the filtered bytes (as signed bytes), the same
+// heuristic used by libpng to choose the best filter of each row.
+unsigned filter_row(const int filter,
+                    const uint8_t* cur,
+                    const uint8_t* prev,
+                    const std::size_t rowBytes,
+                    const int bpp,
+                    uint8_t* out)
+{
+  unsigned sum = 0;
+  for (std::size_t i = 0; i < rowBytes; ++i) {
+    const int a = (i >= std::size_t(bpp) ? cur[i - bpp] : 0);
+    const int b = prev[i];
+    const int c = (i >= std::size_t(bpp) ? prev[i - bpp] : 0);
+    uint8_t v = cur[i];
+    switch (filter) {
+      case kFilterSub:     v -= a; break;
+      case kFilterUp:      v -= b; break;
+      case kFilterAverage: v -= (a + b) / 2; break;
+      case kFilterPaeth:   v -= paeth_predictor(a, b, c); break;
+    }
+    out[i] = v;
+    sum += (v < 128 ? v : 256 - v);
+  }
+  return sum;
+}
+
+} // anonymous namespace
+
+struct PngIdatEncoder::Block {
+  int y0 = 0, y1 = 0;
+  std::vector<uint8_t> filtered; // Filter type byte + filtered bytes of each row
+  std::vector<uint8_t> compressed;
+  uLong adler = 0;
+  bool ok = false;
+};
+
+PngIdatEncoder::PngIdatEncoder(const int height,
+                               const std::size_t rowBytes,
+                               const int bytesPerPixel,
+                               const bool indexed,
+                               const PngOptions::Compression compression)
+  : m_height(height)
+  , m_rowBytes(rowBytes)
+  , m_bpp(bytesPerPixel)
+  , m_rowsPerBlock(std::max<int>(1, int(kBlockSize / (rowBytes + 1))))
+{
+  // Same defaults used in PngFormat::onSave() for the libpng encoder
+  switch (compression) {
+    case PngOptions::Compression::Fast:
+      m_level = 1;
+      m_memLevel = 8;
+      m_filter = (indexed ? kFilterNone : kFilterUp);
+      break;
+    case PngOptions::Compression::Smallest:
+      m_level = 9;
+      m_memLevel = 9;
+      m_filter = kAdaptiveFilter;
+      break;
+    default:
+      m_level = 6;
+      m_memLevel = 8;
+      m_filter = (indexed ? kFilterNone : kAdaptiveFilter);
+      break;
+  }
+}
+
+// static
+bool PngIdatEncoder::isWorthParallelizing(const int height, const std::size_t rowBytes)
+{
+  return (std::size_t(height) * (rowBytes + 1) >= kMinParallelSize &&
+          doc::parallel_bands_count(height, 1) > 1);
+}
+
+bool PngIdatEncoder::encode(const GetRow& getRow, const Write& write, const Progress& progress)
+{
+  const int nblocks = (m_height + m_rowsPerBlock - 1) / m_rowsPerBlock;
+  const int groupSize = 4 * doc::parallel_bands_count(nblocks, 1);
+
+  std::vector<Block> blocks(groupSize);
+  Block prevBlock; // Last block of the previous group (just its tail)
+  std::vector<uint8_t> out;
+  uLong adler = adler32(0, Z_NULL, 0);
+
+  // zlib header: deflate with a 32K window, FLEVEL according to the
+  // compression level, and no preset dictionary.
+  {
+    const int cmf = 0x78;
+    int flg = (m_level == 1 ? 0 : m_level < 6 ? 1 : m_level == 6 ? 2 : 3) << 6;
+    flg += 31 - ((cmf * 256 + flg) % 31);
+    out.push_back(cmf);
+    out.push_back(flg);
+  }
+
+  for (int g = 0; g < nblocks; g += groupSize) {
+    const int n = std::min(groupSize, nblocks - g);
+    for (int i = 0; i < n; ++i) {
+      blocks[i].y0 = (g + i) * m_rowsPerBlock;
+      blocks[i].y1 = std::min(m_height, blocks[i].y0 + m_rowsPerBlock);
+    }
+
+    doc::parallel_for_bands(0, n, 1, [this, &getRow, &blocks](const int a, const int b) {
+      for (int i = a; i < b; ++i)
+        filterBlock(getRow, blocks[i]);
+    });
+
+    doc::parallel_for_bands(0, n, 1, [this, &blocks, &prevBlock, g, nblocks](const int a,
+                                                                             const int b) {
+      for (int i = a; i < b; ++i) {
+        const Block* prev = (i > 0 ? &blocks[i - 1] : (g > 0 ? &prevBlock : nullptr));
+        blocks[i].ok = deflateBlock(blocks[i], prev, g + i == nblocks - 1);
+      }
+    });
+
+    for (int i = 0; i < n; ++i) {
+      Block& block = blocks[i];
+      if (!block.ok)
+        return false;
+
+      out.insert(out.end(), block.compressed.begin(), block.compressed.end());
+      adler = adler32_combine(adler, block.adler, z_off_t(block.filtered.size()));
+    }
+
+    // Keep the tail of the last block as the dictionary of the next group
+    {
+      const Block& last = blocks[n - 1];
+      const std::size_t tail = std::min(kWindowSize, last.filtered.size());
+      prevBlock.filtered.assign(last.filtered.end() - tail, last.filtered.end());
+    }
+
+    // Add the adler32 checksum at the end of the zlib stream
+    if (g + n == nblocks) {
+      out.push_back((adler >> 24) & 0xff);
+      out.push_back((adler >> 16) & 0xff);
+      out.push_back((adler >> 8) & 0xff);
+      out.push_back(adler & 0xff);
+    }
+
+    write(out.data(), out.size());
+    out.clear();
+
+    if (progress)
+      progress(double(g + n) / double(nblocks));
+  }
+  return true;
+}
+
+void PngIdatEncoder::filterBlock(const GetRow& getRow, Block& block) const
+{
+  const std::size_t stride = m_rowBytes + 1;
+  std::vector<uint8_t> prev(m_rowBytes, 0);
+  std::vector<uint8_t> cur(m_rowBytes);
+  std::vector<uint8_t> tmp(m_filter == kAdaptiveFilter ? m_rowBytes : 0);
+
+  // The first row of the block is filtered with the last row of the
+  // previous block.
+  if (block.y0 > 0)
+    getRow(block.y0 - 1, prev.data());
+
+  block.filtered.resize(stride * (block.y1 - block.y0));
+  uint8_t* dst = block.filtered.data();
+
+  for (int y = block.y0; y < block.y1; ++y, dst += stride) {
+    getRow(y, cur.data());
+
+    if (m_filter == kAdaptiveFilter) {
+      unsigned best = filter_row(kFilterNone, cur.data(), prev.data(), m_rowBytes, m_bpp, dst + 1);
+      dst[0] = kFilterNone;
+      for (int f = kFilterSub; f < kFilters; ++f) {
+        const unsigned sum = filter_row(f, cur.data(), prev.data(), m_rowBytes, m_bpp, tmp.data());
+        if (sum < best) {
+          best = sum;
+          dst[0] = f;
+          std::copy(tmp.begin(), tmp.end(), dst + 1);
+        }
+      }
+    }
+    else {
+      dst[0] = m_filter;
+      filter_row(m_filter, cur.data(), prev.data(), m_rowBytes, m_bpp, dst + 1);
+    }
+
+    std::swap(prev, cur);
+  }
+
+  block.adler = adler32(adler32(0, Z_NULL, 0), block.filtered.data(), uInt(block.filtered.size()));
+}
+
+bool PngIdatEncoder::deflateBlock(Block& block, const Block* prevBlock, const bool last) const
+{
+  z_stream zs = {};
+  // Raw deflate (negative window bits), the zlib header and trailer
+  // are added by encode().
+  if (deflateInit2(&zs, m_level, Z_DEFLATED, -15, m_memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+
+  bool ok = true;
+  if (prevBlock && !prevBlock->filtered.empty()) {
+    const std::size_t dictSize = std::min(kWindowSize, prevBlock->filtered.size());
+    ok = (deflateSetDictionary(&zs,
+                               prevBlock->filtered.data() + prevBlock->filtered.size() - dictSize,
+                               uInt(dictSize)) == Z_OK);
+  }
+
+  // deflateBound() doesn't include the bytes of the sync flush
+  block.compressed.resize(deflateBound(&zs, uLong(block.filtered.size())) + 16);
+  zs.next_in = block.filtered.data();
+  zs.avail_in = uInt(block.filtered.size());
+
+  zs.next_out = block.compressed.data();
+  zs.avail_out = uInt(block.compressed.size());
+
+  const int flush = (last ? Z_FINISH : Z_SYNC_FLUSH);
+  while (ok) {
+    const int ret = deflate(&zs, flush);
+    if (ret == Z_STREAM_ERROR) {
+      ok = false;
+      break;
+    }
+
+    // The sync flush is complete when deflate() doesn't fill the
+    // whole output buffer.
+    if (last ? ret == Z_STREAM_END : zs.avail_out > 0)
+      break;
+
+    // More space is needed
+    const std::size_t used = zs.total_out;
+    block.compressed.resize(block.compressed.size() * 3 / 2 + 64);
+    zs.next_out = block.compressed.data() + used;
+    zs.avail_out = uInt(block.compressed.size() - used);
+  }
+
+  block.compressed.resize(zs.total_out);
+  deflateEnd(&zs);
+  return ok;
+}
+
+} // namespace app
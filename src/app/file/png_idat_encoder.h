@@ -0,0 +1,71 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_FILE_PNG_IDAT_ENCODER_H_INCLUDED
+#define APP_FILE_PNG_IDAT_ENCODER_H_INCLUDED
+#pragma once
+
+#include "app/file/png_options.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace app {
+
+// Encodes the image data of a non-interlaced PNG file (the zlib
+// stream of filtered scanlines stored in IDAT chunks) using several
+// threads. The rows are split in blocks that are filtered and
+// deflated concurrently; each block is primed with the last 32KB of
+// the previous one (as pigz does) and ends with a sync flush, so all
+// blocks can be joined in one standard zlib stream.
+class PngIdatEncoder {
+public:
+  // Fills "row" with the scanline "y" (rowBytes bytes, without the
+  // filter type byte). It's called from several threads at the same
+  // time (for different rows).
+  using GetRow = std::function<void(int y, uint8_t* row)>;
+
+  // Receives the zlib stream (in order) to be written in IDAT chunks.
+  using Write = std::function<void(const uint8_t* data, std::size_t size)>;
+
+  // Receives the progress of the encoding (from 0.0 to 1.0).
+  using Progress = std::function<void(double progress)>;
+
+  PngIdatEncoder(int height,
+                 std::size_t rowBytes,
+                 int bytesPerPixel,
+                 bool indexed,
+                 PngOptions::Compression compression);
+
+  // Returns true if the image is big enough to be encoded with
+  // several threads.
+  static bool isWorthParallelizing(int height, std::size_t rowBytes);
+
+  // Returns false if zlib fails.
+  bool encode(const GetRow& getRow, const Write& write, const Progress& progress = nullptr);
+
+private:
+  struct Block;
+
+  // Value of m_filter to choose the best filter for each row
+  static constexpr int kAdaptiveFilter = -1;
+
+  void filterBlock(const GetRow& getRow, Block& block) const;
+  bool deflateBlock(Block& block, const Block* prevBlock, bool last) const;
+
+  int m_height;
+  std::size_t m_rowBytes;
+  int m_bpp;
+  int m_level;
+  int m_memLevel;
+  int m_filter; // PNG filter type used in all rows (or kAdaptiveFilter)
+  int m_rowsPerBlock;
+};
+
+} // namespace app
+
+#endif
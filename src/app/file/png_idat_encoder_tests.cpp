@@ -0,0 +1,89 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/file/png_idat_encoder.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "zlib.h"
+
+using namespace app;
+
+// Reverts the PNG filters of the decompressed IDAT data.
+static std::vector<uint8_t> unfilter(const std::vector<uint8_t>& data,
+                                     const int height,
+                                     const std::size_t rowBytes,
+                                     const int bpp)
+{
+  std::vector<uint8_t> rows(height * rowBytes);
+  std::vector<uint8_t> zero(rowBytes, 0);
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* src = &data[y * (rowBytes + 1)];
+    uint8_t* cur = &rows[y * rowBytes];
+    const uint8_t* prev = (y > 0 ? cur - rowBytes : zero.data());
+    const int filter = *(src++);
+    for (std::size_t i = 0; i < rowBytes; ++i) {
+      const int a = (i >= std::size_t(bpp) ? cur[i - bpp] : 0);
+      const int b = prev[i];
+      const int c = (i >= std::size_t(bpp) ? prev[i - bpp] : 0);
+      int pred = 0;
+      switch (filter) {
+        case 1: pred = a; break;
+        case 2: pred = b; break;
+        case 3: pred = (a + b) / 2; break;
+        case 4: {
+          const int p = a + b - c;
+          const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+          pred = (pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+          break;
+        }
+      }
+      cur[i] = uint8_t(src[i] + pred);
+    }
+  }
+  return rows;
+}
+
+TEST(PngIdatEncoder, ValidZlibStream)
+{
+  const int bpp = 4;
+  const std::size_t rowBytes = 317 * bpp;
+
+  for (int height : { 1, 7, 1000 }) {
+    // Pixel-art like rows (runs of colors)
+    std::vector<uint8_t> rows(height * rowBytes);
+    std::srand(height);
+    for (std::size_t i = 0; i < rows.size(); ++i)
+      rows[i] = ((std::rand() % 8) == 0 ? std::rand() : (i >= bpp ? rows[i - bpp] : 0));
+
+    for (auto compression : { PngOptions::Compression::Default,
+                              PngOptions::Compression::Fast,
+                              PngOptions::Compression::Smallest }) {
+      std::vector<uint8_t> stream;
+      PngIdatEncoder encoder(height, rowBytes, bpp, false, compression);
+      ASSERT_TRUE(encoder.encode(
+        [&rows, rowBytes](int y, uint8_t* row) {
+          std::copy(&rows[y * rowBytes], &rows[(y + 1) * rowBytes], row);
+        },
+        [&stream](const uint8_t* data, std::size_t size) {
+          stream.insert(stream.end(), data, data + size);
+        }));
+
+      // uncompress() checks the zlib header and the adler32 checksum
+      std::vector<uint8_t> data(height * (rowBytes + 1));
+      uLongf size = uLongf(data.size());
+      ASSERT_EQ(Z_OK, uncompress(data.data(), &size, stream.data(), uLong(stream.size())))
+        << "height=" << height << " compression=" << int(compression);
+      ASSERT_EQ(data.size(), size);
+
+      EXPECT_EQ(rows, unfilter(data, height, rowBytes, bpp))
+        << "height=" << height << " compression=" << int(compression);
+    }
+  }
+}
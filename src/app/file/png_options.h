@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,11 +11,21 @@
 #include "app/file/format_options.h"
 #include "base/buffer.h"
 
+#include <string>
+#include <vector>
+
 namespace app {
 
 // Data for PNG files
 class PngOptions : public FormatOptions {
 public:
+  // Trade-off between encoding speed and file size.
+  enum class Compression {
+    Default,  // libpng defaults (zlib level 6, adaptive filters)
+    Fast,     // zlib level 1 and the "Up" filter for all rows
+    Smallest, // zlib level 9 and adaptive filters for all images
+  };
+
   struct Chunk {
     std::string name;
     base::buffer data;
@@ -33,8 +43,27 @@ public:
 
   const Chunks& chunks() const { return m_userChunks; }
 
+  // Converts "fast", "default", or "smallest" to a Compression
+  // value, returns false if the string is not valid.
+  static bool parseCompression(const std::string& str, Compression& compression)
+  {
+    if (str == "default")
+      compression = Compression::Default;
+    else if (str == "fast")
+      compression = Compression::Fast;
+    else if (str == "smallest")
+      compression = Compression::Smallest;
+    else
+      return false;
+    return true;
+  }
+
+  Compression compression() const { return m_compression; }
+  void setCompression(Compression compression) { m_compression = compression; }
+
 private:
   Chunks m_userChunks;
+  Compression m_compression = Compression::Default;
 };
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,10 +11,15 @@
 #include "doc/image_impl.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
+#include "doc/parallel_for.h"
 #include "doc/slice.h"
 #include "doc/sprite.h"
 #include "psd/psd.h"
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 namespace app {
 
 doc::PixelFormat psd_cmode_to_ase_format(const psd::ColorMode mode)
@@ -74,9 +79,32 @@ FileFormat* CreatePsdFormat()
 }
 
 class PsdDecoderDelegate : public psd::DecoderDelegate {
+  // The decoded channel data of the layers is kept in memory (with
+  // its original depth) until it reaches this size, then all pending
+  // layers are converted to images in parallel.
+  static constexpr std::size_t kMaxPendingBytes = 64 * 1024 * 1024;
+
+  // Channel scanlines of an image that are converted later.
+  struct PendingChannel {
+    psd::ChannelID id;
+    int depth;
+    int rowBytes;
+    std::vector<uint8_t> rows;
+    std::vector<bool> receivedRows;
+  };
+
+  struct PendingImage {
+    doc::ImageRef image;
+    bool hasTransparentChannel;
+    std::vector<PendingChannel> channels;
+  };
+
 public:
-  PsdDecoderDelegate()
-    : m_currentImage(nullptr)
+  PsdDecoderDelegate(const bool skipHiddenLayers)
+    : m_skipHiddenLayers(skipHiddenLayers)
+    , m_skipCurrentLayer(false)
+    , m_pendingBytes(0)
+    , m_currentImage(nullptr)
     , m_currentLayer(nullptr)
     , m_layerGroup(nullptr)
     , m_sprite(nullptr)
@@ -86,7 +114,11 @@ public:
   {
   }
 
-  Sprite* getSprite() { return assembleDocument(); }
+  Sprite* getSprite()
+  {
+    convertPendingImages();
+    return assembleDocument();
+  }
 
   void onFileHeader(const psd::FileHeader& header) override
   {
@@ -170,10 +202,33 @@ public:
         createNewLayer(layerRecord.name);
         // m_currentLayer->setVisible(layerRecord.isVisible());
         m_layerHasTransparentChannel = hasTransparency(layerRecord.channels.size());
+
+        // Hidden layers are kept in the layer hierarchy, but their
+        // channel data is ignored (no image/cel is created).
+        if (m_skipHiddenLayers && !layerRecord.isVisible()) {
+          m_currentLayer->setVisible(false);
+          m_skipCurrentLayer = true;
+        }
       }
       else {
+        // The channels of this record are merged with the existing
+        // image, so it must be converted first.
+        convertPendingImages();
         m_currentLayer = *findIter;
-        m_currentImage = m_currentLayer->cel(frame_t(0))->imageRef();
+
+        if (Cel* cel = m_currentLayer->cel(frame_t(0))) {
+          m_currentImage = cel->imageRef();
+        }
+        // The existing layer doesn't have an image (e.g. it was a
+        // skipped hidden layer)
+        else if (m_skipHiddenLayers && !layerRecord.isVisible()) {
+          m_skipCurrentLayer = true;
+        }
+        // A new image/cel is created in onBeginImage()
+        else {
+          m_currentLayer->setVisible(true);
+          m_layerHasTransparentChannel = hasTransparency(layerRecord.channels.size());
+        }
       }
     }
   }
@@ -182,6 +237,9 @@ public:
   {
     if (!m_framesInfo.empty() && (layerRecord.inFrames.size() == m_framesInfo.size()) &&
         m_currentImage) {
+      // The image is copied in each frame
+      convertPendingImages();
+
       std::unique_ptr<Cel> layerCel(m_currentLayer->cel(frame_t(0)));
       LayerImage* imageLayer = static_cast<LayerImage*>(m_currentLayer);
       imageLayer->removeCel(layerCel.get());
@@ -206,6 +264,10 @@ public:
     m_currentImage.reset();
     m_currentLayer = nullptr;
     m_layerHasTransparentChannel = false;
+    m_skipCurrentLayer = false;
+
+    if (m_pendingBytes >= kMaxPendingBytes)
+      convertPendingImages();
   }
 
   // Emitted only if there's a palette in an image
@@ -229,7 +291,7 @@ public:
         createNewLayer("Layer 1");
         m_layerHasTransparentChannel = hasTransparency(imageData.channels.size());
       }
-      if (m_currentLayer) {
+      if (m_currentLayer && !m_skipCurrentLayer) {
         createNewImage(imageData.width, imageData.height);
         linkNewCel(m_currentLayer, m_currentImage);
       }
@@ -266,57 +328,82 @@ public:
     if (!m_currentImage || y >= m_currentImage->height())
       return;
 
-    const int dataCount = bytes / (img.depth >= 8 ? (img.depth / 8) : 1);
-    uint8_t* dstGenericAddress = m_currentImage->getPixelAddress(0, y);
+    // The image is converted later (in parallel with other images),
+    // here we only copy the scanline.
+    if (m_pending.empty() || m_pending.back().image != m_currentImage) {
+      PendingImage pending;
+      pending.image = m_currentImage;
+      pending.hasTransparentChannel = m_layerHasTransparentChannel;
+      m_pending.push_back(std::move(pending));
+    }
 
-    if (m_pixelFormat == doc::PixelFormat::IMAGE_INDEXED) {
-      IndexedTraits::address_t dstAddress = (IndexedTraits::address_t)dstGenericAddress;
-      for (int x = 0; x < dataCount && x < m_currentImage->width(); ++x) {
-        *(dstAddress)++ = getNormalizedPixelValue(data, img.depth);
-      }
+    // Channels are transmitted one after the other, with all their
+    // scanlines
+    auto& channels = m_pending.back().channels;
+    if (channels.empty() || channels.back().id != chanID) {
+      PendingChannel channel;
+      channel.id = chanID;
+      channel.depth = img.depth;
+      channel.rowBytes = bytes;
+      channel.rows.resize(std::size_t(bytes) * m_currentImage->height(), 0);
+      channel.receivedRows.resize(m_currentImage->height(), false);
+      m_pendingBytes += channel.rows.size();
+      channels.push_back(std::move(channel));
     }
-    else if (m_pixelFormat == doc::PixelFormat::IMAGE_GRAYSCALE) {
-      GrayscaleTraits::address_t dstAddress = (GrayscaleTraits::address_t)dstGenericAddress;
-      uint8_t v = 0, a = 0;
-      for (int x = 0; x < dataCount && x < m_currentImage->width(); ++x) {
-        const GrayscaleTraits::pixel_t pixel = *dstAddress;
-        const uint8_t newPixelValue = getNormalizedPixelValue(data, img.depth);
-        if (chanID == psd::ChannelID::Red) {
-          v = newPixelValue;
-          a = m_layerHasTransparentChannel ? graya_geta(pixel) : 255;
-        }
-        else if (chanID == psd::ChannelID::Alpha || chanID == psd::ChannelID::TransparencyMask) {
-          a = newPixelValue;
-          v = graya_getv(pixel);
+
+    PendingChannel& channel = channels.back();
+    channel.receivedRows[y] = true;
+    std::memcpy(&channel.rows[std::size_t(y) * channel.rowBytes],
+                data,
+                std::min(bytes, channel.rowBytes));
+  }
+
+  // Converts all the pending channels to pixels. Each image is
+  // converted in a different thread (or each band of rows if there
+  // is just one image).
+  void convertPendingImages()
+  {
+    if (m_pending.empty())
+      return;
+
+    auto convertRows = [pixelFormat = m_pixelFormat](const PendingImage& pending,
+                                                     const int y0,
+                                                     const int y1) {
+      for (int y = y0; y < y1; ++y) {
+        for (const PendingChannel& channel : pending.channels) {
+          if (!channel.receivedRows[y])
+            continue;
+          convertScanline(pending.image.get(),
+                          pixelFormat,
+                          pending.hasTransparentChannel,
+                          y,
+                          channel.id,
+                          channel.depth,
+                          &channel.rows[std::size_t(y) * channel.rowBytes],
+                          channel.rowBytes);
         }
-        *(dstAddress++) = graya(v, a);
       }
+    };
+
+    if (m_pending.size() == 1) {
+      const PendingImage& pending = m_pending.front();
+      doc::parallel_for_bands(0,
+                              pending.image->height(),
+                              64,
+                              [&pending, &convertRows](const int a, const int b) {
+                                convertRows(pending, a, b);
+                              });
     }
-    else if (m_pixelFormat == doc::PixelFormat::IMAGE_RGB) {
-      RgbTraits::address_t dstAddress = (RgbTraits::address_t)dstGenericAddress;
-      uint8_t r, g, b, a;
-      for (int x = 0; x < dataCount && x < m_currentImage->width(); ++x) {
-        const uint8_t newPixelValue = getNormalizedPixelValue(data, img.depth);
-        const color_t c = *(dstAddress);
-        r = rgba_getr(c);
-        g = rgba_getg(c);
-        b = rgba_getb(c);
-        a = m_layerHasTransparentChannel ? rgba_geta(c) : 255;
-        if (chanID == psd::ChannelID::Red) {
-          r = newPixelValue;
-        }
-        else if (chanID == psd::ChannelID::Green) {
-          g = newPixelValue;
-        }
-        else if (chanID == psd::ChannelID::Blue) {
-          b = newPixelValue;
-        }
-        else if (chanID == psd::ChannelID::Alpha || chanID == psd::ChannelID::TransparencyMask) {
-          a = newPixelValue;
-        }
-        *(dstAddress++) = rgba(r, g, b, a);
-      }
+    else {
+      doc::parallel_for_bands(0, int(m_pending.size()), 1, [this, &convertRows](const int a,
+                                                                               const int b) {
+        for (int i = a; i < b; ++i)
+          convertRows(m_pending[i], 0, m_pending[i].image->height());
+      });
     }
+
+    m_pending.clear();
+    m_pendingBytes = 0;
   }
 
 private:
@@ -357,7 +444,69 @@ private:
     return m_sprite;
   }
 
-  std::uint8_t getNormalizedPixelValue(const std::uint8_t*& data, const int depth)
+  static void convertScanline(doc::Image* image,
+                              const doc::PixelFormat pixelFormat,
+                              const bool hasTransparentChannel,
+                              const int y,
+                              const psd::ChannelID chanID,
+                              const int depth,
+                              const uint8_t* data,
+                              const int bytes)
+  {
+    const int dataCount = bytes / (depth >= 8 ? (depth / 8) : 1);
+    uint8_t* dstGenericAddress = image->getPixelAddress(0, y);
+
+    if (pixelFormat == doc::PixelFormat::IMAGE_INDEXED) {
+      IndexedTraits::address_t dstAddress = (IndexedTraits::address_t)dstGenericAddress;
+      for (int x = 0; x < dataCount && x < image->width(); ++x) {
+        *(dstAddress)++ = getNormalizedPixelValue(data, depth);
+      }
+    }
+    else if (pixelFormat == doc::PixelFormat::IMAGE_GRAYSCALE) {
+      GrayscaleTraits::address_t dstAddress = (GrayscaleTraits::address_t)dstGenericAddress;
+      uint8_t v = 0, a = 0;
+      for (int x = 0; x < dataCount && x < image->width(); ++x) {
+        const GrayscaleTraits::pixel_t pixel = *dstAddress;
+        const uint8_t newPixelValue = getNormalizedPixelValue(data, depth);
+        if (chanID == psd::ChannelID::Red) {
+          v = newPixelValue;
+          a = hasTransparentChannel ? graya_geta(pixel) : 255;
+        }
+        else if (chanID == psd::ChannelID::Alpha || chanID == psd::ChannelID::TransparencyMask) {
+          a = newPixelValue;
+          v = graya_getv(pixel);
+        }
+        *(dstAddress++) = graya(v, a);
+      }
+    }
+    else if (pixelFormat == doc::PixelFormat::IMAGE_RGB) {
+      RgbTraits::address_t dstAddress = (RgbTraits::address_t)dstGenericAddress;
+      uint8_t r, g, b, a;
+      for (int x = 0; x < dataCount && x < image->width(); ++x) {
+        const uint8_t newPixelValue = getNormalizedPixelValue(data, depth);
+        const color_t c = *(dstAddress);
+        r = rgba_getr(c);
+        g = rgba_getg(c);
+        b = rgba_getb(c);
+        a = hasTransparentChannel ? rgba_geta(c) : 255;
+        if (chanID == psd::ChannelID::Red) {
+          r = newPixelValue;
+        }
+        else if (chanID == psd::ChannelID::Green) {
+          g = newPixelValue;
+        }
+        else if (chanID == psd::ChannelID::Blue) {
+          b = newPixelValue;
+        }
+        else if (chanID == psd::ChannelID::Alpha || chanID == psd::ChannelID::TransparencyMask) {
+          a = newPixelValue;
+        }
+        *(dstAddress++) = rgba(r, g, b, a);
+      }
+    }
+  }
+
+  static std::uint8_t getNormalizedPixelValue(const std::uint8_t*& data, const int depth)
   {
     if (depth == 1 || depth == 8) {
       return *(data++);
@@ -386,6 +535,10 @@ private:
     clear_image(m_currentImage.get(), 0);
   }
 
+  bool m_skipHiddenLayers;
+  bool m_skipCurrentLayer;
+  std::vector<PendingImage> m_pending;
+  std::size_t m_pendingBytes;
   doc::ImageRef m_currentImage;
   doc::Layer* m_currentLayer;
   doc::LayerGroup* m_layerGroup;
@@ -404,7 +557,7 @@ bool PsdFormat::onLoad(FileOp* fop)
   base::FileHandle fileHandle = base::open_file_with_exception(fop->filename(), "rb");
   FILE* f = fileHandle.get();
   psd::StdioFileInterface fileInterface(f);
-  PsdDecoderDelegate pDelegate;
+  PsdDecoderDelegate pDelegate(fop->isSkipHiddenLayers());
   psd::Decoder decoder(&fileInterface, &pDelegate);
 
   if (!decoder.readFileHeader()) {
@@ -426,6 +579,7 @@ bool PsdFormat::onLoad(FileOp* fop)
     decoder.readImageResources();
     decoder.readLayersAndMask();
     decoder.readImageData();
+    pDelegate.convertPendingImages();
   }
   catch (const std::runtime_error& e) {
     fop->setError(e.what());
@@ -0,0 +1,172 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/file/file.h"
+#include "doc/doc.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace app;
+
+namespace {
+
+// Writes a PSD file in memory (big-endian values).
+class PsdWriter {
+public:
+  void put8(int v) { m_data.push_back(uint8_t(v)); }
+  void put16(int v)
+  {
+    put8(v >> 8);
+    put8(v);
+  }
+  void put32(uint32_t v)
+  {
+    put16(v >> 16);
+    put16(v & 0xffff);
+  }
+  void put(const char* s)
+  {
+    while (*s)
+      put8(*s++);
+  }
+  std::size_t size() const { return m_data.size(); }
+  const std::vector<uint8_t>& data() const { return m_data; }
+
+private:
+  std::vector<uint8_t> m_data;
+};
+
+struct TestLayer {
+  std::string name;
+  bool visible;
+  gfx::Rect bounds;
+  doc::color_t color;
+};
+
+// Creates a RGB 8x8 PSD file with the given layers (each one filled
+// with a plain color).
+void write_psd(const std::string& fn, const std::vector<TestLayer>& layers)
+{
+  const int w = 8, h = 8;
+  const int channelIds[] = { -1, 0, 1, 2 }; // Alpha, R, G, B
+
+  // Layer records and channel data
+  PsdWriter info;
+  info.put16(int(layers.size()));
+  for (const TestLayer& layer : layers) {
+    const gfx::Rect& rc = layer.bounds;
+    info.put32(rc.y);
+    info.put32(rc.x);
+    info.put32(rc.y2());
+    info.put32(rc.x2());
+    info.put16(4);
+    for (int id : channelIds) {
+      info.put16(id);
+      info.put32(2 + rc.w * rc.h);
+    }
+    info.put("8BIMnorm");
+    info.put8(255); // Opacity
+    info.put8(0);   // Clipping
+    info.put8(layer.visible ? 0 : 2);
+    info.put8(0);
+
+    // Layer mask + blending ranges + name (padded to 4 bytes)
+    const int nameSize = (1 + int(layer.name.size()) + 3) & ~3;
+    info.put32(4 + 4 + nameSize);
+    info.put32(0);
+    info.put32(0);
+    info.put8(int(layer.name.size()));
+    info.put(layer.name.c_str());
+    for (int i = 1 + int(layer.name.size()); i < nameSize; ++i)
+      info.put8(0);
+  }
+  for (const TestLayer& layer : layers) {
+    for (int id : channelIds) {
+      const int shift = (id < 0 ? doc::rgba_a_shift : 8 * id);
+      info.put16(0); // Raw data
+      for (int i = 0; i < layer.bounds.w * layer.bounds.h; ++i)
+        info.put8((layer.color >> shift) & 0xff);
+    }
+  }
+  if (info.size() & 1)
+    info.put8(0);
+
+  PsdWriter psd;
+  psd.put("8BPS");
+  psd.put16(1);
+  for (int i = 0; i < 6; ++i)
+    psd.put8(0);
+  psd.put16(3); // Channels
+  psd.put32(h);
+  psd.put32(w);
+  psd.put16(8); // Depth
+  psd.put16(3); // RGB
+  psd.put32(0); // Color mode data
+  psd.put32(0); // Image resources
+  psd.put32(4 + info.size() + 4);
+  psd.put32(info.size());
+  for (uint8_t v : info.data())
+    psd.put8(v);
+  psd.put32(0); // Global layer mask
+
+  // Composite image
+  psd.put16(0);
+  for (int i = 0; i < 3 * w * h; ++i)
+    psd.put8(0);
+
+  FILE* f = std::fopen(fn.c_str(), "wb");
+  ASSERT_TRUE(f != nullptr);
+  std::fwrite(psd.data().data(), 1, psd.size(), f);
+  std::fclose(f);
+}
+
+} // anonymous namespace
+
+TEST(PsdFormat, SkipHiddenLayerWithSameNameAsVisibleLayer)
+{
+  app::Context ctx;
+  const std::string fn = "test_hidden_layers.psd";
+  write_psd(fn,
+            {
+              { "Shape", false, gfx::Rect(0, 0, 8, 8), doc::rgba(0, 0, 255, 255) },
+              { "Shape", true, gfx::Rect(2, 2, 4, 4), doc::rgba(255, 0, 0, 255) },
+            });
+
+  std::unique_ptr<FileOp> fop(
+    FileOp::createLoadDocumentOperation(&ctx,
+                                        fn,
+                                        FILE_LOAD_SEQUENCE_NONE | FILE_LOAD_SKIP_HIDDEN_LAYERS));
+  ASSERT_TRUE(fop != nullptr);
+  fop->operate();
+  fop->done();
+  fop->postLoad();
+  EXPECT_FALSE(fop->hasError()) << fop->error();
+
+  std::unique_ptr<Doc> doc(fop->releaseDocument());
+  ASSERT_TRUE(doc != nullptr);
+
+  // Both records are merged in the same layer, with the image of the
+  // visible one
+  const doc::LayerList layers = doc->sprite()->allLayers();
+  ASSERT_EQ(1, int(layers.size()));
+  EXPECT_EQ("Shape", layers[0]->name());
+  EXPECT_TRUE(layers[0]->isVisible());
+
+  const doc::Cel* cel = layers[0]->cel(0);
+  ASSERT_TRUE(cel != nullptr);
+  EXPECT_EQ(4, cel->image()->width());
+  EXPECT_EQ(doc::rgba(255, 0, 0, 255), doc::get_pixel(cel->image(), 0, 0));
+
+  doc->close();
+  std::remove(fn.c_str());
+}
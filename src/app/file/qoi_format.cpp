@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -8,12 +8,14 @@
   #include "config.h"
 #endif
 
+#include "app/file/buffered_file.h"
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "base/file_handle.h"
 
+// Only for qoi_desc and color space constants (the encoder and
+// decoder are implemented here to stream the image rows)
 #define QOI_NO_STDIO
-#define QOI_IMPLEMENTATION
 #include "qoi.h"
 
 namespace app {
@@ -44,52 +46,122 @@ FileFormat* CreateQoiFormat()
   return new QoiFormat;
 }
 
+namespace {
+
+// QOI chunk tags (see the QOI specification in https://qoiformat.org/)
+constexpr uint8_t kOpIndex = 0x00; // 00xxxxxx
+constexpr uint8_t kOpDiff = 0x40;  // 01xxxxxx
+constexpr uint8_t kOpLuma = 0x80;  // 10xxxxxx
+constexpr uint8_t kOpRun = 0xc0;   // 11xxxxxx
+constexpr uint8_t kOpRgb = 0xfe;   // 11111110
+constexpr uint8_t kOpRgba = 0xff;  // 11111111
+constexpr uint8_t kMask2 = 0xc0;   // 11000000
+
+constexpr uint32_t kMagic = (uint32_t('q') << 24) | (uint32_t('o') << 16) |
+                            (uint32_t('i') << 8) | uint32_t('f');
+constexpr uint32_t kPixelsMax = 400000000;
+constexpr int kPaddingSize = 8;
+
+struct QoiPixel {
+  uint8_t r = 0, g = 0, b = 0, a = 0;
+
+  bool operator==(const QoiPixel& o) const
+  {
+    return r == o.r && g == o.g && b == o.b && a == o.a;
+  }
+  bool operator!=(const QoiPixel& o) const { return !operator==(o); }
+
+  int hash() const { return (r * 3 + g * 5 + b * 7 + a * 11) % 64; }
+};
+
+} // anonymous namespace
+
+// The QOI image is decoded/encoded chunk by chunk directly from/to
+// the image rows (without buffering the whole file or all the pixels
+// in memory).
+
 bool QoiFormat::onLoad(FileOp* fop)
 {
   FileHandle handle(open_file_with_exception(fop->filename(), "rb"));
-  FILE* f = handle.get();
-
-  fseek(f, 0, SEEK_END);
-  auto size = ftell(f);
-  if (size <= 0)
-    return false;
-  fseek(f, 0, SEEK_SET);
-
-  auto data = QOI_MALLOC(size);
-  if (!data)
-    return false;
+  BufferedFileReader f(handle.get());
 
   qoi_desc desc;
-  auto bytes_read = fread(data, 1, size, f);
-  auto pixels = qoi_decode(data, bytes_read, &desc, 0);
-  QOI_FREE(data);
-  if (!pixels)
+  const uint32_t magic = f.read32be();
+  desc.width = f.read32be();
+  desc.height = f.read32be();
+  desc.channels = f.read8();
+  desc.colorspace = f.read8();
+
+  if (f.eof() || magic != kMagic || desc.width == 0 || desc.height == 0 || desc.channels < 3 ||
+      desc.channels > 4 || desc.colorspace > 1 || desc.height >= kPixelsMax / desc.width) {
+    fop->setError("Invalid QOI header\n");
     return false;
+  }
 
   ImageRef image = fop->sequenceImageToLoad(IMAGE_RGB, desc.width, desc.height);
   if (!image)
     return false;
 
-  auto src = (const uint8_t*)pixels;
-  for (int y = 0; y < desc.height; ++y) {
+  QoiPixel index[64];
+  QoiPixel px;
+  px.a = 255;
+  int run = 0;
+
+  for (int y = 0; y < int(desc.height); ++y) {
     auto dst = (uint32_t*)image->getPixelAddress(0, y);
-    switch (desc.channels) {
-      case 4:
-        for (int x = 0; x < desc.width; ++x, ++dst) {
-          *dst = doc::rgba(src[0], src[1], src[2], src[3]);
-          src += 4;
+
+    for (int x = 0; x < int(desc.width); ++x, ++dst) {
+      if (run > 0) {
+        --run;
+      }
+      else {
+        const int b1 = f.read8();
+        if (b1 == kOpRgb) {
+          px.r = f.read8();
+          px.g = f.read8();
+          px.b = f.read8();
+        }
+        else if (b1 == kOpRgba) {
+          px.r = f.read8();
+          px.g = f.read8();
+          px.b = f.read8();
+          px.a = f.read8();
+        }
+        else if ((b1 & kMask2) == kOpIndex) {
+          px = index[b1];
+        }
+        else if ((b1 & kMask2) == kOpDiff) {
+          px.r += ((b1 >> 4) & 0x03) - 2;
+          px.g += ((b1 >> 2) & 0x03) - 2;
+          px.b += (b1 & 0x03) - 2;
         }
-        break;
-      case 3:
-        for (int x = 0; x < desc.width; ++x, ++dst) {
-          *dst = doc::rgba(src[0], src[1], src[2], 255);
-          src += 3;
+        else if ((b1 & kMask2) == kOpLuma) {
+          const int b2 = f.read8();
+          const int vg = (b1 & 0x3f) - 32;
+          px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+          px.g += vg;
+          px.b += vg - 8 + (b2 & 0x0f);
         }
-        break;
+        else if ((b1 & kMask2) == kOpRun) {
+          run = (b1 & 0x3f);
+        }
+
+        // read8() returns 0 at the end of the file, so a truncated
+        // file would be decoded as a sequence of kOpIndex chunks.
+        if (f.eof()) {
+          fop->setError("Unexpected end of QOI file\n");
+          return false;
+        }
+        index[px.hash()] = px;
+      }
+
+      *dst = doc::rgba(px.r, px.g, px.b, (desc.channels == 4 ? px.a : 255));
     }
-  }
 
-  QOI_FREE(pixels);
+    fop->setProgress(double(y + 1) / double(desc.height));
+    if (fop->isStop())
+      break;
+  }
 
   if (desc.channels == 4)
     fop->sequenceSetHasAlpha(true);
@@ -120,9 +192,8 @@ bool QoiFormat::onLoad(FileOp* fop)
 bool QoiFormat::onSave(FileOp* fop)
 {
   const FileAbstractImage* img = fop->abstractImageToSave();
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
-  FILE* f = handle.get();
-  doc::ImageRef image = img->getScaledImage();
+  FileHandle handle(fop->openOutputFile());
+  BufferedFileWriter f(handle.get());
 
   qoi_desc desc;
   desc.width = img->width();
@@ -137,44 +208,90 @@ bool QoiFormat::onSave(FileOp* fop)
     desc.colorspace = QOI_LINEAR;
   }
 
-  auto pixels = (uint8_t*)QOI_MALLOC(desc.width * desc.height * desc.channels);
-  if (!pixels)
-    return false;
-
-  auto dst = pixels;
-  for (int y = 0; y < desc.height; ++y) {
-    auto src = (uint32_t*)image->getPixelAddress(0, y);
-    switch (desc.channels) {
-      case 4:
-        for (int x = 0; x < desc.width; ++x, ++src) {
-          uint32_t c = *src;
-          dst[0] = doc::rgba_getr(c);
-          dst[1] = doc::rgba_getg(c);
-          dst[2] = doc::rgba_getb(c);
-          dst[3] = doc::rgba_geta(c);
-          dst += 4;
+  f.write32be(kMagic);
+  f.write32be(desc.width);
+  f.write32be(desc.height);
+  f.write8(desc.channels);
+  f.write8(desc.colorspace);
+
+  QoiPixel index[64];
+  QoiPixel prev;
+  prev.a = 255;
+  int run = 0;
+
+  for (int y = 0; y < int(desc.height); ++y) {
+    auto src = (const uint32_t*)img->getScanline(y);
+    const bool lastRow = (y == int(desc.height) - 1);
+
+    for (int x = 0; x < int(desc.width); ++x, ++src) {
+      const uint32_t c = *src;
+      QoiPixel px;
+      px.r = doc::rgba_getr(c);
+      px.g = doc::rgba_getg(c);
+      px.b = doc::rgba_getb(c);
+      px.a = (desc.channels == 4 ? doc::rgba_geta(c) : prev.a);
+
+      if (px == prev) {
+        ++run;
+        if (run == 62 || (lastRow && x == int(desc.width) - 1)) {
+          f.write8(kOpRun | (run - 1));
+          run = 0;
         }
-        break;
-      case 3:
-        for (int x = 0; x < desc.width; ++x, ++src) {
-          uint32_t c = *src;
-          dst[0] = doc::rgba_getr(c);
-          dst[1] = doc::rgba_getg(c);
-          dst[2] = doc::rgba_getb(c);
-          dst += 3;
+        continue;
+      }
+
+      if (run > 0) {
+        f.write8(kOpRun | (run - 1));
+        run = 0;
+      }
+
+      const int h = px.hash();
+      if (index[h] == px) {
+        f.write8(kOpIndex | h);
+      }
+      else {
+        index[h] = px;
+
+        if (px.a == prev.a) {
+          const int8_t vr = px.r - prev.r;
+          const int8_t vg = px.g - prev.g;
+          const int8_t vb = px.b - prev.b;
+          const int8_t vg_r = vr - vg;
+          const int8_t vg_b = vb - vg;
+
+          if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+            f.write8(kOpDiff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+          }
+          else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+            f.write8(kOpLuma | (vg + 32));
+            f.write8((vg_r + 8) << 4 | (vg_b + 8));
+          }
+          else {
+            f.write8(kOpRgb);
+            f.write8(px.r);
+            f.write8(px.g);
+            f.write8(px.b);
+          }
         }
-        break;
+        else {
+          f.write8(kOpRgba);
+          f.write8(px.r);
+          f.write8(px.g);
+          f.write8(px.b);
+          f.write8(px.a);
+        }
+      }
+      prev = px;
     }
-  }
 
-  int size = 0;
-  auto encoded = qoi_encode(pixels, &desc, &size);
-  QOI_FREE(pixels);
-  if (!encoded)
-    return false;
+    fop->setProgress(double(y + 1) / double(desc.height));
+  }
 
-  fwrite(encoded, 1, size, f);
-  QOI_FREE(encoded);
+  // End marker
+  for (int i = 0; i < kPaddingSize - 1; ++i)
+    f.write8(0);
+  f.write8(1);
+  f.flush();
 
   if (ferror(handle.get())) {
     fop->setError("Error writing file.\n");
@@ -0,0 +1,94 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/file/file.h"
+#include "doc/doc.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace app;
+
+namespace {
+
+// Creates a 4x4 RGBA QOI file with a red pixel repeated with a
+// kOpRun chunk. The file is truncated to "size" bytes (if it's > 0).
+void write_qoi(const std::string& fn, const int size = 0)
+{
+  std::vector<uint8_t> data = {
+    'q', 'o', 'i', 'f',           // Magic
+    0, 0, 0, 4,                   // Width
+    0, 0, 0, 4,                   // Height
+    4, 0,                         // Channels + color space
+    0xff, 255, 0, 0, 255,         // kOpRgba
+    0xc0 | 14,                    // kOpRun (15 pixels)
+    0, 0, 0, 0, 0, 0, 0, 1,       // End marker
+  };
+  if (size > 0)
+    data.resize(size);
+
+  FILE* f = std::fopen(fn.c_str(), "wb");
+  ASSERT_TRUE(f != nullptr);
+  std::fwrite(data.data(), 1, data.size(), f);
+  std::fclose(f);
+}
+
+std::unique_ptr<FileOp> load_qoi(app::Context* ctx, const std::string& fn)
+{
+  std::unique_ptr<FileOp> fop(
+    FileOp::createLoadDocumentOperation(ctx, fn, FILE_LOAD_SEQUENCE_NONE));
+  if (fop) {
+    fop->operate();
+    fop->done();
+  }
+  return fop;
+}
+
+} // anonymous namespace
+
+TEST(QoiFormat, Load)
+{
+  app::Context ctx;
+  const std::string fn = "test.qoi";
+  write_qoi(fn);
+
+  std::unique_ptr<FileOp> fop = load_qoi(&ctx, fn);
+  ASSERT_TRUE(fop != nullptr);
+  fop->postLoad();
+  EXPECT_FALSE(fop->hasError()) << fop->error();
+
+  std::unique_ptr<Doc> doc(fop->releaseDocument());
+  ASSERT_TRUE(doc != nullptr);
+  ASSERT_EQ(4, doc->sprite()->width());
+  ASSERT_EQ(4, doc->sprite()->height());
+
+  const doc::Image* image = doc->sprite()->root()->firstLayer()->cel(0)->image();
+  for (int y = 0; y < 4; ++y)
+    for (int x = 0; x < 4; ++x)
+      EXPECT_EQ(doc::rgba(255, 0, 0, 255), doc::get_pixel(image, x, y));
+
+  doc->close();
+  std::remove(fn.c_str());
+}
+
+TEST(QoiFormat, TruncatedFile)
+{
+  app::Context ctx;
+  const std::string fn = "test_truncated.qoi";
+  write_qoi(fn, 19); // Only the header and the first kOpRgba chunk
+
+  std::unique_ptr<FileOp> fop = load_qoi(&ctx, fn);
+  ASSERT_TRUE(fop != nullptr);
+  EXPECT_TRUE(fop->hasError());
+
+  std::remove(fn.c_str());
+}
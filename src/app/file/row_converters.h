@@ -0,0 +1,189 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_FILE_ROW_CONVERTERS_H_INCLUDED
+#define APP_FILE_ROW_CONVERTERS_H_INCLUDED
+#pragma once
+
+#include "doc/color.h"
+#include "doc/color_scales.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Converters of scanlines between the pixel layouts used in files
+// (BMP, JPEG, etc.) and the doc::Image pixel formats. They are simple
+// loops over raw pointers without branches in the inner loop, so the
+// compiler can vectorize them, and they can be called from several
+// threads for different rows.
+
+namespace app {
+
+// Returns the number of bytes of a row of "width" pixels of "bpp"
+// bits aligned to 32 bits (BMP scanlines).
+inline std::size_t row_stride_32(const int width, const int bpp)
+{
+  return ((std::size_t(width) * bpp + 31) / 32) * 4;
+}
+
+// Unpacks a row of 1, 2, 4, or 8 bits per pixel (most significant
+// bits first) to one index per byte.
+inline void unpack_indexed_row(const uint8_t* src, const int bpp, const int width, uint8_t* dst)
+{
+  switch (bpp) {
+    case 1:
+      for (int x = 0; x < width; ++x)
+        dst[x] = (src[x >> 3] >> (7 - (x & 7))) & 1;
+      break;
+    case 2:
+      for (int x = 0; x < width; ++x)
+        dst[x] = (src[x >> 2] >> (6 - 2 * (x & 3))) & 3;
+      break;
+    case 4:
+      for (int x = 0; x < width; ++x)
+        dst[x] = (src[x >> 1] >> (4 - 4 * (x & 1))) & 15;
+      break;
+    case 8:
+      for (int x = 0; x < width; ++x)
+        dst[x] = src[x];
+      break;
+  }
+}
+
+// Packs a row of indexes (one per byte) in 1, 2, 4, or 8 bits per
+// pixel (most significant bits first). The last byte is padded with
+// zeros.
+inline void pack_indexed_row(const uint8_t* src, const int bpp, const int width, uint8_t* dst)
+{
+  if (bpp == 8) {
+    for (int x = 0; x < width; ++x)
+      dst[x] = src[x];
+    return;
+  }
+
+  const int perByte = 8 / bpp;
+  const int mask = (1 << bpp) - 1;
+  const int bytes = (width + perByte - 1) / perByte;
+  for (int i = 0; i < bytes; ++i)
+    dst[i] = 0;
+  for (int x = 0; x < width; ++x)
+    dst[x / perByte] |= (src[x] & mask) << (bpp * (perByte - 1 - (x % perByte)));
+}
+
+// 3 bytes per pixel in R, G, B order (e.g. JPEG) to opaque RGBA.
+inline void rgb_to_rgba_row(const uint8_t* src, const int width, uint32_t* dst)
+{
+  for (int x = 0; x < width; ++x, src += 3)
+    dst[x] = doc::rgba(src[0], src[1], src[2], 255);
+}
+
+// 3 bytes per pixel in B, G, R order (e.g. BMP) to opaque RGBA.
+inline void bgr_to_rgba_row(const uint8_t* src, const int width, uint32_t* dst)
+{
+  for (int x = 0; x < width; ++x, src += 3)
+    dst[x] = doc::rgba(src[2], src[1], src[0], 255);
+}
+
+// 4 bytes per pixel in B, G, R, A order to RGBA. Returns true if
+// some pixel has an alpha value different than zero.
+inline bool bgra_to_rgba_row(const uint8_t* src, const int width, uint32_t* dst)
+{
+  uint8_t alpha = 0;
+  for (int x = 0; x < width; ++x, src += 4) {
+    dst[x] = doc::rgba(src[2], src[1], src[0], src[3]);
+    alpha |= src[3];
+  }
+  return (alpha != 0);
+}
+
+// 16-bit little-endian pixels with 5 bits per channel and the
+// highest bit as alpha (A1R5G5B5). Returns true if some pixel has the
+// alpha bit.
+inline bool argb1555_to_rgba_row(const uint8_t* src, const int width, uint32_t* dst)
+{
+  int alpha = 0;
+  for (int x = 0; x < width; ++x, src += 2) {
+    const int word = src[0] | (src[1] << 8);
+    dst[x] = doc::rgba(doc::scale_5bits_to_8bits((word >> 10) & 0x1f),
+                       doc::scale_5bits_to_8bits((word >> 5) & 0x1f),
+                       doc::scale_5bits_to_8bits(word & 0x1f),
+                       (word & 0x8000 ? 255 : 0));
+    alpha |= word;
+  }
+  return ((alpha & 0x8000) != 0);
+}
+
+// 16-bit little-endian pixels with 5 bits for red and blue and 6
+// bits for green (R5G6B5) to opaque RGBA.
+inline void rgb565_to_rgba_row(const uint8_t* src, const int width, uint32_t* dst)
+{
+  for (int x = 0; x < width; ++x, src += 2) {
+    const int word = src[0] | (src[1] << 8);
+    dst[x] = doc::rgba(doc::scale_5bits_to_8bits((word >> 11) & 0x1f),
+                       doc::scale_6bits_to_8bits((word >> 5) & 0x3f),
+                       doc::scale_5bits_to_8bits(word & 0x1f),
+                       255);
+  }
+}
+
+// 8-bit gray values to opaque grayscale pixels.
+inline void gray_to_graya_row(const uint8_t* src, const int width, uint16_t* dst)
+{
+  for (int x = 0; x < width; ++x)
+    dst[x] = doc::graya(src[x], 255);
+}
+
+// Sets the alpha of all RGBA pixels to 255.
+inline void make_opaque_rgba_row(uint32_t* row, const int width)
+{
+  for (int x = 0; x < width; ++x)
+    row[x] |= doc::rgba_a_mask;
+}
+
+// RGBA pixels to 3 bytes per pixel in R, G, B order.
+inline void rgba_to_rgb_row(const uint32_t* src, const int width, uint8_t* dst)
+{
+  for (int x = 0; x < width; ++x, dst += 3) {
+    const uint32_t c = src[x];
+    dst[0] = doc::rgba_getr(c);
+    dst[1] = doc::rgba_getg(c);
+    dst[2] = doc::rgba_getb(c);
+  }
+}
+
+// RGBA pixels to 3 bytes per pixel in B, G, R order.
+inline void rgba_to_bgr_row(const uint32_t* src, const int width, uint8_t* dst)
+{
+  for (int x = 0; x < width; ++x, dst += 3) {
+    const uint32_t c = src[x];
+    dst[0] = doc::rgba_getb(c);
+    dst[1] = doc::rgba_getg(c);
+    dst[2] = doc::rgba_getr(c);
+  }
+}
+
+// RGBA pixels to 4 bytes per pixel in B, G, R, A order.
+inline void rgba_to_bgra_row(const uint32_t* src, const int width, uint8_t* dst)
+{
+  for (int x = 0; x < width; ++x, dst += 4) {
+    const uint32_t c = src[x];
+    dst[0] = doc::rgba_getb(c);
+    dst[1] = doc::rgba_getg(c);
+    dst[2] = doc::rgba_getr(c);
+    dst[3] = doc::rgba_geta(c);
+  }
+}
+
+// Grayscale pixels to 8-bit gray values (alpha is discarded).
+inline void graya_to_gray_row(const uint16_t* src, const int width, uint8_t* dst)
+{
+  for (int x = 0; x < width; ++x)
+    dst[x] = doc::graya_getv(src[x]);
+}
+
+} // namespace app
+
+#endif
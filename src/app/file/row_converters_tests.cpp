@@ -0,0 +1,126 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/file/row_converters.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace app;
+using namespace doc;
+
+TEST(RowConverters, RowStride32)
+{
+  EXPECT_EQ(4, row_stride_32(1, 1));
+  EXPECT_EQ(4, row_stride_32(32, 1));
+  EXPECT_EQ(8, row_stride_32(33, 1));
+  EXPECT_EQ(12, row_stride_32(3, 24));
+  EXPECT_EQ(8, row_stride_32(3, 16));
+  EXPECT_EQ(12, row_stride_32(3, 32));
+}
+
+TEST(RowConverters, PackUnpackIndexed)
+{
+  for (int bpp : { 1, 2, 4, 8 }) {
+    for (int width : { 1, 7, 8, 9, 31, 100 }) {
+      std::vector<uint8_t> indexes(width);
+      for (int x = 0; x < width; ++x)
+        indexes[x] = (x * 7 + 3) & ((1 << bpp) - 1);
+
+      std::vector<uint8_t> packed(row_stride_32(width, bpp), 0xff);
+      pack_indexed_row(indexes.data(), bpp, width, packed.data());
+
+      std::vector<uint8_t> unpacked(width);
+      unpack_indexed_row(packed.data(), bpp, width, unpacked.data());
+      EXPECT_EQ(indexes, unpacked) << "bpp=" << bpp << " width=" << width;
+    }
+  }
+
+  // Most significant bits first
+  const uint8_t src[] = { 0x1b };
+  uint8_t dst[4];
+  unpack_indexed_row(src, 2, 4, dst);
+  EXPECT_EQ(0, dst[0]);
+  EXPECT_EQ(1, dst[1]);
+  EXPECT_EQ(2, dst[2]);
+  EXPECT_EQ(3, dst[3]);
+}
+
+TEST(RowConverters, RgbOrders)
+{
+  const uint8_t src[] = { 1, 2, 3, 4, 5, 6 };
+  uint32_t dst[2];
+
+  rgb_to_rgba_row(src, 2, dst);
+  EXPECT_EQ(rgba(1, 2, 3, 255), dst[0]);
+  EXPECT_EQ(rgba(4, 5, 6, 255), dst[1]);
+
+  bgr_to_rgba_row(src, 2, dst);
+  EXPECT_EQ(rgba(3, 2, 1, 255), dst[0]);
+  EXPECT_EQ(rgba(6, 5, 4, 255), dst[1]);
+
+  uint8_t out[6];
+  rgba_to_bgr_row(dst, 2, out);
+  EXPECT_EQ(0, std::memcmp(src, out, 6));
+
+  bgr_to_rgba_row(src, 2, dst);
+  rgba_to_rgb_row(dst, 2, out);
+  EXPECT_EQ(3, out[0]);
+  EXPECT_EQ(1, out[2]);
+}
+
+TEST(RowConverters, Bgra)
+{
+  const uint8_t opaque[] = { 1, 2, 3, 0, 4, 5, 6, 0 };
+  const uint8_t alpha[] = { 1, 2, 3, 0, 4, 5, 6, 128 };
+  uint32_t dst[2];
+
+  EXPECT_FALSE(bgra_to_rgba_row(opaque, 2, dst));
+  EXPECT_TRUE(bgra_to_rgba_row(alpha, 2, dst));
+  EXPECT_EQ(rgba(3, 2, 1, 0), dst[0]);
+  EXPECT_EQ(rgba(6, 5, 4, 128), dst[1]);
+
+  uint8_t out[8];
+  rgba_to_bgra_row(dst, 2, out);
+  EXPECT_EQ(0, std::memcmp(alpha, out, 8));
+
+  make_opaque_rgba_row(dst, 2);
+  EXPECT_EQ(rgba(3, 2, 1, 255), dst[0]);
+  EXPECT_EQ(rgba(6, 5, 4, 255), dst[1]);
+}
+
+TEST(RowConverters, SixteenBits)
+{
+  // Little-endian words
+  const uint8_t src1555[] = { 0x1f, 0x00, 0xe0, 0xff };
+  uint32_t dst[2];
+
+  EXPECT_TRUE(argb1555_to_rgba_row(src1555, 2, dst));
+  EXPECT_EQ(rgba(0, 0, 255, 0), dst[0]);
+  EXPECT_EQ(rgba(255, 255, 0, 255), dst[1]);
+  EXPECT_FALSE(argb1555_to_rgba_row(src1555, 1, dst));
+
+  const uint8_t src565[] = { 0x00, 0xf8, 0xe0, 0x07 };
+  rgb565_to_rgba_row(src565, 2, dst);
+  EXPECT_EQ(rgba(255, 0, 0, 255), dst[0]);
+  EXPECT_EQ(rgba(0, 255, 0, 255), dst[1]);
+}
+
+TEST(RowConverters, Gray)
+{
+  const uint8_t src[] = { 0, 128, 255 };
+  uint16_t dst[3];
+  gray_to_graya_row(src, 3, dst);
+  EXPECT_EQ(graya(0, 255), dst[0]);
+  EXPECT_EQ(graya(128, 255), dst[1]);
+  EXPECT_EQ(graya(255, 255), dst[2]);
+
+  uint8_t out[3];
+  graya_to_gray_row(dst, 3, out);
+  EXPECT_EQ(0, std::memcmp(src, out, 3));
+}
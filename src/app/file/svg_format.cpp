@@ -73,7 +73,7 @@ bool SvgFormat::onSave(FileOp* fop)
   int x, y, c, r, g, b, a, alpha;
   const auto svg_options = std::static_pointer_cast<SvgOptions>(fop->formatOptions());
   const int pixelScaleValue = std::clamp(svg_options->pixelScale, 0, 10000);
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* f = handle.get();
   auto printcol = [f](int x, int y, int r, int g, int b, int a, int pxScale) {
     fprintf(f,
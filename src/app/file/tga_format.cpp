@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -12,6 +12,7 @@
 #include "app/console.h"
 #include "app/context.h"
 #include "app/doc.h"
+#include "app/file/buffered_file.h"
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/tga_options.h"
@@ -73,6 +74,43 @@ private:
   FileOp* m_fop;
 };
 
+// tga::FileInterface implementations that use a buffer to read/write
+// the file (tga::StdioFileInterface calls fgetc()/fputc() for each
+// byte). The pixels are still decoded/encoded directly from/to the
+// image rows.
+class TgaFileReader : public tga::FileInterface {
+public:
+  TgaFileReader(FILE* file) : m_file(file), m_reader(file) {}
+  bool ok() const override { return !m_reader.eof() && !ferror(m_file); }
+  size_t tell() override { return m_reader.tell(); }
+  void seek(size_t absPos) override { m_reader.seek(absPos); }
+  uint8_t read8() override { return m_reader.read8(); }
+  void write8(uint8_t) override { ASSERT(false); }
+
+private:
+  FILE* m_file;
+  BufferedFileReader m_reader;
+};
+
+class TgaFileWriter : public tga::FileInterface {
+public:
+  TgaFileWriter(FILE* file) : m_file(file), m_writer(file) {}
+  bool ok() const override { return !ferror(m_file); }
+  size_t tell() override { return m_writer.tell(); }
+  void seek(size_t absPos) override { m_writer.seek(absPos); }
+  uint8_t read8() override
+  {
+    ASSERT(false);
+    return 0;
+  }
+  void write8(uint8_t value) override { m_writer.write8(value); }
+  void flush() { m_writer.flush(); }
+
+private:
+  FILE* m_file;
+  BufferedFileWriter m_writer;
+};
+
 bool get_image_spec(const tga::Header& header, ImageSpec& spec)
 {
   switch (header.imageType) {
@@ -106,7 +144,7 @@ bool get_image_spec(const tga::Header& header, ImageSpec& spec)
 bool TgaFormat::onLoad(FileOp* fop)
 {
   FileHandle handle(open_file_with_exception(fop->filename(), "rb"));
-  tga::StdioFileInterface finterface(handle.get());
+  TgaFileReader finterface(handle.get());
   tga::Decoder decoder(&finterface);
   tga::Header header;
   if (!decoder.readHeader(header)) {
@@ -263,8 +301,8 @@ bool TgaFormat::onSave(FileOp* fop)
   const FileAbstractImage* img = fop->abstractImageToSave();
   const Palette* palette = fop->sequenceGetPalette();
 
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
-  tga::StdioFileInterface finterface(handle.get());
+  FileHandle handle(fop->openOutputFile());
+  TgaFileWriter finterface(handle.get());
   tga::Encoder encoder(&finterface);
   tga::Header header;
 
@@ -290,6 +328,7 @@ bool TgaFormat::onSave(FileOp* fop)
   TgaDelegate delegate(fop);
   encoder.writeImage(header, tgaImage);
   encoder.writeFooter();
+  finterface.flush();
 
   if (ferror(handle.get())) {
     fop->setError("Error writing file.\n");
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 // Copyright (C) 2015  Gabriel Rauter
 //
@@ -30,7 +30,10 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <future>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include <webp/demux.h>
 #include <webp/mux.h>
@@ -243,7 +246,7 @@ static int progress_report(int percent, const WebPPicture* pic)
 
 bool WebPFormat::onSave(FileOp* fop)
 {
-  FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
+  FileHandle handle(fop->openOutputFile());
   FILE* fp = handle.get();
 
   const FileAbstractImage* sprite = fop->abstractImageToSave();
@@ -286,7 +289,13 @@ bool WebPFormat::onSave(FileOp* fop)
   enc_options.anim_params.loop_count = (opts->loop() ? 0 : // 0 = infinite
                                                        1);              // 1 = loop once
 
-  ImageRef image(Image::create(IMAGE_RGB, w, h));
+  // Use an extra thread to encode each frame (when possible)
+  config.thread_level = 1;
+
+  // Two images to render the next frame while the current one is
+  // being encoded.
+  ImageRef images[2] = { ImageRef(Image::create(IMAGE_RGB, w, h)),
+                         ImageRef(Image::create(IMAGE_RGB, w, h)) };
 
   const doc::frame_t totalFrames = fop->roi().frames();
   WriterData wd(fp, fop, totalFrames);
@@ -295,22 +304,29 @@ bool WebPFormat::onSave(FileOp* fop)
   pic.width = w;
   pic.height = h;
   pic.use_argb = true;
-  pic.argb = (uint32_t*)image->getPixelAddress(0, 0);
-  pic.argb_stride = image->rowPixels(); // Stride in pixels (not bytes)
+  pic.argb_stride = images[0]->rowPixels(); // Stride in pixels (not bytes)
   pic.user_data = &wd;
   pic.progress_hook = progress_report;
 
-  WebPAnimEncoder* enc = WebPAnimEncoderNew(w, h, &enc_options);
-  int timestamp_ms = 0;
-  for (frame_t frame : fop->roi().framesSequence()) {
+  std::vector<frame_t> frames;
+  for (frame_t frame : fop->roi().framesSequence())
+    frames.push_back(frame);
+
+  // Renders the frame "i" in images[i % 2] (in a worker thread), and
+  // returns true if it's equal to the previous frame. In that case
+  // we skip the frame (extending the duration of the previous one)
+  // so libwebp doesn't need to compare both frames.
+  auto renderFrame = [&](const int i) -> bool {
+    Image* image = images[i % 2].get();
+
     // Render the frame in the bitmap
-    clear_image(image.get(), image->maskColor());
-    sprite->renderFrame(frame, fop->roi().frameBounds(frame), image.get());
+    clear_image(image, image->maskColor());
+    sprite->renderFrame(frames[i], fop->roi().frameBounds(frames[i]), image);
 
     // Switch R <-> B channels because WebPAnimEncoderAssemble()
     // expects MODE_BGRA pictures.
     {
-      LockImageBits<RgbTraits> bits(image.get(), Image::ReadWriteLock);
+      LockImageBits<RgbTraits> bits(image, Image::ReadWriteLock);
       auto it = bits.begin(), end = bits.end();
       for (; it != end; ++it) {
         auto c = *it;
@@ -321,24 +337,56 @@ bool WebPFormat::onSave(FileOp* fop)
       }
     }
 
-    if (!WebPAnimEncoderAdd(enc, &pic, timestamp_ms, &config)) {
-      if (!fop->isStop()) {
-        fop->setError("Error saving frame %d info\n", frame);
-        return false;
+    // The image of the previous frame is only read by libwebp in the
+    // meantime.
+    return (i > 0 && is_same_image(image, images[(i + 1) % 2].get()));
+  };
+
+  std::unique_ptr<WebPAnimEncoder, decltype(&WebPAnimEncoderDelete)>
+    enc(WebPAnimEncoderNew(w, h, &enc_options), &WebPAnimEncoderDelete);
+  if (!enc) {
+    fop->setError("Error creating the WebP encoder\n");
+    return false;
+  }
+
+  int timestamp_ms = 0;
+  std::future<bool> next;
+  if (!frames.empty())
+    next = std::async(std::launch::async, renderFrame, 0);
+
+  for (int i = 0; i < int(frames.size()); ++i) {
+    const bool sameAsPrevious = next.get();
+
+    // Render the next frame while we encode this one. We can reuse
+    // the image of the previous frame because WebPAnimEncoderAdd()
+    // copies the given picture.
+    if (i + 1 < int(frames.size()))
+      next = std::async(std::launch::async, renderFrame, i + 1);
+
+    if (!sameAsPrevious) {
+      pic.argb = (uint32_t*)images[i % 2]->getPixelAddress(0, 0);
+      if (!WebPAnimEncoderAdd(enc.get(), &pic, timestamp_ms, &config)) {
+        if (next.valid())
+          next.wait();
+
+        if (!fop->isStop()) {
+          fop->setError("Error saving frame %d info\n", frames[i]);
+          return false;
+        }
+        else
+          return true;
       }
-      else
-        return true;
     }
-    timestamp_ms += sprite->frameDuration(frame);
+    timestamp_ms += sprite->frameDuration(frames[i]);
 
     wd.f++;
   }
-  WebPAnimEncoderAdd(enc, nullptr, timestamp_ms, nullptr);
+  WebPAnimEncoderAdd(enc.get(), nullptr, timestamp_ms, nullptr);
 
   WebPData webp_data;
   WebPDataInit(&webp_data);
-  WebPAnimEncoderAssemble(enc, &webp_data);
-  WebPAnimEncoderDelete(enc);
+  WebPAnimEncoderAssemble(enc.get(), &webp_data);
+  enc.reset();
 
   if (fwrite(webp_data.bytes, 1, webp_data.size, fp) != webp_data.size) {
     fop->setError("Error saving content into file\n");
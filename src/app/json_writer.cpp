@@ -0,0 +1,368 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/json_writer.h"
+
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+namespace app {
+
+//////////////////////////////////////////////////////////////////////
+// DataWriter
+
+DataWriter::DataWriter(std::ostream& os) : m_os(&os), m_buf(&m_ownBuf)
+{
+  m_ownBuf.reserve(kBufferSize);
+}
+
+DataWriter::DataWriter(std::string& output) : m_buf(&output)
+{
+}
+
+DataWriter::~DataWriter()
+{
+  flush();
+}
+
+void DataWriter::flush()
+{
+  if (m_os && !m_buf->empty()) {
+    m_os->write(m_buf->data(), std::streamsize(m_buf->size()));
+    m_buf->clear();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// JsonWriter
+
+JsonWriter::JsonWriter(std::ostream& os, Style style) : DataWriter(os), m_style(style)
+{
+  m_stack.reserve(16);
+}
+
+JsonWriter::JsonWriter(std::string& output, Style style) : DataWriter(output), m_style(style)
+{
+  m_stack.reserve(16);
+}
+
+void JsonWriter::beginElement()
+{
+  // The value of a key is written after the ": " separator
+  if (m_afterKey) {
+    m_afterKey = false;
+    return;
+  }
+
+  if (m_stack.empty())
+    return;
+
+  Container& c = m_stack.back();
+  if (!c.empty)
+    put(',');
+
+  switch (c.format) {
+    case Format::Block:
+      // The first element of the root is in the same line
+      if (c.empty && m_stack.size() == 1) {
+        put(' ');
+        m_firstLine = true;
+      }
+      else
+        newLine(c.indent);
+      break;
+    case Format::Inline:
+      if (!c.empty || (c.object && !c.packed))
+        put(' ');
+      break;
+    case Format::Compact:
+      if (!c.empty)
+        put(' ');
+      break;
+  }
+  c.empty = false;
+}
+
+void JsonWriter::newLine(const int indent)
+{
+  put('\n');
+  for (int i = 0; i < indent; ++i)
+    put(' ');
+  m_firstLine = false;
+}
+
+void JsonWriter::onBegin(const bool object, const Layout layout)
+{
+  beginElement();
+
+  Container c{ object, Format::Block, true, false, 0 };
+  if (m_style == Style::Compact)
+    c.format = Format::Compact;
+  else if (layout == Layout::Inline || (!m_stack.empty() && m_stack.back().format != Format::Block))
+    c.format = Format::Inline;
+
+  if (c.format == Format::Block) {
+    // Containers that start in the first line of the root are
+    // indented one extra level
+    if (m_stack.empty())
+      c.indent = 1;
+    else
+      c.indent = m_stack.back().indent + (m_firstLine ? 2 : 1);
+  }
+  else if (c.format == Format::Inline && object) {
+    c.packed = (!m_stack.empty() && m_stack.back().format == Format::Inline &&
+                m_stack.back().object);
+  }
+
+  m_stack.push_back(c);
+  put(object ? '{' : '[');
+}
+
+void JsonWriter::onEnd(const bool object)
+{
+  const Container c = m_stack.back();
+  m_stack.pop_back();
+
+  // Block containers are closed in a new line (even if they are empty)
+  if (c.format == Format::Block)
+    newLine(m_stack.empty() ? 0 : m_stack.back().indent);
+  else if (!c.empty && c.format == Format::Inline && object)
+    put(' ');
+  put(object ? '}' : ']');
+
+  // New line at the end of the pretty printed data
+  if (m_stack.empty() && m_style == Style::Pretty)
+    put('\n');
+
+  checkFlush();
+}
+
+void JsonWriter::onKey(const std::string_view key)
+{
+  beginElement();
+  putString(key);
+  put(": ");
+  m_afterKey = true;
+}
+
+void JsonWriter::onNull()
+{
+  beginElement();
+  put("null");
+  checkFlush();
+}
+
+void JsonWriter::onBool(const bool value)
+{
+  beginElement();
+  put(value ? "true" : "false");
+  checkFlush();
+}
+
+void JsonWriter::onInt(const int64_t value)
+{
+  beginElement();
+  char buf[32];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  put(std::string_view(buf, res.ptr - buf));
+  checkFlush();
+}
+
+void JsonWriter::onDouble(const double value)
+{
+  beginElement();
+  if (std::isfinite(value)) {
+    char buf[32];
+    const int n = std::snprintf(buf, sizeof(buf), "%.17g", value);
+    put(std::string_view(buf, n));
+  }
+  else
+    put("null");
+  checkFlush();
+}
+
+void JsonWriter::onString(const std::string_view value)
+{
+  beginElement();
+  putString(value);
+  checkFlush();
+}
+
+// Escapes the same characters as json11::dump()
+void JsonWriter::putString(const std::string_view s)
+{
+  put('"');
+
+  const char* begin = s.data();
+  const char* end = begin + s.size();
+  const char* run = begin; // First character that wasn't added yet
+  for (const char* p = begin; p != end; ++p) {
+    const uint8_t ch = uint8_t(*p);
+    const char* escaped = nullptr;
+    char buf[8];
+
+    switch (ch) {
+      case '\\': escaped = "\\\\"; break;
+      case '"':  escaped = "\\\""; break;
+      case '\b': escaped = "\\b"; break;
+      case '\f': escaped = "\\f"; break;
+      case '\n': escaped = "\\n"; break;
+      case '\r': escaped = "\\r"; break;
+      case '\t': escaped = "\\t"; break;
+      default:
+        if (ch <= 0x1f) {
+          std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+          escaped = buf;
+        }
+        // U+2028 and U+2029 (valid in JSON but not in JavaScript)
+        else if (ch == 0xe2 && end - p >= 3 && uint8_t(p[1]) == 0x80 &&
+                 (uint8_t(p[2]) == 0xa8 || uint8_t(p[2]) == 0xa9)) {
+          put(std::string_view(run, p - run));
+          put(uint8_t(p[2]) == 0xa8 ? "\\u2028" : "\\u2029");
+          p += 2;
+          run = p + 1;
+        }
+        break;
+    }
+
+    if (escaped) {
+      put(std::string_view(run, p - run));
+      put(escaped);
+      run = p + 1;
+    }
+  }
+  put(std::string_view(run, end - run));
+  put('"');
+}
+
+//////////////////////////////////////////////////////////////////////
+// CborWriter
+
+namespace {
+
+enum CborMajorType {
+  kCborUnsigned = 0,
+  kCborNegative = 1,
+  kCborText = 3,
+  kCborArray = 4,
+  kCborMap = 5,
+  kCborTag = 6,
+};
+
+} // anonymous namespace
+
+CborWriter::CborWriter(std::ostream& os) : DataWriter(os)
+{
+  putHead(kCborTag, 55799);
+}
+
+CborWriter::CborWriter(std::string& output) : DataWriter(output)
+{
+  putHead(kCborTag, 55799);
+}
+
+void CborWriter::putHead(const int majorType, const uint64_t value)
+{
+  const char type = char(majorType << 5);
+  if (value < 24) {
+    put(char(type | value));
+  }
+  else if (value <= 0xff) {
+    put(char(type | 24));
+    put(char(value));
+  }
+  else if (value <= 0xffff) {
+    put(char(type | 25));
+    put(char(value >> 8));
+    put(char(value));
+  }
+  else if (value <= 0xffffffff) {
+    put(char(type | 26));
+    for (int shift = 24; shift >= 0; shift -= 8)
+      put(char(value >> shift));
+  }
+  else {
+    put(char(type | 27));
+    for (int shift = 56; shift >= 0; shift -= 8)
+      put(char(value >> shift));
+  }
+}
+
+void CborWriter::onBegin(const bool object, const Layout)
+{
+  // Indefinite-length map/array
+  put(char(object ? 0xbf : 0x9f));
+}
+
+void CborWriter::onEnd(const bool)
+{
+  put(char(0xff)); // Break
+  checkFlush();
+}
+
+void CborWriter::onKey(const std::string_view key)
+{
+  onString(key);
+}
+
+void CborWriter::onNull()
+{
+  put(char(0xf6));
+  checkFlush();
+}
+
+void CborWriter::onBool(const bool value)
+{
+  put(char(value ? 0xf5 : 0xf4));
+  checkFlush();
+}
+
+void CborWriter::onInt(const int64_t value)
+{
+  if (value >= 0)
+    putHead(kCborUnsigned, uint64_t(value));
+  else
+    putHead(kCborNegative, uint64_t(-1 - value));
+  checkFlush();
+}
+
+void CborWriter::onDouble(const double value)
+{
+  // Use single precision if it doesn't lose information
+  const float f = (std::fabs(value) <= FLT_MAX || !std::isfinite(value) ? float(value) : 0.0f);
+  if (double(f) == value || std::isnan(value)) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    put(char(0xfa));
+    for (int shift = 24; shift >= 0; shift -= 8)
+      put(char(bits >> shift));
+  }
+  else {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put(char(0xfb));
+    for (int shift = 56; shift >= 0; shift -= 8)
+      put(char(bits >> shift));
+  }
+  checkFlush();
+}
+
+void CborWriter::onString(const std::string_view value)
+{
+  putHead(kCborText, value.size());
+  put(value);
+  checkFlush();
+}
+
+} // namespace app
@@ -0,0 +1,166 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_JSON_WRITER_H_INCLUDED
+#define APP_JSON_WRITER_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace app {
+
+// Writes a tree of objects, arrays, and values (the JSON data model)
+// sequentially, without building the tree in memory. The output is
+// accumulated in a pre-reserved buffer that is written to the stream
+// in big chunks (or directly in a std::string).
+class DataWriter {
+public:
+  // Hint for JsonWriter to write small objects/arrays in one line.
+  enum class Layout { Block, Inline };
+
+  static constexpr std::size_t kBufferSize = 64 * 1024;
+
+  explicit DataWriter(std::ostream& os);
+  explicit DataWriter(std::string& output);
+  virtual ~DataWriter();
+
+  void beginObject(Layout layout = Layout::Block) { onBegin(true, layout); }
+  void endObject() { onEnd(true); }
+  void beginArray(Layout layout = Layout::Block) { onBegin(false, layout); }
+  void endArray() { onEnd(false); }
+
+  // Key of the next value/object/array inside an object.
+  void key(const std::string_view key) { onKey(key); }
+
+  void null() { onNull(); }
+  void value(const bool value) { onBool(value); }
+  void value(const int value) { onInt(value); }
+  void value(const int64_t value) { onInt(value); }
+  void value(const double value) { onDouble(value); }
+  void value(const std::string_view value) { onString(value); }
+  void value(const char* value) { onString(value); }
+  void value(const std::string& value) { onString(value); }
+
+  template<typename T>
+  void field(const std::string_view key, const T& value)
+  {
+    onKey(key);
+    this->value(value);
+  }
+
+  // Writes the buffered data to the stream.
+  void flush();
+
+protected:
+  virtual void onBegin(bool object, Layout layout) = 0;
+  virtual void onEnd(bool object) = 0;
+  virtual void onKey(std::string_view key) = 0;
+  virtual void onNull() = 0;
+  virtual void onBool(bool value) = 0;
+  virtual void onInt(int64_t value) = 0;
+  virtual void onDouble(double value) = 0;
+  virtual void onString(std::string_view value) = 0;
+
+  void put(const char c) { m_buf->push_back(c); }
+  void put(const std::string_view s) { m_buf->append(s.data(), s.size()); }
+
+  // Flushes the buffer if it's almost full (called after each token).
+  void checkFlush()
+  {
+    if (m_os && m_buf->size() >= kBufferSize - 256)
+      flush();
+  }
+
+private:
+  std::ostream* m_os = nullptr;
+  std::string m_ownBuf;
+  std::string* m_buf;
+
+  DISABLE_COPYING(DataWriter);
+};
+
+// Writes JSON text. The "Pretty" style reproduces the layout of the
+// sprite sheet data files of previous versions: objects/arrays in
+// several lines with one space of indentation per level (unless
+// Layout::Inline is used), where the first key of the root object is
+// in the same line ("{ "frames": ...") and its value is indented one
+// extra level. The "Compact" style writes everything in one line like
+// json11::dump().
+class JsonWriter : public DataWriter {
+public:
+  enum class Style { Pretty, Compact };
+
+  explicit JsonWriter(std::ostream& os, Style style = Style::Pretty);
+  explicit JsonWriter(std::string& output, Style style = Style::Pretty);
+
+protected:
+  void onBegin(bool object, Layout layout) override;
+  void onEnd(bool object) override;
+  void onKey(std::string_view key) override;
+  void onNull() override;
+  void onBool(bool value) override;
+  void onInt(int64_t value) override;
+  void onDouble(double value) override;
+  void onString(std::string_view value) override;
+
+private:
+  enum class Format : uint8_t { Block, Inline, Compact };
+  struct Container {
+    bool object;
+    Format format;
+    bool empty;
+    // Inline object without a space after "{" (inside another inline
+    // object, e.g. "bounds": {"x": 0, ... })
+    bool packed;
+    // Indentation of the elements of a Block container
+    int indent;
+  };
+
+  void beginElement();
+  void newLine(int indent);
+  void putString(std::string_view s);
+
+  Style m_style;
+  std::vector<Container> m_stack;
+  bool m_afterKey = false;
+  // True while we are in the first line of the root ("{ "key": ...")
+  bool m_firstLine = false;
+};
+
+// Writes the same data in CBOR (RFC 8949), a compact binary format
+// that can be parsed at load time without text parsing. Objects and
+// arrays are written as indefinite-length maps and arrays, and the
+// data is prefixed with the self-describe CBOR tag (0xd9d9f7) so it
+// can be identified by its first bytes.
+class CborWriter : public DataWriter {
+public:
+  explicit CborWriter(std::ostream& os);
+  explicit CborWriter(std::string& output);
+
+protected:
+  void onBegin(bool object, Layout layout) override;
+  void onEnd(bool object) override;
+  void onKey(std::string_view key) override;
+  void onNull() override;
+  void onBool(bool value) override;
+  void onInt(int64_t value) override;
+  void onDouble(double value) override;
+  void onString(std::string_view value) override;
+
+private:
+  void putHead(int majorType, uint64_t value);
+};
+
+} // namespace app
+
+#endif
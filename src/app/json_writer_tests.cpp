@@ -0,0 +1,155 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/json_writer.h"
+
+#include <sstream>
+
+using namespace app;
+
+static void write_sample(DataWriter& w)
+{
+  w.beginObject();
+  w.key("frames");
+  w.beginArray();
+  for (int i = 0; i < 2; ++i) {
+    w.beginObject();
+    w.field("filename", "a\"b\\c\n");
+    w.key("frame");
+    w.beginObject(DataWriter::Layout::Inline);
+    w.field("x", i * 32);
+    w.field("y", -1);
+    w.endObject();
+    w.field("trimmed", false);
+    w.endObject();
+  }
+  w.endArray();
+  w.key("meta");
+  w.beginObject();
+  w.field("scale", 1.5);
+  w.key("empty");
+  w.beginArray();
+  w.endArray();
+  w.key("layers");
+  w.beginArray();
+  w.beginObject(DataWriter::Layout::Inline);
+  w.key("cels");
+  w.beginArray();
+  w.null();
+  w.value(true);
+  w.endArray();
+  w.endObject();
+  w.endArray();
+  w.endObject();
+  w.endObject();
+}
+
+TEST(JsonWriter, Pretty)
+{
+  std::string output;
+  {
+    JsonWriter w(output);
+    write_sample(w);
+  }
+  EXPECT_EQ(
+    "{ \"frames\": [\n"
+    "   {\n"
+    "    \"filename\": \"a\\\"b\\\\c\\n\",\n"
+    "    \"frame\": { \"x\": 0, \"y\": -1 },\n"
+    "    \"trimmed\": false\n"
+    "   },\n"
+    "   {\n"
+    "    \"filename\": \"a\\\"b\\\\c\\n\",\n"
+    "    \"frame\": { \"x\": 32, \"y\": -1 },\n"
+    "    \"trimmed\": false\n"
+    "   }\n"
+    " ],\n"
+    " \"meta\": {\n"
+    "  \"scale\": 1.5,\n"
+    "  \"empty\": [\n"
+    "  ],\n"
+    "  \"layers\": [\n"
+    "   { \"cels\": [null, true] }\n"
+    "  ]\n"
+    " }\n"
+    "}\n",
+    output);
+}
+
+TEST(JsonWriter, Compact)
+{
+  std::string output;
+  {
+    JsonWriter w(output, JsonWriter::Style::Compact);
+    write_sample(w);
+  }
+  EXPECT_EQ("{\"frames\": [{\"filename\": \"a\\\"b\\\\c\\n\", \"frame\": {\"x\": 0, \"y\": -1}, "
+            "\"trimmed\": false}, {\"filename\": \"a\\\"b\\\\c\\n\", \"frame\": {\"x\": 32, "
+            "\"y\": -1}, \"trimmed\": false}], \"meta\": {\"scale\": 1.5, \"empty\": [], "
+            "\"layers\": [{\"cels\": [null, true]}]}}",
+            output);
+}
+
+TEST(JsonWriter, Escape)
+{
+  std::string output;
+  {
+    JsonWriter w(output, JsonWriter::Style::Compact);
+    w.value("\t\x01/\xe2\x80\xa8\xc3\xa1");
+  }
+  EXPECT_EQ("\"\\t\\u0001/\\u2028\xc3\xa1\"", output);
+}
+
+TEST(JsonWriter, Stream)
+{
+  // Big arrays are flushed to the stream in several chunks
+  std::string expected;
+  std::ostringstream os;
+  {
+    JsonWriter w1(expected, JsonWriter::Style::Compact);
+    JsonWriter w2(os, JsonWriter::Style::Compact);
+    for (DataWriter* w : { (DataWriter*)&w1, (DataWriter*)&w2 }) {
+      w->beginArray();
+      for (int i = 0; i < 100000; ++i)
+        w->value(i);
+      w->endArray();
+    }
+  }
+  EXPECT_GT(expected.size(), DataWriter::kBufferSize);
+  EXPECT_EQ(expected, os.str());
+}
+
+TEST(CborWriter, Basic)
+{
+  std::string output;
+  {
+    CborWriter w(output);
+    w.beginObject();
+    w.field("a", 1);
+    w.key("b");
+    w.beginArray();
+    w.value(-500);
+    w.value(1.5);
+    w.value(false);
+    w.null();
+    w.endArray();
+    w.endObject();
+  }
+  const std::string expected("\xd9\xd9\xf7"           // Self-describe tag
+                             "\xbf"                   // Map
+                             "\x61"
+                             "a\x01"                  // "a": 1
+                             "\x61"
+                             "b\x9f"                  // "b": [
+                             "\x39\x01\xf3"           // -500
+                             "\xfa\x3f\xc0\x00\x00"   // 1.5
+                             "\xf4\xf6\xff"           // false, null ]
+                             "\xff",                  // End of map
+                             22);
+  EXPECT_EQ(expected, output);
+}
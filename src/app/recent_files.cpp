@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2020  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,11 +13,13 @@
 
 #include "app/ini_file.h"
 #include "base/fs.h"
+#include "doc/parallel_for.h"
 #include "fmt/format.h"
 
 #include <cstdio>
 #include <cstring>
 #include <set>
+#include <vector>
 
 namespace {
 
@@ -160,6 +162,13 @@ void RecentFiles::removeItem(base::paths& list, const std::string& fn)
 
 void RecentFiles::load()
 {
+  struct Item {
+    int collection;
+    std::string fn;
+    bool exists;
+  };
+  std::vector<Item> items;
+
   for (int i = 0; i < kCollections; ++i) {
     const char* section = kSectionName[i];
 
@@ -182,11 +191,24 @@ void RecentFiles::load()
       }
 
       const char* fn = get_config_string(section, key.c_str(), nullptr);
-      if (fn && *fn && ((i < 2 && base::is_file(fn)) || (i >= 2 && base::is_directory(fn)))) {
-        std::string normalFn = normalizePath(fn);
-        m_paths[i].push_back(normalFn);
-      }
+      if (fn && *fn)
+        items.push_back(Item{ i, fn, false });
+    }
+  }
+
+  // Check that the files/folders still exist from several threads, as
+  // each check can block for a while (e.g. files from network
+  // drives or removable devices).
+  doc::parallel_for_bands(0, int(items.size()), 4, [&items](const int a, const int b) {
+    for (int j = a; j < b; ++j) {
+      Item& item = items[j];
+      item.exists = (item.collection < 2 ? base::is_file(item.fn) : base::is_directory(item.fn));
     }
+  });
+
+  for (const Item& item : items) {
+    if (item.exists)
+      m_paths[item.collection].push_back(normalizePath(item.fn));
   }
 }
 
@@ -342,6 +342,7 @@ Engine::Engine() : L(luaL_newstate()), m_delegate(nullptr), m_printLastResult(fa
   lua_setglobal(L, "SpriteSheetDataFormat");
   setfield_integer(L, "JSON_HASH", SpriteSheetDataFormat::JsonHash);
   setfield_integer(L, "JSON_ARRAY", SpriteSheetDataFormat::JsonArray);
+  setfield_integer(L, "CBOR", SpriteSheetDataFormat::Cbor);
   lua_pop(L, 1);
 
   lua_newtable(L);
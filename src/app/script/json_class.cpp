@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -8,10 +8,14 @@
   #include "config.h"
 #endif
 
+#include "app/json_writer.h"
 #include "app/script/luacpp.h"
 #include "app/script/values.h"
 
+#include <algorithm>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "json11.hpp"
 
@@ -82,6 +86,74 @@ JsonObj get_json_value(lua_State* L, int index)
   return JsonObj();
 }
 
+// Writes the given Lua value as get_json_value(L, index).dump() but
+// without creating the intermediate json11 objects.
+void write_json_value(lua_State* L, int index, DataWriter& w)
+{
+  switch (lua_type(L, index)) {
+    case LUA_TBOOLEAN: w.value(lua_toboolean(L, index) ? true : false); break;
+
+    case LUA_TNUMBER:  w.value(double(lua_tonumber(L, index))); break;
+
+    case LUA_TSTRING:  w.value(lua_tostring(L, index)); break;
+
+    case LUA_TTABLE:
+      index = lua_absindex(L, index);
+      if (is_array_table(L, index)) {
+        w.beginArray();
+        lua_pushnil(L);
+        while (lua_next(L, index) != 0) {
+          write_json_value(L, -1, w);
+          lua_pop(L, 1); // pop the value lua_next(), leave the key in the stack
+        }
+        w.endArray();
+      }
+      else {
+        // json11 objects are sorted by key, so we sort the keys to
+        // generate the same output.
+        struct Key {
+          std::string str;
+          int ref; // Position of the key in the iteration order
+        };
+        std::vector<Key> keys;
+        lua_newtable(L); // Table to keep the original keys by position
+        const int keysTable = lua_absindex(L, -1);
+        lua_pushnil(L);
+        while (lua_next(L, index) != 0) {
+          lua_pushvalue(L, -2); // Copy the key to convert it to string
+          if (const char* k = lua_tostring(L, -1)) {
+            keys.push_back(Key{ k, int(keys.size()) + 1 });
+            lua_pushvalue(L, -3);
+            lua_rawseti(L, keysTable, keys.back().ref);
+          }
+          lua_pop(L, 2); // pop the key copy and the value
+        }
+
+        // Equal keys (e.g. 1 and "1") are saved only once (the last one)
+        std::stable_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+          return a.str < b.str;
+        });
+
+        w.beginObject();
+        for (auto it = keys.begin(); it != keys.end(); ++it) {
+          if (it + 1 != keys.end() && (it + 1)->str == it->str)
+            continue;
+
+          w.key(it->str);
+          lua_rawgeti(L, keysTable, it->ref);
+          lua_rawget(L, index);
+          write_json_value(L, -1, w);
+          lua_pop(L, 1);
+        }
+        w.endObject();
+        lua_pop(L, 1); // Pop keys table
+      }
+      break;
+
+    default: w.null(); break;
+  }
+}
+
 int JsonObj_gc(lua_State* L)
 {
   get_obj<JsonObj>(L, 1)->~JsonObj();
@@ -227,7 +299,10 @@ int Json_encode(lua_State* L)
   }
   // Encode a Lua table
   else if (lua_istable(L, 1)) {
-    lua_pushstring(L, get_json_value(L, 1).dump().c_str());
+    std::string output;
+    JsonWriter writer(output, JsonWriter::Style::Compact);
+    write_json_value(L, 1, writer);
+    lua_pushlstring(L, output.c_str(), output.size());
     return 1;
   }
   return 0;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -10,7 +10,15 @@
 
 namespace app {
 
-enum class SpriteSheetDataFormat { JsonHash, JsonArray, Default = JsonHash };
+// The Cbor format contains the same data as JsonArray encoded in CBOR
+// (a compact binary format, see app::CborWriter).
+enum class SpriteSheetDataFormat { JsonHash, JsonArray, Cbor, Default = JsonHash };
+
+// Returns the extension of the data files of the given format.
+inline const char* get_sprite_sheet_data_format_extension(const SpriteSheetDataFormat format)
+{
+  return (format == SpriteSheetDataFormat::Cbor ? "cbor" : "json");
+}
 
 } // namespace app
 
@@ -0,0 +1,47 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/startup_trace.h"
+
+#include "base/log.h"
+#include "fmt/format.h"
+
+#include <ostream>
+
+namespace app {
+
+StartupTrace::Phase::Phase(StartupTrace* trace, const char* name) : m_trace(trace), m_name(name)
+{
+}
+
+void StartupTrace::Phase::end()
+{
+  if (m_trace) {
+    m_trace->add(m_name, m_chrono.elapsed());
+    m_trace = nullptr;
+  }
+}
+
+void StartupTrace::add(const std::string& name, const double seconds)
+{
+  LOG("APP: Startup phase '%s' took %.3f ms\n", name.c_str(), seconds * 1000.0);
+  m_phases.push_back(Item{ name, seconds });
+}
+
+void StartupTrace::print(std::ostream& os) const
+{
+  os << "Startup trace:\n";
+  for (const auto& phase : m_phases)
+    os << fmt::format("  {:<24} {:9.3f} ms\n", phase.name, phase.seconds * 1000.0);
+  os << fmt::format("  {:<24} {:9.3f} ms\n", "total", m_total.elapsed() * 1000.0);
+  os.flush();
+}
+
+} // namespace app
@@ -0,0 +1,61 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_STARTUP_TRACE_H_INCLUDED
+#define APP_STARTUP_TRACE_H_INCLUDED
+#pragma once
+
+#include "base/chrono.h"
+#include "base/disable_copying.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace app {
+
+// Measures the wall time of each phase of the program initialization
+// (enabled with the --trace-startup CLI option).
+class StartupTrace {
+public:
+  // Measures one phase from its construction to its destruction (or
+  // until end() is called). It does nothing if "trace" is nullptr.
+  class Phase {
+  public:
+    Phase(StartupTrace* trace, const char* name);
+    ~Phase() { end(); }
+    void end();
+
+  private:
+    StartupTrace* m_trace;
+    const char* m_name;
+    base::Chrono m_chrono;
+
+    DISABLE_COPYING(Phase);
+  };
+
+  StartupTrace() = default;
+
+  void add(const std::string& name, double seconds);
+
+  // Prints all phases and the total time since the trace was created.
+  void print(std::ostream& os) const;
+
+private:
+  struct Item {
+    std::string name;
+    double seconds;
+  };
+
+  base::Chrono m_total;
+  std::vector<Item> m_phases;
+
+  DISABLE_COPYING(StartupTrace);
+};
+
+} // namespace app
+
+#endif
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -14,6 +15,7 @@ enum class RotationAlgorithm {
   DEFAULT = 0,
   FAST = 0,
   ROTSPRITE = 1,
+  BILINEAR = 2,
 };
 
 }} // namespace app::tools
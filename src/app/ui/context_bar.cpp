@@ -928,6 +928,7 @@ public:
     m_lockChange = true;
     addItem(new Item(Strings::context_bar_fast_rotation(), tools::RotationAlgorithm::FAST));
     addItem(new Item(Strings::context_bar_rotsprite(), tools::RotationAlgorithm::ROTSPRITE));
+    addItem(new Item(Strings::context_bar_bilinear_rotation(), tools::RotationAlgorithm::BILINEAR));
     m_lockChange = false;
 
     setSelectedItemIndex((int)Preferences::instance().selection.rotationAlgorithm());
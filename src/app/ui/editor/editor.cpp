@@ -998,7 +998,20 @@ void Editor::drawMask(Graphics* g)
 
   // Create the mask boundaries path
   auto& segs = m_document->maskBoundaries();
-  segs.createPathIfNeeeded();
+  const gfx::PointF scale(m_proj.scaleX(), m_proj.scaleY());
+  if (m_maskPathVersion != segs.version() || m_maskPathScale != scale || m_maskPathOrigin != pt) {
+    segs.createPathIfNeeeded();
+
+    // We translate the path instead of applying a matrix to the
+    // ui::Graphics so the "checkered" pattern is not scaled too.
+    m_maskPath.rewind();
+    segs.path().transform(m_proj.scaleMatrix(), &m_maskPath);
+    m_maskPath.offset(pt.x, pt.y);
+
+    m_maskPathVersion = segs.version();
+    m_maskPathScale = scale;
+    m_maskPathOrigin = pt;
+  }
 
   ui::Paint paint;
   paint.style(ui::Paint::Stroke);
@@ -1007,12 +1020,7 @@ void Editor::drawMask(Graphics* g)
                            gfx::rgba(0, 0, 0, 255),
                            gfx::rgba(255, 255, 255, 255));
 
-  // We translate the path instead of applying a matrix to the
-  // ui::Graphics so the "checkered" pattern is not scaled too.
-  gfx::Path path;
-  segs.path().transform(m_proj.scaleMatrix(), &path);
-  path.offset(pt.x, pt.y);
-  g->drawPath(path, paint);
+  g->drawPath(m_maskPath, paint);
 }
 
 void Editor::drawMaskSafe()
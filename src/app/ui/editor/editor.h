@@ -29,6 +29,8 @@
 #include "doc/selected_objects.h"
 #include "filters/tiled_mode.h"
 #include "gfx/fwd.h"
+#include "gfx/path.h"
+#include "gfx/point.h"
 #include "obs/connection.h"
 #include "os/color_space.h"
 #include "render/projection.h"
@@ -436,6 +438,14 @@ private:
   ui::Timer m_antsTimer;
   int m_antsOffset;
 
+  // Mask boundaries path in screen coordinates, re-created only when
+  // the boundaries, the zoom, or the scroll position change (and not
+  // each time the marching ants are animated).
+  gfx::Path m_maskPath;
+  uint32_t m_maskPathVersion = 0;
+  gfx::PointF m_maskPathScale;
+  gfx::Point m_maskPathOrigin;
+
   obs::scoped_connection m_samplingChangeConn;
   obs::scoped_connection m_fgColorChangeConn;
   obs::scoped_connection m_contextBarBrushChangeConn;
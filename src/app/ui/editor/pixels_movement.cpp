@@ -35,7 +35,6 @@
 #include "base/pi.h"
 #include "doc/algorithm/flip_image.h"
 #include "doc/algorithm/rotate.h"
-#include "doc/algorithm/rotsprite.h"
 #include "doc/algorithm/shift_image.h"
 #include "doc/blend_internals.h"
 #include "doc/cel.h"
@@ -126,6 +125,8 @@ PixelsMovement::PixelsMovement(Context* context,
   , m_canHandleFrameChange(false)
   , m_fastMode(false)
   , m_needsRotSpriteRedraw(false)
+  , m_rotSpriteImage(std::make_unique<doc::algorithm::RotSprite>())
+  , m_rotSpriteMask(std::make_unique<doc::algorithm::RotSprite>())
 {
   // Save and Lock the TilemapMode.
   // TODO: enable TilemapMode exchanges during PixelMovement.
@@ -810,6 +811,9 @@ void PixelsMovement::alignMasksAndTransformData(const Mask* initialMask0,
   m_initialMask0->replace(make_aligned_mask(&grid, initialMask0));
   m_initialMask->replace(make_aligned_mask(&grid, initialMask));
   m_currentMask->replace(make_aligned_mask(&grid, currentMask));
+  m_rotSpriteMask->invalidate();
+  m_cachedMask.mask.reset();
+  discardFlipVariants();
   m_initialData = *initialData;
   m_initialData.bounds(m_initialMask0->bounds());
   m_currentData = *currentData;
@@ -939,6 +943,8 @@ void PixelsMovement::stampImage(bool finalStamp)
   m_initialMask0->replace(initialMask0);
   m_initialMask->replace(initialMask);
   m_currentMask->replace(currentMask);
+  m_rotSpriteMask->invalidate();
+  m_cachedMask.mask.reset();
   m_initialData.bounds(initialData.bounds());
   m_currentData.bounds(currentData.bounds());
   m_site.tilesetMode(originalSiteTilesetMode);
@@ -1224,6 +1230,21 @@ void PixelsMovement::drawMask(doc::Mask* mask, bool shrink)
     return;
   }
 
+  // The cached mask is not used in fast mode because
+  // drawParallelogram() must know that RotSprite was skipped.
+  const auto& pref = Preferences::instance().selection;
+  const int rotAlgo = int(pref.rotationAlgorithm());
+  const bool forceRotsprite = pref.forceRotsprite();
+  if (!m_fastMode && m_cachedMask.mask && m_cachedMask.shrink == shrink &&
+      m_cachedMask.cornerThick == m_currentData.cornerThick() &&
+      m_cachedMask.rotAlgo == rotAlgo && m_cachedMask.forceRotsprite == forceRotsprite &&
+      std::equal(&corners[0],
+                 &corners[0] + Transformation::Corners::NUM_OF_CORNERS,
+                 &m_cachedMask.corners[0])) {
+    mask->copyFrom(m_cachedMask.mask.get());
+    return;
+  }
+
   mask->replace(bounds);
   if (shrink)
     mask->freeze();
@@ -1236,6 +1257,17 @@ void PixelsMovement::drawMask(doc::Mask* mask, bool shrink)
                     gfx::PointF(bounds.origin()));
   if (shrink)
     mask->unfreeze();
+
+  if (!m_fastMode) {
+    m_cachedMask.corners = corners;
+    m_cachedMask.cornerThick = m_currentData.cornerThick();
+    m_cachedMask.shrink = shrink;
+    m_cachedMask.rotAlgo = rotAlgo;
+    m_cachedMask.forceRotsprite = forceRotsprite;
+    if (!m_cachedMask.mask)
+      m_cachedMask.mask = std::make_unique<Mask>();
+    m_cachedMask.mask->copyFrom(mask);
+  }
 }
 
 void PixelsMovement::drawParallelogram(const Transformation& transformation,
@@ -1269,6 +1301,7 @@ retry:; // In case that we don't have enough memory for RotSprite
 
   switch (rotAlgo) {
     case tools::RotationAlgorithm::FAST:
+    case tools::RotationAlgorithm::BILINEAR:
       doc::algorithm::parallelogram(dst,
                                     src,
                                     (mask ? mask->bitmap() : nullptr),
@@ -1279,22 +1312,28 @@ retry:; // In case that we don't have enough memory for RotSprite
                                     int(corners.rightBottom().x - leftTop.x),
                                     int(corners.rightBottom().y - leftTop.y),
                                     int(corners.leftBottom().x - leftTop.x),
-                                    int(corners.leftBottom().y - leftTop.y));
+                                    int(corners.leftBottom().y - leftTop.y),
+                                    (rotAlgo == tools::RotationAlgorithm::BILINEAR ?
+                                       doc::algorithm::Interpolation::Bilinear :
+                                       doc::algorithm::Interpolation::NearestNeighbor));
       break;
 
     case tools::RotationAlgorithm::ROTSPRITE:
       try {
-        doc::algorithm::rotsprite_image(dst,
-                                        src,
-                                        (mask ? mask->bitmap() : nullptr),
-                                        int(corners.leftTop().x - leftTop.x),
-                                        int(corners.leftTop().y - leftTop.y),
-                                        int(corners.rightTop().x - leftTop.x),
-                                        int(corners.rightTop().y - leftTop.y),
-                                        int(corners.rightBottom().x - leftTop.x),
-                                        int(corners.rightBottom().y - leftTop.y),
-                                        int(corners.leftBottom().x - leftTop.x),
-                                        int(corners.leftBottom().y - leftTop.y));
+        doc::algorithm::RotSprite& rotsprite =
+          (src == m_originalImage.get() ? *m_rotSpriteImage : *m_rotSpriteMask);
+
+        rotsprite.draw(dst,
+                       src,
+                       (mask ? mask->bitmap() : nullptr),
+                       int(corners.leftTop().x - leftTop.x),
+                       int(corners.leftTop().y - leftTop.y),
+                       int(corners.rightTop().x - leftTop.x),
+                       int(corners.rightTop().y - leftTop.y),
+                       int(corners.rightBottom().x - leftTop.x),
+                       int(corners.rightBottom().y - leftTop.y),
+                       int(corners.leftBottom().x - leftTop.x),
+                       int(corners.leftBottom().y - leftTop.y));
       }
       catch (const std::bad_alloc&) {
         StatusBar::instance()->showTip(1000, Strings::statusbar_tips_not_enough_rotsprite_memory());
@@ -1392,6 +1431,58 @@ void PixelsMovement::hideDocumentMask()
 
 void PixelsMovement::flipOriginalImage(const doc::algorithm::FlipType flipType)
 {
+  // Maximum number of other orientations to keep in memory (each one
+  // can have its own RotSprite caches).
+  constexpr std::size_t kMaxFlipVariants = 2;
+
+  m_cachedMask.mask.reset();
+
+  if (flipType == doc::algorithm::FlipDiagonal) {
+    // A diagonal flip cannot be combined with the horizontal/vertical
+    // flip bits, so we just start again from this orientation.
+    discardFlipVariants();
+  }
+  else {
+    const int flips = m_flips ^ (flipType == doc::algorithm::FlipHorizontal ? 1 : 2);
+    auto it = std::find_if(m_flipVariants.begin(),
+                           m_flipVariants.end(),
+                           [flips](const FlipVariant& v) { return v.flips == flips; });
+
+    // Swap the current orientation with the cached one.
+    if (it != m_flipVariants.end()) {
+      FlipVariant variant = std::move(*it);
+      m_flipVariants.erase(it);
+      std::swap(variant.image, m_originalImage);
+      std::swap(variant.mask, m_initialMask);
+      std::swap(variant.rotSpriteImage, m_rotSpriteImage);
+      std::swap(variant.rotSpriteMask, m_rotSpriteMask);
+      variant.flips = m_flips;
+      m_flipVariants.push_back(std::move(variant));
+      m_flips = flips;
+      return;
+    }
+
+    // Keep the current orientation (the image and mask with their
+    // RotSprite caches) and flip copies of it.
+    if (m_flipVariants.size() == kMaxFlipVariants)
+      m_flipVariants.erase(m_flipVariants.begin());
+
+    FlipVariant variant;
+    variant.flips = m_flips;
+    variant.image = m_originalImage;
+    variant.mask = std::move(m_initialMask);
+    variant.rotSpriteImage = std::move(m_rotSpriteImage);
+    variant.rotSpriteMask = std::move(m_rotSpriteMask);
+
+    m_originalImage.reset(Image::createCopy(m_originalImage.get()));
+    m_initialMask = std::make_unique<Mask>(*variant.mask);
+    m_flipVariants.push_back(std::move(variant));
+
+    m_rotSpriteImage = std::make_unique<doc::algorithm::RotSprite>();
+    m_rotSpriteMask = std::make_unique<doc::algorithm::RotSprite>();
+    m_flips = flips;
+  }
+
   // Flip the image.
   doc::algorithm::flip_image(
     m_originalImage.get(),
@@ -1402,11 +1493,24 @@ void PixelsMovement::flipOriginalImage(const doc::algorithm::FlipType flipType)
   doc::algorithm::flip_image(m_initialMask->bitmap(),
                              gfx::Rect(gfx::Point(0, 0), m_initialMask->bounds().size()),
                              flipType);
+
+  m_rotSpriteImage->invalidate();
+  m_rotSpriteMask->invalidate();
 }
 
 void PixelsMovement::shiftOriginalImage(const int dx, const int dy, const double angle)
 {
+  // The other orientations don't include the shift.
+  discardFlipVariants();
+
   doc::algorithm::shift_image(m_originalImage.get(), dx, dy, angle);
+  m_rotSpriteImage->invalidate();
+}
+
+void PixelsMovement::discardFlipVariants()
+{
+  m_flipVariants.clear();
+  m_flips = 0;
 }
 
 // Returns the list of cels that will be transformed (the first item
@@ -1516,6 +1620,10 @@ void PixelsMovement::reproduceAllTransformationsWithInnerCmds()
 
   m_document->setMask(m_initialMask0.get());
   m_initialMask->copyFrom(m_initialMask0.get());
+  m_rotSpriteImage->invalidate();
+  m_rotSpriteMask->invalidate();
+  m_cachedMask.mask.reset();
+  discardFlipVariants();
   if (m_site.layer()->isTilemap() && m_site.tilemapMode() == TilemapMode::Tiles) {
     m_originalImage.reset(new_tilemap_from_mask(m_site, m_initialMask.get()));
   }
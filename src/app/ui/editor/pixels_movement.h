@@ -16,12 +16,14 @@
 #include "app/tx.h"
 #include "app/ui/editor/handle_type.h"
 #include "doc/algorithm/flip_type.h"
+#include "doc/algorithm/rotsprite.h"
 #include "doc/frame.h"
 #include "doc/image_ref.h"
 #include "gfx/size.h"
 #include "obs/connection.h"
 
 #include <memory>
+#include <vector>
 
 namespace doc {
 class Image;
@@ -160,6 +162,7 @@ private:
 
   void flipOriginalImage(const doc::algorithm::FlipType flipType);
   void shiftOriginalImage(const int dx, const int dy, const double angle);
+  void discardFlipVariants();
   CelList getEditableCels();
   void reproduceAllTransformationsWithInnerCmds();
 
@@ -203,6 +206,43 @@ private:
   bool m_fastMode;
   bool m_needsRotSpriteRedraw;
 
+  // RotSprite caches of the 8x versions of m_originalImage and
+  // m_initialMask, so dragging a rotation handle doesn't need to
+  // re-scale the original image on each mouse movement.
+  std::unique_ptr<doc::algorithm::RotSprite> m_rotSpriteImage;
+  std::unique_ptr<doc::algorithm::RotSprite> m_rotSpriteMask;
+
+  // Other orientations of m_originalImage/m_initialMask (with their
+  // RotSprite caches) that were used before flipping the selection,
+  // so flipping it back doesn't need to flip the pixels and re-scale
+  // the image again. "flips" are the FlipHorizontal/FlipVertical
+  // bits applied from the orientation given in the constructor (or
+  // the last shift/diagonal flip, which discard these variants).
+  struct FlipVariant {
+    int flips;
+    doc::ImageRef image;
+    std::unique_ptr<Mask> mask;
+    std::unique_ptr<doc::algorithm::RotSprite> rotSpriteImage;
+    std::unique_ptr<doc::algorithm::RotSprite> rotSpriteMask;
+  };
+  std::vector<FlipVariant> m_flipVariants; // Most recently used at the end
+  int m_flips = 0;
+
+  // Last mask rendered by drawMask() with the corners/parameters
+  // used to render it (all of them are the cache key, so a different
+  // rotation algorithm renders the mask again). Redrawing the mask
+  // for the same transformation (e.g. when only the pivot or the
+  // frame changes) is just a copy.
+  struct CachedMask {
+    Transformation::Corners corners;
+    double cornerThick = 0.0;
+    bool shrink = false;
+    int rotAlgo = -1;
+    bool forceRotsprite = false;
+    std::unique_ptr<Mask> mask;
+  };
+  CachedMask m_cachedMask;
+
   // Commands used in the interaction with the transformed pixels.
   // This is used to re-create the whole interaction on each
   // modified cel when we are modifying multiples cels at the same
@@ -787,8 +787,11 @@ void Clipboard::paste(Context* ctx, const bool interactive, const gfx::Point* po
 
 ImageRef Clipboard::getImage(Palette* palette)
 {
-  // Get the image from the native clipboard.
-  if (use_native_clipboard()) {
+  // Get the image from the native clipboard. If the native clipboard
+  // contains the image that we've copied, we can use the one we have
+  // in m_data (sharing it with the paste operation) instead of
+  // decoding it again.
+  if (use_native_clipboard() && !(m_data->image && isOwnNativeBitmap())) {
     Image* native_image = nullptr;
     Mask* native_mask = nullptr;
     Palette* native_palette = nullptr;
@@ -805,7 +808,8 @@ ImageRef Clipboard::getImage(Palette* palette)
 
 bool Clipboard::getImageSize(gfx::Size& size)
 {
-  if (use_native_clipboard() && getNativeBitmapSize(&size))
+  if (use_native_clipboard() && !(m_data->image && isOwnNativeBitmap()) &&
+      getNativeBitmapSize(&size))
     return true;
 
   if (m_data->image) {
@@ -16,6 +16,7 @@
 #include "ui/base.h"
 #include "ui/clipboard_delegate.h"
 
+#include <cstdint>
 #include <memory>
 
 namespace doc {
@@ -110,11 +111,18 @@ private:
                        doc::Palette** palette,
                        doc::Tileset** tileset);
   bool getNativeBitmapSize(gfx::Size* size);
+  bool isOwnNativeBitmap() const;
 
   bool setNativePalette(const doc::Palette* palette, const doc::PalettePicks& picks);
 
   struct Data;
   std::unique_ptr<Data> m_data;
+
+  // ID of the last image that we've put in the native clipboard (it's
+  // put in the clipboard too). If the native clipboard still contains
+  // this ID, we can paste the image from m_data directly instead of
+  // decoding it from the native clipboard.
+  uint64_t m_nativeBitmapId = 0;
 };
 
 } // namespace app
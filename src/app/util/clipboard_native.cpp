@@ -27,6 +27,7 @@
 #include "os/window.h"
 #include "ui/alert.h"
 
+#include <random>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -38,8 +39,26 @@ using namespace base::serialization::little_endian;
 
 namespace {
 clip::format custom_image_format = 0;
+clip::format custom_image_id_format = 0;
 bool show_clip_errors = true;
 
+// The custom image format is compressed with the fastest zlib level:
+// the data lives in memory only, so the copy operation must be fast
+// even for big images.
+constexpr int kCustomImageCompressionLevel = 1;
+
+// Generates a new ID for the image copied to the native clipboard. It
+// is random so it doesn't match the ID of other Aseprite processes.
+uint64_t new_native_bitmap_id()
+{
+  static std::mt19937_64 gen(std::random_device{}());
+  uint64_t id;
+  do {
+    id = gen();
+  } while (id == 0);
+  return id;
+}
+
 class InhibitClipErrors {
   bool m_saved;
 
@@ -86,6 +105,7 @@ void Clipboard::registerNativeFormats()
 {
   clip::set_error_handler(custom_error_handler);
   custom_image_format = clip::register_format("org.aseprite.Image");
+  custom_image_id_format = clip::register_format("org.aseprite.ImageId");
 }
 
 bool Clipboard::hasNativeBitmap() const
@@ -105,16 +125,17 @@ bool Clipboard::setNativeBitmap(const doc::Image* image,
     return false;
 
   l.clear();
+  m_nativeBitmapId = 0;
 
   if (!image)
     return false;
 
   // Set custom clipboard formats
   if (custom_image_format) {
-    std::stringstream os;
+    std::ostringstream os;
     write32(os, (image ? 1 : 0) | (mask ? 2 : 0) | (palette ? 4 : 0) | (tileset ? 8 : 0));
     if (image)
-      doc::write_image(os, image);
+      doc::write_image(os, image, nullptr, kCustomImageCompressionLevel);
     if (mask)
       doc::write_mask(os, mask);
     if (palette)
@@ -123,17 +144,20 @@ bool Clipboard::setNativeBitmap(const doc::Image* image,
       doc::write_tileset(os, tileset);
 
     if (os.good()) {
-      size_t size = (size_t)os.tellp();
-      if (size > 0) {
-        std::vector<char> data(size);
-        os.seekp(0);
-        os.read(&data[0], size);
-
-        l.set_data(custom_image_format, &data[0], size);
-      }
+      const std::string data = os.str();
+      if (!data.empty())
+        l.set_data(custom_image_format, data.data(), data.size());
     }
   }
 
+  // Set the ID of this image so we can paste it in this same process
+  // without decoding it from the clipboard.
+  if (custom_image_id_format) {
+    const uint64_t id = new_native_bitmap_id();
+    if (l.set_data(custom_image_id_format, (const char*)&id, sizeof(id)))
+      m_nativeBitmapId = id;
+  }
+
   clip::image_spec spec;
   spec.width = image->width();
   spec.height = image->height();
@@ -319,6 +343,21 @@ bool Clipboard::getNativeBitmap(doc::Image** image,
   return true;
 }
 
+bool Clipboard::isOwnNativeBitmap() const
+{
+  if (!m_nativeBitmapId || !custom_image_id_format)
+    return false;
+
+  InhibitClipErrors ice;
+  clip::lock l(native_window_handle());
+  if (!l.locked() || !l.is_convertible(custom_image_id_format) ||
+      l.get_data_length(custom_image_id_format) != sizeof(uint64_t))
+    return false;
+
+  uint64_t id = 0;
+  return (l.get_data(custom_image_id_format, (char*)&id, sizeof(id)) && id == m_nativeBitmapId);
+}
+
 bool Clipboard::getNativeBitmapSize(gfx::Size* size)
 {
   // Don't show errors when we are trying to get the size of the image
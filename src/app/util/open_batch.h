@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2021  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -19,11 +19,17 @@ namespace app {
 // elements)
 class OpenBatchOfFiles {
 public:
-  void open(Context* ctx, const std::string& fn, const bool oneFrame)
+  void open(Context* ctx,
+            const std::string& fn,
+            const bool oneFrame,
+            const bool skipHiddenLayers = false)
   {
     Params params;
     params.set("filename", fn.c_str());
 
+    if (skipHiddenLayers)
+      params.set("skip_hidden_layers", "true");
+
     if (oneFrame)
       params.set("oneframe", "true");
     else {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2019-2022  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -44,11 +44,37 @@ doc::Image* resize_image(const doc::Image* image,
   return newImage.release();
 }
 
+doc::ImageRef create_resized_cel_image(doc::Cel* cel,
+                                       const gfx::SizeF& scale,
+                                       const doc::algorithm::ResizeMethod method,
+                                       const doc::RgbMap* rgbmap)
+{
+  doc::Image* image = cel->image();
+  if (!image || cel->link() || cel->layer()->isReference())
+    return nullptr;
+
+  const doc::Sprite* sprite = cel->sprite();
+  const int w = std::max(1, int(scale.w * image->width()));
+  const int h = std::max(1, int(scale.h * image->height()));
+  doc::ImageRef newImage(doc::Image::create(image->pixelFormat(), w, h));
+  newImage->setMaskColor(image->maskColor());
+
+  doc::algorithm::fixup_image_transparent_colors(image);
+  doc::algorithm::resize_image(image,
+                               newImage.get(),
+                               method,
+                               sprite->palette(cel->frame()),
+                               rgbmap,
+                               (cel->layer()->isBackground() ? -1 : sprite->transparentColor()));
+  return newImage;
+}
+
 void resize_cel_image(Tx& tx,
                       doc::Cel* cel,
                       const gfx::SizeF& scale,
                       const doc::algorithm::ResizeMethod method,
-                      const gfx::PointF& pivot)
+                      const gfx::PointF& pivot,
+                      const doc::ImageRef& newImage)
 {
   // Get cel's image
   doc::Image* image = cel->image();
@@ -71,22 +97,11 @@ void resize_cel_image(Tx& tx,
         tx(new cmd::SetCelPosition(cel, x, y));
 
       // Resize the image
-      const int w = std::max(1, int(scale.w * image->width()));
-      const int h = std::max(1, int(scale.h * image->height()));
-      doc::ImageRef newImage(
-        doc::Image::create(image->pixelFormat(), std::max(1, w), std::max(1, h)));
-      newImage->setMaskColor(image->maskColor());
-
-      doc::algorithm::fixup_image_transparent_colors(image);
-      doc::algorithm::resize_image(
-        image,
-        newImage.get(),
-        method,
-        sprite->palette(cel->frame()),
-        sprite->rgbMap(cel->frame()),
-        (cel->layer()->isBackground() ? -1 : sprite->transparentColor()));
-
-      tx(new cmd::ReplaceImage(sprite, cel->imageRef(), newImage));
+      doc::ImageRef resizedImage = newImage;
+      if (!resizedImage)
+        resizedImage = create_resized_cel_image(cel, scale, method, sprite->rgbMap(cel->frame()));
+
+      tx(new cmd::ReplaceImage(sprite, cel->imageRef(), resizedImage));
     }
   }
 }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2019-2021  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -10,6 +10,7 @@
 
 #include "doc/algorithm/resize_image.h"
 #include "doc/color.h"
+#include "doc/image_ref.h"
 #include "gfx/point.h"
 #include "gfx/size.h"
 
@@ -29,11 +30,24 @@ doc::Image* resize_image(const doc::Image* image,
                          const doc::Palette* pal,
                          const doc::RgbMap* rgbmap);
 
+// Returns the resized image that resize_cel_image() uses for the
+// given cel (or nullptr if the cel image is not resized, e.g. linked
+// cels or reference layers). It doesn't add commands to any
+// transaction, so it can be called from several threads for
+// different cels (each thread with its own "rgbmap").
+doc::ImageRef create_resized_cel_image(doc::Cel* cel,
+                                       const gfx::SizeF& scale,
+                                       const doc::algorithm::ResizeMethod method,
+                                       const doc::RgbMap* rgbmap);
+
+// Resizes the cel image, "newImage" can be the result of
+// create_resized_cel_image() to avoid resizing the image again.
 void resize_cel_image(Tx& tx,
                       doc::Cel* cel,
                       const gfx::SizeF& scale,
                       const doc::algorithm::ResizeMethod method,
-                      const gfx::PointF& pivot);
+                      const gfx::PointF& pivot,
+                      const doc::ImageRef& newImage = doc::ImageRef());
 
 } // namespace app
 
@@ -0,0 +1,55 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/util/worker_rgbmap.h"
+
+#include "doc/octree_map.h"
+#include "doc/palette.h"
+#include "doc/rgbmap_rgb5a3.h"
+#include "doc/sprite.h"
+
+namespace app {
+
+WorkerRgbMap::WorkerRgbMap(const doc::Sprite* sprite,
+                           const doc::RgbMapAlgorithm algorithm,
+                           const doc::FitCriteria fitCriteria)
+  : m_sprite(sprite)
+  , m_algorithm(algorithm)
+  , m_fitCriteria(fitCriteria)
+  , m_opaque(sprite->rgbMapForSprite() == doc::Sprite::RgbMapFor::OpaqueLayer)
+{
+}
+
+WorkerRgbMap::~WorkerRgbMap()
+{
+}
+
+doc::RgbMap* WorkerRgbMap::get(const doc::frame_t frame)
+{
+  if (!m_rgbmap) {
+    if (m_algorithm == doc::RgbMapAlgorithm::RGB5A3)
+      m_rgbmap = std::make_unique<doc::RgbMapRGB5A3>();
+    else
+      m_rgbmap = std::make_unique<doc::OctreeMap>();
+    m_rgbmap->fitCriteria(m_fitCriteria);
+  }
+
+  const doc::Palette* palette = m_sprite->palette(frame);
+  int maskIndex = palette->findMaskColor();
+  if (maskIndex == -1)
+    maskIndex = (m_opaque ? -1 : 0);
+
+  // This does nothing if the palette wasn't modified since the last
+  // call.
+  m_rgbmap->regenerateMap(palette, maskIndex, m_fitCriteria);
+  return m_rgbmap.get();
+}
+
+} // namespace app
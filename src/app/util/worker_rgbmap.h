@@ -0,0 +1,53 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_WORKER_RGBMAP_H_INCLUDED
+#define APP_UTIL_WORKER_RGBMAP_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+#include "doc/fit_criteria.h"
+#include "doc/frame.h"
+#include "doc/rgbmap_algorithm.h"
+
+#include <memory>
+
+namespace doc {
+class RgbMap;
+class Sprite;
+} // namespace doc
+
+namespace app {
+
+// RgbMap to convert/resize images of a sprite from a worker thread.
+// The sprite RgbMap (Sprite::rgbMap()) cannot be shared between
+// threads: it's regenerated for each frame palette and it caches
+// the mapped colors on demand. So each thread must use its own
+// WorkerRgbMap instance.
+class WorkerRgbMap {
+public:
+  WorkerRgbMap(const doc::Sprite* sprite,
+               const doc::RgbMapAlgorithm algorithm,
+               const doc::FitCriteria fitCriteria);
+  ~WorkerRgbMap();
+
+  // Returns the RgbMap for the palette of the given frame, with the
+  // same mask index that Sprite::rgbMap() would use.
+  doc::RgbMap* get(const doc::frame_t frame);
+
+private:
+  const doc::Sprite* m_sprite;
+  doc::RgbMapAlgorithm m_algorithm;
+  doc::FitCriteria m_fitCriteria;
+  bool m_opaque;
+  std::unique_ptr<doc::RgbMap> m_rgbmap;
+
+  DISABLE_COPYING(WorkerRgbMap);
+};
+
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2021 Igara Studio S.A.
+// Copyright (c) 2021-2024 Igara Studio S.A.
 // Copyright (c) 2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -13,79 +13,211 @@
 
 #include "doc/image_impl.h"
 #include "doc/mask.h"
+#include "doc/parallel_for.h"
 #include "doc/primitives.h"
+#include "doc/primitives_fast.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <vector>
 
 namespace doc { namespace algorithm {
 
-// TODO create morphological operators/functions in "doc" namespace
-// TODO the impl is not optimal, but is good enough as a first version
-void modify_selection(const SelectionModifier modifier,
-                      const Mask* srcMask,
-                      Mask* dstMask,
-                      const int radius,
-                      const doc::BrushType brush)
-{
-  const doc::Image* srcImage = srcMask->bitmap();
-  doc::Image* dstImage = dstMask->bitmap();
-  const gfx::Point offset = srcMask->bounds().origin() - dstMask->bounds().origin();
+namespace {
 
-  // Image bounds to clip get/put pixels
-  const gfx::Rect srcBounds = srcImage->bounds();
+// Returns the half width of each row of the kernel (brush) used to
+// modify the selection, i.e. the kernel contains the (u, v) pixels
+// with |u| <= halfWidths[|v|], for v in [-radius, radius].
+std::vector<int> kernel_half_widths(const int radius, const doc::BrushType brush)
+{
+  std::vector<int> halfWidths(radius + 1, radius);
+  if (brush != doc::kCircleBrushType)
+    return halfWidths;
 
-  // Create a kernel
+  // Use the same ellipse algorithm used to draw circle brushes
   const int size = 2 * radius + 1;
   std::unique_ptr<doc::Image> kernel(doc::Image::create(IMAGE_BITMAP, size, size));
   doc::clear_image(kernel.get(), 0);
-  if (brush == doc::kCircleBrushType)
-    doc::fill_ellipse(kernel.get(), 0, 0, size - 1, size - 1, 0, 0, 1);
-  else
-    doc::fill_rect(kernel.get(), 0, 0, size - 1, size - 1, 1);
-  doc::put_pixel(kernel.get(), radius, radius, 0);
-
-  int total = 0; // Number of 1s in the kernel image
-  for (int v = 0; v < size; ++v)
-    for (int u = 0; u < size; ++u)
-      total += kernel->getPixel(u, v);
-
-  for (int y = -radius; y < srcBounds.h + radius; ++y) {
-    for (int x = -radius; x < srcBounds.w + radius; ++x) {
-      doc::color_t c;
-      if (srcBounds.contains(x, y))
-        c = srcImage->getPixel(x, y);
-      else
-        c = 0;
-
-      int accum = 0;
-      for (int v = 0; v < size; ++v) {
-        for (int u = 0; u < size; ++u) {
-          if (kernel->getPixel(u, v)) {
-            if (srcBounds.contains(x + u - radius, y + v - radius))
-              accum += srcImage->getPixel(x - radius + u, y - radius + v);
-          }
-        }
+  doc::fill_ellipse(kernel.get(), 0, 0, size - 1, size - 1, 0, 0, 1);
+
+  for (int v = 0; v <= radius; ++v) {
+    // -1 if the row is empty
+    int u = radius;
+    while (u >= 0 && !kernel->getPixel(radius + u, radius + v))
+      --u;
+    halfWidths[v] = u;
+
+    // The ellipse is symmetric and convex
+    ASSERT(u < 0 || kernel->getPixel(radius - u, radius + v));
+    ASSERT(u < 0 || kernel->getPixel(radius + u, radius - v));
+    ASSERT(v == 0 || halfWidths[v] <= halfWidths[v - 1]);
+  }
+  return halfWidths;
+}
+
+// Flags of each pixel of the work area after dilate()
+enum : uint8_t { kSelected = 1, kDilated = 2 };
+
+// Morphological dilation of the selected pixels of "srcImage" (or
+// the non-selected pixels if "inverted" is true) with the kernel
+// defined by "halfWidths", in O(w*h) for any radius. The work area is
+// "w" x "h" (the bitmap is at (radius, radius), and pixels outside
+// the bitmap are not selected). It's a two-pass distance transform:
+//
+// 1. For each row, the horizontal distance (clamped to radius+1)
+//    from each pixel to the nearest pixel to dilate of the same row
+//    (rows in parallel).
+// 2. A pixel at distance "d" at row y' dilates the pixel (x, y) if
+//    |y - y'| <= maxDy[d] (the last kernel row that is at least "d"
+//    pixels wide). Each column is swept from top to bottom keeping
+//    the farthest row reached by those intervals (columns in
+//    parallel).
+//
+// The distances of each column are replaced in place with the
+// kSelected/kDilated flags of its pixels, so "area" is the only
+// buffer with one element per pixel (T is uint16_t for any
+// reasonable radius).
+//
+// The result is exact for any convex kernel symmetric in both axes
+// (the circle and square brushes).
+template<typename T>
+void dilate(const Image* srcImage,
+            const bool inverted,
+            const int w,
+            const int h,
+            const std::vector<int>& halfWidths,
+            std::vector<T>& area)
+{
+  const int radius = int(halfWidths.size()) - 1;
+  const int far = radius + 1; // Distance of pixels that cannot be reached
+  const gfx::Rect srcBounds(radius, radius, srcImage->width(), srcImage->height());
+
+  // maxDy[d] = maximum |v| of the kernel rows with half width >= d
+  std::vector<int> maxDy(radius + 1, -1);
+  for (int v = 0; v <= radius; ++v)
+    for (int d = 0; d <= halfWidths[v]; ++d)
+      maxDy[d] = v;
+
+  // Horizontal distances
+  area.resize(std::size_t(w) * h);
+  parallel_for_bands(0, h, 32, [&](const int a, const int b) {
+    for (int y = a; y < b; ++y) {
+      const bool insideRow = (y >= srcBounds.y && y < srcBounds.y2());
+      T* d = &area[std::size_t(y) * w];
+      int last = -far;
+      for (int x = 0; x < w; ++x) {
+        const bool selected = (insideRow && x >= srcBounds.x && x < srcBounds.x2() &&
+                               get_pixel_fast<BitmapTraits>(srcImage,
+                                                            x - srcBounds.x,
+                                                            y - srcBounds.y));
+        if (selected != inverted)
+          last = x;
+        d[x] = T(std::min(x - last, far));
+      }
+      last = w - 1 + far;
+      for (int x = w - 1; x >= 0; --x) {
+        if (d[x] == 0)
+          last = x;
+        d[x] = T(std::min<int>(d[x], last - x));
       }
+    }
+  });
 
-      switch (modifier) {
-        case SelectionModifier::Border: {
-          c = (c && accum < total) ? 1 : 0;
-          break;
-        }
-        case SelectionModifier::Expand: {
-          c = (c || accum > 0) ? 1 : 0;
-          break;
-        }
-        case SelectionModifier::Contract: {
-          c = (c && accum == total) ? 1 : 0;
-          break;
+  // Vertical sweep, reach[y] is the last row covered by the intervals
+  // that start at row y.
+  parallel_for_bands(0, w, 32, [&](const int a, const int b) {
+    std::vector<int> reach(h);
+    for (int x = a; x < b; ++x) {
+      std::fill(reach.begin(), reach.end(), -1);
+      for (int y = 0; y < h; ++y) {
+        const int d = area[std::size_t(y) * w + x];
+        if (d < far && maxDy[d] >= 0) {
+          const int dy = maxDy[d];
+          int& r = reach[std::max(0, y - dy)];
+          r = std::max(r, y + dy);
         }
       }
 
-      if (c)
-        doc::put_pixel(dstImage, offset.x + x, offset.y + y, 1);
+      int lastRow = -1;
+      for (int y = 0; y < h; ++y) {
+        T& value = area[std::size_t(y) * w + x];
+        const bool selected = ((value == 0) != inverted);
+        lastRow = std::max(lastRow, reach[y]);
+        value = T((selected ? kSelected : 0) | (lastRow >= y ? kDilated : 0));
+      }
     }
-  }
+  });
+}
+
+template<typename T>
+void modify_selection_templ(const SelectionModifier modifier,
+                            const doc::Image* srcImage,
+                            doc::Image* dstImage,
+                            const gfx::Point& offset,
+                            const std::vector<int>& halfWidths)
+{
+  // Work area: the source bitmap with "radius" pixels around it.
+  const int radius = int(halfWidths.size()) - 1;
+  const int w = srcImage->width() + 2 * radius;
+  const int h = srcImage->height() + 2 * radius;
+
+  // Expand is the dilation of the selection. Contract and Border are
+  // calculated with the dilation of the non-selected pixels (a pixel
+  // is kept in Contract if no non-selected pixel touches it, and in
+  // Border if some non-selected pixel touches it).
+  std::vector<T> area;
+  dilate(srcImage, modifier != SelectionModifier::Expand, w, h, halfWidths, area);
+
+  // Each band of rows writes different rows of the destination bitmap
+  parallel_for_bands(0, h, 64, [&](const int a, const int b) {
+    for (int v = a; v < b; ++v) {
+      const int y = offset.y + v - radius;
+      if (y < 0 || y >= dstImage->height())
+        continue;
+
+      const T* flags = &area[std::size_t(v) * w];
+      for (int u = 0; u < w; ++u) {
+        const bool s = (flags[u] & kSelected) != 0;
+        const bool d = (flags[u] & kDilated) != 0;
+        bool c;
+        switch (modifier) {
+          case SelectionModifier::Border:   c = (s && d); break;
+          case SelectionModifier::Expand:   c = d; break;
+          case SelectionModifier::Contract: c = (s && !d); break;
+          default:                          c = false; break;
+        }
+
+        const int x = offset.x + u - radius;
+        if (c && x >= 0 && x < dstImage->width())
+          put_pixel_fast<BitmapTraits>(dstImage, x, y, 1);
+      }
+    }
+  });
+}
+
+} // anonymous namespace
+
+void modify_selection(const SelectionModifier modifier,
+                      const Mask* srcMask,
+                      Mask* dstMask,
+                      const int radius,
+                      const doc::BrushType brush)
+{
+  const doc::Image* srcImage = srcMask->bitmap();
+  doc::Image* dstImage = dstMask->bitmap();
+  if (!srcImage || !dstImage || radius < 0)
+    return;
+
+  const gfx::Point offset = srcMask->bounds().origin() - dstMask->bounds().origin();
+  const std::vector<int> halfWidths = kernel_half_widths(radius, brush);
+
+  // Distances are clamped to radius+1
+  if (radius < std::numeric_limits<uint16_t>::max())
+    modify_selection_templ<uint16_t>(modifier, srcImage, dstImage, offset, halfWidths);
+  else
+    modify_selection_templ<uint32_t>(modifier, srcImage, dstImage, offset, halfWidths);
 }
 
 }} // namespace doc::algorithm
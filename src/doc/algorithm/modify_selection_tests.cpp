@@ -0,0 +1,138 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/modify_selection.h"
+#include "doc/image.h"
+#include "doc/mask.h"
+#include "doc/mask_test_utils.h"
+#include "doc/primitives.h"
+
+#include <memory>
+#include <random>
+
+using namespace doc;
+using namespace doc::algorithm;
+using namespace gfx;
+
+namespace {
+
+// The original implementation (convolution of the kernel at each
+// pixel) used as reference for the distance transform version.
+void modify_selection_with_kernel(const SelectionModifier modifier,
+                                  const Mask* srcMask,
+                                  Mask* dstMask,
+                                  const int radius,
+                                  const BrushType brush)
+{
+  const Image* srcImage = srcMask->bitmap();
+  Image* dstImage = dstMask->bitmap();
+  const Point offset = srcMask->bounds().origin() - dstMask->bounds().origin();
+  const Rect srcBounds = srcImage->bounds();
+
+  const int size = 2 * radius + 1;
+  std::unique_ptr<Image> kernel(Image::create(IMAGE_BITMAP, size, size));
+  clear_image(kernel.get(), 0);
+  if (brush == kCircleBrushType)
+    fill_ellipse(kernel.get(), 0, 0, size - 1, size - 1, 0, 0, 1);
+  else
+    fill_rect(kernel.get(), 0, 0, size - 1, size - 1, 1);
+  put_pixel(kernel.get(), radius, radius, 0);
+
+  int total = 0;
+  for (int v = 0; v < size; ++v)
+    for (int u = 0; u < size; ++u)
+      total += kernel->getPixel(u, v);
+
+  for (int y = -radius; y < srcBounds.h + radius; ++y) {
+    for (int x = -radius; x < srcBounds.w + radius; ++x) {
+      color_t c = (srcBounds.contains(x, y) ? srcImage->getPixel(x, y) : 0);
+
+      int accum = 0;
+      for (int v = 0; v < size; ++v) {
+        for (int u = 0; u < size; ++u) {
+          if (kernel->getPixel(u, v) && srcBounds.contains(x + u - radius, y + v - radius))
+            accum += srcImage->getPixel(x - radius + u, y - radius + v);
+        }
+      }
+
+      switch (modifier) {
+        case SelectionModifier::Border:   c = (c && accum < total) ? 1 : 0; break;
+        case SelectionModifier::Expand:   c = (c || accum > 0) ? 1 : 0; break;
+        case SelectionModifier::Contract: c = (c && accum == total) ? 1 : 0; break;
+      }
+
+      if (c)
+        put_pixel(dstImage, offset.x + x, offset.y + y, 1);
+    }
+  }
+}
+
+} // anonymous namespace
+
+TEST(ModifySelection, SameResultsAsKernel)
+{
+  std::mt19937 random(1234);
+  const Rect dstBounds(0, 0, 64, 48);
+
+  for (const BrushType brush : { kCircleBrushType, kSquareBrushType }) {
+    for (const SelectionModifier modifier :
+         { SelectionModifier::Border, SelectionModifier::Expand, SelectionModifier::Contract }) {
+      for (int radius = 0; radius <= 7; ++radius) {
+        Mask src;
+        random_mask(src, Rect(5 + radius, 3, 37, 29), random, 0.3);
+
+        Mask expected, actual;
+        expected.reserve(dstBounds);
+        actual.reserve(dstBounds);
+        modify_selection_with_kernel(modifier, &src, &expected, radius, brush);
+        modify_selection(modifier, &src, &actual, radius, brush);
+
+        EXPECT_TRUE(cmp_masks(expected, actual))
+          << "brush=" << int(brush) << " modifier=" << int(modifier) << " radius=" << radius;
+      }
+    }
+  }
+}
+
+TEST(ModifySelection, ClippedToDestination)
+{
+  // The source selection touches the destination edges
+  std::mt19937 random(5678);
+  const Rect dstBounds(0, 0, 20, 20);
+
+  for (const SelectionModifier modifier :
+       { SelectionModifier::Border, SelectionModifier::Expand, SelectionModifier::Contract }) {
+    Mask src;
+    random_mask(src, Rect(-3, 2, 30, 10), random, 0.3);
+
+    Mask expected, actual;
+    expected.reserve(dstBounds);
+    actual.reserve(dstBounds);
+    modify_selection_with_kernel(modifier, &src, &expected, 4, kCircleBrushType);
+    modify_selection(modifier, &src, &actual, 4, kCircleBrushType);
+
+    EXPECT_TRUE(cmp_masks(expected, actual)) << "modifier=" << int(modifier);
+  }
+}
+
+TEST(ModifySelection, LargeRadius)
+{
+  // A big square selection contracted with a big radius
+  Mask src;
+  src.replace(Rect(0, 0, 300, 200));
+
+  Mask dst;
+  dst.reserve(Rect(-200, -200, 700, 600));
+  modify_selection(SelectionModifier::Contract, &src, &dst, 90, kSquareBrushType);
+
+  const Image* bitmap = dst.bitmap();
+  EXPECT_EQ(0, bitmap->getPixel(200 + 89, 200 + 89));
+  EXPECT_EQ(1, bitmap->getPixel(200 + 90, 200 + 90));
+  EXPECT_EQ(1, bitmap->getPixel(200 + 209, 200 + 109));
+  EXPECT_EQ(0, bitmap->getPixel(200 + 210, 200 + 109));
+}
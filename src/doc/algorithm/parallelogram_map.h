@@ -0,0 +1,164 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_ALGORITHM_PARALLELOGRAM_MAP_H_INCLUDED
+#define DOC_ALGORITHM_PARALLELOGRAM_MAP_H_INCLUDED
+#pragma once
+
+#include "gfx/rect.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace doc { namespace algorithm {
+
+// Inverse affine mapping from destination pixels to source image
+// coordinates for a sprite of srcW x srcH pixels mapped to the
+// parallelogram formed by the given corners:
+//
+//    1-----2
+//    |     |
+//    4-----3
+//
+// Corners are the outer corners of the source corner pixels (the
+// source point (0, 0) is mapped to corner 1, (srcW, 0) to corner 2,
+// and (0, srcH) to corner 4). A destination pixel (x, y) is sampled
+// at its center (x+0.5, y+0.5), and it's covered by the sprite if
+// its source coordinates are inside [0, srcW) x [0, srcH).
+//
+// The mapping is precalculated so each row is a linear function of
+// x (u = row.u + x*dux(), v = row.v + x*dvx()) and rows can be
+// processed independently (e.g. from different threads).
+class ParallelogramMap {
+public:
+  struct Row {
+    double u, v;
+  };
+
+  ParallelogramMap(const double srcW,
+                   const double srcH,
+                   const double x1,
+                   const double y1,
+                   const double x2,
+                   const double y2,
+                   const double x4,
+                   const double y4)
+    : m_srcW(srcW)
+    , m_srcH(srcH)
+  {
+    const double e1x = x2 - x1, e1y = y2 - y1;
+    const double e2x = x4 - x1, e2y = y4 - y1;
+    const double det = e1x * e2y - e1y * e2x;
+
+    m_valid = (srcW > 0.0 && srcH > 0.0 && det != 0.0 && std::isfinite(det));
+    if (!m_valid)
+      return;
+
+    m_dux = srcW * e2y / det;
+    m_duy = -srcW * e2x / det;
+    m_dvx = -srcH * e1y / det;
+    m_dvy = srcH * e1x / det;
+
+    const double cx = 0.5 - x1;
+    const double cy = 0.5 - y1;
+    m_u0 = cx * m_dux + cy * m_duy;
+    m_v0 = cx * m_dvx + cy * m_dvy;
+
+    // Bounding box of the parallelogram (x3 = x2 + x4 - x1)
+    const double x3 = x2 + x4 - x1;
+    const double y3 = y2 + y4 - y1;
+    const double xmin = std::min({ x1, x2, x3, x4 });
+    const double ymin = std::min({ y1, y2, y3, y4 });
+    const double xmax = std::max({ x1, x2, x3, x4 });
+    const double ymax = std::max({ y1, y2, y3, y4 });
+    m_bounds = gfx::Rect(int(std::floor(xmin)),
+                         int(std::floor(ymin)),
+                         int(std::ceil(xmax) - std::floor(xmin)),
+                         int(std::ceil(ymax) - std::floor(ymin)));
+  }
+
+  bool isValid() const { return m_valid; }
+
+  // Destination area that can be touched by the sprite.
+  const gfx::Rect& bounds() const { return m_bounds; }
+
+  double dux() const { return m_dux; }
+  double dvx() const { return m_dvx; }
+
+  Row row(const int y) const { return Row{ m_u0 + y * m_duy, m_v0 + y * m_dvy }; }
+
+  double u(const Row& row, const int x) const { return row.u + x * m_dux; }
+  double v(const Row& row, const int x) const { return row.v + x * m_dvx; }
+
+  bool contains(const Row& row, const int x, const gfx::Rect& srcRc) const
+  {
+    const double uu = u(row, x);
+    const double vv = v(row, x);
+    return (uu >= srcRc.x && uu < srcRc.x2() && vv >= srcRc.y && vv < srcRc.y2());
+  }
+
+  // Calculates the range [x1, x2) of pixels in the given row (and
+  // inside [clipX1, clipX2)) whose source coordinates are inside
+  // the given source rectangle. Returns false if there is no pixel.
+  //
+  // The result matches exactly the contains() predicate, so two
+  // adjacent source rectangles produce disjoint ranges.
+  bool span(const Row& row,
+            const gfx::Rect& srcRc,
+            const int clipX1,
+            const int clipX2,
+            int& x1,
+            int& x2) const
+  {
+    double lo = clipX1;
+    double hi = clipX2;
+    if (!clipAxis(row.u, m_dux, srcRc.x, srcRc.x2(), lo, hi) ||
+        !clipAxis(row.v, m_dvx, srcRc.y, srcRc.y2(), lo, hi))
+      return false;
+
+    // The analytic range can be one pixel bigger/smaller because of
+    // floating point errors, so we start from a conservative range
+    // and adjust it with the exact predicate.
+    x1 = std::clamp(int(std::floor(lo)) - 1, clipX1, clipX2);
+    x2 = std::clamp(int(std::ceil(hi)) + 1, clipX1, clipX2);
+    while (x1 < x2 && !contains(row, x1, srcRc))
+      ++x1;
+    while (x2 > x1 && !contains(row, x2 - 1, srcRc))
+      --x2;
+    return (x1 < x2);
+  }
+
+private:
+  static bool clipAxis(const double a,
+                       const double da,
+                       const double minValue,
+                       const double maxValue,
+                       double& lo,
+                       double& hi)
+  {
+    if (da == 0.0)
+      return (a >= minValue && a < maxValue);
+
+    double t1 = (minValue - a) / da;
+    double t2 = (maxValue - a) / da;
+    if (t1 > t2)
+      std::swap(t1, t2);
+    lo = std::max(lo, t1);
+    hi = std::min(hi, t2);
+    return (lo <= hi);
+  }
+
+  double m_srcW, m_srcH;
+  double m_u0 = 0.0, m_v0 = 0.0;
+  double m_dux = 0.0, m_duy = 0.0;
+  double m_dvx = 0.0, m_dvy = 0.0;
+  gfx::Rect m_bounds;
+  bool m_valid;
+};
+
+}} // namespace doc::algorithm
+
+#endif
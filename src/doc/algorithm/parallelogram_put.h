@@ -0,0 +1,83 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_ALGORITHM_PARALLELOGRAM_PUT_H_INCLUDED
+#define DOC_ALGORITHM_PARALLELOGRAM_PUT_H_INCLUDED
+#pragma once
+
+#include "doc/blend_funcs.h"
+#include "doc/color.h"
+#include "doc/image.h"
+#include "doc/image_traits.h"
+#include "doc/primitives_fast.h"
+
+namespace doc { namespace algorithm {
+
+// Functions to put a transformed source pixel in the destination
+// image (used by parallelogram() and RotSprite). Source pixels with
+// the mask color are skipped, and RGB/Grayscale pixels are blended
+// with the destination.
+
+class RgbPut {
+public:
+  RgbPut(color_t maskColor) : m_maskColor(maskColor) {}
+  void operator()(Image* dst, int x, int y, color_t c) const
+  {
+    if ((rgba_geta(m_maskColor) == 0) || ((c & rgba_rgb_mask) != (m_maskColor & rgba_rgb_mask))) {
+      put_pixel_fast<RgbTraits>(dst,
+                                x,
+                                y,
+                                rgba_blender_normal(get_pixel_fast<RgbTraits>(dst, x, y), c));
+    }
+  }
+
+private:
+  color_t m_maskColor;
+};
+
+class GrayscalePut {
+public:
+  GrayscalePut(color_t maskColor) : m_maskColor(maskColor) {}
+  void operator()(Image* dst, int x, int y, color_t c) const
+  {
+    if ((graya_geta(m_maskColor) == 0) || ((c & graya_v_mask) != (m_maskColor & graya_v_mask))) {
+      put_pixel_fast<GrayscaleTraits>(
+        dst,
+        x,
+        y,
+        graya_blender_normal(get_pixel_fast<GrayscaleTraits>(dst, x, y), c, 255));
+    }
+  }
+
+private:
+  color_t m_maskColor;
+};
+
+class IndexedPut {
+public:
+  IndexedPut(color_t maskColor) : m_maskColor(maskColor) {}
+  void operator()(Image* dst, int x, int y, color_t c) const
+  {
+    if (c != m_maskColor)
+      put_pixel_fast<IndexedTraits>(dst, x, y, c);
+  }
+
+private:
+  color_t m_maskColor;
+};
+
+class BitmapPut {
+public:
+  void operator()(Image* dst, int x, int y, color_t c) const
+  {
+    if (c != 0)
+      put_pixel_fast<BitmapTraits>(dst, x, y, c);
+  }
+};
+
+}} // namespace doc::algorithm
+
+#endif
@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -13,6 +14,14 @@ class Image;
 
 namespace algorithm {
 
+// Sampling method used to rotate/scale images. Bilinear is only
+// available for RGB and Grayscale images (Indexed and Bitmap images
+// always use the nearest neighbor).
+enum class Interpolation {
+  NearestNeighbor,
+  Bilinear,
+};
+
 void scale_image(Image* dst,
                  const Image* src,
                  int dst_x,
@@ -32,7 +41,8 @@ void rotate_image(Image* dst,
                   int h,
                   int cx,
                   int cy,
-                  double angle);
+                  double angle,
+                  Interpolation interpolation = Interpolation::NearestNeighbor);
 
 void parallelogram(Image* dst,
                    const Image* src,
@@ -44,7 +54,8 @@ void parallelogram(Image* dst,
                    int x3,
                    int y3,
                    int x4,
-                   int y4);
+                   int y4,
+                   Interpolation interpolation = Interpolation::NearestNeighbor);
 
 } // namespace algorithm
 } // namespace doc
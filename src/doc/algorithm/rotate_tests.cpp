@@ -0,0 +1,89 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/rotate.h"
+
+#include "doc/algorithm/random_image.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+
+using namespace doc;
+using namespace doc::algorithm;
+using namespace gfx;
+
+TEST(Parallelogram, Identity)
+{
+  for (auto pf : { IMAGE_INDEXED, IMAGE_BITMAP }) {
+    for (const Size size : { Size(1, 1), Size(5, 9), Size(300, 200) }) {
+      ImageRef src(Image::create(pf, size.w, size.h));
+      ImageRef dst(Image::create(pf, size.w, size.h));
+      random_image(src.get());
+      src->setMaskColor(-1); // Copy all pixels
+      dst->clear(0);
+
+      parallelogram(dst.get(), src.get(), nullptr, 0, 0, size.w, 0, size.w, size.h, 0, size.h);
+
+      EXPECT_TRUE(is_same_image(src.get(), dst.get()))
+        << "Pixel format=" << pf << " Size=" << size.w << "x" << size.h;
+    }
+  }
+}
+
+TEST(Parallelogram, Rotate90)
+{
+  for (auto pf : { IMAGE_INDEXED, IMAGE_BITMAP }) {
+    const int w = 37, h = 300;
+    ImageRef src(Image::create(pf, w, h));
+    ImageRef dst(Image::create(pf, h, w));
+    ImageRef expected(Image::create(pf, h, w));
+    random_image(src.get());
+    src->setMaskColor(-1);
+    dst->clear(0);
+
+    doc::rotate_image(src.get(), expected.get(), 90);
+    parallelogram(dst.get(), src.get(), nullptr, h, 0, h, w, 0, w, 0, 0);
+
+    EXPECT_TRUE(is_same_image(expected.get(), dst.get())) << "Pixel format=" << pf;
+  }
+}
+
+TEST(Parallelogram, BilinearPlainImage)
+{
+  ImageRef src(Image::create(IMAGE_RGB, 64, 64));
+  ImageRef dst(Image::create(IMAGE_RGB, 200, 200));
+  const color_t c = rgba(10, 200, 30, 255);
+  src->clear(c);
+  dst->clear(0);
+
+  parallelogram(dst.get(),
+                src.get(),
+                nullptr,
+                100,
+                0,
+                200,
+                100,
+                100,
+                200,
+                0,
+                100,
+                Interpolation::Bilinear);
+
+  // The center of the rotated image must be the same color, and the
+  // corners must be untouched.
+  EXPECT_EQ(c, get_pixel(dst.get(), 100, 100));
+  EXPECT_EQ(c, get_pixel(dst.get(), 60, 100));
+  EXPECT_EQ(0, get_pixel(dst.get(), 0, 0));
+  EXPECT_EQ(0, get_pixel(dst.get(), 199, 199));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020-2023  Igara Studio S.A.
+// Copyright (c) 2020-2024  Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,162 +9,344 @@
   #include "config.h"
 #endif
 
-#include "doc/algorithm/rotate.h"
+#include "doc/algorithm/rotsprite.h"
+
+#include "doc/algorithm/parallelogram_map.h"
+#include "doc/algorithm/parallelogram_put.h"
 #include "doc/image_impl.h"
+#include "doc/parallel_for.h"
 #include "doc/primitives.h"
+#include "doc/primitives_fast.h"
 
 #include <algorithm>
-#include <memory>
+#include <vector>
 
 namespace doc { namespace algorithm {
 
+namespace {
+
+// Size of each tile in source pixels (8x tiles are 256x256 pixels
+// plus a small border)
+constexpr int kTileSize = 32;
+constexpr int kTileShift = 5;
+static_assert((1 << kTileShift) == kTileSize);
+
+// Scale factor of the RotSprite algorithm (3 Scale2x passes)
+constexpr int kScale = 8;
+constexpr int kScaleShift = 3;
+
+// Destination pixels are processed in blocks of this size, so each
+// block touches a small number of 8x tiles.
+constexpr int kBlockSize = 64;
+
+// Minimum number of destination pixels to process in each thread.
+constexpr int kMinPixelsPerThread = 128 * 128;
+
 // More information about EPX/Scale2x:
 // http://en.wikipedia.org/wiki/Pixel_art_scaling_algorithms#EPX.2FScale2.C3.97.2FAdvMAME2.C3.97
 // http://scale2x.sourceforge.net/algorithm.html
 // http://scale2x.sourceforge.net/scale2xandepx.html
+//
+// Scales the "srcRc" area of a full image of "size" dimensions
+// (where "src" contains only the "srcRc" area). Pixels outside the
+// full image are replaced with the center pixel (as the original
+// Scale2x), but we cannot scale pixels in the border of "srcRc"
+// that are not in the border of the full image (we don't know its
+// neighbors), so the returned "dstRc" area is a little smaller.
 template<typename ImageTraits>
-static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h)
+ImageRef scale2x_area(const Image* src,
+                      const gfx::Rect& srcRc,
+                      const gfx::Size& size,
+                      gfx::Rect& dstRc)
 {
-#if 0 // TODO complete this implementation that should be faster
-      // than using a lot of get/put_pixel_fast calls.
-  int dst_w = src_w*2;
-  int dst_h = src_h*2;
-
-  LockImageBits<ImageTraits> dstBits(dst, Image::WriteLock, gfx::Rect(0, 0, dst_w, dst_h));
-  const LockImageBits<ImageTraits> srcBits(src);
-
-  LockImageBits<ImageTraits>::iterator dstRow0_it = dstBits.begin();
-  LockImageBits<ImageTraits>::iterator dstRow1_it = dstBits.begin();
-  LockImageBits<ImageTraits>::iterator dstRow0_end = dstBits.end();
-  LockImageBits<ImageTraits>::iterator dstRow1_end = dstBits.end();
-
-  // Iterators:
-  //   A
-  // C P B
-  //   D
-  //
-  // These iterators are displaced through src image and are modified in this way:
-  //
-  // P: is the simplest one, we just start from (0, 0) to srcEnd.
-  // A: starts from row 0 (so A = P in the first row), then we start
-  //    again from the row 0.
-  // B: It starts from (1, row) and in the last pixel we don't moved it.
-  // C: It starts from (0, 0) and then it is moved with a delay.
-  // D: It starts from row 1 and continues until we reach the last
-  //    row, in that case we start D iterator again.
-  //
-  LockImageBits<ImageTraits>::const_iterator itP, itA, itB, itC, itD, savedD;
-  LockImageBits<ImageTraits>::const_iterator srcEnd = srcBits.end();
-  color_t P, A, B, C, D;
-
-  // Adjust iterators
-  itP = itA = itB = itC = itD = savedD = srcBits.begin();
-  dstRow1_it += dst_w;
-  itD += src->width();
-
-  for (int y=0; y<src_h; ++y) {
-    if (y == 1) itA = srcBits.begin();
-    if (y == src_h-2) savedD = itD;
-    if (y == src_h-1) itD = savedD;
-    ++itB;
-
-    for (int x=0; x<src_w; ++x) {
-      ASSERT(itP != srcEnd);
-      ASSERT(itA != srcEnd);
-      ASSERT(itB != srcEnd);
-      ASSERT(itC != srcEnd);
-      ASSERT(itD != srcEnd);
-      ASSERT(dstRow0_it != dstRow0_end);
-      ASSERT(dstRow1_it != dstRow1_end);
-
-      P = *itP;
-      A = *itA;                 // y-1
-      B = *itB;                 // x+1
-      C = *itC;                 // x-1
-      D = *itD;                 // y+1
-
-      *dstRow0_it = (C == A && C != D && A != B ? A: P);
-      ++dstRow0_it;
-      *dstRow0_it = (A == B && A != C && B != D ? B: P);
-      ++dstRow0_it;
-
-      *dstRow1_it = (D == C && D != B && C != A ? C: P);
-      ++dstRow1_it;
-      *dstRow1_it = (B == D && B != A && D != C ? D: P);
-      ++dstRow1_it;
-
-      ++itP;
-      ++itA;
-      if (x < src_w-2) ++itB;
-      if (x > 0) ++itC;
-      ++itD;
+  gfx::Rect inner = srcRc;
+  if (inner.x > 0) {
+    ++inner.x;
+    --inner.w;
+  }
+  if (inner.y > 0) {
+    ++inner.y;
+    --inner.h;
+  }
+  if (inner.x2() < size.w)
+    --inner.w;
+  if (inner.y2() < size.h)
+    --inner.h;
+
+  dstRc = gfx::Rect(inner.x * 2, inner.y * 2, inner.w * 2, inner.h * 2);
+  if (dstRc.isEmpty())
+    return nullptr;
+
+  ImageRef dst(Image::create(src->pixelFormat(), dstRc.w, dstRc.h));
+
+  using pixel_t = typename ImageTraits::pixel_t;
+  pixel_t A, B, C, D, P;
+
+  for (int y = inner.y; y < inner.y2(); ++y) {
+    const int sy = y - srcRc.y;
+    const int dy = 2 * (y - inner.y);
+    for (int x = inner.x; x < inner.x2(); ++x) {
+      const int sx = x - srcRc.x;
+      const int dx = 2 * (x - inner.x);
+
+      P = get_pixel_fast<ImageTraits>(src, sx, sy);
+      A = (y > 0 ? get_pixel_fast<ImageTraits>(src, sx, sy - 1) : P);
+      B = (x < size.w - 1 ? get_pixel_fast<ImageTraits>(src, sx + 1, sy) : P);
+      C = (x > 0 ? get_pixel_fast<ImageTraits>(src, sx - 1, sy) : P);
+      D = (y < size.h - 1 ? get_pixel_fast<ImageTraits>(src, sx, sy + 1) : P);
+
+      put_pixel_fast<ImageTraits>(dst.get(), dx, dy, (C == A && C != D && A != B ? A : P));
+      put_pixel_fast<ImageTraits>(dst.get(), dx + 1, dy, (A == B && A != C && B != D ? B : P));
+      put_pixel_fast<ImageTraits>(dst.get(), dx, dy + 1, (D == C && D != B && C != A ? C : P));
+      put_pixel_fast<ImageTraits>(dst.get(), dx + 1, dy + 1, (B == D && B != A && D != C ? D : P));
     }
+  }
 
-    // Adjust iterators for the next two rows.
-    ++itB;
-    ++itC;
-    dstRow0_it += dst_w;
-    if (y < src_h-1)
-      dstRow1_it += dst_w;
+  return dst;
+}
+
+// Creates the 8x version of the "tileBounds" area of "spr".
+template<typename ImageTraits>
+RotSprite::Tile create_tile_tpl(const Image* spr, const gfx::Rect& tileBounds)
+{
+  // We need 2 extra pixels around the tile to calculate the
+  // 3 Scale2x passes.
+  gfx::Rect rc = tileBounds;
+  rc.enlarge(2);
+  rc &= spr->bounds();
+
+  ImageRef img(Image::create(spr->pixelFormat(), rc.w, rc.h));
+  img->copy(spr, gfx::Clip(0, 0, rc));
+
+  gfx::Size size = spr->size();
+  for (int i = 0; i < kScaleShift; ++i) {
+    gfx::Rect scaledRc;
+    img = scale2x_area<ImageTraits>(img.get(), rc, size, scaledRc);
+    rc = scaledRc;
+    size.w *= 2;
+    size.h *= 2;
+  }
+
+  ASSERT(rc.contains(gfx::Rect(tileBounds.x * kScale,
+                               tileBounds.y * kScale,
+                               tileBounds.w * kScale,
+                               tileBounds.h * kScale)));
+  return RotSprite::Tile{ img, rc };
+}
+
+RotSprite::Tile create_tile(const Image* spr, const gfx::Rect& tileBounds)
+{
+  switch (spr->pixelFormat()) {
+    case IMAGE_RGB:       return create_tile_tpl<RgbTraits>(spr, tileBounds);
+    case IMAGE_GRAYSCALE: return create_tile_tpl<GrayscaleTraits>(spr, tileBounds);
+    case IMAGE_INDEXED:   return create_tile_tpl<IndexedTraits>(spr, tileBounds);
+    case IMAGE_BITMAP:    return create_tile_tpl<BitmapTraits>(spr, tileBounds);
   }
+  return RotSprite::Tile();
+}
 
-  // ASSERT(itP == srcEnd);
-  // ASSERT(itA == srcEnd);
-  // ASSERT(itB == srcEnd);
-  // ASSERT(itC == srcEnd);
-  // ASSERT(itD == srcEnd);
-  ASSERT(dstRow0_it == dstRow0_end);
-  ASSERT(dstRow1_it == dstRow1_end);
-#else
-
-  #define A c[0]
-  #define B c[1]
-  #define C c[2]
-  #define D c[3]
-  #define P c[4]
-
-  LockImageBits<ImageTraits> dstBits(dst, gfx::Rect(0, 0, src_w * 2, src_h * 2));
-  auto dstIt = dstBits.begin();
-  auto dstIt2 = dstIt;
-
-  color_t c[5];
-  for (int y = 0; y < src_h; ++y) {
-    dstIt2 += src_w * 2;
-    for (int x = 0; x < src_w; ++x) {
-      P = get_pixel_fast<ImageTraits>(src, x, y);
-      A = (y > 0 ? get_pixel_fast<ImageTraits>(src, x, y - 1) : P);
-      B = (x < src_w - 1 ? get_pixel_fast<ImageTraits>(src, x + 1, y) : P);
-      C = (x > 0 ? get_pixel_fast<ImageTraits>(src, x - 1, y) : P);
-      D = (y < src_h - 1 ? get_pixel_fast<ImageTraits>(src, x, y + 1) : P);
-
-      *dstIt = (C == A && C != D && A != B ? A : P);
-      ++dstIt;
-      *dstIt = (A == B && A != C && B != D ? B : P);
-      ++dstIt;
-
-      *dstIt2 = (D == C && D != B && C != A ? C : P);
-      ++dstIt2;
-      *dstIt2 = (B == D && B != A && D != C ? D : P);
-      ++dstIt2;
+// Tiles used by one destination block, so we don't need to lock the
+// RotSprite cache for each pixel.
+class BlockTiles {
+public:
+  BlockTiles(RotSprite& rotsprite, const Image* spr) : m_rotsprite(rotsprite), m_spr(spr) {}
+
+  const RotSprite::Tile* get(int srcX, int srcY)
+  {
+    const int tx = srcX >> kTileShift;
+    const int ty = srcY >> kTileShift;
+    if (m_last && m_lastX == tx && m_lastY == ty)
+      return m_last;
+
+    for (const auto& item : m_tiles) {
+      if (item.x == tx && item.y == ty)
+        return setLast(item);
     }
-    dstIt += src_w * 2;
+
+    m_tiles.push_back(Item{ tx, ty, m_rotsprite.getTile(m_spr, srcX, srcY) });
+    return setLast(m_tiles.back());
   }
 
-#endif
+  void clear()
+  {
+    m_tiles.clear();
+    m_last = nullptr;
+  }
+
+private:
+  struct Item {
+    int x, y;
+    RotSprite::TileRef tile;
+  };
+
+  const RotSprite::Tile* setLast(const Item& item)
+  {
+    m_lastX = item.x;
+    m_lastY = item.y;
+    m_last = item.tile.get();
+    return m_last;
+  }
+
+  RotSprite& m_rotsprite;
+  const Image* m_spr;
+  std::vector<Item> m_tiles;
+  const RotSprite::Tile* m_last = nullptr;
+  int m_lastX = 0, m_lastY = 0;
+};
+
+template<typename ImageTraits, typename Put>
+void draw_tpl(RotSprite& rotsprite,
+              Image* dst,
+              const Image* spr,
+              const Image* mask,
+              const ParallelogramMap& map,
+              const gfx::Rect& area,
+              const Put& put)
+{
+  const gfx::Rect sprBounds = spr->bounds();
+  const gfx::Rect maskBounds = (mask ? mask->bounds() : sprBounds);
+  const int blockRows = (area.h + kBlockSize - 1) / kBlockSize;
+  const int minBlockRows = std::max(1, kMinPixelsPerThread / (kBlockSize * area.w));
+
+  parallel_for_bands(0, blockRows, minBlockRows, [&](const int b1, const int b2) {
+    BlockTiles tiles(rotsprite, spr);
+
+    for (int by = area.y + b1 * kBlockSize; by < std::min(area.y2(), area.y + b2 * kBlockSize);
+         by += kBlockSize) {
+      const int by2 = std::min(area.y2(), by + kBlockSize);
+
+      for (int bx = area.x; bx < area.x2(); bx += kBlockSize) {
+        const int bx2 = std::min(area.x2(), bx + kBlockSize);
+
+        for (int y = by; y < by2; ++y) {
+          const ParallelogramMap::Row row = map.row(y);
+          int x1, x2;
+          if (!map.span(row, sprBounds, bx, bx2, x1, x2))
+            continue;
+
+          for (int x = x1; x < x2; ++x) {
+            const double u = map.u(row, x);
+            const double v = map.v(row, x);
+            const int su = int(u);
+            const int sv = int(v);
+
+            if (mask && (!maskBounds.contains(su, sv) ||
+                         !get_pixel_fast<BitmapTraits>(mask, su, sv)))
+              continue;
+
+            const RotSprite::Tile* tile = tiles.get(su, sv);
+            const int tu = std::clamp(int(u * kScale), su * kScale, su * kScale + kScale - 1);
+            const int tv = std::clamp(int(v * kScale), sv * kScale, sv * kScale + kScale - 1);
+
+            put(dst,
+                x,
+                y,
+                get_pixel_fast<ImageTraits>(tile->image.get(),
+                                            tu - tile->bounds.x,
+                                            tv - tile->bounds.y));
+          }
+        }
+
+        // Release the tiles of this block (they are still in the
+        // RotSprite cache if there is enough memory).
+        tiles.clear();
+      }
+    }
+  });
 }
 
-static void image_scale2x(Image* dst, const Image* src, int src_w, int src_h)
+} // anonymous namespace
+
+RotSprite::RotSprite(std::size_t maxCacheSize) : m_maxCacheSize(maxCacheSize)
 {
-  switch (src->pixelFormat()) {
-    case IMAGE_RGB:       image_scale2x_tpl<RgbTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_GRAYSCALE: image_scale2x_tpl<GrayscaleTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_INDEXED:   image_scale2x_tpl<IndexedTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_BITMAP:    image_scale2x_tpl<BitmapTraits>(dst, src, src_w, src_h); break;
+}
+
+RotSprite::~RotSprite()
+{
+}
+
+void RotSprite::invalidate()
+{
+  const std::lock_guard lock(m_mutex);
+  m_tiles.clear();
+  m_lru.clear();
+  m_cacheSize = 0;
+}
+
+std::size_t RotSprite::cacheSize() const
+{
+  const std::lock_guard lock(m_mutex);
+  return m_cacheSize;
+}
+
+void RotSprite::setSource(const Image* src)
+{
+  if (m_src != src || m_srcBounds != src->bounds() || m_srcFormat != int(src->pixelFormat())) {
+    invalidate();
+    m_src = src;
+    m_srcBounds = src->bounds();
+    m_srcFormat = int(src->pixelFormat());
   }
 }
 
-void rotsprite_image(Image* bmp,
-                     const Image* spr,
+RotSprite::TileRef RotSprite::getTile(const Image* src, int srcX, int srcY)
+{
+  ASSERT(src == m_src);
+
+  const int tx = srcX >> kTileShift;
+  const int ty = srcY >> kTileShift;
+  const int tilesPerRow = (src->width() + kTileSize - 1) / kTileSize;
+  const Key key = ty * tilesPerRow + tx;
+
+  {
+    const std::lock_guard lock(m_mutex);
+    auto it = m_tiles.find(key);
+    if (it != m_tiles.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+      return it->second.tile;
+    }
+  }
+
+  // Generate the tile without locking the cache (other threads can
+  // generate other tiles at the same time).
+  auto tile = std::make_shared<Tile>(
+    create_tile(src,
+                gfx::Rect(tx * kTileSize, ty * kTileSize, kTileSize, kTileSize) & src->bounds()));
+  const std::size_t size = std::size_t(tile->image->rowBytes()) * tile->image->height();
+
+  const std::lock_guard lock(m_mutex);
+  auto it = m_tiles.find(key);
+  if (it != m_tiles.end()) // Generated by other thread
+    return it->second.tile;
+
+  m_lru.push_front(key);
+  m_tiles[key] = Entry{ tile, size, m_lru.begin() };
+  m_cacheSize += size;
+  shrinkCache();
+  return tile;
+}
+
+void RotSprite::shrinkCache()
+{
+  // Tiles that are being used by a draw() call are kept alive by
+  // their TileRef until the block is finished.
+  while (m_cacheSize > m_maxCacheSize && m_lru.size() > 1) {
+    const Key key = m_lru.back();
+    m_lru.pop_back();
+
+    auto it = m_tiles.find(key);
+    ASSERT(it != m_tiles.end());
+    m_cacheSize -= it->second.size;
+    m_tiles.erase(it);
+  }
+}
+
+/*    1-----2
+      |     |
+      4-----3
+ */
+void RotSprite::draw(Image* dst,
+                     const Image* src,
                      const Image* mask,
                      int x1,
                      int y1,
@@ -175,86 +357,50 @@ void rotsprite_image(Image* bmp,
                      int x4,
                      int y4)
 {
-  static ImageBufferPtr buf[3]; // TODO non-thread safe
-
-  for (int i = 0; i < 3; ++i)
-    if (!buf[i])
-      buf[i].reset(new ImageBuffer(1));
-
-  int xmin = std::min(x1, std::min(x2, std::min(x3, x4)));
-  int xmax = std::max(x1, std::max(x2, std::max(x3, x4)));
-  int ymin = std::min(y1, std::min(y2, std::min(y3, y4)));
-  int ymax = std::max(y1, std::max(y2, std::max(y3, y4)));
-  int rot_width = xmax - xmin;
-  int rot_height = ymax - ymin;
-
-  if (rot_width == 0 || rot_height == 0)
+  if (src->width() == 0 || src->height() == 0)
     return;
 
-  int scale = 8;
-  std::unique_ptr<Image> bmp_copy(
-    Image::create(bmp->pixelFormat(), rot_width * scale, rot_height * scale, buf[0]));
-  std::unique_ptr<Image> tmp_copy(
-    Image::create(spr->pixelFormat(), spr->width() * scale, spr->height() * scale, buf[1]));
-  std::unique_ptr<Image> spr_copy(
-    Image::create(spr->pixelFormat(), spr->width() * scale, spr->height() * scale, buf[2]));
-  std::unique_ptr<Image> msk_copy;
-
-  color_t maskColor = spr->maskColor();
-
-  bmp_copy->setMaskColor(maskColor);
-  tmp_copy->setMaskColor(maskColor);
-  spr_copy->setMaskColor(maskColor);
+  const ParallelogramMap map(src->width(), src->height(), x1, y1, x2, y2, x4, y4);
+  if (!map.isValid())
+    return;
 
-  spr_copy->clear(maskColor);
-  spr_copy->copy(spr, gfx::Clip(spr->bounds()));
+  const gfx::Rect area = map.bounds() & dst->bounds();
+  if (area.isEmpty())
+    return;
 
-  for (int i = 0; i < 3; ++i) {
-    // clear_image(tmp_copy, maskColor);
-    image_scale2x(tmp_copy.get(), spr_copy.get(), spr->width() * (1 << i), spr->height() * (1 << i));
-    spr_copy->copy(tmp_copy.get(), gfx::Clip(tmp_copy->bounds()));
-  }
+  setSource(src);
 
-  if (mask) {
-    // Same ImageBuffer than tmp_copy
-    msk_copy.reset(
-      Image::create(IMAGE_BITMAP, mask->width() * scale, mask->height() * scale, buf[1]));
-    clear_image(msk_copy.get(), 0);
-    scale_image(msk_copy.get(),
-                mask,
-                0,
-                0,
-                msk_copy->width(),
-                msk_copy->height(),
-                0,
-                0,
-                mask->width(),
-                mask->height());
+  const color_t maskColor = src->maskColor();
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB:
+      draw_tpl<RgbTraits>(*this, dst, src, mask, map, area, RgbPut(maskColor));
+      break;
+    case IMAGE_GRAYSCALE:
+      draw_tpl<GrayscaleTraits>(*this, dst, src, mask, map, area, GrayscalePut(maskColor));
+      break;
+    case IMAGE_INDEXED:
+      draw_tpl<IndexedTraits>(*this, dst, src, mask, map, area, IndexedPut(maskColor));
+      break;
+    case IMAGE_BITMAP:
+      draw_tpl<BitmapTraits>(*this, dst, src, mask, map, area, BitmapPut());
+      break;
   }
+}
 
-  clear_image(bmp_copy.get(), maskColor);
-  parallelogram(bmp_copy.get(),
-                spr_copy.get(),
-                msk_copy.get(),
-                (x1 - xmin) * scale,
-                (y1 - ymin) * scale,
-                (x2 - xmin) * scale,
-                (y2 - ymin) * scale,
-                (x3 - xmin) * scale,
-                (y3 - ymin) * scale,
-                (x4 - xmin) * scale,
-                (y4 - ymin) * scale);
-
-  scale_image(bmp,
-              bmp_copy.get(),
-              std::max(0, xmin),
-              std::max(0, ymin),
-              std::clamp(rot_width, 0, std::max(0, bmp->width() - std::max(0, xmin))),
-              std::clamp(rot_height, 0, std::max(0, bmp->height() - std::max(0, ymin))),
-              0,
-              0,
-              bmp_copy->width(),
-              bmp_copy->height());
+void rotsprite_image(Image* bmp,
+                     const Image* spr,
+                     const Image* mask,
+                     int x1,
+                     int y1,
+                     int x2,
+                     int y2,
+                     int x3,
+                     int y3,
+                     int x4,
+                     int y4)
+{
+  RotSprite rotsprite;
+  rotsprite.draw(bmp, spr, mask, x1, y1, x2, y2, x3, y3, x4, y4);
 }
 
 }} // namespace doc::algorithm
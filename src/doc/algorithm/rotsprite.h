@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -8,11 +9,95 @@
 #define DOC_ALGORITHM_ROTSPRITE_H_INCLUDED
 #pragma once
 
+#include "doc/image_ref.h"
+#include "gfx/rect.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 namespace doc {
 class Image;
 
 namespace algorithm {
 
+// RotSprite engine. The source image is scaled 8x with three
+// Scale2x passes, but the 8x image is never created completely:
+// it's generated in small tiles (on demand) that are kept in a cache
+// limited to the given amount of memory. In this way we can call
+// draw() several times with the same source image (e.g. each time
+// the mouse is moved to rotate the selection) and only the final
+// parallelogram sampling is done again.
+//
+// The sampling is done in parallel (by bands of destination rows)
+// and this class doesn't use global state, so different instances
+// can be used from different threads.
+class RotSprite {
+public:
+  static constexpr std::size_t kDefaultCacheSize = 128 * 1024 * 1024;
+
+  explicit RotSprite(std::size_t maxCacheSize = kDefaultCacheSize);
+  ~RotSprite();
+
+  // Discards all the cached 8x tiles. It must be called when the
+  // pixels of the source image are modified in place (the cache is
+  // discarded automatically if draw() is called with other image).
+  void invalidate();
+
+  // Draws the "src" image (and optional "mask" bitmap with the same
+  // size as "src") in the parallelogram formed by the given corners.
+  void draw(Image* dst,
+            const Image* src,
+            const Image* mask,
+            int x1,
+            int y1,
+            int x2,
+            int y2,
+            int x3,
+            int y3,
+            int x4,
+            int y4);
+
+  // Memory used by cached tiles (in bytes).
+  std::size_t cacheSize() const;
+
+  // A piece of the 8x source image. "bounds" is the area of the 8x
+  // image covered by "image".
+  struct Tile {
+    ImageRef image;
+    gfx::Rect bounds;
+  };
+  using TileRef = std::shared_ptr<const Tile>;
+
+  // Returns the 8x tile that contains the given source pixel.
+  TileRef getTile(const Image* src, int srcX, int srcY);
+
+private:
+  using Key = int;
+  using LRU = std::list<Key>;
+  struct Entry {
+    TileRef tile;
+    std::size_t size;
+    LRU::iterator lru;
+  };
+
+  void setSource(const Image* src);
+  void shrinkCache();
+
+  mutable std::mutex m_mutex;
+  std::size_t m_maxCacheSize;
+  std::size_t m_cacheSize = 0;
+  std::unordered_map<Key, Entry> m_tiles;
+  LRU m_lru; // Most recently used tiles at the front
+  const Image* m_src = nullptr;
+  gfx::Rect m_srcBounds;
+  int m_srcFormat = -1;
+};
+
+// Draws the given image using a temporary RotSprite instance (the
+// 8x tiles are discarded after the call).
 void rotsprite_image(Image* dst,
                      const Image* src,
                      const Image* mask,
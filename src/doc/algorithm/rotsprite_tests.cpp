@@ -0,0 +1,128 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/rotsprite.h"
+
+#include "doc/algorithm/parallelogram_map.h"
+#include "doc/algorithm/random_image.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+
+using namespace doc;
+using namespace doc::algorithm;
+using namespace gfx;
+
+// Simple Scale2x of the whole image
+static ImageRef scale2x(const Image* src)
+{
+  const int w = src->width();
+  const int h = src->height();
+  ImageRef dst(Image::create(src->pixelFormat(), w * 2, h * 2));
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      color_t P = get_pixel(src, x, y);
+      color_t A = (y > 0 ? get_pixel(src, x, y - 1) : P);
+      color_t B = (x < w - 1 ? get_pixel(src, x + 1, y) : P);
+      color_t C = (x > 0 ? get_pixel(src, x - 1, y) : P);
+      color_t D = (y < h - 1 ? get_pixel(src, x, y + 1) : P);
+      put_pixel(dst.get(), 2 * x, 2 * y, (C == A && C != D && A != B ? A : P));
+      put_pixel(dst.get(), 2 * x + 1, 2 * y, (A == B && A != C && B != D ? B : P));
+      put_pixel(dst.get(), 2 * x, 2 * y + 1, (D == C && D != B && C != A ? C : P));
+      put_pixel(dst.get(), 2 * x + 1, 2 * y + 1, (B == D && B != A && D != C ? D : P));
+    }
+  }
+  return dst;
+}
+
+TEST(RotSprite, TilesMatchFullScale2x)
+{
+  for (auto pf : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED, IMAGE_BITMAP }) {
+    for (const Size size : { Size(1, 1), Size(7, 3), Size(33, 65), Size(70, 40) }) {
+      ImageRef src(Image::create(pf, size.w, size.h));
+      random_image(src.get());
+
+      ImageRef full = scale2x(scale2x(scale2x(src.get()).get()).get());
+
+      // Draw something to set the source image of the cache
+      ImageRef dst(Image::create(pf, size.w, size.h));
+      RotSprite rotsprite;
+      rotsprite.draw(dst.get(), src.get(), nullptr, 0, 0, size.w, 0, size.w, size.h, 0, size.h);
+
+      for (int y = 0; y < size.h; ++y) {
+        for (int x = 0; x < size.w; ++x) {
+          auto tile = rotsprite.getTile(src.get(), x, y);
+          for (int v = y * 8; v < y * 8 + 8; ++v) {
+            for (int u = x * 8; u < x * 8 + 8; ++u) {
+              ASSERT_EQ(get_pixel(full.get(), u, v),
+                        get_pixel(tile->image.get(), u - tile->bounds.x, v - tile->bounds.y))
+                << "Pixel format=" << pf << " Size=" << size.w << "x" << size.h << " u=" << u
+                << " v=" << v;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(RotSprite, PlainImage)
+{
+  ImageRef src(Image::create(IMAGE_INDEXED, 100, 50));
+  ImageRef dst(Image::create(IMAGE_INDEXED, 100, 50));
+  src->setMaskColor(0);
+  src->clear(5);
+  dst->clear(0);
+
+  rotsprite_image(dst.get(), src.get(), nullptr, 0, 0, 100, 0, 100, 50, 0, 50);
+  EXPECT_TRUE(is_same_image(dst.get(), src.get()));
+}
+
+TEST(RotSprite, BoundedCache)
+{
+  ImageRef src(Image::create(IMAGE_RGB, 256, 256));
+  ImageRef dst(Image::create(IMAGE_RGB, 400, 400));
+  random_image(src.get());
+
+  // Space for ~4 tiles of 288x288 RGBA pixels
+  const std::size_t maxSize = 4 * 288 * 288 * 4;
+  RotSprite rotsprite(maxSize);
+  rotsprite.draw(dst.get(), src.get(), nullptr, 200, 0, 400, 200, 200, 400, 0, 200);
+  EXPECT_LE(rotsprite.cacheSize(), maxSize);
+  EXPECT_GT(rotsprite.cacheSize(), 0u);
+}
+
+TEST(ParallelogramMap, DisjointSpans)
+{
+  ParallelogramMap map(64, 64, 10.3, 2.7, 70.1, 30.2, -15.6, 60.4);
+  ASSERT_TRUE(map.isValid());
+
+  const Rect bounds = map.bounds();
+  for (int y = bounds.y; y < bounds.y2(); ++y) {
+    const auto row = map.row(y);
+    int total = 0, expected = 0;
+    for (int x = bounds.x; x < bounds.x2(); ++x) {
+      if (map.contains(row, x, Rect(0, 0, 64, 64)))
+        ++expected;
+    }
+    for (int v = 0; v < 64; v += 16) {
+      for (int u = 0; u < 64; u += 16) {
+        int x1, x2;
+        if (map.span(row, Rect(u, v, 16, 16), bounds.x, bounds.x2(), x1, x2))
+          total += x2 - x1;
+      }
+    }
+    EXPECT_EQ(expected, total) << "y=" << y;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,58 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/algorithm/select_by_color.h"
+
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/mask.h"
+
+#include <map>
+
+namespace doc { namespace algorithm {
+
+std::vector<std::unique_ptr<Mask>> select_by_color(const Layer* layer,
+                                                   const frame_t fromFrame,
+                                                   const frame_t toFrame,
+                                                   const color_t color,
+                                                   const int fuzziness)
+{
+  std::vector<std::unique_ptr<Mask>> masks;
+  if (fromFrame > toFrame)
+    return masks;
+
+  masks.reserve(toFrame - fromFrame + 1);
+
+  // Masks already calculated for each cel data (linked cels)
+  std::map<const CelData*, const Mask*> done;
+
+  // Each Mask::byColor() call processes bands of rows of the image in
+  // parallel, so frames are processed one after the other.
+  for (frame_t frame = fromFrame; frame <= toFrame; ++frame) {
+    auto mask = std::make_unique<Mask>();
+    const Cel* cel = (layer && layer->isImage() ? layer->cel(frame) : nullptr);
+    if (cel && cel->image() && cel->image()->pixelFormat() != IMAGE_TILEMAP) {
+      auto it = done.find(cel->data());
+      if (it != done.end()) {
+        mask->copyFrom(it->second);
+      }
+      else {
+        mask->byColor(cel->image(), color, fuzziness);
+        mask->offsetOrigin(cel->x(), cel->y());
+        done[cel->data()] = mask.get();
+      }
+    }
+    masks.push_back(std::move(mask));
+  }
+  return masks;
+}
+
+}} // namespace doc::algorithm
@@ -0,0 +1,35 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_ALGORITHM_SELECT_BY_COLOR_H_INCLUDED
+#define DOC_ALGORITHM_SELECT_BY_COLOR_H_INCLUDED
+#pragma once
+
+#include "doc/color.h"
+#include "doc/frame.h"
+
+#include <memory>
+#include <vector>
+
+namespace doc {
+class Layer;
+class Mask;
+namespace algorithm {
+
+// Selects the pixels of the given color (see Mask::byColor) in the
+// cel of each frame of the [fromFrame, toFrame] range of the layer.
+// Returns one mask per frame in sprite coordinates (the mask is empty
+// if the frame doesn't have a cel). Linked cels are processed once.
+std::vector<std::unique_ptr<Mask>> select_by_color(const Layer* layer,
+                                                   frame_t fromFrame,
+                                                   frame_t toFrame,
+                                                   color_t color,
+                                                   int fuzziness);
+
+} // namespace algorithm
+} // namespace doc
+
+#endif
@@ -28,7 +28,10 @@ using namespace base::serialization::little_endian;
 
 // TODO Create a zlib wrapper for iostreams
 
-bool write_image(std::ostream& os, const Image* image, CancelIO* cancel)
+bool write_image(std::ostream& os,
+                 const Image* image,
+                 CancelIO* cancel,
+                 const int compressionLevel)
 {
   write32(os, image->id());
   write8(os, image->pixelFormat()); // Pixel format
@@ -53,7 +56,7 @@ bool write_image(std::ostream& os, const Image* image, CancelIO* cancel)
     zstream.zalloc = (alloc_func)0;
     zstream.zfree = (free_func)0;
     zstream.opaque = (voidpf)0;
-    int err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
+    int err = deflateInit(&zstream, compressionLevel);
     if (err != Z_OK)
       throw base::Exception("ZLib error %d in deflateInit().", err);
 
@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -15,7 +16,12 @@ namespace doc {
 class CancelIO;
 class Image;
 
-bool write_image(std::ostream& os, const Image* image, CancelIO* cancel = nullptr);
+// The "compressionLevel" is the zlib level used to compress the
+// pixels (-1 is the zlib default, 1 is the fastest one).
+bool write_image(std::ostream& os,
+                 const Image* image,
+                 CancelIO* cancel = nullptr,
+                 int compressionLevel = -1);
 Image* read_image(std::istream& is, bool setId = true);
 
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -381,20 +381,28 @@ void LayerImage::configureAsBackground()
 
 void LayerImage::displaceFrames(frame_t fromThis, frame_t delta)
 {
-  Sprite* sprite = this->sprite();
-
-  if (delta > 0) {
-    for (frame_t c = sprite->lastFrame(); c >= fromThis; --c) {
-      if (Cel* cel = this->cel(c))
-        moveCel(cel, c + delta);
-    }
+  // The cels are sorted by frame, and displacing all frames after
+  // "fromThis" keeps them sorted, so we can change the frame of each
+  // cel in-place (instead of calling moveCel() for each one).
+  for (auto it = findFirstCelIteratorAfter(fromThis - 1), end = m_cels.end(); it != end; ++it) {
+    Cel* cel = *it;
+    cel->setFrame(cel->frame() + delta);
+    cel->incrementVersion(); // TODO this should be in app::cmd module
   }
-  else {
-    for (frame_t c = fromThis; c <= sprite->lastFrame(); ++c) {
-      if (Cel* cel = this->cel(c))
-        moveCel(cel, c + delta);
+}
+
+void LayerImage::permuteFrames(const std::vector<frame_t>& newFrames)
+{
+  for (Cel* cel : m_cels) {
+    const frame_t frame = cel->frame();
+    if (frame >= 0 && frame < frame_t(newFrames.size()) && newFrames[frame] != frame) {
+      cel->setFrame(newFrames[frame]);
+      cel->incrementVersion(); // TODO this should be in app::cmd module
     }
   }
+  std::stable_sort(m_cels.begin(), m_cels.end(), [](const Cel* a, const Cel* b) {
+    return a->frame() < b->frame();
+  });
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -584,4 +592,10 @@ void LayerGroup::displaceFrames(frame_t fromThis, frame_t delta)
     layer->displaceFrames(fromThis, delta);
 }
 
+void LayerGroup::permuteFrames(const std::vector<frame_t>& newFrames)
+{
+  for (Layer* layer : m_layers)
+    layer->permuteFrames(newFrames);
+}
+
 } // namespace doc
@@ -17,6 +17,7 @@
 #include "doc/with_user_data.h"
 
 #include <string>
+#include <vector>
 
 namespace doc {
 
@@ -127,6 +128,10 @@ public:
   virtual void getCels(CelList& cels) const = 0;
   virtual void displaceFrames(frame_t fromThis, frame_t delta) = 0;
 
+  // Moves each cel from frame "i" to frame "newFrames[i]", where
+  // "newFrames" is a permutation of all the sprite frames.
+  virtual void permuteFrames(const std::vector<frame_t>& newFrames) = 0;
+
 private:
   std::string m_name;   // layer name
   Sprite* m_sprite;     // owner of the layer
@@ -161,6 +166,7 @@ public:
   Cel* cel(frame_t frame) const override;
   void getCels(CelList& cels) const override;
   void displaceFrames(frame_t fromThis, frame_t delta) override;
+  void permuteFrames(const std::vector<frame_t>& newFrames) override;
 
   Cel* getLastCel() const;
   CelConstIterator findCelIterator(frame_t frame) const;
@@ -216,6 +222,7 @@ public:
 
   void getCels(CelList& cels) const override;
   void displaceFrames(frame_t fromThis, frame_t delta) override;
+  void permuteFrames(const std::vector<frame_t>& newFrames) override;
 
   bool isBrowsable() const override { return isGroup() && isExpanded() && !m_layers.empty(); }
 
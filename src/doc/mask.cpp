@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -13,32 +13,214 @@
 
 #include "base/memory.h"
 #include "doc/image_impl.h"
+#include "doc/parallel_for.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+#endif
 
 namespace doc {
 
 namespace {
 
-template<typename Func>
-void for_each_mask_pixel(Mask& a, const Mask& b, Func f)
+// Bitmaps are processed in words of 64 pixels, where the bit i of a
+// word is the pixel i (the same order of pixels in each byte of a
+// bitmap row).
+using Word = uint64_t;
+
+inline int words_for(const int pixels)
+{
+  return (pixels + 63) / 64;
+}
+
+// Reads "count" pixels from the row "y" of the bitmap starting at the
+// pixel "start" (pixels outside the bitmap are 0). The pixel "start
+// + i" is the bit (i % 64) of words[i / 64].
+void read_bits(const Image* bitmap, const int y, const int start, const int count, Word* words)
 {
-  a.reserve(b.bounds());
+  const int nwords = words_for(count);
+  std::fill(words, words + nwords, 0);
+
+  const int a = std::max(start, 0);
+  const int b = std::min(start + count, bitmap->width());
+  if (a >= b)
+    return;
+
+  const uint8_t* row = bitmap->getPixelAddress(0, y);
+  for (int i = (a >> 3); i <= ((b - 1) >> 3); ++i) {
+    // Pixels of this byte inside the [a, b) range
+    const int lo = std::max(a - 8 * i, 0);
+    const int hi = std::min(b - 8 * i, 8);
+    const Word byte = row[i] & ((0xff >> (8 - hi)) & (0xff << lo));
+    if (!byte)
+      continue;
+
+    // Destination bit of the first pixel of this byte (it can be
+    // negative only for the first byte when "start" isn't aligned)
+    const int bit = 8 * i - start;
+    if (bit < 0) {
+      words[0] |= byte >> -bit;
+    }
+    else {
+      const int j = (bit >> 6);
+      const int shift = (bit & 63);
+      words[j] |= byte << shift;
+      if (shift > 56 && j + 1 < nwords)
+        words[j + 1] |= byte >> (64 - shift);
+    }
+  }
+}
+
+// Writes a whole row of the bitmap from the given words.
+void write_bits(Image* bitmap, const int y, const Word* words)
+{
+  const int w = bitmap->width();
+  const int nbytes = (w + 7) / 8;
+  uint8_t* row = bitmap->getPixelAddress(0, y);
+  for (int i = 0; i < nbytes; ++i)
+    row[i] = uint8_t(words[i >> 3] >> ((i & 7) * 8));
+
+  // Clear the unused bits of the last byte
+  if (w & 7)
+    row[nbytes - 1] &= (1 << (w & 7)) - 1;
+}
+
+inline int lowest_bit(const Word word)
+{
+  ASSERT(word);
+  int i = 0;
+  while (!(word & (Word(1) << i)))
+    ++i;
+  return i;
+}
+
+inline int highest_bit(const Word word)
+{
+  ASSERT(word);
+  int i = 63;
+  while (!(word & (Word(1) << i)))
+    --i;
+  return i;
+}
 
+// Inclusive range of accepted values for each byte of a pixel (up
+// to 4 bytes per pixel) used to select pixels by color.
+struct ChannelRanges {
+  uint8_t lo[4] = { 0, 0, 0, 0 };
+  uint8_t hi[4] = { 255, 255, 255, 255 };
+
+  void set(const int channel, const int value, const int fuzziness)
   {
-    LockImageBits<BitmapTraits> aBits(a.bitmap());
-    auto aIt = aBits.begin();
-
-    auto bounds = a.bounds();
-    for (int y = 0; y < bounds.h; ++y) {
-      for (int x = 0; x < bounds.w; ++x, ++aIt) {
-        color_t aColor = *aIt;
-        color_t bColor = (b.containsPoint(bounds.x + x, bounds.y + y) ? 1 : 0);
-        *aIt = f(aColor, bColor);
+    if (fuzziness >= 0) {
+      lo[channel] = uint8_t(std::clamp(value - fuzziness, 0, 255));
+      hi[channel] = uint8_t(std::clamp(value + fuzziness, 0, 255));
+    }
+    // A negative fuzziness doesn't accept any value
+    else {
+      lo[channel] = 255;
+      hi[channel] = 0;
+    }
+  }
+};
+
+// Sets the bits of "words" for the pixels of the row (of "w" pixels)
+// that are inside the given channel ranges.
+template<typename ImageTraits>
+void by_color_row(const uint8_t* row, const int w, const ChannelRanges& ranges, Word* words)
+{
+  using address_t = typename ImageTraits::const_address_t;
+  constexpr int bpp = ImageTraits::bytes_per_pixel;
+  const address_t p = (address_t)row;
+  int x = 0;
+
+#if defined(__x86_64__) || defined(_WIN64)
+  // Use SSE2 to compare 16 bytes at the same time (4 RGB pixels, 8
+  // grayscale pixels, or 16 indexed pixels). A byte is inside the
+  // range if both saturated subtractions (byte - hi) and (lo - byte)
+  // are zero. 64 is a multiple of the pixels of each step, so all
+  // bits of each step go to the same word.
+  {
+    alignas(16) uint8_t lo[16], hi[16];
+    for (int i = 0; i < 16; ++i) {
+      lo[i] = ranges.lo[i % bpp];
+      hi[i] = ranges.hi[i % bpp];
+    }
+    const __m128i vlo = _mm_load_si128((const __m128i*)lo);
+    const __m128i vhi = _mm_load_si128((const __m128i*)hi);
+    const __m128i zero = _mm_setzero_si128();
+    constexpr int step = 16 / bpp;
+
+    for (; x + step <= w; x += step) {
+      const __m128i c = _mm_loadu_si128((const __m128i*)(p + x));
+      const __m128i out = _mm_or_si128(_mm_subs_epu8(c, vhi), _mm_subs_epu8(vlo, c));
+      int bits;
+      if constexpr (bpp == 4) {
+        bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(out, zero)));
+      }
+      else if constexpr (bpp == 2) {
+        const __m128i in = _mm_cmpeq_epi16(out, zero);
+        bits = (_mm_movemask_epi8(_mm_packs_epi16(in, zero)) & 0xff);
       }
+      else {
+        bits = _mm_movemask_epi8(_mm_cmpeq_epi8(out, zero));
+      }
+      words[x >> 6] |= Word(bits) << (x & 63);
+    }
+  }
+#endif
+
+  for (; x < w; ++x) {
+    const color_t c = p[x];
+    bool in = true;
+    for (int i = 0; i < bpp; ++i) {
+      const int v = ((c >> (8 * i)) & 0xff);
+      in &= (v >= ranges.lo[i] && v <= ranges.hi[i]);
     }
+    if (in)
+      words[x >> 6] |= Word(1) << (x & 63);
   }
+}
+
+// Replaces each pixel of "a" with f(a, b) where "b" is the pixel of
+// the other mask in the same position (or 0 if it's outside "b"),
+// processing 64 pixels at the same time (and bands of rows in
+// parallel).
+template<typename Func>
+void combine_masks(Mask& a, const Mask& b, Func f)
+{
+  const Image* bBitmap = b.bitmap();
+  if (bBitmap)
+    a.reserve(b.bounds());
+
+  Image* aBitmap = a.bitmap();
+  if (!aBitmap)
+    return;
+
+  const gfx::Rect aBounds = a.bounds();
+  const gfx::Rect bBounds = b.bounds();
+  const int nwords = words_for(aBounds.w);
+
+  parallel_for_bands(0, aBounds.h, 256, [&](const int y1, const int y2) {
+    std::vector<Word> aWords(nwords), bWords(nwords, 0);
+    for (int y = y1; y < y2; ++y) {
+      const int by = aBounds.y + y - bBounds.y;
+      if (bBitmap && by >= 0 && by < bBounds.h)
+        read_bits(bBitmap, by, aBounds.x - bBounds.x, aBounds.w, bWords.data());
+      else
+        std::fill(bWords.begin(), bWords.end(), 0);
+
+      read_bits(aBitmap, y, 0, aBounds.w, aWords.data());
+      for (int i = 0; i < nwords; ++i)
+        aWords[i] = f(aWords[i], bWords[i]);
+      write_bits(aBitmap, y, aWords.data());
+    }
+  });
 
   a.shrink();
 }
@@ -98,14 +280,19 @@ bool Mask::isRectangular() const
   if (!m_bitmap)
     return false;
 
-  LockImageBits<BitmapTraits> bits(m_bitmap.get());
-  LockImageBits<BitmapTraits>::iterator it = bits.begin(), end = bits.end();
-
-  for (; it != end; ++it) {
-    if (*it == 0)
+  const int w = m_bounds.w;
+  const int nwords = words_for(w);
+  const Word lastWord = ((w & 63) ? (Word(1) << (w & 63)) - 1 : ~Word(0));
+  std::vector<Word> words(nwords);
+  for (int y = 0; y < m_bounds.h; ++y) {
+    read_bits(m_bitmap.get(), y, 0, w, words.data());
+    for (int i = 0; i < nwords - 1; ++i) {
+      if (words[i] != ~Word(0))
+        return false;
+    }
+    if (words[nwords - 1] != lastWord)
       return false;
   }
-
   return true;
 }
 
@@ -143,11 +330,17 @@ void Mask::invert()
   if (!m_bitmap)
     return;
 
-  LockImageBits<BitmapTraits> bits(m_bitmap.get());
-  LockImageBits<BitmapTraits>::iterator it = bits.begin(), end = bits.end();
-
-  for (; it != end; ++it)
-    *it = (*it ? 0 : 1);
+  Image* bitmap = m_bitmap.get();
+  const int nwords = words_for(m_bounds.w);
+  parallel_for_bands(0, m_bounds.h, 256, [this, bitmap, nwords](const int y1, const int y2) {
+    std::vector<Word> words(nwords);
+    for (int y = y1; y < y2; ++y) {
+      read_bits(bitmap, y, 0, m_bounds.w, words.data());
+      for (Word& word : words)
+        word = ~word;
+      write_bits(bitmap, y, words.data());
+    }
+  });
 
   shrink();
 }
@@ -167,22 +360,17 @@ void Mask::replace(const gfx::Rect& bounds)
 
 void Mask::add(const doc::Mask& mask)
 {
-  for_each_mask_pixel(*this, mask, [](color_t a, color_t b) -> color_t { return a | b; });
+  combine_masks(*this, mask, [](Word a, Word b) -> Word { return a | b; });
 }
 
 void Mask::subtract(const doc::Mask& mask)
 {
-  for_each_mask_pixel(*this, mask, [](color_t a, color_t b) -> color_t {
-    if (a)
-      return a - b;
-    else
-      return 0;
-  });
+  combine_masks(*this, mask, [](Word a, Word b) -> Word { return a & ~b; });
 }
 
 void Mask::intersect(const doc::Mask& mask)
 {
-  for_each_mask_pixel(*this, mask, [](color_t a, color_t b) -> color_t { return a & b; });
+  combine_masks(*this, mask, [](Word a, Word b) -> Word { return a & b; });
 }
 
 void Mask::add(const gfx::Rect& bounds)
@@ -247,102 +435,42 @@ void Mask::byColor(const Image* src, int color, int fuzziness)
 
   Image* dst = m_bitmap.get();
 
+  // Range of accepted values for each channel (byte) of the pixel
+  ChannelRanges ranges;
   switch (src->pixelFormat()) {
-    case IMAGE_RGB: {
-      const LockImageBits<RgbTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<RgbTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_r, src_g, src_b, src_a;
-      int dst_r, dst_g, dst_b, dst_a;
-      color_t c;
-
-      dst_r = rgba_getr(color);
-      dst_g = rgba_getg(color);
-      dst_b = rgba_getb(color);
-      dst_a = rgba_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        src_r = rgba_getr(c);
-        src_g = rgba_getg(c);
-        src_b = rgba_getb(c);
-        src_a = rgba_geta(c);
-
-        if (!((src_r >= dst_r - fuzziness) && (src_r <= dst_r + fuzziness) &&
-              (src_g >= dst_g - fuzziness) && (src_g <= dst_g + fuzziness) &&
-              (src_b >= dst_b - fuzziness) && (src_b <= dst_b + fuzziness) &&
-              (src_a >= dst_a - fuzziness) && (src_a <= dst_a + fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+    case IMAGE_RGB:
+      ranges.set(rgba_r_shift / 8, rgba_getr(color), fuzziness);
+      ranges.set(rgba_g_shift / 8, rgba_getg(color), fuzziness);
+      ranges.set(rgba_b_shift / 8, rgba_getb(color), fuzziness);
+      ranges.set(rgba_a_shift / 8, rgba_geta(color), fuzziness);
       break;
-    }
-
-    case IMAGE_GRAYSCALE: {
-      const LockImageBits<GrayscaleTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<GrayscaleTraits>::const_iterator src_it = srcBits.begin(),
-                                                     src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_k, src_a;
-      int dst_k, dst_a;
-      color_t c;
-
-      dst_k = graya_getv(color);
-      dst_a = graya_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        src_k = graya_getv(c);
-        src_a = graya_geta(c);
-
-        if (!((src_k >= dst_k - fuzziness) && (src_k <= dst_k + fuzziness) &&
-              (src_a >= dst_a - fuzziness) && (src_a <= dst_a + fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+    case IMAGE_GRAYSCALE:
+      ranges.set(graya_v_shift / 8, graya_getv(color), fuzziness);
+      ranges.set(graya_a_shift / 8, graya_geta(color), fuzziness);
       break;
-    }
-
-    case IMAGE_INDEXED: {
-      const LockImageBits<IndexedTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<IndexedTraits>::const_iterator src_it = srcBits.begin(),
-                                                   src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      color_t c, min, max;
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        if (color > fuzziness)
-          min = color - fuzziness;
-        else
-          min = 0;
-        max = color + fuzziness;
+    case IMAGE_INDEXED: ranges.set(0, color, fuzziness); break;
+    default:            return;
+  }
 
-        if (!((c >= min) && (c <= max)))
-          *dst_it = 0;
+  const int w = src->width();
+  parallel_for_bands(0, src->height(), 64, [src, dst, w, &ranges](const int y1, const int y2) {
+    std::vector<Word> words(words_for(w));
+    for (int y = y1; y < y2; ++y) {
+      std::fill(words.begin(), words.end(), 0);
+      switch (src->pixelFormat()) {
+        case IMAGE_RGB:
+          by_color_row<RgbTraits>(src->getPixelAddress(0, y), w, ranges, words.data());
+          break;
+        case IMAGE_GRAYSCALE:
+          by_color_row<GrayscaleTraits>(src->getPixelAddress(0, y), w, ranges, words.data());
+          break;
+        case IMAGE_INDEXED:
+          by_color_row<IndexedTraits>(src->getPixelAddress(0, y), w, ranges, words.data());
+          break;
       }
-      ASSERT(dst_it == dst_end);
-      break;
+      write_bits(dst, y, words.data());
     }
-  }
+  });
 
   shrink();
 }
@@ -432,57 +560,46 @@ void Mask::reserve(const gfx::Rect& bounds)
 void Mask::shrink()
 {
   // If the mask is frozen we avoid the shrinking
-  if (m_freeze_count > 0)
+  if (m_freeze_count > 0 || !m_bitmap)
     return;
 
-#define SHRINK_SIDE(u_begin, u_op, u_final, u_add, v_begin, v_op, v_final, v_add, U, V, var)       \
-  {                                                                                                \
-    for (u = u_begin; u u_op u_final; u u_add) {                                                   \
-      for (v = v_begin; v v_op v_final; v v_add) {                                                 \
-        if (get_pixel_fast<BitmapTraits>(m_bitmap.get(), U, V))                                    \
-          break;                                                                                   \
-      }                                                                                            \
-      if (v == v_final)                                                                            \
-        var;                                                                                       \
-      else                                                                                         \
-        break;                                                                                     \
-    }                                                                                              \
+  // Find the first/last rows with pixels, and the union of the pixels
+  // of all rows to find the first/last columns.
+  const int nwords = words_for(m_bounds.w);
+  std::vector<Word> words(nwords), columns(nwords, 0);
+  int y1 = -1, y2 = -1;
+  for (int y = 0; y < m_bounds.h; ++y) {
+    read_bits(m_bitmap.get(), y, 0, m_bounds.w, words.data());
+    Word any = 0;
+    for (int i = 0; i < nwords; ++i) {
+      any |= words[i];
+      columns[i] |= words[i];
+    }
+    if (any) {
+      if (y1 < 0)
+        y1 = y;
+      y2 = y;
+    }
   }
 
-  int u, v, x1, y1, x2, y2;
-
-  x1 = m_bounds.x;
-  y1 = m_bounds.y;
-  x2 = m_bounds.x + m_bounds.w - 1;
-  y2 = m_bounds.y + m_bounds.h - 1;
-
-  SHRINK_SIDE(0, <, m_bounds.w, ++, 0, <, m_bounds.h, ++, u, v, x1++);
-
-  SHRINK_SIDE(0, <, m_bounds.h, ++, 0, <, m_bounds.w, ++, v, u, y1++);
-
-  SHRINK_SIDE(m_bounds.w - 1, >, 0, --, 0, <, m_bounds.h, ++, u, v, x2--);
-
-  SHRINK_SIDE(m_bounds.h - 1, >, 0, --, 0, <, m_bounds.w, ++, v, u, y2--);
-
-  if ((x1 > x2) || (y1 > y2)) {
+  if (y1 < 0) {
     clear();
+    return;
   }
-  else if ((x1 != m_bounds.x) || (x2 != m_bounds.x + m_bounds.w - 1) || (y1 != m_bounds.y) ||
-           (y2 != m_bounds.y + m_bounds.h - 1)) {
-    u = m_bounds.x;
-    v = m_bounds.y;
-
-    m_bounds.x = x1;
-    m_bounds.y = y1;
-    m_bounds.w = x2 - x1 + 1;
-    m_bounds.h = y2 - y1 + 1;
-
-    Image* image =
-      crop_image(m_bitmap.get(), m_bounds.x - u, m_bounds.y - v, m_bounds.w, m_bounds.h, 0);
+
+  int x1 = 0, x2 = nwords - 1;
+  while (!columns[x1])
+    ++x1;
+  while (!columns[x2])
+    --x2;
+  x1 = 64 * x1 + lowest_bit(columns[x1]);
+  x2 = 64 * x2 + highest_bit(columns[x2]);
+
+  if (x1 != 0 || y1 != 0 || x2 != m_bounds.w - 1 || y2 != m_bounds.h - 1) {
+    Image* image = crop_image(m_bitmap.get(), x1, y1, x2 - x1 + 1, y2 - y1 + 1, 0);
     m_bitmap.reset(image);
+    m_bounds = gfx::Rect(m_bounds.x + x1, m_bounds.y + y1, x2 - x1 + 1, y2 - y1 + 1);
   }
-
-#undef SHRINK_SIDE
 }
 
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -91,6 +91,8 @@ public:
   void subtract(const gfx::Rect& bounds);
   void intersect(const gfx::Rect& bounds);
 
+  // Selects the pixels of the image with each channel at most
+  // "fuzziness" units far from the given color.
   void byColor(const Image* image, int color, int fuzziness);
   void crop(const Image* image);
 
@@ -0,0 +1,143 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/mask.h"
+
+#include "doc/image.h"
+#include "doc/primitives.h"
+
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+
+using namespace doc;
+
+namespace {
+
+// Mask with a random pattern of pixels (about the 50% selected).
+void random_mask(Mask& mask, const gfx::Rect& bounds)
+{
+  std::mt19937 random(bounds.w * bounds.h);
+  std::uniform_int_distribution<int> dist(0, 1);
+
+  mask.replace(bounds);
+  Image* bitmap = mask.bitmap();
+  for (int y = 0; y < bounds.h; ++y)
+    for (int x = 0; x < bounds.w; ++x)
+      if (dist(random))
+        bitmap->putPixel(x, y, 0);
+}
+
+enum Op { kAdd, kSubtract, kIntersect };
+
+} // anonymous namespace
+
+// Combines two masks of size NxN, the second one displaced
+// (N/3 + 5, N/5 + 3) pixels (an unaligned offset).
+void BM_MaskBoolOp(benchmark::State& state)
+{
+  const Op op = (Op)state.range(0);
+  const int n = state.range(1);
+
+  Mask a, b;
+  random_mask(a, gfx::Rect(0, 0, n, n));
+  random_mask(b, gfx::Rect(n / 3 + 5, n / 5 + 3, n, n));
+
+  Mask result;
+  for (auto _ : state) {
+    state.PauseTiming();
+    result.copyFrom(&a);
+    state.ResumeTiming();
+
+    switch (op) {
+      case kAdd:       result.add(b); break;
+      case kSubtract:  result.subtract(b); break;
+      case kIntersect: result.intersect(b); break;
+    }
+  }
+}
+
+void BM_MaskInvert(benchmark::State& state)
+{
+  const int n = state.range(0);
+
+  Mask mask;
+  random_mask(mask, gfx::Rect(0, 0, n, n));
+  for (auto _ : state)
+    mask.invert();
+}
+
+// Shrinks a big mask with only one selected pixel in the middle.
+void BM_MaskShrink(benchmark::State& state)
+{
+  const int n = state.range(0);
+
+  Mask mask;
+  for (auto _ : state) {
+    state.PauseTiming();
+    mask.replace(gfx::Rect(0, 0, n, n));
+    clear_image(mask.bitmap(), 0);
+    mask.bitmap()->putPixel(n / 2, n / 2, 1);
+    state.ResumeTiming();
+
+    mask.shrink();
+  }
+}
+
+void BM_MaskByColor(benchmark::State& state)
+{
+  const PixelFormat pixelFormat = (PixelFormat)state.range(0);
+  const int n = state.range(1);
+
+  std::unique_ptr<Image> image(Image::create(pixelFormat, n, n));
+  std::mt19937 random(n);
+  for (int y = 0; y < n; ++y)
+    for (int x = 0; x < n; ++x)
+      image->putPixel(x, y, random() & 0x0f0f0f0f);
+
+  Mask mask;
+  for (auto _ : state)
+    mask.byColor(image.get(), 0x01010101, 2);
+}
+
+#define DEFARGS(OP)                                                                                \
+  ->Args({ OP, 100 })->Args({ OP, 500 })->Args({ OP, 1000 })->Args({ OP, 2000 })->Args({ OP, 4000 })
+
+BENCHMARK(BM_MaskBoolOp)
+DEFARGS(kAdd)
+DEFARGS(kSubtract)
+DEFARGS(kIntersect)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+BENCHMARK(BM_MaskByColor)
+DEFARGS(IMAGE_RGB)
+DEFARGS(IMAGE_GRAYSCALE)
+DEFARGS(IMAGE_INDEXED)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+BENCHMARK(BM_MaskInvert)
+  ->Arg(100)
+  ->Arg(500)
+  ->Arg(1000)
+  ->Arg(2000)
+  ->Arg(4000)
+  ->Arg(8000)
+  ->Unit(benchmark::kMicrosecond)
+  ->UseRealTime();
+
+BENCHMARK(BM_MaskShrink)
+  ->Arg(100)
+  ->Arg(500)
+  ->Arg(1000)
+  ->Arg(2000)
+  ->Arg(4000)
+  ->Arg(8000)
+  ->Unit(benchmark::kMicrosecond)
+  ->UseRealTime();
+
+BENCHMARK_MAIN();
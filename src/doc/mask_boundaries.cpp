@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,43 +12,271 @@
 #include "doc/mask_boundaries.h"
 
 #include "doc/image_impl.h"
+#include "doc/mask.h"
+#include "doc/parallel_for.h"
+#include "doc/primitives_fast.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace doc {
 
+namespace {
+
+// Used to give a different version to each change of any
+// MaskBoundaries instance.
+std::atomic<uint32_t> g_version(0);
+
+// Division rounded towards negative infinity.
+inline int floor_div(const int a, const int b)
+{
+  return (a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+// Returns true if the pixel (x, y) (in sprite coordinates) of the
+// bitmap located at "origin" is selected.
+inline bool is_pixel_selected(const Image* bitmap,
+                              const gfx::Point& origin,
+                              const int x,
+                              const int y)
+{
+  const int u = x - origin.x;
+  const int v = y - origin.y;
+  return (u >= 0 && u < bitmap->width() && v >= 0 && v < bitmap->height() &&
+          get_pixel_fast<BitmapTraits>(bitmap, u, v));
+}
+
+// Returns true if the row "y" (in sprite coordinates) of the bitmap
+// "a" located at "aOrigin" is different from the same row of the
+// bitmap "b" located at "bOrigin".
+bool is_row_modified(const Image* a,
+                     const gfx::Point& aOrigin,
+                     const Image* b,
+                     const gfx::Point& bOrigin,
+                     const int y)
+{
+  const int ay = y - aOrigin.y;
+  const int by = y - bOrigin.y;
+  const bool aRow = (ay >= 0 && ay < a->height());
+  const bool bRow = (by >= 0 && by < b->height());
+  if (!aRow && !bRow)
+    return false;
+
+  // Same columns, compare the bytes of the row (the unused bits of
+  // the last byte of the row are ignored)
+  const int w = a->width();
+  if (aRow && bRow && aOrigin.x == bOrigin.x && w == b->width()) {
+    const int nbytes = (w + 7) / 8;
+    const uint8_t lastByteMask = ((w & 7) ? (1 << (w & 7)) - 1 : 0xff);
+    const uint8_t* p = a->getPixelAddress(0, ay);
+    const uint8_t* q = b->getPixelAddress(0, by);
+    return (std::memcmp(p, q, nbytes - 1) != 0 ||
+            ((p[nbytes - 1] ^ q[nbytes - 1]) & lastByteMask) != 0);
+  }
+
+  // Pixels outside both bitmaps are equal (not selected)
+  const int ax2 = aOrigin.x + w;
+  if (aRow) {
+    for (int x = aOrigin.x; x < ax2; ++x) {
+      if (is_pixel_selected(a, aOrigin, x, y) != is_pixel_selected(b, bOrigin, x, y))
+        return true;
+    }
+  }
+  if (bRow) {
+    for (int x = bOrigin.x; x < bOrigin.x + b->width(); ++x) {
+      if ((!aRow || x < aOrigin.x || x >= ax2) && is_pixel_selected(b, bOrigin, x, y))
+        return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
 void MaskBoundaries::reset()
 {
   m_segs.clear();
   if (!m_path.isEmpty())
     m_path.rewind();
+
+  m_bands.clear();
+  m_bandsY = 0;
+  m_bitmap.reset();
+  m_origin = gfx::Point(0, 0);
+  m_version = ++g_version;
 }
 
 void MaskBoundaries::regen(const Image* bitmap)
 {
   reset();
 
+  std::vector<int> bands(bitmap->height() / kBandRows + 1);
+  for (int i = 0; i < int(bands.size()); ++i)
+    bands[i] = i;
+
+  m_bands.resize(bands.size());
+  regenBands(bitmap, bands);
+  updateSegs(0);
+}
+
+void MaskBoundaries::regen(const Mask* mask)
+{
+  const Image* bitmap = mask->bitmap();
+  if (!bitmap) {
+    reset();
+    return;
+  }
+
+  const gfx::Point origin = mask->bounds().origin();
+  const int h = bitmap->height();
+
+  if (!m_bitmap) {
+    // The bands are aligned to the first generated mask
+    reset();
+    m_bandsY = origin.y;
+  }
+  else if (m_bitmap->width() == bitmap->width() && m_bitmap->height() == h) {
+    bool modified = false;
+    for (int y = origin.y; y < origin.y + h && !modified; ++y)
+      modified = is_row_modified(m_bitmap.get(), origin, bitmap, origin, y);
+
+    // Same bitmap, just displace the segments (and the bands)
+    if (!modified) {
+      if (origin != m_origin)
+        offset(origin.x - m_origin.x, origin.y - m_origin.y);
+      return;
+    }
+  }
+
+  // Bands that contain the grid rows of the new bitmap (the grid row
+  // "y" is the line between the pixel rows y-1 and y), re-using the
+  // bands that contain the same rows of the previous bitmap.
+  const int first = floor_div(origin.y - m_bandsY, kBandRows);
+  const int count = floor_div(origin.y + h - m_bandsY, kBandRows) - first + 1;
+  std::vector<list_type> bands(count);
+  std::vector<bool> modified(count, false);
+  for (int i = 0; i < count; ++i) {
+    const int j = first + i;
+    if (j >= 0 && j < int(m_bands.size()))
+      bands[i] = std::move(m_bands[j]);
+    else
+      modified[i] = true;
+  }
+
+  // Pixels of the row "y" are used to generate the segments of the
+  // grid rows "y" and "y+1"
+  if (m_bitmap) {
+    for (int y = origin.y - 1; y <= origin.y + h; ++y) {
+      if (!is_row_modified(m_bitmap.get(), m_origin, bitmap, origin, y))
+        continue;
+
+      for (const int gridRow : { y, y + 1 }) {
+        const int i = floor_div(gridRow - m_bandsY, kBandRows) - first;
+        if (i >= 0 && i < count)
+          modified[i] = true;
+      }
+    }
+  }
+
+  m_bands = std::move(bands);
+  m_bandsY += first * kBandRows;
+  m_bitmap.reset(Image::createCopy(bitmap));
+  m_origin = origin;
+
+  std::vector<int> modifiedBands;
+  for (int i = 0; i < count; ++i) {
+    if (modified[i])
+      modifiedBands.push_back(i);
+  }
+  regenBands(bitmap, modifiedBands);
+
+  // The segments of the bands before the first modified band are
+  // already in m_segs (if the first band is the same one)
+  updateSegs(first == 0 ? (modifiedBands.empty() ? count : modifiedBands.front()) : 0);
+}
+
+void MaskBoundaries::regenBands(const Image* bitmap, const std::vector<int>& bands)
+{
+  const int gridRows = bitmap->height() + 1;
+  parallel_for_bands(0, int(bands.size()), 4, [this, bitmap, gridRows, &bands](int a, int b) {
+    for (int i = a; i < b; ++i) {
+      const int band = bands[i];
+      list_type& segs = m_bands[band];
+
+      // Grid rows of the band in bitmap coordinates
+      const int top = m_bandsY + band * kBandRows - m_origin.y;
+      const int y0 = std::clamp(top, 0, gridRows);
+      const int y1 = std::clamp(top + kBandRows, 0, gridRows);
+      if (y0 < y1)
+        regenRows(bitmap, y0, y1, segs);
+      else
+        segs.clear();
+
+      for (Segment& seg : segs)
+        seg.offset(m_origin.x, m_origin.y);
+    }
+  });
+}
+
+void MaskBoundaries::updateSegs(const int firstBand)
+{
+  std::size_t n = 0;
+  for (int i = 0; i < firstBand; ++i)
+    n += m_bands[i].size();
+
+  ASSERT(n <= m_segs.size());
+  m_segs.erase(m_segs.begin() + std::min(n, m_segs.size()), m_segs.end());
+  for (int i = firstBand; i < int(m_bands.size()); ++i)
+    m_segs.insert(m_segs.end(), m_bands[i].begin(), m_bands[i].end());
+
+  // The path is re-created in createPathIfNeeeded()
+  if (!m_path.isEmpty())
+    m_path.rewind();
+
+  m_version = ++g_version;
+}
+
+// Generates the segments of the grid rows [y0, y1) of the bitmap
+// (the grid row "y" is the line between the pixel rows y-1 and y, so
+// there are height+1 grid rows).
+void MaskBoundaries::regenRows(const Image* bitmap, const int y0, const int y1, list_type& segs)
+{
+  segs.clear();
+
   int x, y, w = bitmap->width(), h = bitmap->height();
 
-  const LockImageBits<BitmapTraits> bits(bitmap);
-  auto it = bits.begin(); // Current pixel iterator
-#if _DEBUG
-  auto prevIt = bits.begin(); // Previous row iterator (same X pos)
-#endif
+  auto pixel = [bitmap, w, h](const int u, const int v) -> bool {
+    return (u >= 0 && u < w && v >= 0 && v < h && get_pixel_fast<BitmapTraits>(bitmap, u, v));
+  };
 
-  // Vertical segments being expanded from the previous row.
+  // Vertical segments being expanded from the previous row. The
+  // vertical edges of the last row of the previous band are added as
+  // empty segments (they are removed at the end if they don't
+  // continue in this band).
   std::vector<int> vertSegs(w + 1, -1);
+  if (y0 > 0) {
+    for (x = 0; x <= w; ++x) {
+      const bool right = pixel(x, y0 - 1);
+      if (pixel(x - 1, y0 - 1) != right) {
+        segs.push_back(Segment(right, gfx::Rect(x, y0, 0, 0)));
+        vertSegs[x] = int(segs.size() - 1);
+      }
+    }
+  }
 
   // Horizontal segment being expanded from the previous column.
   int horzSeg;
 
 #define new_hseg(open)                                                                             \
   {                                                                                                \
-    m_segs.push_back(Segment(open, gfx::Rect(x, y, 1, 0)));                                        \
-    horzSeg = int(m_segs.size() - 1);                                                              \
+    segs.push_back(Segment(open, gfx::Rect(x, y, 1, 0)));                                          \
+    horzSeg = int(segs.size() - 1);                                                                \
   }
 #define new_vseg(open)                                                                             \
   {                                                                                                \
-    m_segs.push_back(Segment(open, gfx::Rect(x, y, 0, 1)));                                        \
-    vertSegs[x] = int(m_segs.size() - 1);                                                          \
+    segs.push_back(Segment(open, gfx::Rect(x, y, 0, 1)));                                          \
+    vertSegs[x] = int(segs.size() - 1);                                                            \
   }
 #define expand_hseg()                                                                              \
   {                                                                                                \
@@ -68,17 +297,17 @@ void MaskBoundaries::regen(const Image* bitmap)
     vertSegs[x] = -1;                                                                              \
   }
 
-  for (y = 0; y <= h; ++y) {
+  for (y = y0; y < y1; ++y) {
     bool prevColor = false; // Previous color (X-1) same Y row
     horzSeg = -1;
 
     for (x = 0; x <= w; ++x) {
-      bool color = (x < w && y < h && *it ? true : false);
+      bool color = pixel(x, y);
 #if _DEBUG
-      bool prevRowColor = (x < w && y > 0 && *prevIt ? true : false);
+      bool prevRowColor = pixel(x, y - 1);
 #endif
-      Segment* hseg = (horzSeg >= 0 ? &m_segs[horzSeg] : nullptr);
-      Segment* vseg = (vertSegs[x] >= 0 ? &m_segs[vertSegs[x]] : nullptr);
+      Segment* hseg = (horzSeg >= 0 ? &segs[horzSeg] : nullptr);
+      Segment* vseg = (vertSegs[x] >= 0 ? &segs[vertSegs[x]] : nullptr);
 
       //
       // -   -
@@ -332,27 +561,34 @@ void MaskBoundaries::regen(const Image* bitmap)
       }
 
       prevColor = color;
-      if (x < w) {
-#if _DEBUG
-        if (y > 0)
-          ++prevIt;
-#endif
-        if (y < h)
-          ++it;
-      }
     }
   }
 
-  ASSERT(it == bits.end());
-  ASSERT(prevIt == bits.end());
+  if (y0 > 0) {
+    // Remove the vertical segments of the previous band that didn't
+    // continue in this band
+    auto isEmptySeg = [](const Segment& seg) {
+      return (seg.bounds().w == 0 && seg.bounds().h == 0);
+    };
+    segs.erase(std::remove_if(segs.begin(), segs.end(), isEmptySeg), segs.end());
+  }
+
 }
 
 void MaskBoundaries::offset(int x, int y)
 {
   for (Segment& seg : m_segs)
     seg.offset(x, y);
+  for (auto& band : m_bands) {
+    for (Segment& seg : band)
+      seg.offset(x, y);
+  }
 
   m_path.offset(x, y);
+  m_bandsY += y;
+  m_origin.x += x;
+  m_origin.y += y;
+  m_version = ++g_version;
 }
 
 void MaskBoundaries::createPathIfNeeeded()
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,13 +9,17 @@
 #define DOC_MASK_BOUNDARIES_H_INCLUDED
 #pragma once
 
+#include "doc/image_ref.h"
 #include "gfx/path.h"
+#include "gfx/point.h"
 #include "gfx/rect.h"
 
+#include <cstdint>
 #include <vector>
 
 namespace doc {
 class Image;
+class Mask;
 
 class MaskBoundaries {
 public:
@@ -46,6 +50,15 @@ public:
   void reset();
   void regen(const Image* bitmap);
 
+  // Generates the boundaries of the mask in sprite coordinates. A
+  // copy of the mask bitmap is kept, so in the next call only the
+  // bands of rows that were modified are re-generated, even if the
+  // mask bounds changed (or the segments are just displaced if only
+  // the origin of the mask was changed). The segments of the bands
+  // after the first modified band are copied again to the list of
+  // segments, and the path is re-created.
+  void regen(const Mask* mask);
+
   const_iterator begin() const { return m_segs.begin(); }
   const_iterator end() const { return m_segs.end(); }
   iterator begin() { return m_segs.begin(); }
@@ -56,9 +69,31 @@ public:
 
   void createPathIfNeeeded();
 
+  // Changes each time the segments are modified (different for each
+  // MaskBoundaries instance), useful to cache paths created from the
+  // segments.
+  uint32_t version() const { return m_version; }
+
 private:
+  // Number of rows of each band of segments.
+  static constexpr int kBandRows = 64;
+
+  static void regenRows(const Image* bitmap, int y0, int y1, list_type& segs);
+  void regenBands(const Image* bitmap, const std::vector<int>& bands);
+  void updateSegs(int firstBand);
+
   list_type m_segs;
   gfx::Path m_path;
+
+  // Segments of each band of kBandRows grid rows (in sprite
+  // coordinates, m_bands[i] contains the grid rows starting at
+  // m_bandsY + i*kBandRows), and a copy of the bitmap used to
+  // generate them (located at m_origin).
+  std::vector<list_type> m_bands;
+  int m_bandsY = 0;
+  ImageRef m_bitmap;
+  gfx::Point m_origin;
+  uint32_t m_version = 0;
 };
 
 } // namespace doc
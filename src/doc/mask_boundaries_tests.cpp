@@ -0,0 +1,133 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image.h"
+#include "doc/mask.h"
+#include "doc/mask_boundaries.h"
+#include "doc/mask_test_utils.h"
+
+#include <random>
+#include <set>
+#include <tuple>
+
+using namespace doc;
+using namespace gfx;
+
+namespace {
+
+// Unit edge between two pixels: x, y, vertical, open (the pixel at
+// the right/bottom side is selected).
+using Edge = std::tuple<int, int, bool, bool>;
+
+std::set<Edge> edges_from_segments(const MaskBoundaries& boundaries)
+{
+  std::set<Edge> edges;
+  for (const auto& seg : boundaries) {
+    const Rect& rc = seg.bounds();
+    if (seg.vertical()) {
+      for (int y = rc.y; y < rc.y2(); ++y)
+        EXPECT_TRUE(edges.insert(Edge(rc.x, y, true, seg.open())).second);
+    }
+    else {
+      for (int x = rc.x; x < rc.x2(); ++x)
+        EXPECT_TRUE(edges.insert(Edge(x, rc.y, false, seg.open())).second);
+    }
+  }
+  return edges;
+}
+
+std::set<Edge> edges_from_mask(const Mask& mask)
+{
+  std::set<Edge> edges;
+  const Rect bounds = mask.bounds();
+  for (int y = bounds.y; y <= bounds.y2(); ++y) {
+    for (int x = bounds.x; x <= bounds.x2(); ++x) {
+      const bool c = mask.containsPoint(x, y);
+      if (c != mask.containsPoint(x - 1, y))
+        edges.insert(Edge(x, y, true, c));
+      if (c != mask.containsPoint(x, y - 1))
+        edges.insert(Edge(x, y, false, c));
+    }
+  }
+  return edges;
+}
+
+} // anonymous namespace
+
+TEST(MaskBoundaries, EdgesOfRandomMask)
+{
+  std::mt19937 random(1234);
+  Mask mask;
+  random_mask(mask, Rect(-7, 11, 150, 200), random, 0.25);
+
+  MaskBoundaries boundaries;
+  boundaries.regen(&mask);
+  EXPECT_EQ(edges_from_mask(mask), edges_from_segments(boundaries));
+}
+
+TEST(MaskBoundaries, IncrementalRegen)
+{
+  std::mt19937 random(5678);
+  Mask mask;
+  random_mask(mask, Rect(0, 0, 97, 300), random, 0.25);
+
+  MaskBoundaries boundaries;
+  boundaries.regen(&mask);
+
+  // Modify some rows (the mask keeps its bounds)
+  Image* bitmap = mask.bitmap();
+  for (const int y : { 0, 63, 64, 130, 299 })
+    for (int x = 10; x < 20; ++x)
+      bitmap->putPixel(x, y, !bitmap->getPixel(x, y));
+
+  const uint32_t version = boundaries.version();
+  boundaries.regen(&mask);
+  EXPECT_NE(version, boundaries.version());
+
+  MaskBoundaries expected;
+  expected.regen(&mask);
+  EXPECT_EQ(edges_from_mask(mask), edges_from_segments(boundaries));
+  EXPECT_EQ(edges_from_segments(expected), edges_from_segments(boundaries));
+
+  // Only the origin changed
+  mask.setOrigin(5, 9);
+  boundaries.regen(&mask);
+  EXPECT_EQ(edges_from_mask(mask), edges_from_segments(boundaries));
+}
+
+TEST(MaskBoundaries, IncrementalRegenWithNewBounds)
+{
+  std::mt19937 random(9012);
+  Mask mask;
+  random_mask(mask, Rect(3, 100, 80, 200), random, 0.25);
+
+  MaskBoundaries boundaries;
+  boundaries.regen(&mask);
+
+  // Rectangles that grow the mask bounds in each direction (the
+  // bands of the previous mask are re-used)
+  for (const Rect& rc : { Rect(50, 90, 10, 5),
+                          Rect(-20, 150, 4, 4),
+                          Rect(70, 310, 30, 12),
+                          Rect(0, 20, 1, 1) }) {
+    mask.add(rc);
+    boundaries.regen(&mask);
+    EXPECT_EQ(edges_from_mask(mask), edges_from_segments(boundaries));
+  }
+
+  // Displaced and then modified
+  mask.setOrigin(mask.bounds().x + 7, mask.bounds().y - 33);
+  boundaries.regen(&mask);
+  mask.add(Rect(-40, -40, 3, 3));
+  boundaries.regen(&mask);
+  EXPECT_EQ(edges_from_mask(mask), edges_from_segments(boundaries));
+}
@@ -0,0 +1,63 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_MASK_TEST_UTILS_H_INCLUDED
+#define DOC_MASK_TEST_UTILS_H_INCLUDED
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include "doc/image.h"
+#include "doc/mask.h"
+#include "gfx/rect.h"
+
+#include <random>
+
+namespace doc {
+
+// Creates a selection in the given bounds with random holes (each
+// pixel is unselected with the "holes" probability).
+inline void random_mask(Mask& mask,
+                        const gfx::Rect& bounds,
+                        std::mt19937& random,
+                        const double holes = 0.5)
+{
+  mask.replace(bounds);
+  Image* bitmap = mask.bitmap();
+  std::bernoulli_distribution hole(holes);
+  for (int y = 0; y < bounds.h; ++y)
+    for (int x = 0; x < bounds.w; ++x)
+      if (hole(random))
+        bitmap->putPixel(x, y, 0);
+}
+
+// Compares the pixels of the mask in the "area" with the given
+// function (pixel by pixel).
+template<typename Func>
+::testing::AssertionResult cmp_mask(const Mask& mask, const gfx::Rect& area, Func expected)
+{
+  for (int y = area.y; y < area.y2(); ++y) {
+    for (int x = area.x; x < area.x2(); ++x) {
+      if (mask.containsPoint(x, y) != expected(x, y)) {
+        return ::testing::AssertionFailure()
+               << "Expected=" << expected(x, y) << " x=" << x << " y=" << y;
+      }
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+// Compares two masks pixel by pixel (in the union of their bounds).
+inline ::testing::AssertionResult cmp_masks(const Mask& expected, const Mask& actual)
+{
+  return cmp_mask(actual,
+                  expected.bounds().createUnion(actual.bounds()),
+                  [&expected](int x, int y) { return expected.containsPoint(x, y); });
+}
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,154 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/algorithm/select_by_color.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/mask.h"
+#include "doc/mask_test_utils.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+using namespace doc;
+using namespace gfx;
+
+TEST(Mask, BoolOpsWithOffsets)
+{
+  std::mt19937 random(1234);
+
+  for (int i = 0; i < 50; ++i) {
+    std::uniform_int_distribution<int> pos(-70, 70), size(1, 150);
+    Mask a, b;
+    random_mask(a, Rect(pos(random), pos(random), size(random), size(random)), random);
+    random_mask(b, Rect(pos(random), pos(random), size(random), size(random)), random);
+    const Rect area = a.bounds().createUnion(b.bounds()).enlarge(2);
+
+    Mask add, subtract, intersect;
+    add.copyFrom(&a);
+    subtract.copyFrom(&a);
+    intersect.copyFrom(&a);
+    add.add(b);
+    subtract.subtract(b);
+    intersect.intersect(b);
+
+    EXPECT_TRUE(cmp_mask(add, area, [&](int x, int y) {
+      return a.containsPoint(x, y) || b.containsPoint(x, y);
+    }));
+    EXPECT_TRUE(cmp_mask(subtract, area, [&](int x, int y) {
+      return a.containsPoint(x, y) && !b.containsPoint(x, y);
+    }));
+    EXPECT_TRUE(cmp_mask(intersect, area, [&](int x, int y) {
+      return a.containsPoint(x, y) && b.containsPoint(x, y);
+    }));
+  }
+}
+
+TEST(Mask, Invert)
+{
+  std::mt19937 random(5678);
+
+  Mask a, b;
+  random_mask(a, Rect(3, -5, 131, 67), random);
+  b.copyFrom(&a);
+  b.invert();
+
+  const Rect area = a.bounds();
+  EXPECT_TRUE(cmp_mask(b, area, [&](int x, int y) { return !a.containsPoint(x, y); }));
+}
+
+TEST(Mask, Shrink)
+{
+  Mask mask;
+  mask.replace(Rect(10, 20, 200, 100));
+  mask.subtract(Rect(10, 20, 200, 100));
+  EXPECT_TRUE(mask.isEmpty());
+
+  mask.replace(Rect(10, 20, 200, 100));
+  mask.subtract(Rect(10, 20, 200, 30));
+  mask.subtract(Rect(10, 20, 67, 100));
+  mask.subtract(Rect(150, 20, 60, 100));
+  EXPECT_EQ(Rect(77, 50, 73, 70), mask.bounds());
+  EXPECT_TRUE(mask.isRectangular());
+
+  mask.subtract(Rect(100, 60, 1, 1));
+  EXPECT_EQ(Rect(77, 50, 73, 70), mask.bounds());
+  EXPECT_FALSE(mask.isRectangular());
+}
+
+TEST(Mask, ByColor)
+{
+  std::mt19937 random(91011);
+  std::uniform_int_distribution<int> byte(0, 255), delta(-12, 12);
+
+  for (const PixelFormat format : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED }) {
+    const color_t color = (format == IMAGE_RGB       ? rgba(120, 80, 200, 255) :
+                           format == IMAGE_GRAYSCALE ? graya(90, 255) :
+                                                       40);
+
+    // Image with random pixels near the reference color
+    std::unique_ptr<Image> image(Image::create(format, 83, 41));
+    for (int y = 0; y < image->height(); ++y) {
+      for (int x = 0; x < image->width(); ++x) {
+        color_t c = 0;
+        for (int i = 0; i < image->bytesPerPixel(); ++i) {
+          const int v = std::clamp(int((color >> (8 * i)) & 0xff) + delta(random), 0, 255);
+          c |= (color_t(v) << (8 * i));
+        }
+        image->putPixel(x, y, (byte(random) < 16 ? color_t(byte(random)) : c));
+      }
+    }
+
+    for (const int fuzziness : { 0, 3, 10, 255 }) {
+      Mask mask;
+      mask.byColor(image.get(), color, fuzziness);
+
+      EXPECT_TRUE(cmp_mask(mask, image->bounds(), [&](int x, int y) {
+        const color_t c = image->getPixel(x, y);
+        for (int i = 0; i < image->bytesPerPixel(); ++i) {
+          const int a = ((c >> (8 * i)) & 0xff);
+          const int b = ((color >> (8 * i)) & 0xff);
+          if (a < b - fuzziness || a > b + fuzziness)
+            return false;
+        }
+        return true;
+      })) << "format=" << int(format) << " fuzziness=" << fuzziness;
+    }
+  }
+}
+
+TEST(Mask, SelectByColorInFrames)
+{
+  auto sprite = std::make_shared<Sprite>(ImageSpec(ColorMode::INDEXED, 32, 32), 256);
+  sprite->setTotalFrames(4);
+  auto layer = new LayerImage(sprite.get());
+  sprite->root()->addLayer(layer);
+
+  ImageRef image(Image::create(IMAGE_INDEXED, 8, 8));
+  clear_image(image.get(), 0);
+  fill_rect(image.get(), 2, 3, 4, 5, 7);
+  Cel* cel = new Cel(0, image);
+  cel->setPosition(10, 20);
+  layer->addCel(cel);
+  layer->addCel(Cel::MakeLink(2, cel)); // Frame 1 is empty
+
+  auto masks = algorithm::select_by_color(layer, 0, 3, 7, 0);
+  ASSERT_EQ(4, int(masks.size()));
+  EXPECT_EQ(Rect(12, 23, 3, 3), masks[0]->bounds());
+  EXPECT_TRUE(masks[1]->isEmpty());
+  EXPECT_EQ(Rect(12, 23, 3, 3), masks[2]->bounds());
+  EXPECT_TRUE(masks[3]->isEmpty());
+}
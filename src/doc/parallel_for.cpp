@@ -0,0 +1,33 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/parallel_for.h"
+
+#include "base/thread_pool.h"
+
+namespace doc {
+
+bool parallel_execute(std::function<void()>&& func)
+{
+  // Created the first time it's needed, so programs that don't
+  // process big images don't start these threads.
+  static base::thread_pool pool(
+    std::max<int>(1, int(std::thread::hardware_concurrency()) - 1));
+
+  try {
+    pool.execute(std::move(func));
+    return true;
+  }
+  catch (...) {
+    return false;
+  }
+}
+
+} // namespace doc
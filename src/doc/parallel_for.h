@@ -0,0 +1,111 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_PARALLEL_FOR_H_INCLUDED
+#define DOC_PARALLEL_FOR_H_INCLUDED
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace doc {
+
+// Returns the number of threads that can be used to process the
+// given number of items in bands of at least "minBandSize" items.
+inline int parallel_bands_count(const int items, const int minBandSize)
+{
+  const int cores = std::max<int>(1, std::thread::hardware_concurrency());
+  return std::clamp(items / std::max(1, minBandSize), 1, cores);
+}
+
+// Executes the given function in the shared pool of threads used by
+// parallel_for_bands() (with one thread less than the number of
+// cores, as the calling thread processes bands too). Returns false if
+// the function couldn't be queued.
+bool parallel_execute(std::function<void()>&& func);
+
+// Splits the [begin, end) range in bands of consecutive items (e.g.
+// image rows) and calls func(bandBegin, bandEnd) for each band from
+// the threads of a shared pool. The calling thread processes bands
+// too, and waits only for the bands that are being processed by
+// other threads, so it can be used from the pool threads (nested
+// calls) without deadlocks. Small ranges (less than 2*minBandSize
+// items) are processed completely in the calling thread.
+//
+// Each band must write to memory that isn't written by other bands
+// (e.g. different image rows). If "func" throws an exception, the
+// first one is re-thrown in the calling thread after all bands are
+// done.
+template<typename Func>
+void parallel_for_bands(const int begin, const int end, const int minBandSize, Func&& func)
+{
+  if (begin >= end)
+    return;
+
+  const int items = end - begin;
+  const int bands = parallel_bands_count(items, minBandSize);
+  if (bands <= 1) {
+    func(begin, end);
+    return;
+  }
+
+  // State shared with the queued tasks, a task that starts after all
+  // bands were processed (when this function already returned) only
+  // releases its reference to the state.
+  struct State {
+    std::atomic<int> next{ 0 };
+    std::mutex mutex;
+    std::condition_variable done;
+    int processed = 0;
+    std::exception_ptr error;
+  };
+  auto state = std::make_shared<State>();
+
+  auto process_bands = [state, &func, begin, items, bands] {
+    int i;
+    while ((i = state->next++) < bands) {
+      const int a = begin + int(std::int64_t(items) * i / bands);
+      const int b = begin + int(std::int64_t(items) * (i + 1) / bands);
+      std::exception_ptr error;
+      try {
+        func(a, b);
+      }
+      catch (...) {
+        error = std::current_exception();
+      }
+
+      const std::lock_guard lock(state->mutex);
+      if (error && !state->error)
+        state->error = error;
+      if (++state->processed == bands)
+        state->done.notify_one();
+    }
+  };
+
+  // If a task cannot be queued, the remaining bands are processed in
+  // the calling thread.
+  for (int i = 0; i < bands - 1; ++i) {
+    if (!parallel_execute(process_bands))
+      break;
+  }
+  process_bands();
+
+  std::unique_lock lock(state->mutex);
+  state->done.wait(lock, [&state, bands] { return state->processed == bands; });
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+} // namespace doc
+
+#endif
@@ -16,6 +16,7 @@
 #include "doc/dispatch.h"
 #include "doc/image_impl.h"
 #include "doc/palette.h"
+#include "doc/parallel_for.h"
 #include "doc/remap.h"
 #include "doc/rgbmap.h"
 #include "doc/tile.h"
@@ -23,7 +24,9 @@
 
 #include <city.h>
 
+#include <algorithm>
 #include <stdexcept>
+#include <type_traits>
 
 #if defined(__x86_64__) || defined(_WIN64)
   #include <emmintrin.h>
@@ -105,43 +108,60 @@ Image* crop_image(const Image* image,
   return crop_image(image, bounds.x, bounds.y, bounds.w, bounds.h, bg, buffer);
 }
 
+template<typename ImageTraits>
+static void rotate_image_templ(const Image* src, Image* dst, int angle)
+{
+  const int w = src->width();
+  const int h = src->height();
+
+  // We iterate destination rows so each thread writes its own rows
+  // (even for bitmaps, where a byte contains several pixels).
+  parallel_for_bands(0, dst->height(), std::max(1, 65536 / std::max(1, dst->width())),
+                     [=](const int y1, const int y2) {
+    for (int y = y1; y < y2; ++y) {
+      auto dstPtr = get_pixel_address_fast<ImageTraits>(dst, 0, y);
+      for (int x = 0; x < dst->width(); ++x) {
+        typename ImageTraits::pixel_t c;
+        switch (angle) {
+          case 180: c = get_pixel_fast<ImageTraits>(src, w - x - 1, h - y - 1); break;
+          case 90:  c = get_pixel_fast<ImageTraits>(src, y, h - x - 1); break;
+          default:  c = get_pixel_fast<ImageTraits>(src, w - y - 1, x); break;
+        }
+        if constexpr (std::is_same_v<ImageTraits, BitmapTraits>) {
+          put_pixel_fast<ImageTraits>(dst, x, y, c);
+        }
+        else {
+          *dstPtr = c;
+          ++dstPtr;
+        }
+      }
+    }
+  });
+}
+
 void rotate_image(const Image* src, Image* dst, int angle)
 {
   ASSERT(src);
   ASSERT(dst);
-  int x, y;
+  ASSERT(src->pixelFormat() == dst->pixelFormat());
 
   switch (angle) {
     case 180:
       ASSERT(dst->width() == src->width());
       ASSERT(dst->height() == src->height());
-
-      for (y = 0; y < src->height(); ++y)
-        for (x = 0; x < src->width(); ++x)
-          dst->putPixel(src->width() - x - 1, src->height() - y - 1, src->getPixel(x, y));
       break;
 
     case 90:
-      ASSERT(dst->width() == src->height());
-      ASSERT(dst->height() == src->width());
-
-      for (y = 0; y < src->height(); ++y)
-        for (x = 0; x < src->width(); ++x)
-          dst->putPixel(src->height() - y - 1, x, src->getPixel(x, y));
-      break;
-
     case -90:
       ASSERT(dst->width() == src->height());
       ASSERT(dst->height() == src->width());
-
-      for (y = 0; y < src->height(); ++y)
-        for (x = 0; x < src->width(); ++x)
-          dst->putPixel(y, src->width() - x - 1, src->getPixel(x, y));
       break;
 
     // bad angle
     default: throw std::invalid_argument("Invalid angle specified to rotate the image");
   }
+
+  DOC_DISPATCH_BY_COLOR_MODE(src->colorMode(), rotate_image_templ, src, dst, angle);
 }
 
 void draw_hline(Image* image, int x1, int y, int x2, color_t color)
@@ -81,6 +81,35 @@ TYPED_TEST(Primitives, IsSameImage)
   }
 }
 
+TYPED_TEST(Primitives, RotateImage)
+{
+  using ImageTraits = TypeParam;
+
+  for (const Size size : { Size(1, 1), Size(3, 7), Size(300, 257) }) {
+    const int w = size.w, h = size.h;
+    ImageRef a(Image::create(ImageTraits::pixel_format, w, h));
+    doc::algorithm::random_image(a.get());
+
+    ImageRef b(Image::create(ImageTraits::pixel_format, h, w));
+    ImageRef c(Image::create(ImageTraits::pixel_format, w, h));
+
+    rotate_image(a.get(), b.get(), 90);
+    for (int y = 0; y < h; ++y)
+      for (int x = 0; x < w; ++x)
+        ASSERT_EQ(get_pixel(a.get(), x, y), get_pixel(b.get(), h - y - 1, x));
+
+    rotate_image(a.get(), b.get(), -90);
+    for (int y = 0; y < h; ++y)
+      for (int x = 0; x < w; ++x)
+        ASSERT_EQ(get_pixel(a.get(), x, y), get_pixel(b.get(), y, w - x - 1));
+
+    rotate_image(a.get(), c.get(), 180);
+    for (int y = 0; y < h; ++y)
+      for (int x = 0; x < w; ++x)
+        ASSERT_EQ(get_pixel(a.get(), x, y), get_pixel(c.get(), w - x - 1, h - y - 1));
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -479,6 +479,18 @@ void Sprite::removeFrame(frame_t frame)
   setTotalFrames(newTotal);
 }
 
+void Sprite::permuteFrames(const std::vector<frame_t>& newFrames)
+{
+  ASSERT(newFrames.size() == m_frlens.size());
+
+  std::vector<int> frlens(m_frlens.size());
+  for (frame_t i = 0; i < m_frames; ++i)
+    frlens[newFrames[i]] = m_frlens[i];
+  m_frlens.swap(frlens);
+
+  root()->permuteFrames(newFrames);
+}
+
 void Sprite::setTotalFrames(frame_t frames)
 {
   frames = std::max(frame_t(1), frames);
@@ -179,6 +179,10 @@ public:
   void removeFrame(frame_t frame);
   void setTotalFrames(frame_t frames);
 
+  // Reorders all frames (durations and cels) moving the frame "i" to
+  // "newFrames[i]". "newFrames" must be a permutation of all frames.
+  void permuteFrames(const std::vector<frame_t>& newFrames);
+
   int frameDuration(frame_t frame) const;
   int totalAnimationDuration() const;
   void setFrameDuration(frame_t frame, int msecs);
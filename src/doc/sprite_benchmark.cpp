@@ -0,0 +1,110 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/cel.h"
+#include "doc/layer.h"
+#include "doc/sprite.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <numeric>
+#include <vector>
+
+using namespace doc;
+
+// Creates a sprite with "layers" layers and "frames" frames with one
+// cel in each frame (all cels share the same small image).
+static std::shared_ptr<Sprite> make_sprite(const int layers, const int frames)
+{
+  auto spr = std::make_shared<Sprite>(ImageSpec(ColorMode::RGB, 4, 4), 256);
+  spr->setTotalFrames(frames);
+
+  ImageRef img(Image::create(IMAGE_RGB, 4, 4));
+  for (int i = 0; i < layers; ++i) {
+    auto lay = new LayerImage(spr.get());
+    spr->root()->addLayer(lay);
+    for (frame_t f = 0; f < frames; ++f)
+      lay->addCel(new Cel(f, img));
+  }
+  return spr;
+}
+
+// Order of frames after moving the first half of the frames to the
+// end of the sprite.
+static std::vector<frame_t> move_first_half_to_end(const int frames)
+{
+  std::vector<frame_t> newFrames(frames);
+  const int half = frames / 2;
+  for (frame_t f = 0; f < frames; ++f)
+    newFrames[f] = (f < half ? f + (frames - half) : f - half);
+  return newFrames;
+}
+
+void BM_SpriteAddRemoveFrame(benchmark::State& state)
+{
+  auto spr = make_sprite(state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    spr->addFrame(0);
+    spr->removeFrame(0);
+  }
+}
+
+// Moving frames with one Layer::moveCel() for each cel (like one
+// cmd::SetCelFrame per cel).
+void BM_SpriteMoveFramesCelByCel(benchmark::State& state)
+{
+  const int frames = state.range(1);
+  auto spr = make_sprite(state.range(0), frames);
+  const std::vector<frame_t> newFrames = move_first_half_to_end(frames);
+  std::vector<frame_t> oldFrames(frames);
+  for (frame_t f = 0; f < frames; ++f)
+    oldFrames[newFrames[f]] = f;
+
+  while (state.KeepRunning()) {
+    for (const auto* order : { &newFrames, &oldFrames }) {
+      for (Layer* layer : spr->allLayers()) {
+        auto lay = static_cast<LayerImage*>(layer);
+        CelList cels;
+        lay->getCels(cels);
+        for (Cel* cel : cels)
+          lay->moveCel(cel, (*order)[cel->frame()]);
+      }
+    }
+  }
+}
+
+void BM_SpritePermuteFrames(benchmark::State& state)
+{
+  const int frames = state.range(1);
+  auto spr = make_sprite(state.range(0), frames);
+  const std::vector<frame_t> newFrames = move_first_half_to_end(frames);
+  std::vector<frame_t> oldFrames(frames);
+  for (frame_t f = 0; f < frames; ++f)
+    oldFrames[newFrames[f]] = f;
+
+  while (state.KeepRunning()) {
+    spr->permuteFrames(newFrames);
+    spr->permuteFrames(oldFrames);
+  }
+}
+
+#define DEFARGS() ->Args({ 1, 100 })->Args({ 10, 500 })->Args({ 50, 1000 })->Args({ 100, 2000 })
+
+BENCHMARK(BM_SpriteAddRemoveFrame)
+DEFARGS()->UseRealTime();
+
+BENCHMARK(BM_SpriteMoveFramesCelByCel)
+DEFARGS()->UseRealTime();
+
+BENCHMARK(BM_SpritePermuteFrames)
+DEFARGS()->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2022 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -207,6 +207,92 @@ TEST(Sprite, CelsRange)
   EXPECT_EQ(3, i);
 }
 
+//            frames
+//            0 1 2 3
+// root
+// - lay1:    A B   C
+// - grp1:
+//   - lay2:  D   E
+TEST(Sprite, AddRemovePermuteFrames)
+{
+  std::shared_ptr<Sprite> sprPtr(std::make_shared<Sprite>(ImageSpec(ColorMode::RGB, 32, 32), 256));
+  Sprite* spr = sprPtr.get();
+  spr->setTotalFrames(4);
+  for (frame_t f = 0; f < 4; ++f)
+    spr->setFrameDuration(f, 10 * (f + 1));
+
+  LayerImage* lay1 = new LayerImage(spr);
+  LayerGroup* grp1 = new LayerGroup(spr);
+  LayerImage* lay2 = new LayerImage(spr);
+  spr->root()->addLayer(lay1);
+  spr->root()->addLayer(grp1);
+  grp1->addLayer(lay2);
+
+  ImageRef img(Image::create(IMAGE_RGB, 32, 32));
+  Cel* celA = new Cel(frame_t(0), img);
+  Cel* celB = new Cel(frame_t(1), img);
+  Cel* celC = new Cel(frame_t(3), img);
+  Cel* celD = new Cel(frame_t(0), img);
+  Cel* celE = new Cel(frame_t(2), img);
+  lay1->addCel(celA);
+  lay1->addCel(celB);
+  lay1->addCel(celC);
+  lay2->addCel(celD);
+  lay2->addCel(celE);
+
+  // Insert a frame at 1
+  spr->addFrame(1);
+  ASSERT_EQ(5, spr->totalFrames());
+  EXPECT_EQ(celA, lay1->cel(0));
+  EXPECT_EQ(nullptr, lay1->cel(1));
+  EXPECT_EQ(celB, lay1->cel(2));
+  EXPECT_EQ(celC, lay1->cel(4));
+  EXPECT_EQ(celD, lay2->cel(0));
+  EXPECT_EQ(celE, lay2->cel(3));
+  EXPECT_EQ(10, spr->frameDuration(1));
+  EXPECT_EQ(20, spr->frameDuration(2));
+  EXPECT_EQ(40, spr->frameDuration(4));
+
+  // Remove it
+  spr->removeFrame(1);
+  ASSERT_EQ(4, spr->totalFrames());
+  EXPECT_EQ(celB, lay1->cel(1));
+  EXPECT_EQ(celC, lay1->cel(3));
+  EXPECT_EQ(celE, lay2->cel(2));
+  EXPECT_EQ(20, spr->frameDuration(1));
+
+  // Move frame 0 -> 2, 1 -> 0, 2 -> 3, 3 -> 1
+  spr->permuteFrames({ 2, 0, 3, 1 });
+  EXPECT_EQ(celB, lay1->cel(0));
+  EXPECT_EQ(celC, lay1->cel(1));
+  EXPECT_EQ(celA, lay1->cel(2));
+  EXPECT_EQ(nullptr, lay1->cel(3));
+  EXPECT_EQ(celD, lay2->cel(2));
+  EXPECT_EQ(celE, lay2->cel(3));
+  EXPECT_EQ(20, spr->frameDuration(0));
+  EXPECT_EQ(40, spr->frameDuration(1));
+  EXPECT_EQ(10, spr->frameDuration(2));
+  EXPECT_EQ(30, spr->frameDuration(3));
+
+  // Cels are still sorted by frame
+  CelList cels;
+  lay1->getCels(cels);
+  ASSERT_EQ(3, cels.size());
+  EXPECT_EQ(celB, cels[0]);
+  EXPECT_EQ(celC, cels[1]);
+  EXPECT_EQ(celA, cels[2]);
+
+  // Inverse permutation
+  spr->permuteFrames({ 1, 3, 0, 2 });
+  EXPECT_EQ(celA, lay1->cel(0));
+  EXPECT_EQ(celB, lay1->cel(1));
+  EXPECT_EQ(celC, lay1->cel(3));
+  EXPECT_EQ(celD, lay2->cel(0));
+  EXPECT_EQ(celE, lay2->cel(2));
+  EXPECT_EQ(10, spr->frameDuration(0));
+  EXPECT_EQ(40, spr->frameDuration(3));
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
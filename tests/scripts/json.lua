@@ -63,6 +63,9 @@ do
   assert(arr[2] == "hi")
   assert(arr[3] == true)
 
+  -- Keys are sorted
+  assert(json.encode({ b=1, a="x\n" }) == '{"a": "x\\n", "b": 1}')
+
   local obj = json.decode(json.encode({ a=4, b=true, c="name", d={1,8,{a=2}} }))
   assert(obj.a == 4)
   assert(obj.b == true)